@@ -1,5 +1,6 @@
 #include "IPlugControls.h"
 #include "IPlug_include_in_plug_src.h"
+#if IPLUG_EDITOR
 #include "IControls.h"
 #include "IPlugPaths.h"
 
@@ -66,6 +67,7 @@ public:
     }
   }
 };
+#endif
 
 IPlugControls::IPlugControls(IPlugInstanceInfo instanceInfo)
 : IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo)
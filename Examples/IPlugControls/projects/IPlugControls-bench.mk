@@ -0,0 +1,9 @@
+include ./../../common-bench.mk
+
+TARGET = ./build-bench/IPlugControls-bench
+
+SRC += IPlugControls.cpp
+
+$(TARGET): $(SRC)
+	mkdir -p $(dir $@)
+	$(CXX) $(CFLAGS) $(EXTRA_CFLAGS) -o $@ $(SRC) $(LDFLAGS)
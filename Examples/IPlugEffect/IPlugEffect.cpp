@@ -1,11 +1,14 @@
 #include "IPlugEffect.h"
 #include "IPlug_include_in_plug_src.h"
+#if IPLUG_EDITOR
 #include "IControls.h"
+#endif
 
 IPlugEffect::IPlugEffect(IPlugInstanceInfo instanceInfo)
 : IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo)
 {
   GetParam(kGain)->InitDouble("Gain", 100., 0., 100.0, 0.01, "%");
+  SetParamSmoothing(kGain, 20.);
 
 #if IPLUG_EDITOR // All UI methods and member variables should be within an IPLUG_EDITOR guard, should you want distributed UI
   mMakeGraphicsFunc = [&]() {
@@ -26,13 +29,24 @@ IPlugEffect::IPlugEffect(IPlugInstanceInfo instanceInfo)
 #if IPLUG_DSP
 void IPlugEffect::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
-  const double gain = GetParam(kGain)->Value() / 100.;
   const int nChans = NOutChansConnected();
   
-  for (int s = 0; s < nFrames; s++) {
-    for (int c = 0; c < nChans; c++) {
-      outputs[c][s] = inputs[c][s] * gain;
+  for (int offset = 0; offset < nFrames;) {
+    const int n = RenderSmoothedParams(nFrames - offset);
+    const sample* gain = GetSmoothedParamValues(kGain);
+    
+    for (int s = 0; s < n; s++) {
+      for (int c = 0; c < nChans; c++) {
+        outputs[c][offset + s] = inputs[c][offset + s] * gain[s] / 100.;
+      }
     }
+    
+    offset += n;
   }
 }
+
+void IPlugEffect::OnReset()
+{
+  ResetParamSmoothing(GetSampleRate(), GetBlockSize());
+}
 #endif
@@ -1,6 +1,8 @@
 #include "IPlugInstrument.h"
 #include "IPlug_include_in_plug_src.h"
+#if IPLUG_EDITOR
 #include "IControls.h"
+#endif
 
 IPlugInstrument::IPlugInstrument(IPlugInstanceInfo instanceInfo)
 : IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo)
@@ -64,6 +66,7 @@ void IPlugInstrument::OnIdle()
 void IPlugInstrument::OnReset()
 {
   mDSP.Reset(GetSampleRate(), GetBlockSize());
+  mMeterBallistics.Reset(GetSampleRate());
 }
 
 void IPlugInstrument::ProcessMidiMsg(const IMidiMsg& msg)
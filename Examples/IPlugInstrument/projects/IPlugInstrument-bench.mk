@@ -0,0 +1,10 @@
+include ./../../common-bench.mk
+
+TARGET = ./build-bench/IPlugInstrument-bench
+
+SRC += IPlugInstrument.cpp
+SRC += $(IPLUG_SYNTH_PATH)/*.cpp
+
+$(TARGET): $(SRC)
+	mkdir -p $(dir $@)
+	$(CXX) $(CFLAGS) $(EXTRA_CFLAGS) -o $@ $(SRC) $(LDFLAGS)
@@ -0,0 +1,25 @@
+#! /bin/sh
+
+#shell script to build and run the headless bench target for all the plugin projects in this directory that have one, e.g. on a linux CI machine
+#extra arguments are passed to each bench, e.g. ./benchall.sh -b 64,512 --json
+#the benches are built with RT_GUARD=1, so this checks for realtime violations rather than measuring representative timings
+#exits with an error if a build fails, if the RT_GUARD self-test fails, or if a bench reports a realtime violation (see IPlug/IPlugRTGuard.h) or fails to render
+
+BASEDIR=$(dirname $0)
+
+cd $BASEDIR
+
+echo "benchmarking all example plugins..."
+
+for file in *
+do
+  if [ -f "$file/projects/$file-bench.mk" ]
+  then
+    echo "building $file/projects/$file-bench.mk"
+    (cd "$file" && make -s -f "projects/$file-bench.mk" RT_GUARD=1) || exit 1
+    "$file/build-bench/$file-bench" --rt-guard-self-test || exit 1
+    "$file/build-bench/$file-bench" --fail-on-violation "$@" || exit 1
+  fi
+done
+
+echo "done"
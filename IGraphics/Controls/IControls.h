@@ -21,6 +21,8 @@
 #include "IVKeyboardControl.h"
 #include "IVMeterControl.h"
 #include "IVScopeControl.h"
+#include "IVSpectrumAnalyserControl.h"
+#include "IVDSPLoadControl.h"
 #include "IVMultiSliderControl.h"
 
 /**
@@ -200,7 +200,9 @@ bool ITextEntryControl::OnKeyDown(float x, float y, const IKeyPress& key)
 void ITextEntryControl::OnEndAnimation()
 {
   if(mEditing)
-    SetDirty(true);
+    SetDirty(true); // restarts the cursor blink
+  else
+    IControl::OnEndAnimation();
 }
 
 //static
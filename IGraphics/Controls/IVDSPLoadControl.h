@@ -0,0 +1,80 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVDSPLoadControl
+ */
+
+#include "IControl.h"
+#include "IPlugStructs.h"
+#include "IPlugProcessTimer.h"
+
+/** Vectorial DSP load meter, displaying the IProcessTimingStats measured by IPlugProcessor.
+ * The bar shows the average load, the line the 99th percentile and the text the peak load and number of overruns.
+ * Enable timing with EnableProcessTiming(true), then in OnIdle():
+ * @code
+ * IProcessTimingStats stats;
+ * if(GetProcessTimingStats(stats))
+ *   SendControlMsgFromDelegate(kCtrlTagDSPLoad, IVDSPLoadControl::kUpdateMessage, sizeof(stats), &stats);
+ * @endcode
+ * @ingroup IControls */
+class IVDSPLoadControl : public IControl
+                       , public IVectorBase
+{
+public:
+  static constexpr int kUpdateMessage = 0;
+
+  IVDSPLoadControl(IGEditorDelegate& dlg, IRECT bounds, const IText& text = DEFAULT_TEXT)
+  : IControl(dlg, bounds)
+  {
+    AttachIControl(this);
+    mText = text;
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    g.FillRect(GetColor(kBG), mRECT);
+
+    IRECT r = mRECT.GetPadded(-mPadding);
+
+    // the meter covers 0 - 100% load, the bar turns to the highlight color when the worst block is over budget
+    const IColor& barColor = mStats.mMaxLoad > 1.f ? GetColor(kHL) : GetColor(kFG);
+    g.FillRect(barColor, r.FracRectHorizontal(Clip(mStats.mAverageLoad, 0.f, 1.f)));
+
+    const float p99X = r.L + r.W() * Clip(mStats.mP99Load, 0.f, 1.f);
+    g.DrawLine(GetColor(kFR), p99X, r.T, p99X, r.B);
+
+    WDL_String str;
+    str.SetFormatted(64, "%.1f%% (peak %.0f%%, %d overruns)", mStats.mAverageLoad * 100.f, mStats.mPeakLoad * 100.f, mStats.mNOverruns);
+    g.DrawText(mText, str.Get(), r);
+  }
+
+  void OnMsgFromDelegate(int messageTag, int dataSize, const void* pData) override
+  {
+    if(messageTag != kUpdateMessage || dataSize != sizeof(IProcessTimingStats))
+      return;
+
+    IByteStream stream(pData, dataSize);
+    stream.Get(&mStats, 0);
+
+    SetDirty(false);
+  }
+
+  /** @return The most recent stats received */
+  const IProcessTimingStats& GetStats() const { return mStats; }
+
+private:
+  IProcessTimingStats mStats;
+  float mPadding = 2.f;
+};
@@ -224,8 +224,6 @@ public:
         break;
       default: break;
     }
-
-    SetDirty(false);
   }
 
   void DrawKey(IGraphics& g, const IRECT& bounds, const IColor& color)
@@ -243,10 +241,13 @@ public:
     float BKBottom = mRECT.T + mRECT.H() * mBKHeightRatio;
     float BKWidth = GetBKWidth();
 
+    // when only some keys changed, skip the keys that are not being redrawn
+    const IRECT& region = g.GetDrawRegion();
+
     // first draw white keys
     for (int i = 0; i < NKeys(); ++i)
     {
-      if (!IsBlackKey(i))
+      if (!IsBlackKey(i) && GetKeyRedrawBounds(i).Intersects(region))
       {
         float kL = *GetKeyXPos(i);
         IRECT keyBounds = IRECT(kL, mRECT.T, kL + mWKWidth, mRECT.B);
@@ -278,7 +279,7 @@ public:
     // then blacks
     for (int i = 0; i < NKeys(); ++i)
     {
-      if (IsBlackKey(i))
+      if (IsBlackKey(i) && GetKeyRedrawBounds(i).Intersects(region))
       {
         float kL = *GetKeyXPos(i);
         IRECT keyBounds = IRECT(kL, mRECT.T, kL + BKWidth, BKBottom);
@@ -392,10 +393,15 @@ public:
     SetKeyIsPressed(noteNum - mMinNote, played);
   }
 
+  /** Only the key and its neighbours' shadows are marked dirty, and only if the key changes, so that a flood of MIDI notes doesn't redraw
+   * the whole keyboard */
   void SetKeyIsPressed(int key, bool pressed)
   {
+    if (key < 0 || key >= NKeys() || mPressedKeys.Get()[key] == pressed)
+      return;
+
     mPressedKeys.Get()[key] = pressed;
-    SetDirty(false);
+    SetDirtyRect(GetKeyRedrawBounds(key));
   }
 
   void ClearNotesFromMidi()
@@ -685,6 +691,14 @@ private:
     return w;
   }
 
+  // the key, padded by a black key width to each side, as the shadows of black keys depend on the key to their right, and reach past it
+  IRECT GetKeyRedrawBounds(int i)
+  {
+    const float BKWidth = GetBKWidth();
+    const float kL = *GetKeyXPos(i);
+    return IRECT(kL - BKWidth, mRECT.T, kL + (IsBlackKey(i) ? BKWidth : mWKWidth) + BKWidth, mRECT.B);
+  }
+
   void TriggerMidiMsgFromKeyPress(int key, int velocity)
   {
     IMidiMsg msg;
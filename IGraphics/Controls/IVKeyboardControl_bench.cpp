@@ -0,0 +1,168 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of the frame time of IVKeyboardControl under a flood of MIDI chords, and of IVMultiSliderControl while
+ * sliders are dragged
+ *
+ * An 88 key keyboard and a 128 step multislider are drawn with IGraphicsBench, over a panel background. Every frame, the keyboard
+ * receives -c chords of -n notes each, each chord releasing the previous one, and one slider of the multislider is set the way a mouse
+ * drag sets it. Each frame then runs the draw loop of a platform class (IsDirty(), SetAllControlsClean(), Draw()), which is timed.
+ * This is done once with the controls redrawing only the keys and sliders that changed, and once with them redrawing all of themselves on
+ * every change, as they used to. With -s the draw loop is not strict, and draws each dirty region on its own instead of their union.
+ * With -k the sliders are left alone.
+ *
+ * Build on Linux with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -include cstdlib -DNOMINMAX -DNDEBUG -DNO_IGRAPHICS -DIGRAPHICS_LICE -D_LICE_NO_SYSBITMAPS_ -DSAMPLE_TYPE_DOUBLE -IWDL -IWDL/swell -IWDL/lice -IIPlug -IIGraphics -IIGraphics/Controls -IIGraphics/Platforms -IDependencies/IGraphics/NanoSVG/src -IDependencies/IGraphics/STB IGraphics/Controls/IVKeyboardControl_bench.cpp IGraphics/IGraphics.cpp IGraphics/IControl.cpp IGraphics/IGraphicsEditorDelegate.cpp IGraphics/Controls/IControls.cpp IGraphics/Controls/IPopupMenuControl.cpp IGraphics/Controls/ITextEntryControl.cpp IPlug/IPlugParameter.cpp IPlug/IPlugPluginBase.cpp WDL/lice/lice.cpp WDL/lice/lice_line.cpp WDL/lice/lice_arc.cpp -lpthread -o keyboardbench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "IGraphicsBench.h"
+#include "IControls.h"
+#include "IVKeyboardControl.h"
+#include "IVMultiSliderControl.h"
+
+struct Options
+{
+  int nFrames = 2000;
+  int chordsPerFrame = 4;
+  int notesPerChord = 16;
+  bool strict = true;
+  bool keyboardOnly = false;
+};
+
+static double NowSeconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** The multislider, able to set a slider the way dragging the mouse over it does */
+class BenchMultiSlider : public IVMultiSliderControl<128>
+{
+public:
+  using IVMultiSliderControl<128>::IVMultiSliderControl;
+
+  void Drag(int slider, float value)
+  {
+    IRECT track = mTrackBounds.Get()[slider];
+    OnMouseDrag(track.MW(), track.B - value * track.H(), 0.f, 0.f, IMouseMod());
+  }
+};
+
+static void Run(const Options& o, bool fullRedraw)
+{
+  IGraphicsBench::Delegate dlg;
+  IGraphicsBench g(dlg, 1040, 400);
+  g.SetStrictDrawing(o.strict);
+  g.AttachPanelBackground(COLOR_GRAY);
+
+  IVKeyboardControl* pKeyboard = new IVKeyboardControl(dlg, IRECT(20, 220, 1020, 380), 21, 108);
+  BenchMultiSlider* pSliders = new BenchMultiSlider(dlg, IRECT(20, 20, 1020, 200));
+  g.AttachControl(pKeyboard);
+  g.AttachControl(pSliders);
+  pSliders->MakeRects();
+  g.RunFrame();
+  g.GetAndResetPixelsDrawn();
+
+  std::vector<int> chord;
+  std::vector<double> times;
+  times.reserve(o.nFrames);
+  srand(1);
+
+  for (int f = 0; f < o.nFrames; f++)
+  {
+    for (int c = 0; c < o.chordsPerFrame; c++)
+    {
+      IMidiMsg msg;
+
+      for (int note : chord)
+      {
+        msg.MakeNoteOffMsg(note, 0);
+        pKeyboard->OnMidi(msg);
+
+        if (fullRedraw)
+          pKeyboard->SetDirty(false);
+      }
+
+      chord.clear();
+      const int root = 21 + rand() % (88 - o.notesPerChord);
+
+      for (int n = 0; n < o.notesPerChord; n++)
+      {
+        chord.push_back(root + n);
+        msg.MakeNoteOnMsg(root + n, 100, 0);
+        pKeyboard->OnMidi(msg);
+
+        if (fullRedraw)
+          pKeyboard->SetDirty(false);
+      }
+    }
+
+    if (!o.keyboardOnly)
+    {
+      pSliders->Drag(f % 128, (float) rand() / RAND_MAX);
+
+      if (fullRedraw)
+        pSliders->SetDirty(false);
+    }
+
+    const double t0 = NowSeconds();
+    g.RunFrame();
+    times.push_back(1e6 * (NowSeconds() - t0));
+  }
+
+  std::sort(times.begin(), times.end());
+  double sum = 0.;
+
+  for (double t : times)
+    sum += t;
+
+  printf("%-24s mean %8.1f us  p50 %8.1f us  p99 %8.1f us per frame, %8.0f pixels per frame\n", fullRedraw ? "whole control redrawn" : "changed parts redrawn",
+         sum / o.nFrames, times[o.nFrames / 2], times[std::min(o.nFrames - 1, (int) (0.99 * o.nFrames))], (double) g.GetAndResetPixelsDrawn() / o.nFrames);
+}
+
+int main(int argc, char* argv[])
+{
+  Options o;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-s"))
+      o.strict = false;
+    else if (!strcmp(argv[i], "-k"))
+      o.keyboardOnly = true;
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      o.nFrames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      o.chordsPerFrame = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      o.notesPerChord = Clip(atoi(argv[++i]), 1, 87);
+    else
+    {
+      printf("usage: %s [-s] [-k] [-f frames] [-c chords per frame] [-n notes per chord]\n", argv[0]);
+      printf("  -s  draw each dirty region on its own, see IGraphics::SetStrictDrawing()\n");
+      printf("  -k  only play chords, don't drag the sliders\n");
+      return 1;
+    }
+  }
+
+  printf("%d frames, %d chords of %d notes per frame, %s drawing\n", o.nFrames, o.chordsPerFrame, o.notesPerChord, o.strict ? "strict" : "non strict");
+  Run(o, true);
+  Run(o, false);
+  return 0;
+}
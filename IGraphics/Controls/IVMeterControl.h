@@ -17,10 +17,10 @@
  */
 
 #include "IControl.h"
-#include "IPlugQueue.h"
+#include "IPlugTripleBuffer.h"
 #include "IPlugStructs.h"
 
-/** Vectorial multichannel capable meter control
+/** Vectorial multichannel capable meter control. Each track fills to the RMS level of its channel, and its marker shows the peak level
  * @ingroup IControls */
 template <int MAXNC = 1>
 class IVMeterControl : public IVTrackControlBase
@@ -32,70 +32,113 @@ public:
   struct Data
   {
     int nchans = MAXNC;
-    float vals[MAXNC] = {};
+    float vals[MAXNC] = {}; // RMS levels
+    float peaks[MAXNC] = {}; // peak levels
 
-    bool AboveThreshold()
+    bool AboveThreshold() const
     {
       static const float threshold = (float) DBToAmp(-90.);
 
-      float sum = 0.f;
-
       for(int i = 0; i < MAXNC; i++)
       {
-        sum += vals[i];
+        if(peaks[i] > threshold)
+          return true;
       }
 
-      return std::abs(sum) > threshold;
+      return false;
     }
   };
 
-  /** Used on the DSP side in order to queue sample values and transfer data to low priority thread. */
+  /** Used on the DSP side in order to follow the peak and RMS level of each channel, and transfer the latest levels to low priority thread.
+   * Levels are published through a triple buffer once per block, so that ProcessBlock() never waits, and TransmitData() sends at most
+   * one message per call, however many blocks were processed in between */
   class IVMeterBallistics
   {
   public:
-    IVMeterBallistics(int controlTag)
+    /** @param controlTag The tag of the IVMeterControl
+     * @param peakReleaseMs The time the peak level takes to fall by 1/e (about 8.7dB)
+     * @param rmsWindowMs The time constant of the RMS average */
+    IVMeterBallistics(int controlTag, double peakReleaseMs = 300., double rmsWindowMs = 100.)
     : mControlTag(controlTag)
+    , mPeakReleaseMs(peakReleaseMs)
+    , mRMSWindowMs(rmsWindowMs)
     {
+      Reset(DEFAULT_SAMPLE_RATE);
+    }
+
+    /** Call in OnReset(), so that the ballistics follow the sample rate */
+    void Reset(double sampleRate)
+    {
+      mSamplePeriodMs = 1000. / sampleRate;
+      mBlockSize = 0;
+      memset(mPeak, 0, sizeof(mPeak));
+      memset(mMeanSquare, 0, sizeof(mMeanSquare));
     }
 
     void ProcessBlock(sample** inputs, int nFrames)
     {
-      Data d;
+      if(nFrames <= 0)
+        return;
 
+      if(nFrames != mBlockSize) // the coefficients are per block
+      {
+        mBlockSize = nFrames;
+        mPeakRelease = (float) std::exp(-nFrames * mSamplePeriodMs / mPeakReleaseMs);
+        mRMSCoeff = (float) (1. - std::exp(-nFrames * mSamplePeriodMs / mRMSWindowMs));
+      }
+
+      float peak[MAXNC] = {};
+      float sumSquares[MAXNC] = {};
+
+      // channels innermost, so that the compiler can vectorize across them
       for (auto s = 0; s < nFrames; s++)
       {
         for (auto c = 0; c < MAXNC; c++)
         {
-          d.vals[c] += std::fabs((float) inputs[c][s]);
+          const float x = (float) inputs[c][s];
+          peak[c] = std::max(peak[c], std::fabs(x));
+          sumSquares[c] += x * x;
         }
       }
 
+      Data& d = mBuffer.GetWriteBuffer();
+
       for (auto c = 0; c < MAXNC; c++)
       {
-        d.vals[c] /= (float) nFrames;
+        mPeak[c] = std::max(peak[c], mPeak[c] * mPeakRelease);
+        mMeanSquare[c] += mRMSCoeff * (sumSquares[c] / (float) nFrames - mMeanSquare[c]);
+        d.peaks[c] = mPeak[c];
+        d.vals[c] = std::sqrt(mMeanSquare[c]);
       }
 
-      if(mPrevAboveThreshold)
-        mQueue.Push(d); // TODO: expensive?
+      const bool aboveThreshold = d.AboveThreshold();
 
-      mPrevAboveThreshold = d.AboveThreshold();
+      // after silence has been published once, stop sending it
+      if(aboveThreshold || mPrevAboveThreshold)
+        mBuffer.Publish();
+
+      mPrevAboveThreshold = aboveThreshold;
     }
 
     // this must be called on the main thread - typically in MyPlugin::OnIdle()
     void TransmitData(IEditorDelegate& dlg)
     {
-      while(mQueue.ElementsAvailable())
-      {
-        Data d;
-        mQueue.Pop(d);
-        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &d);
-      }
+      if(mBuffer.Consume())
+        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), &mBuffer.GetReadBuffer());
     }
 
   private:
     int mControlTag;
+    double mPeakReleaseMs;
+    double mRMSWindowMs;
+    double mSamplePeriodMs;
+    int mBlockSize = 0;
+    float mPeakRelease = 0.f;
+    float mRMSCoeff = 1.f;
+    float mPeak[MAXNC];
+    float mMeanSquare[MAXNC];
     bool mPrevAboveThreshold = true;
-    IPlugQueue<Data> mQueue { 1024 };
+    ITripleBuffer<Data> mBuffer;
   };
 
   IVMeterControl(IGEditorDelegate& dlg, IRECT bounds, const char* trackNames = 0, ...)
@@ -109,21 +152,32 @@ public:
 
   void OnMsgFromDelegate(int messageTag, int dataSize, const void* pData) override
   {
-    IByteStream stream(pData, dataSize);
+    if(messageTag != kUpdateMessage || dataSize != sizeof(Data))
+      return;
 
-    int pos = 0;
-    Data data;
-    pos = stream.Get(&data.nchans, pos);
+    const Data* pLevels = static_cast<const Data*>(pData);
+    const int nChans = std::min(pLevels->nchans, MAXNC);
 
-    while(pos < stream.Size())
+    for (auto i = 0; i < nChans; i++)
     {
-      for (auto i = 0; i < data.nchans; i++) {
-        pos = stream.Get(&data.vals[i], pos);
-        float* pVal = GetTrackData(i);
-        *pVal = Clip(data.vals[i], 0.f, 1.f);
-      }
+      SetTrackData(i, pLevels->vals[i]);
+      mPeakData[i] = Clip(pLevels->peaks[i], 0.f, 1.f);
     }
 
     SetDirty(false);
   }
+
+private:
+  void DrawPeak(IGraphics& g, IRECT& r, int chIdx) override
+  {
+    // r is at the top of the RMS fill, the marker goes to the peak level instead
+    const IRECT peakFill = mTrackBounds.Get()[chIdx].FracRect(mDirection, mPeakData[chIdx]);
+
+    if(mDirection == kVertical)
+      g.FillRect(GetColor(kHL), IRECT(peakFill.L, peakFill.T, peakFill.R, peakFill.T + mPeakSize));
+    else
+      g.FillRect(GetColor(kHL), IRECT(peakFill.R - mPeakSize, peakFill.T, peakFill.R, peakFill.B));
+  }
+
+  float mPeakData[MAXNC] = {};
 };
@@ -44,6 +44,7 @@ public:
     yValue = std::round( yValue / mGrain ) * mGrain;
 
     int sliderTest = -1;
+    bool changed = false;
 
     for(auto i = 0; i < MaxNTracks(); i++)
     {
@@ -57,7 +58,9 @@ public:
     if (sliderTest > -1)
     {
       float* trackValue = GetTrackData(sliderTest);
-      *trackValue = mMinTrackValue + (1.f - Clip(yValue, 0.f, 1.f)) * (mMaxTrackValue - mMinTrackValue);
+      const float newValue = mMinTrackValue + (1.f - Clip(yValue, 0.f, 1.f)) * (mMaxTrackValue - mMinTrackValue);
+      changed = *trackValue != newValue;
+      *trackValue = newValue;
       OnNewValue(sliderTest, *trackValue);
 
       mSliderHit = sliderTest;
@@ -83,11 +86,17 @@ public:
           {
             trackValue = GetTrackData(i);
             float frac = (float)(i - lowBounds) / float(highBounds-lowBounds);
-            *trackValue = LERP(*GetTrackData(lowBounds), *GetTrackData(highBounds), frac);
+            const float lerpValue = LERP(*GetTrackData(lowBounds), *GetTrackData(highBounds), frac);
+            changed |= *trackValue != lerpValue;
+            *trackValue = lerpValue;
             OnNewValue(i, *trackValue);
           }
+
+          SetTracksDirty(lowBounds, highBounds);
         }
       }
+
+      SetTracksDirty(sliderTest, sliderTest);
       mPrevSliderHit = mSliderHit;
     }
     else
@@ -95,7 +104,9 @@ public:
       mSliderHit = -1;
     }
 
-    SetDirty();
+    // only the sliders that changed are redrawn, with SetTracksDirty() rather than SetDirty(), so the value change is sent separately
+    if (changed)
+      OnValueChangedFromUI();
   }
 
   //  void OnResize() override;
@@ -18,9 +18,11 @@
 
 #include "IControl.h"
 #include "IPlugStructs.h"
-#include "IPlugQueue.h"
+#include "IPlugTripleBuffer.h"
 
-/** Vectorial multichannel capable oscilloscope control
+/** Vectorial multichannel capable oscilloscope control. The trace has MAXBUF columns, each holding the minimum and maximum of the samples
+ * it covers, so that peaks are not lost however many samples are decimated into a column. Set the samples per column of the ballistics to
+ * the time window / MAXBUF. MAXBUF can be larger than the width of the control, DrawData() reduces the trace to pixel columns
  * @ingroup IControls */
 template <int MAXNC = 1, int MAXBUF = 128>
 class IVScopeControl : public IControl
@@ -33,82 +35,135 @@ public:
   struct Data
   {
     int nchans = MAXNC;
-    float vals[MAXNC][MAXBUF] = {};
+    float mins[MAXNC][MAXBUF] = {};
+    float maxs[MAXNC][MAXBUF] = {};
 
-    bool AboveThreshold()
+    bool AboveThreshold() const
     {
       static const float threshold = (float) DBToAmp(-90.);
 
-      float sum = 0.f;
-
       for(auto c = 0; c < MAXNC; c++)
       {
         for(auto s = 0; s < MAXBUF; s++)
         {
-          sum += vals[c][s];
+          if(maxs[c][s] > threshold || mins[c][s] < -threshold)
+            return true;
         }
       }
 
-      return std::abs(sum) > threshold;
+      return false;
     }
   };
 
-  /** Used on the DSP side in order to queue sample values and transfer data to low priority thread. */
+  /** Used on the DSP side in order to decimate sample values into min/max columns and transfer the latest full trace to low priority thread.
+   * Traces are published through a triple buffer, so that ProcessBlock() never waits, and TransmitData() sends at most one message per call,
+   * however many traces were completed in between */
   class IVScopeBallistics
   {
   public:
-    IVScopeBallistics(int controlTag)
+    /** @param controlTag The tag of the IVScopeControl
+     * @param samplesPerColumn The number of samples decimated into each of the MAXBUF columns */
+    IVScopeBallistics(int controlTag, int samplesPerColumn = 1)
     : mControlTag(controlTag)
     {
+      SetSamplesPerColumn(samplesPerColumn);
     }
 
-    void ProcessBlock(sample** inputs, int nFrames)
+    /** Call on the audio thread, e.g. in OnReset(). Restarts the current trace */
+    void SetSamplesPerColumn(int samplesPerColumn)
     {
-      for (auto s = 0; s < nFrames; s++)
-      {
-        if(mBufCount == MAXBUF)
-        {
-          if(mPrevAboveThreshold)
-            mQueue.Push(mBuf); // TODO: expensive?
+      mSamplesPerColumn = std::max(samplesPerColumn, 1);
+      mColumn = 0;
+      mColumnCount = 0;
+    }
 
-          mPrevAboveThreshold = mBuf.AboveThreshold();
+    void ProcessBlock(sample** inputs, int nFrames)
+    {
+      int s = 0;
 
-          mBufCount = 0;
-        }
+      while (s < nFrames)
+      {
+        Data& d = mBuffer.GetWriteBuffer();
+        const int n = std::min(nFrames - s, (MAXBUF - mColumn) * mSamplesPerColumn - mColumnCount); // up to the end of the trace
 
         for (auto c = 0; c < MAXNC; c++)
         {
-          mBuf.vals[c][mBufCount] = (float) inputs[c][s];
+          const sample* pIn = inputs[c] + s;
+
+          if(mSamplesPerColumn == 1) // no decimation, a sample per column
+          {
+            for (auto i = 0; i < n; i++)
+              d.mins[c][mColumn + i] = d.maxs[c][mColumn + i] = (float) pIn[i];
+
+            continue;
+          }
+
+          int column = mColumn;
+          int columnCount = mColumnCount;
+          int i = 0;
+
+          while (i < n)
+          {
+            const int end = i + std::min(n - i, mSamplesPerColumn - columnCount);
+            float lo = columnCount ? d.mins[c][column] : (float) pIn[i];
+            float hi = columnCount ? d.maxs[c][column] : lo;
+
+            for (; i < end; i++)
+            {
+              const float x = (float) pIn[i];
+              lo = std::min(lo, x);
+              hi = std::max(hi, x);
+            }
+
+            d.mins[c][column] = lo;
+            d.maxs[c][column] = hi;
+            columnCount = 0;
+            column++;
+          }
         }
 
-        mBufCount++;
+        s += n;
+        mColumnCount += n;
+        mColumn += mColumnCount / mSamplesPerColumn;
+        mColumnCount %= mSamplesPerColumn;
+
+        if(mColumn == MAXBUF)
+        {
+          const bool aboveThreshold = d.AboveThreshold();
+
+          // after a silent trace has been published once, stop sending it
+          if(aboveThreshold || mPrevAboveThreshold)
+            mBuffer.Publish();
+
+          mPrevAboveThreshold = aboveThreshold;
+          mColumn = 0;
+        }
       }
     }
 
     // this must be called on the main thread - typically in MyPlugin::OnIdle()
     void TransmitData(IEditorDelegate& dlg)
     {
-      Data d;
-
-      while(mQueue.ElementsAvailable())
-      {
-        mQueue.Pop(d);
-        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &d);
-      }
+      if(mBuffer.Consume())
+        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), &mBuffer.GetReadBuffer());
     }
 
   private:
-    Data mBuf;
     int mControlTag;
-    int mBufCount = 0;
-    IPlugQueue<Data> mQueue { 1024 };
+    int mSamplesPerColumn = 1;
+    int mColumn = 0;
+    int mColumnCount = 0;
     bool mPrevAboveThreshold = true;
+    ITripleBuffer<Data> mBuffer;
   };
 
   IVScopeControl(IGEditorDelegate& dlg, IRECT bounds, const char* trackNames = 0, ...)
   : IControl(dlg, bounds)
   {
     AttachIControl(this);
+
+    for (int s = 0; s < MAXBUF; s++)
+      mPointsX[2 * s] = mPointsX[2 * s + 1] = (float) s / (float) std::max(MAXBUF - 1, 1);
   }
 
   virtual void Draw(IGraphics& g) override
@@ -117,47 +172,32 @@ public:
 
     IRECT r = mRECT.GetPadded(-mPadding);
 
-    const float maxY = (r.H() / 2.f); // y +/- centre
-
-    float xPerData = r.W() / (float) MAXBUF;
-
+    // each column contributes its minimum then its maximum at the same x, DrawData() reduces them to pixel columns
     for (int c = 0; c < mBuf.nchans; c++)
     {
-      float xHi = 0.f;
-      float yHi = mBuf.vals[c][0] * maxY;
-      yHi = Clip(yHi, -maxY, maxY);
-
-      for (int s = 1; s < MAXBUF; s++)
+      for (int s = 0; s < MAXBUF; s++)
       {
-        float xLo = xHi, yLo = yHi;
-        xHi = ((float) s * xPerData);
-        yHi = mBuf.vals[c][s] * maxY;
-        yHi = Clip(yHi, -maxY, maxY);
-        g.DrawLine(GetColor(kFG), r.L + xLo, r.MH() - yLo, r.L + xHi, r.MH() - yHi);
+        mPointsY[2 * s] = Clip(0.5f + 0.5f * mBuf.mins[c][s], 0.f, 1.f);
+        mPointsY[2 * s + 1] = Clip(0.5f + 0.5f * mBuf.maxs[c][s], 0.f, 1.f);
       }
+
+      g.DrawData(GetColor(kFG), r, mPointsY, 2 * MAXBUF, mPointsX);
     }
   }
 
   void OnMsgFromDelegate(int messageTag, int dataSize, const void* pData) override
   {
-    IByteStream stream(pData, dataSize);
-
-    int pos = stream.Get(&mBuf.nchans, 0);
-
-    while(pos < stream.Size())
-    {
-      for (auto ch = 0; ch < mBuf.nchans; ch++) {
-        for (auto s = 0; s < MAXBUF; s++) {
-          pos = stream.Get(&mBuf.vals[ch][s], pos);
-        }
-      }
-    }
+    if(messageTag != kUpdateMessage || dataSize != sizeof(Data))
+      return;
 
+    memcpy(&mBuf, pData, sizeof(Data));
+    mBuf.nchans = Clip(mBuf.nchans, 0, MAXNC);
     SetDirty(false);
   }
 
 private:
   Data mBuf;
+  float mPointsX[2 * MAXBUF];
+  float mPointsY[2 * MAXBUF];
   float mPadding = 2.f;
 };
-
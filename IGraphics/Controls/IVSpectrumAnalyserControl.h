@@ -0,0 +1,130 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVSpectrumAnalyserControl
+ */
+
+#include <cmath>
+
+#include "IControl.h"
+#include "IPlugStructs.h"
+
+/** Vectorial multichannel capable spectrum analyser control, displaying log frequency bins in dB.
+ * Receives its data from a SpectrumAnalyser (IPlug/Extras/SpectrumAnalyser.h) with the same MAXNC and MAXBINS
+ * @ingroup IControls */
+template <int MAXNC = 2, int MAXBINS = 256>
+class IVSpectrumAnalyserControl : public IControl
+                                , public IVectorBase
+{
+public:
+  static constexpr int kUpdateMessage = 0;
+
+  /** @param dlg The editor delegate
+   * @param bounds The control's bounds
+   * @param minDB The level at the bottom of the display
+   * @param maxDB The level at the top of the display
+   * @param showGrid If \c true vertical lines are drawn at 100Hz, 1kHz and 10kHz */
+  IVSpectrumAnalyserControl(IGEditorDelegate& dlg, IRECT bounds, float minDB = -90.f, float maxDB = 0.f, bool showGrid = true)
+  : IControl(dlg, bounds)
+  , mMinDB(minDB)
+  , mMaxDB(maxDB)
+  , mShowGrid(showGrid)
+  {
+    AttachIControl(this);
+
+    for (auto c = 0; c < MAXNC; c++)
+    {
+      for (auto b = 0; b < MAXBINS; b++)
+        mVals[c][b] = minDB;
+    }
+  }
+
+  virtual void Draw(IGraphics& g) override
+  {
+    g.FillRect(GetColor(kBG), mRECT);
+
+    IRECT r = mRECT.GetPadded(-mPadding);
+
+    if(mShowGrid && mMaxFreq > mMinFreq)
+    {
+      const float logRange = std::log(mMaxFreq / mMinFreq);
+
+      for (float freq = 100.f; freq < mMaxFreq; freq *= 10.f)
+      {
+        if(freq <= mMinFreq)
+          continue;
+
+        const float x = r.L + r.W() * std::log(freq / mMinFreq) / logRange;
+        g.DrawLine(GetColor(kFR), x, r.T, x, r.B);
+      }
+    }
+
+    if(mNBins < 2)
+      return;
+
+    for (auto c = 0; c < mNChans; c++)
+    {
+      for (auto b = 0; b < mNBins; b++)
+        mPointsY[b] = DBToNorm(mVals[c][b]);
+
+      g.DrawData(GetColor(kFG), r, mPointsY, mNBins);
+    }
+  }
+
+  void OnMsgFromDelegate(int messageTag, int dataSize, const void* pData) override
+  {
+    if(messageTag != kUpdateMessage)
+      return;
+
+    IByteStream stream(pData, dataSize);
+
+    int nChans, nBins;
+    int pos = stream.Get(&nChans, 0);
+    pos = stream.Get(&nBins, pos);
+    pos = stream.Get(&mMinFreq, pos);
+    pos = stream.Get(&mMaxFreq, pos);
+
+    mNChans = Clip(nChans, 0, MAXNC);
+    mNBins = Clip(nBins, 0, MAXBINS);
+
+    for (auto c = 0; c < mNChans; c++)
+    {
+      // rows are always MAXBINS long, regardless of the number of bins in use
+      const int rowPos = pos + (c * MAXBINS * (int) sizeof(float));
+
+      for (auto b = 0; b < mNBins; b++)
+        stream.Get(&mVals[c][b], rowPos + (b * (int) sizeof(float)));
+    }
+
+    SetDirty(false);
+  }
+
+private:
+  float DBToNorm(float dB) const
+  {
+    return Clip((dB - mMinDB) / (mMaxDB - mMinDB), 0.f, 1.f);
+  }
+
+  float mVals[MAXNC][MAXBINS];
+  float mPointsY[MAXBINS];
+  int mNChans = 0;
+  int mNBins = 0;
+  float mMinFreq = 20.f;
+  float mMaxFreq = 20000.f;
+  float mMinDB;
+  float mMaxDB;
+  bool mShowGrid;
+  float mPadding = 2.f;
+};
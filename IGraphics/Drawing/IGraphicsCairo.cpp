@@ -143,14 +143,15 @@ void IGraphicsCairo::DrawResize()
 #endif
 }
 
-APIBitmap* IGraphicsCairo::LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext)
+// these don't use the IGraphics, so that the function from GetAPIBitmapLoader() can call them on a worker thread
+static cairo_surface_t* LoadCairoSurface(const char* fileNameOrResID, EResourceLocation location, void* pWinModuleHandle)
 {
   cairo_surface_t* pSurface = nullptr;
 
 #ifdef OS_WIN
   if (location == EResourceLocation::kWinBinary)
   {
-    PNGStreamReader reader((HINSTANCE) GetWinModuleHandle(), fileNameOrResID);
+    PNGStreamReader reader((HINSTANCE) pWinModuleHandle, fileNameOrResID);
     pSurface = cairo_image_surface_create_from_png_stream(&PNGStreamReader::StaticRead, &reader);
   }
   else
@@ -160,10 +161,10 @@ APIBitmap* IGraphicsCairo::LoadAPIBitmap(const char* fileNameOrResID, int scale,
 
   assert(!pSurface || cairo_surface_status(pSurface) == CAIRO_STATUS_SUCCESS);
 
-  return new CairoBitmap(pSurface, scale, 1.f);
+  return pSurface;
 }
 
-APIBitmap* IGraphicsCairo::ScaleAPIBitmap(const APIBitmap* pBitmap, int scale)
+static APIBitmap* ScaleCairoBitmap(const APIBitmap* pBitmap, int scale)
 {
   cairo_surface_t* pInSurface = pBitmap->GetBitmap();
   
@@ -185,6 +186,40 @@ APIBitmap* IGraphicsCairo::ScaleAPIBitmap(const APIBitmap* pBitmap, int scale)
   return new CairoBitmap(pOutSurface, scale, pBitmap->GetDrawScale());
 }
 
+APIBitmap* IGraphicsCairo::LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext)
+{
+  return new CairoBitmap(LoadCairoSurface(fileNameOrResID, location, GetWinModuleHandle()), scale, 1.f);
+}
+
+APIBitmap* IGraphicsCairo::ScaleAPIBitmap(const APIBitmap* pBitmap, int scale)
+{
+  return ScaleCairoBitmap(pBitmap, scale);
+}
+
+IGraphics::APIBitmapLoaderFunc IGraphicsCairo::GetAPIBitmapLoader(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext, int targetScale)
+{
+  const WDL_String path(fileNameOrResID);
+  void* pWinModuleHandle = GetWinModuleHandle();
+
+  return [=]() -> APIBitmap* {
+    cairo_surface_t* pSurface = LoadCairoSurface(path.Get(), location, pWinModuleHandle);
+
+    if (!pSurface)
+      return nullptr;
+
+    APIBitmap* pBitmap = new CairoBitmap(pSurface, scale, 1.f);
+
+    if (targetScale != scale)
+    {
+      APIBitmap* pScaled = ScaleCairoBitmap(pBitmap, targetScale);
+      delete pBitmap;
+      pBitmap = pScaled;
+    }
+
+    return pBitmap;
+  };
+}
+
 APIBitmap* IGraphicsCairo::CreateAPIBitmap(int width, int height)
 {
   const double scale = GetBackingPixelScale();
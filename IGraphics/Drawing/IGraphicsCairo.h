@@ -88,6 +88,7 @@ protected:
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
   APIBitmap* ScaleAPIBitmap(const APIBitmap* pBitmap, int scale) override;
   APIBitmap* CreateAPIBitmap(int width, int height) override;
+  APIBitmapLoaderFunc GetAPIBitmapLoader(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext, int targetScale) override;
 
   int AlphaChannel() const override { return 3; }
   bool FlippedBitmap() const override { return false; }
@@ -0,0 +1,155 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of IGraphics::DrawData() with LICE, against drawing a line per pair of points
+ *
+ * Draws -c channels of -n points each, every channel in its own strip of a -w pixel wide LICE_MemBitmap, for -f frames, first with one
+ * anti-aliased LICE_FLine per pair of points (what IGraphicsLice::DrawLine() does, and how IVScopeControl used to draw), then the way
+ * IGraphics::DrawData() draws with IGraphicsLice: IDataColumns::Decimate() and one LICE_FillRect() span per pixel column. The time
+ * IDataColumns::Decimate() takes on its own is printed too, as the path based backends (AGG, Cairo, NanoVG) share it and then fill a
+ * single outline of about 2 x width vertices instead of stroking a path of every point.
+ *
+ * Build on Linux with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -DNOMINMAX -DNO_IGRAPHICS -DIGRAPHICS_LICE -D_LICE_NO_SYSBITMAPS_ -IWDL -IWDL/swell -IWDL/lice -IIPlug -IIGraphics -IDependencies/IGraphics/NanoSVG/src IGraphics/Drawing/IGraphicsDrawData_bench.cpp WDL/lice/lice.cpp WDL/lice/lice_line.cpp -o drawdatabench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugLogger.h"
+#include "IPlugUtilities.h"
+#include "IGraphicsUtilities.h"
+#include "lice.h"
+
+struct Options
+{
+  int nChans = 16;
+  int nPoints = 4096;
+  int width = 1000;
+  int stripHeight = 40;
+  int nFrames = 200;
+};
+
+static double NowSeconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char* argv[])
+{
+  Options o;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      o.nChans = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      o.nPoints = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      o.width = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      o.nFrames = atoi(argv[++i]);
+    else
+    {
+      printf("usage: %s [-c channels] [-n points per channel] [-w width] [-f frames]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  LICE_MemBitmap bitmap(o.width, o.nChans * o.stripHeight);
+  const LICE_pixel color = LICE_RGBA(255, 255, 255, 255);
+  const int mode = LICE_BLIT_MODE_COPY | LICE_BLIT_USE_ALPHA;
+
+  // a different noisy sine per channel and frame, normalised as for DrawData()
+  std::vector<std::vector<float>> data(o.nChans, std::vector<float>(o.nPoints));
+  auto makeFrame = [&](int frame) {
+    for (int c = 0; c < o.nChans; c++)
+    {
+      for (int i = 0; i < o.nPoints; i++)
+        data[c][i] = 0.5f + 0.4f * std::sin(0.01f * (i + frame) * (c + 1)) + 0.05f * ((float) rand() / RAND_MAX - 0.5f);
+    }
+  };
+
+  auto getStrip = [&](int c) { return IRECT(0.f, (float) (c * o.stripHeight), (float) o.width, (float) ((c + 1) * o.stripHeight)); };
+
+  printf("%d channels x %d points, %d x %d pixels, %d frames\n", o.nChans, o.nPoints, o.width, o.nChans * o.stripHeight, o.nFrames);
+
+  // a line per pair of points
+  {
+    double t = 0.;
+
+    for (int f = 0; f < o.nFrames; f++)
+    {
+      makeFrame(f);
+      LICE_Clear(&bitmap, 0);
+      const double t0 = NowSeconds();
+
+      for (int c = 0; c < o.nChans; c++)
+      {
+        const IRECT r = getStrip(c);
+        const float xPerPoint = r.W() / (float) (o.nPoints - 1);
+
+        for (int i = 1; i < o.nPoints; i++)
+          LICE_FLine(&bitmap, r.L + (i - 1) * xPerPoint, r.B - r.H() * data[c][i - 1], r.L + i * xPerPoint, r.B - r.H() * data[c][i], color, 1.f, mode, true);
+      }
+
+      t += NowSeconds() - t0;
+    }
+
+    printf("LICE_FLine per point pair  %8.3f ms per frame\n", 1e3 * t / o.nFrames);
+  }
+
+  // DrawData(): decimated to columns, a span per column
+  {
+    IDataColumns columns;
+    double t = 0., tDecimate = 0.;
+
+    for (int f = 0; f < o.nFrames; f++)
+    {
+      makeFrame(f);
+      LICE_Clear(&bitmap, 0);
+      const double t0 = NowSeconds();
+
+      for (int c = 0; c < o.nChans; c++)
+      {
+        const IRECT r = getStrip(c);
+        const double td = NowSeconds();
+
+        if (!columns.Decimate(r, o.width, data[c].data(), o.nPoints))
+        {
+          printf("%d points fit in %d columns, nothing to decimate\n", o.nPoints, o.width);
+          return 1;
+        }
+
+        tDecimate += NowSeconds() - td;
+
+        for (int x = columns.GetFirstColumn(); x <= columns.GetLastColumn(); x++)
+        {
+          const int top = (int) columns.GetTop(x);
+          LICE_FillRect(&bitmap, (int) columns.GetColumnL(x), top, (int) columns.GetColumnW(), std::max((int) columns.GetBottom(x) - top, 1), color, 1.f, mode);
+        }
+      }
+
+      t += NowSeconds() - t0;
+    }
+
+    printf("DrawData, LICE             %8.3f ms per frame, of which IDataColumns::Decimate() %.3f ms\n", 1e3 * t / o.nFrames, 1e3 * tDecimate / o.nFrames);
+  }
+
+  return 0;
+}
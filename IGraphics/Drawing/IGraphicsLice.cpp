@@ -11,6 +11,7 @@
 #include <cmath>
 
 #include "IGraphicsLice.h"
+#include "IGraphicsLiceAtlas.h"
 #include "ITextEntryControl.h"
 
 #include "lice_combine.h"
@@ -18,6 +19,14 @@
 extern int GetSystemVersion();
 
 static StaticStorage<LICE_IFont> s_fontCache;
+static LICEFrameAtlas s_frameAtlas;
+
+// a packed bitmap that is drawn other than frame by frame is drawn whole into strip, which is freed when the caller has drawn it
+static LICE_IBitmap* GetLICEBitmap(const APIBitmap* pBitmap, LICE_MemBitmap& strip)
+{
+  LICEAtlasBitmap* pAtlasBitmap = dynamic_cast<LICEAtlasBitmap*>(const_cast<APIBitmap*>(pBitmap));
+  return pAtlasBitmap ? pAtlasBitmap->DrawStrip(strip) : pBitmap->GetBitmap();
+}
 
 #pragma mark -
 
@@ -73,17 +82,19 @@ void IGraphicsLice::DrawBitmap(IBitmap& bitmap, const IRECT& bounds, int srcX, i
   srcX *= ds;
   srcY *= ds;
   
-  LICE_IBitmap* pLB = bitmap.GetAPIBitmap()->GetBitmap();
   IRECT r = sr.Intersect(sdr);
   srcX += r.L - sr.L;
   srcY += r.T - sr.T;
-  LICE_Blit(mRenderBitmap, pLB, r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend));
+
+  // packed bitmaps are blitted from the frame in the atlas, and clipped to it
+  LICEAtlasBitmap::Blit(mRenderBitmap, bitmap, r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend));
 }
 
 void IGraphicsLice::DrawRotatedBitmap(IBitmap& bitmap, float destCtrX, float destCtrY, double angle, int yOffsetZeroDeg, const IBlend* pBlend)
 {
   const int ds = GetScreenScale();
-  LICE_IBitmap* pLB = bitmap.GetAPIBitmap()->GetBitmap();
+  LICE_MemBitmap strip;
+  LICE_IBitmap* pLB = GetLICEBitmap(bitmap.GetAPIBitmap(), strip);
   
   int W = bitmap.W() * ds;
   int H = bitmap.H() * ds;
@@ -98,9 +109,10 @@ void IGraphicsLice::DrawRotatedMask(IBitmap& base, IBitmap& mask, IBitmap& top,
   x = TransformX(x);
   y = TransformY(y);
   
-  LICE_IBitmap* pBase = base.GetAPIBitmap()->GetBitmap();
-  LICE_IBitmap* pMask = mask.GetAPIBitmap()->GetBitmap();
-  LICE_IBitmap* pTop = top.GetAPIBitmap()->GetBitmap();
+  LICE_MemBitmap baseStrip, maskStrip, topStrip;
+  LICE_IBitmap* pBase = GetLICEBitmap(base.GetAPIBitmap(), baseStrip);
+  LICE_IBitmap* pMask = GetLICEBitmap(mask.GetAPIBitmap(), maskStrip);
+  LICE_IBitmap* pTop = GetLICEBitmap(top.GetAPIBitmap(), topStrip);
   
   int W = base.W();
   int H = base.H();
@@ -127,7 +139,8 @@ void IGraphicsLice::DrawFittedBitmap(IBitmap& bitmap, const IRECT& bounds, const
 {
   // TODO - clipping
   IRECT r = TransformRECT(bounds);
-  LICE_IBitmap* pSrc = bitmap.GetAPIBitmap()->GetBitmap();
+  LICE_MemBitmap strip;
+  LICE_IBitmap* pSrc = GetLICEBitmap(bitmap.GetAPIBitmap(), strip);
   LICE_ScaledBlit(mRenderBitmap, pSrc, r.L, r.T, r.W(), r.H(), 0.0f, 0.0f, (float) pSrc->getWidth(), (float) pSrc->getHeight(), BlendWeight(pBlend), LiceBlendMode(pBlend) | LICE_BLIT_FILTER_BILINEAR);
 }
 
@@ -475,7 +488,8 @@ bool IGraphicsLice::BitmapExtSupported(const char* ext)
   return false;
 }
 
-APIBitmap* IGraphicsLice::LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext)
+// these don't use the IGraphics, so that the function from GetAPIBitmapLoader() can call them on a worker thread
+static LICE_IBitmap* LoadLICEBitmap(const char* fileNameOrResID, EResourceLocation location, const char* ext, void* pWinModuleHandle)
 {
   char extLower[32];
   ToLower(extLower, ext);
@@ -486,10 +500,10 @@ APIBitmap* IGraphicsLice::LoadAPIBitmap(const char* fileNameOrResID, int scale,
   {
 #if defined OS_WIN
     if (location == EResourceLocation::kWinBinary)
-      return new LICEBitmap(LICE_LoadPNGFromResource((HINSTANCE) GetWinModuleHandle(), fileNameOrResID, 0), scale);
+      return LICE_LoadPNGFromResource((HINSTANCE) pWinModuleHandle, fileNameOrResID, 0);
     else
 #endif
-      return new LICEBitmap(LICE_LoadPNG(fileNameOrResID), scale);
+      return LICE_LoadPNG(fileNameOrResID);
   }
 
 #ifdef LICE_JPEG_SUPPORT
@@ -499,26 +513,73 @@ APIBitmap* IGraphicsLice::LoadAPIBitmap(const char* fileNameOrResID, int scale,
   {
     #if defined OS_WIN
     if (location == EResourceLocation::kWinBinary)
-      return new LICEBitmap(LICE_LoadJPGFromResource((HINSTANCE)GetWinModuleHandle(), fileNameOrResID, 0), scale);
+      return LICE_LoadJPGFromResource((HINSTANCE) pWinModuleHandle, fileNameOrResID, 0);
     else
     #endif
-      return new LICEBitmap(LICE_LoadJPG(fileNameOrResID), scale);
+      return LICE_LoadJPG(fileNameOrResID);
   }
 #endif
 
   return nullptr;
 }
 
+static LICE_IBitmap* ScaleLICEBitmap(LICE_IBitmap* pSrc, int destW, int destH)
+{
+  LICE_MemBitmap* pDest = new LICE_MemBitmap(destW, destH);
+  LICE_ScaledBlit(pDest, pSrc, 0, 0, destW, destH, 0.0f, 0.0f, (float) pSrc->getWidth(), (float) pSrc->getHeight(), 1.0f, LICE_BLIT_MODE_COPY | LICE_BLIT_FILTER_BILINEAR);
+  return pDest;
+}
+
+APIBitmap* IGraphicsLice::LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext)
+{
+  LICE_IBitmap* pBitmap = LoadLICEBitmap(fileNameOrResID, location, ext, GetWinModuleHandle());
+  return pBitmap ? new LICEBitmap(pBitmap, scale) : nullptr;
+}
+
 APIBitmap* IGraphicsLice::ScaleAPIBitmap(const APIBitmap* pBitmap, int scale)
 {
   int destW = (pBitmap->GetWidth() / pBitmap->GetScale()) * scale;
   int destH = (pBitmap->GetHeight() / pBitmap->GetScale()) * scale;
   
-  LICE_IBitmap* pSrc = pBitmap->GetBitmap();
-  LICE_MemBitmap* pDest = new LICE_MemBitmap(destW, destH);
-  LICE_ScaledBlit(pDest, pSrc, 0, 0, destW, destH, 0.0f, 0.0f, (float) pSrc->getWidth(), (float) pSrc->getHeight(), 1.0f, LICE_BLIT_MODE_COPY | LICE_BLIT_FILTER_BILINEAR);
-  
-  return new LICEBitmap(pDest, scale);
+  // a packed bitmap is scaled frame by frame, without making the whole strip at its own size
+  if (LICEAtlasBitmap* pAtlasBitmap = dynamic_cast<LICEAtlasBitmap*>(const_cast<APIBitmap*>(pBitmap)))
+  {
+    LICE_MemBitmap* pDest = new LICE_MemBitmap(destW, destH);
+    pAtlasBitmap->DrawStrip(pDest, destW, destH);
+    return new LICEBitmap(pDest, scale);
+  }
+
+  return new LICEBitmap(ScaleLICEBitmap(pBitmap->GetBitmap(), destW, destH), scale);
+}
+
+APIBitmap* IGraphicsLice::PackAPIBitmap(const APIBitmap* pBitmap, int nStates, bool framesAreHorizontal)
+{
+#if FRAME_ATLAS
+  if (LICE_IBitmap* pStrip = pBitmap->GetBitmap())
+    return LICEAtlasBitmap::Create(s_frameAtlas, pStrip, pBitmap->GetScale(), nStates, framesAreHorizontal, FRAME_ATLAS_COMPRESS);
+#endif
+
+  return nullptr;
+}
+
+IGraphics::APIBitmapLoaderFunc IGraphicsLice::GetAPIBitmapLoader(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext, int targetScale)
+{
+  const WDL_String path(fileNameOrResID);
+  const WDL_String extension(ext);
+  void* pWinModuleHandle = GetWinModuleHandle();
+
+  return [=]() -> APIBitmap* {
+    LICE_IBitmap* pBitmap = LoadLICEBitmap(path.Get(), location, extension.Get(), pWinModuleHandle);
+
+    if (pBitmap && targetScale != scale)
+    {
+      LICE_IBitmap* pScaled = ScaleLICEBitmap(pBitmap, (pBitmap->getWidth() / scale) * targetScale, (pBitmap->getHeight() / scale) * targetScale);
+      delete pBitmap;
+      pBitmap = pScaled;
+    }
+
+    return pBitmap ? new LICEBitmap(pBitmap, targetScale) : nullptr;
+  };
 }
 
 APIBitmap* IGraphicsLice::CreateAPIBitmap(int width, int height)
@@ -115,6 +115,8 @@ protected:
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
   APIBitmap* ScaleAPIBitmap(const APIBitmap* pBitmap, int scale) override;
   APIBitmap* CreateAPIBitmap(int width, int height) override;
+  APIBitmapLoaderFunc GetAPIBitmapLoader(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext, int targetScale) override;
+  APIBitmap* PackAPIBitmap(const APIBitmap* pBitmap, int nStates, bool framesAreHorizontal) override;
 
   int AlphaChannel() const override { return LICE_PIXEL_A; }
   bool FlippedBitmap() const override { return false; }
@@ -0,0 +1,621 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief LICEFrameAtlas and LICEAtlasBitmap, which hold the frames of film strip bitmaps for IGraphicsLice in less memory
+ */
+
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+
+#include "IGraphicsStructs.h"
+#include "ptrlist.h"
+#include "heapbuf.h"
+#include "lice.h"
+
+/** Holds the frames of film strip bitmaps, each frame once however many strips it is in. Identical frames are found by a hash of their
+ * pixels, then compared pixel by pixel. A frame is either packed into a page, a bitmap shared by many frames that is FRAME_ATLAS_PAGE_WIDTH
+ * pixels wide and grows in height up to FRAME_ATLAS_PAGE_HEIGHT, or compressed, as runs of identical pixels and the pixels in between.
+ * Compressed frames are decompressed when they are drawn, into a least recently used list of FRAME_ATLAS_HOT_FRAMES bitmaps, so that the
+ * frames of the controls that are moving stay decompressed. Pages are packed in shelves, rows of frames of the same height or less, which
+ * fit the equally sized frames of strips well. They are narrow, as blitting a frame from a wide page touches more memory pages per row.
+ * The space of frames that are removed is only reused once all the frames of their page are removed.
+ * Not thread safe: used on the UI thread, where bitmaps are loaded and drawn. */
+class LICEFrameAtlas
+{
+public:
+  LICEFrameAtlas(int pageWidth = FRAME_ATLAS_PAGE_WIDTH, int pageHeight = FRAME_ATLAS_PAGE_HEIGHT, int nHotFrames = FRAME_ATLAS_HOT_FRAMES)
+  : mPageWidth(pageWidth)
+  , mPageHeight(pageHeight)
+  , mMaxHotFrames(std::max(nHotFrames, 1))
+  {
+  }
+
+  LICEFrameAtlas(const LICEFrameAtlas&) = delete;
+  LICEFrameAtlas& operator=(const LICEFrameAtlas&) = delete;
+
+  ~LICEFrameAtlas()
+  {
+    mFrames.Empty(true);
+    mPages.Empty(true);
+    mHotFrames.Empty(true);
+  }
+
+  /** Adds a frame, or a reference to an identical frame that was added before
+   * @param pSrc The bitmap the frame is in, e.g. a film strip
+   * @param compress \c true to store the frame compressed, if it is not identical to one that is stored already
+   * @return The index of the frame, to pass to GetFrame() and ReleaseFrame() */
+  int AddFrame(LICE_IBitmap* pSrc, int srcX, int srcY, int w, int h, bool compress)
+  {
+    const LICE_pixel* pSrcBits = pSrc->getBits() + srcY * pSrc->getRowSpan() + srcX;
+    const int srcSpan = pSrc->getRowSpan();
+    const uint64_t hash = Hash(pSrcBits, srcSpan, w, h);
+    auto range = mFramesByHash.equal_range(hash);
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      Frame* pFrame = mFrames.Get(it->second);
+
+      if (pFrame->w == w && pFrame->h == h && Equals(it->second, pSrcBits, srcSpan))
+      {
+        pFrame->refs++;
+        return it->second;
+      }
+    }
+
+    Frame* pFrame = new Frame;
+    pFrame->hash = hash;
+    pFrame->w = w;
+    pFrame->h = h;
+
+    if (compress)
+      Compress(pSrcBits, srcSpan, w, h, pFrame->packed);
+    else
+    {
+      Page* pPage = Alloc(w, h, pFrame->page, pFrame->x, pFrame->y);
+      LICE_Blit(pPage->bitmap, pSrc, pFrame->x, pFrame->y, srcX, srcY, w, h, 1.f, LICE_BLIT_MODE_COPY);
+      pPage->nFrames++;
+    }
+
+    int idx = mFrames.Find(nullptr);
+
+    if (idx < 0)
+    {
+      idx = mFrames.GetSize();
+      mFrames.Add(pFrame);
+    }
+    else
+      mFrames.Set(idx, pFrame);
+
+    mFramesByHash.emplace(hash, idx);
+    return idx;
+  }
+
+  /** Removes a reference to a frame added with AddFrame(), and the frame with the last one */
+  void ReleaseFrame(int idx)
+  {
+    Frame* pFrame = mFrames.Get(idx);
+
+    if (!pFrame || --pFrame->refs > 0)
+      return;
+
+    auto range = mFramesByHash.equal_range(pFrame->hash);
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second == idx)
+      {
+        mFramesByHash.erase(it);
+        break;
+      }
+    }
+
+    if (pFrame->pHot)
+    {
+      pFrame->pHot->pFrame = nullptr;
+      mHotFrames.Delete(mHotFrames.Find(pFrame->pHot), true);
+    }
+
+    if (pFrame->page >= 0 && !--mPages.Get(pFrame->page)->nFrames)
+    {
+      // an empty page is freed, and left in the list as nullptr unless it is the last, so that the indices of the others don't change
+      delete mPages.Get(pFrame->page);
+      mPages.Set(pFrame->page, nullptr);
+
+      while (mPages.GetSize() && !mPages.Get(mPages.GetSize() - 1))
+        mPages.Delete(mPages.GetSize() - 1);
+    }
+
+    mFrames.Set(idx, nullptr);
+    delete pFrame;
+
+    while (mFrames.GetSize() && !mFrames.Get(mFrames.GetSize() - 1))
+      mFrames.Delete(mFrames.GetSize() - 1);
+  }
+
+  /** @param idx The index of a frame added with AddFrame()
+   * @param x Set to the left of the frame in the bitmap returned
+   * @param y Set to the top of the frame in the bitmap returned
+   * @return The bitmap holding the frame, which is valid until the next call. A page, or a decompressed frame */
+  LICE_IBitmap* GetFrame(int idx, int& x, int& y)
+  {
+    Frame* pFrame = mFrames.Get(idx);
+
+    if (pFrame->page >= 0)
+    {
+      x = pFrame->x;
+      y = pFrame->y;
+      return mPages.Get(pFrame->page)->bitmap;
+    }
+
+    x = y = 0;
+
+    if (pFrame->pHot)
+    {
+      // most recently used at the end
+      if (mHotFrames.Get(mHotFrames.GetSize() - 1) != pFrame->pHot)
+      {
+        mHotFrames.Delete(mHotFrames.Find(pFrame->pHot));
+        mHotFrames.Add(pFrame->pHot);
+      }
+
+      return &pFrame->pHot->bitmap;
+    }
+
+    HotFrame* pHot;
+
+    if (mHotFrames.GetSize() < mMaxHotFrames)
+      pHot = new HotFrame;
+    else
+    {
+      pHot = mHotFrames.Get(0);
+      mHotFrames.Delete(0);
+      pHot->pFrame->pHot = nullptr;
+    }
+
+    mHotFrames.Add(pHot);
+    pHot->pFrame = pFrame;
+    pFrame->pHot = pHot;
+    pHot->bitmap.resize(pFrame->w, pFrame->h);
+    Decompress(pFrame->packed, pHot->bitmap.getBits(), pHot->bitmap.getRowSpan(), pFrame->w);
+    mHotMisses++;
+    return &pHot->bitmap;
+  }
+
+  /** @return The bytes of pixels held: pages, compressed frames and decompressed frames */
+  int64_t GetMemorySize() const
+  {
+    int64_t size = 0;
+
+    for (auto i = 0; i < mPages.GetSize(); i++)
+    {
+      if (Page* pPage = mPages.Get(i))
+        size += (int64_t) pPage->bitmap->getRowSpan() * pPage->bitmap->getHeight() * sizeof(LICE_pixel);
+    }
+
+    for (auto i = 0; i < mFrames.GetSize(); i++)
+    {
+      if (Frame* pFrame = mFrames.Get(i))
+        size += pFrame->packed.GetSize() * sizeof(LICE_pixel);
+    }
+
+    for (auto i = 0; i < mHotFrames.GetSize(); i++)
+    {
+      LICE_MemBitmap& bitmap = mHotFrames.Get(i)->bitmap;
+      size += (int64_t) bitmap.getRowSpan() * bitmap.getHeight() * sizeof(LICE_pixel);
+    }
+
+    return size;
+  }
+
+  /** @return The number of distinct frames held */
+  int GetNumFrames() const
+  {
+    int n = 0;
+
+    for (auto i = 0; i < mFrames.GetSize(); i++)
+      n += mFrames.Get(i) != nullptr;
+
+    return n;
+  }
+
+  /** @return The number of calls to GetFrame() for compressed frames that had to decompress them, since the last call */
+  int GetAndResetHotFrameMisses() { const int n = mHotMisses; mHotMisses = 0; return n; }
+
+private:
+  struct HotFrame;
+
+  struct Frame
+  {
+    uint64_t hash;
+    int w, h;
+    int refs = 1;
+    int page = -1; // the page the frame is in, if it isn't compressed
+    int x = 0, y = 0; // where in the page
+    WDL_TypedBuf<LICE_pixel> packed; // if it is compressed, see Compress()
+    HotFrame* pHot = nullptr; // if it is compressed and decompressed
+  };
+
+  struct HotFrame
+  {
+    LICE_MemBitmap bitmap;
+    Frame* pFrame = nullptr;
+  };
+
+  struct Shelf
+  {
+    int y, h, x; // x is the left of the free space
+  };
+
+  struct Page
+  {
+    Page(int width) : w(width), bitmap(new LICE_MemBitmap) {}
+    ~Page() { delete bitmap; }
+
+    const int w;
+    LICE_MemBitmap* bitmap; // grows in height as shelves are added
+    WDL_TypedBuf<Shelf> shelves;
+    int nFrames = 0;
+  };
+
+  /** Finds space for a frame, on the first shelf of a page with room for it, or a new shelf, adding a page if none has room */
+  Page* Alloc(int w, int h, int& pageIdx, int& x, int& y)
+  {
+    const int pageW = std::max(w, mPageWidth);
+
+    for (pageIdx = 0; pageIdx <= mPages.GetSize(); pageIdx++)
+    {
+      Page* pPage = mPages.Get(pageIdx);
+
+      if (!pPage)
+      {
+        pPage = new Page(pageW);
+
+        if (pageIdx < mPages.GetSize())
+          mPages.Set(pageIdx, pPage);
+        else
+          mPages.Add(pPage);
+      }
+
+      const int pageMaxH = std::max(h, mPageHeight);
+
+      if (pPage->w < w)
+        continue;
+
+      Shelf* pShelves = pPage->shelves.Get();
+      const int nShelves = pPage->shelves.GetSize();
+
+      for (auto s = 0; s < nShelves; s++)
+      {
+        // a shelf much taller than the frame is left for taller frames
+        if (h <= pShelves[s].h && 2 * h > pShelves[s].h && pShelves[s].x + w <= pPage->w)
+        {
+          x = pShelves[s].x;
+          y = pShelves[s].y;
+          pShelves[s].x += w;
+          return pPage;
+        }
+      }
+
+      const int top = nShelves ? pShelves[nShelves - 1].y + pShelves[nShelves - 1].h : 0;
+
+      if (top + h > pageMaxH)
+        continue;
+
+      Shelf shelf = { top, h, w };
+      pPage->shelves.Add(shelf);
+      Grow(pPage, top + h, pageMaxH);
+      x = 0;
+      y = top;
+      return pPage;
+    }
+
+    return nullptr; // not reached, as a new page fits any frame
+  }
+
+  /** Makes a page at least h pixels tall, by steps of a quarter of its maximum height, keeping its frames */
+  static void Grow(Page* pPage, int h, int maxH)
+  {
+    LICE_MemBitmap* pOld = pPage->bitmap;
+
+    if (pOld->getHeight() >= h)
+      return;
+
+    const int step = std::max(maxH / 4, 1);
+    LICE_MemBitmap* pNew = new LICE_MemBitmap(pPage->w, std::min(((h + step - 1) / step) * step, maxH));
+    LICE_Clear(pNew, 0);
+
+    if (pOld->getHeight())
+      LICE_Blit(pNew, pOld, 0, 0, 0, 0, pOld->getWidth(), pOld->getHeight(), 1.f, LICE_BLIT_MODE_COPY);
+
+    pPage->bitmap = pNew;
+    delete pOld;
+  }
+
+  // FNV-1a
+  static uint64_t Hash(const LICE_pixel* pBits, int span, int w, int h)
+  {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (auto y = 0; y < h; y++, pBits += span)
+    {
+      for (auto x = 0; x < w; x++)
+      {
+        hash ^= pBits[x];
+        hash *= 1099511628211ULL;
+      }
+    }
+
+    return hash;
+  }
+
+  bool Equals(int idx, const LICE_pixel* pBits, int span)
+  {
+    Frame* pFrame = mFrames.Get(idx);
+    int x, y;
+    LICE_IBitmap* pBitmap = GetFrame(idx, x, y);
+    const LICE_pixel* pFrameBits = pBitmap->getBits() + y * pBitmap->getRowSpan() + x;
+
+    for (auto row = 0; row < pFrame->h; row++, pBits += span, pFrameBits += pBitmap->getRowSpan())
+    {
+      if (memcmp(pBits, pFrameBits, pFrame->w * sizeof(LICE_pixel)))
+        return false;
+    }
+
+    return true;
+  }
+
+  /** Compresses the pixels of a frame, read row after row, as words that are either a count of pixels to copy, followed by the pixels,
+   * or a count of identical pixels with the top bit set, followed by the pixel */
+  static void Compress(const LICE_pixel* pBits, int span, int w, int h, WDL_TypedBuf<LICE_pixel>& packed)
+  {
+    static const int kMinRun = 3;
+    WDL_TypedBuf<LICE_pixel> pixels;
+    LICE_pixel* pPixels = pixels.Resize(w * h);
+
+    for (auto y = 0; y < h; y++)
+      memcpy(pPixels + y * w, pBits + y * span, w * sizeof(LICE_pixel));
+
+    packed.Resize(0);
+    const int n = w * h;
+    int literalStart = 0;
+
+    auto addLiterals = [&](int end) {
+      if (end > literalStart)
+      {
+        packed.Add((LICE_pixel) (end - literalStart));
+        packed.Add(pPixels + literalStart, end - literalStart);
+      }
+    };
+
+    for (auto i = 0; i < n;)
+    {
+      int run = 1;
+
+      while (i + run < n && pPixels[i + run] == pPixels[i])
+        run++;
+
+      if (run >= kMinRun)
+      {
+        addLiterals(i);
+        packed.Add(0x80000000 | (LICE_pixel) run);
+        packed.Add(pPixels[i]);
+        literalStart = i + run;
+      }
+
+      i += run;
+    }
+
+    addLiterals(n);
+  }
+
+  static void Decompress(const WDL_TypedBuf<LICE_pixel>& packed, LICE_pixel* pDest, int span, int w)
+  {
+    const LICE_pixel* pWords = packed.Get();
+    const LICE_pixel* pEnd = pWords + packed.GetSize();
+    int x = 0;
+
+    // runs and copies can span rows
+    auto put = [&](LICE_pixel pixel) {
+      pDest[x] = pixel;
+
+      if (++x == w)
+      {
+        x = 0;
+        pDest += span;
+      }
+    };
+
+    while (pWords < pEnd)
+    {
+      const LICE_pixel word = *pWords++;
+      const int count = (int) (word & 0x7fffffff);
+
+      if (word & 0x80000000)
+      {
+        const LICE_pixel pixel = *pWords++;
+
+        for (auto i = 0; i < count; i++)
+          put(pixel);
+      }
+      else
+      {
+        for (auto i = 0; i < count; i++)
+          put(*pWords++);
+      }
+    }
+  }
+
+  const int mPageWidth;
+  const int mPageHeight;
+  const int mMaxHotFrames;
+  WDL_PtrList<Frame> mFrames; // indexed by the indices AddFrame() returns, with nullptr for removed frames
+  std::unordered_multimap<uint64_t, int> mFramesByHash;
+  WDL_PtrList<Page> mPages; // with nullptr for freed pages
+  WDL_PtrList<HotFrame> mHotFrames; // least recently used first
+  int mHotMisses = 0;
+};
+
+/** A film strip bitmap whose frames are held by a LICEFrameAtlas. IGraphicsLice::DrawBitmap() draws the frames from the atlas with
+ * Blit(). To draw it in other ways, e.g. rotated or scaled, DrawStrip() draws the whole strip into a bitmap the caller frees
+ * @ingroup APIBitmaps */
+class LICEAtlasBitmap : public APIBitmap
+{
+public:
+  /** Adds the frames of a film strip to an atlas
+   * @param pStrip The strip, which is left as it is
+   * @param compress \c true to store the frames compressed, see LICEFrameAtlas
+   * @return The bitmap, or \c nullptr if the strip can't be cut in nFrames frames of whole pixels */
+  static LICEAtlasBitmap* Create(LICEFrameAtlas& atlas, LICE_IBitmap* pStrip, int scale, int nFrames, bool framesAreHorizontal, bool compress)
+  {
+    const int w = pStrip->getWidth();
+    const int h = pStrip->getHeight();
+
+    if (nFrames < 2 || (framesAreHorizontal ? w : h) % nFrames || pStrip->isFlipped())
+      return nullptr;
+
+    LICEAtlasBitmap* pBitmap = new LICEAtlasBitmap(atlas, w, h, scale, nFrames, framesAreHorizontal);
+    int* pFrames = pBitmap->mFrames.Resize(nFrames);
+
+    for (auto i = 0; i < nFrames; i++)
+    {
+      const int x = framesAreHorizontal ? i * pBitmap->mFrameW : 0;
+      const int y = framesAreHorizontal ? 0 : i * pBitmap->mFrameH;
+      pFrames[i] = atlas.AddFrame(pStrip, x, y, pBitmap->mFrameW, pBitmap->mFrameH, compress);
+    }
+
+    return pBitmap;
+  }
+
+  /** Blits part of an IBitmap as IGraphicsLice::DrawBitmap() does. A packed bitmap drawn in the frames it was packed in is blitted from
+   * the atlas, clipped to the frame srcX, srcY is in. Other packed bitmaps are drawn whole into a temporary bitmap first
+   * @param srcX The left of the part in the bitmap's pixels
+   * @param srcY The top of the part in the bitmap's pixels
+   * @return The number of pixels blitted */
+  static int Blit(LICE_IBitmap* pDest, const IBitmap& bitmap, int destX, int destY, int srcX, int srcY, int w, int h, float alpha, int mode)
+  {
+    LICEAtlasBitmap* pAtlasBitmap = dynamic_cast<LICEAtlasBitmap*>(bitmap.GetAPIBitmap());
+
+    if (!pAtlasBitmap)
+    {
+      LICE_Blit(pDest, bitmap.GetAPIBitmap()->GetBitmap(), destX, destY, srcX, srcY, w, h, alpha, mode);
+      return w * h;
+    }
+
+    if (!pAtlasBitmap->HasFrames(bitmap.N(), bitmap.GetFramesAreHorizontal()))
+    {
+      LICE_MemBitmap strip;
+      LICE_Blit(pDest, pAtlasBitmap->DrawStrip(strip), destX, destY, srcX, srcY, w, h, alpha, mode);
+      return w * h;
+    }
+
+    int maxW, maxH;
+    LICE_IBitmap* pFrame = pAtlasBitmap->FindFrame(srcX, srcY, maxW, maxH);
+
+    if (!pFrame)
+      return 0;
+
+    w = std::min(w, maxW);
+    h = std::min(h, maxH);
+    LICE_Blit(pDest, pFrame, destX, destY, srcX, srcY, w, h, alpha, mode);
+    return w * h;
+  }
+
+  ~LICEAtlasBitmap()
+  {
+    for (auto i = 0; i < mFrames.GetSize(); i++)
+      mAtlas.ReleaseFrame(mFrames.Get()[i]);
+  }
+
+  /** @return \c true if the frames were cut as IBitmap cuts nFrames frames in the given direction */
+  bool HasFrames(int nFrames, bool framesAreHorizontal) const
+  {
+    return nFrames == mFrames.GetSize() && framesAreHorizontal == mFramesAreHorizontal;
+  }
+
+  /** Finds the frame a pixel of the strip is in
+   * @param srcX The left of the pixel in the strip, set to the left of the pixel in the bitmap returned
+   * @param srcY The top of the pixel in the strip, set to the top of the pixel in the bitmap returned
+   * @param maxW Set to the width of the frame from srcX on
+   * @param maxH Set to the height of the frame from srcY on
+   * @return The bitmap holding the frame, valid until the atlas is used again, or \c nullptr if the pixel is outside the strip */
+  LICE_IBitmap* FindFrame(int& srcX, int& srcY, int& maxW, int& maxH)
+  {
+    if (srcX < 0 || srcY < 0)
+      return nullptr;
+
+    const int i = mFramesAreHorizontal ? srcX / mFrameW : srcY / mFrameH;
+    const int frameX = srcX - (mFramesAreHorizontal ? i * mFrameW : 0);
+    const int frameY = srcY - (mFramesAreHorizontal ? 0 : i * mFrameH);
+
+    if (i >= mFrames.GetSize() || frameX >= mFrameW || frameY >= mFrameH)
+      return nullptr;
+
+    int x, y;
+    LICE_IBitmap* pBitmap = mAtlas.GetFrame(mFrames.Get()[i], x, y);
+    srcX = x + frameX;
+    srcY = y + frameY;
+    maxW = mFrameW - frameX;
+    maxH = mFrameH - frameY;
+    return pBitmap;
+  }
+
+  /** Draws the whole strip frame by frame, scaled to destW x destH if that is not its size. Frames are scaled one at a time, so that
+   * filtering doesn't blend the edges of neighbouring frames
+   * @param pDest The bitmap to draw into, at its top left */
+  void DrawStrip(LICE_IBitmap* pDest, int destW, int destH)
+  {
+    const int n = mFrames.GetSize();
+
+    for (auto i = 0; i < n; i++)
+    {
+      int x, y;
+      LICE_IBitmap* pFrame = mAtlas.GetFrame(mFrames.Get()[i], x, y);
+      const int dx = mFramesAreHorizontal ? i * destW / n : 0;
+      const int dy = mFramesAreHorizontal ? 0 : i * destH / n;
+      const int dw = mFramesAreHorizontal ? (i + 1) * destW / n - dx : destW;
+      const int dh = mFramesAreHorizontal ? destH : (i + 1) * destH / n - dy;
+
+      if (dw == mFrameW && dh == mFrameH)
+        LICE_Blit(pDest, pFrame, dx, dy, x, y, mFrameW, mFrameH, 1.f, LICE_BLIT_MODE_COPY);
+      else
+        LICE_ScaledBlit(pDest, pFrame, dx, dy, dw, dh, (float) x, (float) y, (float) mFrameW, (float) mFrameH, 1.f, LICE_BLIT_MODE_COPY | LICE_BLIT_FILTER_BILINEAR);
+    }
+  }
+
+  /** Draws the whole strip at its size into strip, which the caller frees when it has drawn it, so that the strip is not kept in memory
+   * @return strip */
+  LICE_IBitmap* DrawStrip(LICE_MemBitmap& strip)
+  {
+    strip.resize(GetWidth(), GetHeight());
+    DrawStrip(&strip, GetWidth(), GetHeight());
+    return &strip;
+  }
+
+private:
+  LICEAtlasBitmap(LICEFrameAtlas& atlas, int w, int h, int scale, int nFrames, bool framesAreHorizontal)
+  : APIBitmap(nullptr, w, h, scale, 1.f)
+  , mAtlas(atlas)
+  , mFrameW(framesAreHorizontal ? w / nFrames : w)
+  , mFrameH(framesAreHorizontal ? h : h / nFrames)
+  , mFramesAreHorizontal(framesAreHorizontal)
+  {
+  }
+
+  LICEFrameAtlas& mAtlas;
+  WDL_TypedBuf<int> mFrames; // indices in mAtlas
+  const int mFrameW;
+  const int mFrameH;
+  const bool mFramesAreHorizontal;
+};
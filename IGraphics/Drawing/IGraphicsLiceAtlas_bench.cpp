@@ -0,0 +1,226 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of the memory the film strips of a skin take, and of the time drawing their frames takes, with the strips
+ * kept as they are loaded and with their frames in a LICEFrameAtlas, packed into pages or compressed
+ *
+ * -n IBKnobControls are attached to an IGraphicsBench at a screen scale of 2, each with its own film strip of -f frames of -s x -s pixels,
+ * drawn when IGraphics::LoadBitmap() loads it. There are -u different knob designs, so with -u less than -n some strips are identical, as
+ * when a skin has the same graphics under different names. IGraphics::LoadBitmap() gives each strip to PackAPIBitmap(), which packs it as
+ * IGraphicsLice does, and the frames are blitted with LICEAtlasBitmap::Blit(), which IGraphicsLice::DrawBitmap() calls. For each way of holding the strips, the bytes
+ * they take are printed, then the time of -r frames in which every knob is set to a new value and redrawn, then of -r frames in which -m
+ * knobs are. With the frames compressed, the frames that had to be decompressed are counted too, see FRAME_ATLAS_HOT_FRAMES.
+ *
+ * Build on Linux with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -include cstdlib -DNOMINMAX -DNDEBUG -DNO_IGRAPHICS -DIGRAPHICS_LICE -D_LICE_NO_SYSBITMAPS_ -DSAMPLE_TYPE_DOUBLE -IWDL -IWDL/swell -IWDL/lice -IIPlug -IIGraphics -IIGraphics/Controls -IIGraphics/Drawing -IIGraphics/Platforms -IDependencies/IGraphics/NanoSVG/src -IDependencies/IGraphics/STB IGraphics/Drawing/IGraphicsLiceAtlas_bench.cpp IGraphics/IGraphics.cpp IGraphics/IControl.cpp IGraphics/IGraphicsEditorDelegate.cpp IGraphics/Controls/IControls.cpp IGraphics/Controls/IPopupMenuControl.cpp IGraphics/Controls/ITextEntryControl.cpp IPlug/IPlugParameter.cpp IPlug/IPlugPluginBase.cpp WDL/lice/lice.cpp WDL/lice/lice_line.cpp WDL/lice/lice_arc.cpp -lpthread -o atlasbench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "IGraphicsBench.h"
+#include "IGraphicsLiceAtlas.h"
+#include "IControls.h"
+
+struct Options
+{
+  int nControls = 50;
+  int nDesigns = 50;
+  int nFrames = 128;
+  int frameSize = 128;
+  int nDrawnFrames = 100;
+  int nMoving = 4;
+};
+
+enum class EMode { kStrips, kPages, kCompressed };
+
+static double NowSeconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class StripBitmap : public APIBitmap
+{
+public:
+  StripBitmap(LICE_IBitmap* pBitmap, int scale) : APIBitmap(pBitmap, pBitmap->getWidth(), pBitmap->getHeight(), scale, 1.f) {}
+  ~StripBitmap() { delete GetBitmap(); }
+};
+
+/** Draws the film strips when they are loaded, packs them as IGraphicsLice does and blits their frames to a screen of twice its size */
+class AtlasBench : public IGraphicsBench
+{
+public:
+  AtlasBench(IGEditorDelegate& dlg, int w, int h, const Options& o, EMode mode)
+  : IGraphicsBench(dlg, w, h)
+  , mScreen(2 * w, 2 * h)
+  , mOptions(o)
+  , mMode(mode)
+  {
+  }
+
+  LICEFrameAtlas& GetAtlas() { return mAtlas; }
+  int64_t GetPixelsBlitted() const { return mPixelsBlitted; }
+  bool BitmapExtSupported(const char* ext) override { return !strcmp(ext, "png"); }
+
+  EResourceLocation OSFindResource(const char* fileNameOrResID, const char* type, WDL_String& result) override
+  {
+    result.Set(fileNameOrResID);
+    return kAbsolutePath;
+  }
+
+  void DrawBitmap(IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend) override
+  {
+    const int ds = GetScreenScale();
+    IRECT r = bounds.GetScaled((float) ds).Intersect(IRECT(0.f, 0.f, (float) mScreen.getWidth(), (float) mScreen.getHeight()));
+    srcX = srcX * ds + (int) (r.L - bounds.L * ds);
+    srcY = srcY * ds + (int) (r.T - bounds.T * ds);
+    mPixelsBlitted += LICEAtlasBitmap::Blit(&mScreen, bitmap, (int) r.L, (int) r.T, srcX, srcY, (int) r.W(), (int) r.H(), 1.f, LICE_BLIT_MODE_COPY | LICE_BLIT_USE_ALPHA);
+  }
+
+protected:
+  APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override
+  {
+    int idx = 0;
+    sscanf(fileNameOrResID, "%*[a-z]-knob%d", &idx);
+    const int design = idx % mOptions.nDesigns;
+    const int size = mOptions.frameSize;
+    const float c = 0.5f * size;
+    LICE_MemBitmap* pStrip = new LICE_MemBitmap(size, size * mOptions.nFrames);
+    LICE_Clear(pStrip, 0);
+
+    for (int f = 0; f < mOptions.nFrames; f++)
+    {
+      const float y = (float) (f * size) + c;
+      const float angle = -0.75f * PI + 1.5f * PI * f / (float) (mOptions.nFrames - 1);
+      LICE_FillCircle(pStrip, c, y, 0.45f * size, LICE_RGBA(40 + (design * 37) % 200, 60 + (design * 53) % 180, 90, 255), 1.f, LICE_BLIT_MODE_COPY, true);
+      LICE_Circle(pStrip, c, y, 0.45f * size, LICE_RGBA(20, 20, 20, 255), 1.f, LICE_BLIT_MODE_COPY, true);
+      LICE_Arc(pStrip, c, y, 0.4f * size, -0.75f * PI, angle, LICE_RGBA(255, 200, 80, 255), 1.f, LICE_BLIT_MODE_COPY, true);
+      LICE_FLine(pStrip, c, y, c + 0.35f * size * std::sin(angle), y - 0.35f * size * std::cos(angle), LICE_RGBA(255, 255, 255, 255), 1.f, LICE_BLIT_MODE_COPY, true);
+    }
+
+    return new StripBitmap(pStrip, scale);
+  }
+
+  APIBitmap* PackAPIBitmap(const APIBitmap* pBitmap, int nStates, bool framesAreHorizontal) override
+  {
+    if (mMode == EMode::kStrips)
+      return nullptr;
+
+    return LICEAtlasBitmap::Create(mAtlas, pBitmap->GetBitmap(), pBitmap->GetScale(), nStates, framesAreHorizontal, mMode == EMode::kCompressed);
+  }
+
+private:
+  LICEFrameAtlas mAtlas;
+  LICE_MemBitmap mScreen;
+  const Options& mOptions;
+  const EMode mMode;
+  int64_t mPixelsBlitted = 0;
+};
+
+static void Run(const Options& o, EMode mode, const char* prefix, const char* label)
+{
+  const int columns = 10;
+  const int frameSize = o.frameSize / 2;
+  IGraphicsBench::Delegate dlg;
+  AtlasBench g(dlg, columns * frameSize, ((o.nControls + columns - 1) / columns) * frameSize, o, mode);
+  g.SetScreenScale(2);
+
+  WDL_String name;
+  WDL_PtrList<IBitmap> bitmaps;
+  int64_t bytes = 0;
+
+  for (int i = 0; i < o.nControls; i++)
+  {
+    name.SetFormatted(64, "%s-knob%d.png", prefix, i);
+    IBitmap& bitmap = *bitmaps.Add(new IBitmap(g.LoadBitmap(name.Get(), o.nFrames)));
+
+    if (mode == EMode::kStrips)
+      bytes += (int64_t) bitmap.GetAPIBitmap()->GetBitmap()->getRowSpan() * bitmap.GetAPIBitmap()->GetBitmap()->getHeight() * sizeof(LICE_pixel);
+
+    g.AttachControl(new IBKnobControl(dlg, (float) ((i % columns) * frameSize), (float) ((i / columns) * frameSize), bitmap, kNoParameter));
+  }
+
+  if (mode != EMode::kStrips)
+    bytes = g.GetAtlas().GetMemorySize();
+
+  g.RunFrame();
+  g.GetAtlas().GetAndResetHotFrameMisses();
+  printf("%-20s %8.1f MB, %5d frames stored\n", label, bytes / 1048576., mode == EMode::kStrips ? o.nControls * o.nFrames : g.GetAtlas().GetNumFrames());
+
+  srand(1);
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    const int nMoving = pass ? std::min(o.nMoving, o.nControls) : o.nControls;
+    const int64_t pixels0 = g.GetPixelsBlitted();
+    double t = 0.;
+
+    for (int f = 0; f < o.nDrawnFrames; f++)
+    {
+      for (int i = 0; i < nMoving; i++)
+        g.GetControl(i)->SetValueFromDelegate((double) rand() / RAND_MAX);
+
+      const double t0 = NowSeconds();
+      g.RunFrame();
+      t += NowSeconds() - t0;
+    }
+
+    const double pixels = (double) (g.GetPixelsBlitted() - pixels0);
+    printf("  %3d knobs moving    %8.3f ms per frame, %8.1f Mpixels/s", nMoving, 1e3 * t / o.nDrawnFrames, 1e-6 * pixels / t);
+
+    if (mode == EMode::kCompressed)
+      printf(", %6.1f frames decompressed per frame", (double) g.GetAtlas().GetAndResetHotFrameMisses() / o.nDrawnFrames);
+
+    printf("\n");
+  }
+
+  // out of the cache, as they use the atlas of g
+  for (int i = 0; i < bitmaps.GetSize(); i++)
+    g.ReleaseBitmap(*bitmaps.Get(i));
+
+  bitmaps.Empty(true);
+}
+
+int main(int argc, char* argv[])
+{
+  Options o;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      o.nControls = std::max(atoi(argv[++i]), 1);
+    else if (!strcmp(argv[i], "-u") && i + 1 < argc)
+      o.nDesigns = std::max(atoi(argv[++i]), 1);
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      o.nFrames = std::max(atoi(argv[++i]), 2);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      o.frameSize = std::max(atoi(argv[++i]) / 2 * 2, 8);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      o.nDrawnFrames = std::max(atoi(argv[++i]), 1);
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+      o.nMoving = std::max(atoi(argv[++i]), 1);
+    else
+    {
+      printf("usage: %s [-n knobs] [-u knob designs] [-f frames per strip] [-s frame size in pixels at 2x] [-r frames drawn] [-m knobs moving]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%d knobs of %d designs, %d frames of %d x %d pixels each, %d hot frames\n", o.nControls, std::min(o.nDesigns, o.nControls), o.nFrames, o.frameSize, o.frameSize, FRAME_ATLAS_HOT_FRAMES);
+  Run(o, EMode::kStrips, "a", "strips as loaded");
+  Run(o, EMode::kPages, "b", "atlas pages");
+  Run(o, EMode::kCompressed, "c", "atlas compressed");
+  return 0;
+}
@@ -105,41 +105,84 @@ void IControl::SetDirty(bool triggerAction)
 {
   mValue = Clip(mValue, mClampLo, mClampHi);
   mDirty = true;
+  mDirtyRects.Clear();
+
+  if (mGraphics)
+    mGraphics->RequestFrame();
   
   if (triggerAction)
+    OnValueChangedFromUI();
+}
+
+void IControl::OnValueChangedFromUI()
+{
+  if(mParamIdx > kNoParameter)
   {
-    if(mParamIdx > kNoParameter)
+    mDelegate.SendParameterValueFromUI(mParamIdx, mValue);
+    GetUI()->UpdatePeers(this);
+    
+    const IParam* pParam = GetParam();
+
+    if (mValDisplayControl)
     {
-      mDelegate.SendParameterValueFromUI(mParamIdx, mValue);
-      GetUI()->UpdatePeers(this);
-      
-      const IParam* pParam = GetParam();
+      WDL_String display;
+      pParam->GetDisplayForHost(display);
+      ((ITextControl*)mValDisplayControl)->SetStr(display.Get());
+    }
 
-      if (mValDisplayControl)
-      {
-        WDL_String display;
-        pParam->GetDisplayForHost(display);
-        ((ITextControl*)mValDisplayControl)->SetStr(display.Get());
-      }
+    if (mNameDisplayControl)
+    {
+      ((ITextControl*)mNameDisplayControl)->SetStr(pParam->GetNameForHost());
+    }
+  }
+  
+  if (mActionFunc != nullptr)
+    mActionFunc(this);
+}
 
-      if (mNameDisplayControl)
-      {
-        ((ITextControl*)mNameDisplayControl)->SetStr(pParam->GetNameForHost());
-      }
+void IControl::SetDirtyRect(const IRECT& bounds)
+{
+  if (mDirty && !mDirtyRects.Size()) // the whole control is already dirty
+    return;
+
+  IRECT r = bounds.Intersect(mRECT);
+
+  if (r.Empty())
+    return;
+
+  // merge with the parts that overlap it or are within a pixel of it, so that no pixel is drawn twice once they are pixel aligned
+  for (auto i = 0; i < mDirtyRects.Size(); i++)
+  {
+    if (mDirtyRects.Get(i).GetPadded(1.f).Intersects(r))
+    {
+      r = r.Union(mDirtyRects.Get(i));
+      mDirtyRects.Delete(i);
+      i = -1;
     }
-    
-    if (mActionFunc != nullptr)
-      mActionFunc(this);
   }
+
+  mDirty = true;
+  mDirtyRects.Add(r);
+
+  if (mGraphics)
+    mGraphics->RequestFrame();
+}
+
+void IControl::GetDirtyRects(IRECTList& rects) const
+{
+  // an animation may change anything
+  if (!mDirtyRects.Size() || mAnimationFunc)
+  {
+    rects.Add(mRECT);
+    return;
+  }
+
+  for (auto i = 0; i < mDirtyRects.Size(); i++)
+    rects.Add(mDirtyRects.Get(i));
 }
 
 bool IControl::IsDirty()
 {
-  if(GetAnimationFunction()) {
-    mAnimationFunc(this);
-    return true;
-  }
-  
   return mDirty;
 }
 
@@ -297,12 +297,23 @@ public:
    * NOTE: it is easy to forget that this method always sets the control dirty, the argument is about whether a consective action should be performed */
   virtual void SetDirty(bool triggerAction = true);
 
+  /** Mark only part of the control as dirty, so that only that part is redrawn on the next display refresh. Use this when a control that
+   * draws many elements, such as the keys of a keyboard or the sliders of a multislider, changes a few of them. Does not trigger an action.
+   * If the whole control is already dirty, this does nothing. Calling SetDirty() afterwards makes the whole control dirty again
+   * @param bounds The part of the control to redraw, in the same coordinates as the control's RECT */
+  void SetDirtyRect(const IRECT& bounds);
+
+  /** Called by the IGraphics draw loop for a dirty control, to add the parts of it to redraw
+   * @param rects The list of rectangles to redraw, to add to. The whole control RECT is added unless only parts were marked with SetDirtyRect() */
+  void GetDirtyRects(IRECTList& rects) const;
+
   /* Set the control clean, i.e. Called by IGraphics draw loop after control has been drawn */
-  virtual void SetClean() { mDirty = false; }
+  virtual void SetClean() { mDirty = false; mDirtyRects.Clear(); }
   
   /** Called at each display refresh by the IGraphics draw loop to determine if the control is marked as dirty. 
-   * This is not const, because it is typically  overridden and used to update something at the display refresh rate
-   * The default implementation exectutes a control's Animation Function, so if you override this you may want to call the base implementation, @see Animation Functions
+   * This is not const, because it is typically  overridden and used to update something at the display refresh rate, although the
+   * display timer slows down while nothing is dirty, see IDLE_TIMER_TICKS. Animation functions are called by IGraphics before this,
+   * @see Animation Functions
    * @return \c true if the control is marked dirty. */
   virtual bool IsDirty();
 
@@ -342,6 +353,9 @@ public:
     mGraphics = pGraphics;
     OnResize();
     OnRescale();
+
+    if (mAnimationFunc)
+      mGraphics->ScheduleAnimation(this);
   }
   
   /** @return A pointer to the IGraphics context that owns this control */ 
@@ -374,12 +388,18 @@ public:
   
   /** Set the animation function
    * @param func A std::function conforming to IAnimationFunction */
-  void SetAnimation(IAnimationFunction func) { mAnimationFunc = func;}
+  void SetAnimation(IAnimationFunction func)
+  {
+    mAnimationFunc = func;
+
+    if (mAnimationFunc && mGraphics)
+      mGraphics->ScheduleAnimation(this);
+  }
   
   /** Set the animation function and starts it
    * @param func A std::function conforming to IAnimationFunction
    * @param duration Duration in milliseconds for the animation  */
-  void SetAnimation(IAnimationFunction func, int duration) { mAnimationFunc = func; StartAnimation(duration); }
+  void SetAnimation(IAnimationFunction func, int duration) { SetAnimation(func); StartAnimation(duration); }
 
   IAnimationFunction GetAnimationFunction() { return mAnimationFunc; }
   
@@ -390,14 +410,20 @@ public:
     if(!mAnimationFunc)
       return 0.;
     
-    auto elapsed = Milliseconds(Time::now() - mAnimationStartTime);
-    return elapsed.count() / mAnimationDuration.count();
+    // all animations of a frame use the time at which it started
+    auto elapsed = Milliseconds((mGraphics ? mGraphics->GetFrameTime() : Time::now()) - mAnimationStartTime);
+    return std::max(elapsed.count() / mAnimationDuration.count(), 0.);
   }
   
 #if defined VST3_API || defined VST3C_API
   Steinberg::tresult PLUGIN_API executeMenuItem (Steinberg::int32 tag) override { OnContextSelection(tag); return Steinberg::kResultOk; }
 #endif
   
+protected:
+  /** Sends the control's value to the delegate, updates its peers and display controls and calls its action function, as SetDirty(true) does.
+   * Use this in controls that only redraw the parts that changed with SetDirtyRect() */
+  void OnValueChangedFromUI();
+
 #pragma mark - IControl Member variables
 protected:
   IEditorDelegate& mDelegate;
@@ -420,6 +446,7 @@ protected:
   double mClampLo = 0.;
   double mClampHi = 1.;
   bool mDirty = true;
+  IRECTList mDirtyRects; // the parts of the control to redraw, empty when the whole control is dirty
   bool mHide = false;
   bool mGrayed = false;
   bool mDisablePrompt = true;
@@ -774,9 +801,13 @@ public:
   {
     g.FillRect(GetColor(kBG), mRECT);
     
+    // when only some tracks changed, skip the tracks that are not being redrawn
+    const IRECT& region = g.GetDrawRegion();
+
     for (int ch = 0; ch < MaxNTracks(); ch++)
     {
-      DrawTrack(g, mTrackBounds.Get()[ch], ch);
+      if (GetTrackRedrawBounds(ch, ch).Intersects(region))
+        DrawTrack(g, mTrackBounds.Get()[ch], ch);
     }
     
     if(mDrawFrame)
@@ -788,6 +819,11 @@ public:
   void SetTrackData(int trackIdx, float val) { mTrackData.Get()[trackIdx] = Clip(val, mMinTrackValue, mMaxTrackValue); }
   float* GetTrackData(int trackIdx) { return &mTrackData.Get()[trackIdx];  }
   void SetAllTrackData(float val) { memset(mTrackData.Get(), (int) Clip(val, mMinTrackValue, mMaxTrackValue), mTrackData.GetSize() * sizeof(float) ); }
+
+  /** Mark a range of tracks as dirty, so that only they are redrawn on the next display refresh, @see IControl::SetDirtyRect()
+   * @param firstTrackIdx The first track to redraw
+   * @param lastTrackIdx The last track to redraw */
+  void SetTracksDirty(int firstTrackIdx, int lastTrackIdx) { SetDirtyRect(GetTrackRedrawBounds(firstTrackIdx, lastTrackIdx)); }
 private:
   virtual void DrawFrame(IGraphics& g)
   {
@@ -835,7 +871,12 @@ private:
   }
   
 protected:
-  
+  // the tracks, padded by the frame thickness, as a track frame is stroked on the edge of the track
+  IRECT GetTrackRedrawBounds(int firstTrackIdx, int lastTrackIdx)
+  {
+    return mTrackBounds.Get()[firstTrackIdx].Union(mTrackBounds.Get()[lastTrackIdx]).GetPadded(mFrameThickness);
+  }
+
   EDirection mDirection = EDirection::kVertical;
   int mMaxNTracks;
   WDL_TypedBuf<float> mTrackData; // real values of sliders/meters
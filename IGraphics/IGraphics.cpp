@@ -35,6 +35,7 @@ typedef IPlugVST3Controller VST3_API_BASE;
 #include "ICornerResizerControl.h"
 #include "IPopupMenuControl.h"
 #include "ITextEntryControl.h"
+#include "IGraphicsResourceLoader.h"
 
 struct SVGHolder
 {
@@ -57,6 +58,98 @@ struct SVGHolder
 static StaticStorage<APIBitmap> s_bitmapCache;
 static StaticStorage<SVGHolder> s_SVGCache;
 
+// bitmaps workers have added to s_bitmapCache that LoadBitmap() hasn't returned yet, which can still be replaced by packed ones
+static WDL_PtrList<APIBitmap> s_publishedBitmaps;
+
+/** Loads a bitmap with a function from IGraphics::GetAPIBitmapLoader(), into s_bitmapCache */
+class BitmapLoadJob : public IResourceLoader::Job
+{
+public:
+  BitmapLoadJob(const char* key, const char* name, std::function<APIBitmap*()> loaderFunc)
+  : IResourceLoader::Job(key)
+  , mName(name)
+  , mLoaderFunc(loaderFunc)
+  {
+  }
+
+  ~BitmapLoadJob()
+  {
+    delete mBitmap;
+  }
+
+  void Run() override
+  {
+    mBitmap = mLoaderFunc();
+  }
+
+  void Publish() override
+  {
+    // another instance may have loaded it on the UI thread in the meantime
+    if (mBitmap && !s_bitmapCache.Find(mName.Get(), mBitmap->GetScale()))
+    {
+      s_bitmapCache.Add(mBitmap, mName.Get(), mBitmap->GetScale());
+      s_publishedBitmaps.Add(mBitmap);
+      mBitmap = nullptr;
+    }
+  }
+
+private:
+  WDL_String mName;
+  std::function<APIBitmap*()> mLoaderFunc;
+  APIBitmap* mBitmap = nullptr;
+};
+
+/** Parses an SVG from a file, or from a copy of a windows resource, into s_SVGCache */
+class SVGLoadJob : public IResourceLoader::Job
+{
+public:
+  SVGLoadJob(const char* name, const char* path, const char* data, const char* units, float dpi)
+  : IResourceLoader::Job(name)
+  , mName(name)
+  , mPath(path)
+  , mData(data)
+  , mUnits(units)
+  , mDPI(dpi)
+  {
+  }
+
+  ~SVGLoadJob()
+  {
+    if (mImage)
+      nsvgDelete(mImage);
+  }
+
+  void Run() override
+  {
+    if (mData.GetLength())
+      mImage = nsvgParse(mData.Get(), mUnits.Get(), mDPI); // modifies mData
+    else
+      mImage = nsvgParseFromFile(mPath.Get(), mUnits.Get(), mDPI);
+  }
+
+  void Publish() override
+  {
+    if (mImage && !s_SVGCache.Find(mName.Get()))
+    {
+      s_SVGCache.Add(new SVGHolder(mImage), mName.Get());
+      mImage = nullptr;
+    }
+  }
+
+private:
+  WDL_String mName;
+  WDL_String mPath;
+  WDL_String mData;
+  WDL_String mUnits;
+  float mDPI;
+  NSVGimage* mImage = nullptr;
+};
+
+static void GetBitmapLoadJobKey(WDL_String& key, const char* name, int targetScale)
+{
+  key.SetFormatted((int) strlen(name) + 16, "%s-%dx", name, targetScale);
+}
+
 IGraphics::IGraphics(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
 : mDelegate(dlg)
 , mWidth(w)
@@ -74,6 +167,8 @@ IGraphics::IGraphics(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
 
 IGraphics::~IGraphics()
 {
+  // publishes what the workers have finished, for the next instance
+  DELETE_NULL(mResourceLoader);
   RemoveAllControls();
 }
 
@@ -129,6 +224,7 @@ void IGraphics::RemoveControls(int fromIdx)
       mMouseOverIdx = -1;
     }
     
+    mAnimatingControls.DeletePtr(pControl);
     mControls.Delete(idx--, true);
   }
   
@@ -139,6 +235,7 @@ void IGraphics::RemoveAllControls()
 {
   mMouseCapture = mMouseOver = nullptr;
   mMouseOverIdx = -1;
+  mAnimatingControls.Empty();
 
   if (mPopupControl)
     DELETE_NULL(mPopupControl);
@@ -593,23 +690,77 @@ void IGraphics::DrawGrid(const IColor& color, const IRECT& bounds, float gridSiz
 
 void IGraphics::DrawData(const IColor& color, const IRECT& bounds, float* normYPoints, int nPoints, float* normXPoints, const IBlend* pBlend, float thickness)
 {
-  //TODO:
+  if (nPoints < 2)
+    return;
+
+  const int nColumns = (int) std::ceil(bounds.W() * GetBackingPixelScale());
+
+  if (mDataColumns.Decimate(bounds, nColumns, normYPoints, nPoints, normXPoints, thickness))
+  {
+    // one span per pixel column
+    const float w = mDataColumns.GetColumnW();
+
+    for (auto c = mDataColumns.GetFirstColumn(); c <= mDataColumns.GetLastColumn(); c++)
+    {
+      const float l = mDataColumns.GetColumnL(c);
+      FillRect(color, IRECT(l, mDataColumns.GetTop(c), l + w, mDataColumns.GetBottom(c)), pBlend);
+    }
+  }
+  else
+  {
+    auto getX = [&](int i) { return bounds.L + bounds.W() * (normXPoints ? normXPoints[i] : (float) i / (float) (nPoints - 1)); };
+    auto getY = [&](int i) { return bounds.B - (bounds.H() * normYPoints[i]); };
+
+    for (auto i = 1; i < nPoints; i++)
+      DrawLine(color, getX(i - 1), getY(i - 1), getX(i), getY(i), pBlend, thickness);
+  }
 }
 
 bool IGraphics::IsDirty(IRECTList& rects)
 {
   bool dirty = false;
-    
+
+  if (mResourceLoader)
+    mResourceLoader->PublishFinished();
+
+  // evaluate the animations once, all at the same time, and mark the controls they animate dirty
+  mFrameTime = Time::now();
+
+  for (auto i = 0; i < mAnimatingControls.GetSize(); i++)
+  {
+    IControl* pControl = mAnimatingControls.Get(i);
+    IAnimationFunction func = pControl->GetAnimationFunction();
+
+    if (func)
+      func(pControl);
+
+    if (pControl->GetAnimationFunction())
+      pControl->SetDirty(false);
+    else
+      mAnimatingControls.Delete(i--);
+  }
+
   auto func = [&dirty, &rects](IControl& control)
   {
     if (control.IsDirty())
     {
-      rects.Add(control.GetRECT());
+      control.GetDirtyRects(rects);
       dirty = true;
     }
   };
     
   ForAllControlsFunc(func);
+
+  // slow the platform timer down while there is nothing to draw, until RequestFrame()
+  if (dirty || IsAnimating())
+  {
+    mIdleTimerTicks = 0;
+  }
+  else if (IDLE_TIMER_TICKS > 0 && !mTimerIdle && ++mIdleTimerTicks >= IDLE_TIMER_TICKS)
+  {
+    mTimerIdle = true;
+    PlatformSetTimerInterval(IDLE_TIMER_INTERVAL_MS);
+  }
   
 #ifdef USE_IDLE_CALLS
   if (dirty)
@@ -626,6 +777,25 @@ bool IGraphics::IsDirty(IRECTList& rects)
   return dirty;
 }
 
+void IGraphics::ScheduleAnimation(IControl* pControl)
+{
+  if (mAnimatingControls.Find(pControl) < 0)
+    mAnimatingControls.Add(pControl);
+
+  RequestFrame();
+}
+
+void IGraphics::RequestFrame()
+{
+  mIdleTimerTicks = 0;
+
+  if (mTimerIdle)
+  {
+    mTimerIdle = false;
+    PlatformSetTimerInterval((int) std::round(1000. / FPS()));
+  }
+}
+
 void IGraphics::BeginFrame()
 {
   if(mPerfDisplay)
@@ -648,6 +818,7 @@ void IGraphics::DrawControl(IControl* pControl, const IRECT& bounds, float scale
     if (clipBounds.W() <= 0.0 || clipBounds.H() <= 0)
       return;
     
+    mDrawRegion = clipBounds;
     PrepareRegion(clipBounds);
     pControl->Draw(*this);
     
@@ -1118,6 +1289,9 @@ void IGraphics::EnableLiveEdit(bool enable/*, const char* file, int gridsize*/)
 
 ISVG IGraphics::LoadSVG(const char* fileName, const char* units, float dpi)
 {
+  if (mResourceLoader)
+    mResourceLoader->Complete(fileName);
+
   SVGHolder* pHolder = s_SVGCache.Find(fileName);
 
   if(!pHolder)
@@ -1157,7 +1331,7 @@ ISVG IGraphics::LoadSVG(const char* fileName, const char* units, float dpi)
 
     pHolder = new SVGHolder(pImage);
     
-    s_SVGCache.Add(pHolder, path.Get());
+    s_SVGCache.Add(pHolder, fileName);
   }
 
   return ISVG(pHolder->mImage);
@@ -1168,8 +1342,21 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
   if (targetScale == 0)
     targetScale = GetScreenScale();
 
+  if (mResourceLoader)
+  {
+    WDL_String key;
+    GetBitmapLoadJobKey(key, name, targetScale);
+    mResourceLoader->Complete(key.Get());
+  }
+
   APIBitmap* pAPIBitmap = s_bitmapCache.Find(name, targetScale);
 
+  if (pAPIBitmap && s_publishedBitmaps.Find(pAPIBitmap) >= 0)
+  {
+    s_publishedBitmaps.DeletePtr(pAPIBitmap);
+    pAPIBitmap = PackCachedBitmap(pAPIBitmap, name, nStates, framesAreHorizontal);
+  }
+
   // If the bitmap is not already cached at the targetScale
   if (!pAPIBitmap)
   {
@@ -1218,19 +1405,95 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
       IBitmap scaledBitmap = ScaleBitmap(bitmap, name, targetScale);
       if (fromDisk)
         delete pAPIBitmap;
-      return scaledBitmap;
+      return IBitmap(PackCachedBitmap(scaledBitmap.GetAPIBitmap(), name, nStates, framesAreHorizontal), nStates, framesAreHorizontal, name);
     }
 
     // Retain if we've newly loaded from disk
     if (fromDisk)
+    {
       RetainBitmap(bitmap, name);
+      pAPIBitmap = PackCachedBitmap(pAPIBitmap, name, nStates, framesAreHorizontal);
+    }
   }
 
   return IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name);
 }
 
+void IGraphics::PreloadBitmap(const char* name, int targetScale)
+{
+  if (targetScale == 0)
+    targetScale = GetScreenScale();
+
+  WDL_String key;
+  GetBitmapLoadJobKey(key, name, targetScale);
+
+  if (s_bitmapCache.Find(name, targetScale) || (mResourceLoader && mResourceLoader->Contains(key.Get())))
+    return;
+
+  const char* ext = name + strlen(name) - 1;
+  while (ext >= name && *ext != '.') --ext;
+  ++ext;
+
+  if (!BitmapExtSupported(ext))
+    return;
+
+  // the resource is found here, since the platform classes look resources up on the UI thread
+  WDL_String fullPath;
+  int sourceScale = 0;
+  EResourceLocation resourceLocation = SearchImageResource(name, ext, fullPath, targetScale, sourceScale);
+
+  // a bitmap that is cached at the source scale only needs to be scaled, LoadBitmap() does that
+  if (resourceLocation == EResourceLocation::kNotFound || s_bitmapCache.Find(name, sourceScale))
+    return;
+
+  APIBitmapLoaderFunc loaderFunc = GetAPIBitmapLoader(fullPath.Get(), sourceScale, resourceLocation, ext, targetScale);
+
+  if (!loaderFunc)
+    return;
+
+  if (!mResourceLoader)
+    mResourceLoader = new IResourceLoader(RESOURCE_LOADER_THREADS);
+
+  mResourceLoader->Add(new BitmapLoadJob(key.Get(), name, loaderFunc));
+}
+
+void IGraphics::PreloadSVG(const char* fileName, const char* units, float dpi)
+{
+  if (s_SVGCache.Find(fileName) || (mResourceLoader && mResourceLoader->Contains(fileName)))
+    return;
+
+  WDL_String path;
+  EResourceLocation resourceFound = OSFindResource(fileName, "svg", path);
+  const char* pData = "";
+
+  if (resourceFound == EResourceLocation::kNotFound)
+    return;
+
+#ifdef OS_WIN
+  if (resourceFound == EResourceLocation::kWinBinary)
+  {
+    int size = 0;
+    pData = static_cast<const char*>(LoadWinResource(path.Get(), "svg", size));
+
+    if (!pData)
+      return;
+  }
+#endif
+
+  if (!mResourceLoader)
+    mResourceLoader = new IResourceLoader(RESOURCE_LOADER_THREADS);
+
+  mResourceLoader->Add(new SVGLoadJob(fileName, path.Get(), pData, units, dpi));
+}
+
+bool IGraphics::IsLoadingResources() const
+{
+  return mResourceLoader && mResourceLoader->IsBusy();
+}
+
 void IGraphics::ReleaseBitmap(const IBitmap& bitmap)
 {
+  s_publishedBitmaps.DeletePtr(bitmap.GetAPIBitmap());
   s_bitmapCache.Remove(bitmap.GetAPIBitmap());
 }
 
@@ -1239,6 +1502,19 @@ void IGraphics::RetainBitmap(const IBitmap& bitmap, const char* cacheName)
   s_bitmapCache.Add(bitmap.GetAPIBitmap(), cacheName, bitmap.GetScale());
 }
 
+APIBitmap* IGraphics::PackCachedBitmap(APIBitmap* pBitmap, const char* name, int nStates, bool framesAreHorizontal)
+{
+  APIBitmap* pPacked = nStates > 1 ? PackAPIBitmap(pBitmap, nStates, framesAreHorizontal) : nullptr;
+
+  if (!pPacked)
+    return pBitmap;
+
+  const int scale = pBitmap->GetScale();
+  s_bitmapCache.Remove(pBitmap);
+  s_bitmapCache.Add(pPacked, name, scale);
+  return pPacked;
+}
+
 IBitmap IGraphics::ScaleBitmap(const IBitmap& inBitmap, const char* name, int scale)
 {
   APIBitmap* pAPIBitmap = ScaleAPIBitmap(inBitmap.GetAPIBitmap(), scale);
@@ -1469,7 +1745,7 @@ void IGraphics::ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow)
   kernel.Resize(iSize);
         
   for (int i = 0; i < iSize; i++)
-    kernel.Get()[i] = std::round(255.f * std::expf(-(i * i) * blurConst));
+    kernel.Get()[i] = std::round(255.f * std::exp(-(i * i) * blurConst));
   
   // Kernel normalisation
   
@@ -59,6 +59,7 @@ class ITextEntryControl;
 class ICornerResizerControl;
 class IFPSDisplayControl;
 class IParam;
+class IResourceLoader;
 
 /**  The lowest level base class of an IGraphics context */
 class IGraphics
@@ -444,6 +445,16 @@ public:
    * @param thickness Optional line thickness */
   virtual void DrawGrid(const IColor& color, const IRECT& bounds, float gridSizeH, float gridSizeV, const IBlend* pBlend = 0, float thickness = 1.f);
 
+  /** Draw a line plot of an array of values, e.g. a waveform or a spectrum. When there are more points than pixel columns in bounds, each
+   * column is drawn as a vertical span from the minimum to the maximum of its points (see IDataColumns), so the cost depends on the width
+   * of bounds rather than on nPoints, and peaks are never dropped
+   * @param color The color to draw the plot with
+   * @param bounds The rectangular region to draw the plot in
+   * @param normYPoints The y values, 0 is the bottom of bounds and 1 the top
+   * @param nPoints The number of values
+   * @param normXPoints Optional increasing x values from 0 (left) to 1 (right), if nullptr the points are evenly spaced across bounds
+   * @param pBlend Optional blend method, see IBlend documentation
+   * @param thickness Optional line thickness */
   virtual void DrawData(const IColor& color, const IRECT& bounds, float* normYPoints, int nPoints, float* normXPoints = nullptr, const IBlend* pBlend = 0, float thickness = 1.f);
   
 #pragma mark - IGraphics drawing API layer support
@@ -668,6 +679,26 @@ public:
    * @param rects A set of rectangular regions to draw */
   void Draw(IRECTList& rects);
 
+  /** While a control is drawn, the part of it that is being redrawn. Controls that draw many elements can skip those outside it, when only
+   * parts of them were marked dirty with IControl::SetDirtyRect()
+   * @return The region of the graphics context being redrawn, already intersected with the control's bounds */
+  const IRECT& GetDrawRegion() const { return mDrawRegion; }
+
+  /** Called by IControl::SetAnimation(), so that the control's animation function is called once per frame by IsDirty(), until it is
+   * cleared. Each control is only scheduled once
+   * @param pControl The control to animate */
+  void ScheduleAnimation(IControl* pControl);
+
+  /** @return \c true if any control has an animation function */
+  bool IsAnimating() const { return mAnimatingControls.GetSize() > 0; }
+
+  /** @return The time at which the current frame started. All the animations of a frame use it, see IControl::GetAnimationProgress() */
+  TimePoint GetFrameTime() const { return mFrameTime; }
+
+  /** Called when a control is marked dirty or an animation is scheduled. If the platform timer was slowed down because nothing needed
+   * to be redrawn, it is brought back to the frame rate. See IDLE_TIMER_TICKS */
+  void RequestFrame();
+
   /** This method is called after interacting with a control, so that any other controls linked to the same parameter index, will also be set dirty, and have their values updated.
    * @param pCaller The control that triggered the parameter change. */
   void UpdatePeers(IControl* pCaller);
@@ -1004,6 +1035,23 @@ public:
    * @return An ISVG representing the image */
   virtual ISVG LoadSVG(const char* fileNameOrResID, const char* units = "px", float dpi = 72.f);
 
+  /** Starts loading a bitmap on a worker thread, decoded and scaled to targetScale, so that a later call to LoadBitmap() with the same
+   * fileNameOrResID and targetScale doesn't have to. Call it for all the bitmaps of a UI before loading the first, e.g. at the start of
+   * the layout function. LoadBitmap() takes over a bitmap that no worker has started yet, or waits for the one loading it, and bitmaps that
+   * are never asked for are added to the cache shared by all instances as they finish. Does nothing for drawing APIs that can't load
+   * bitmaps off the UI thread, see GetAPIBitmapLoader(), and for bitmaps that are already loaded
+   * @param fileNameOrResID CString file name or resource ID
+   * @param targetScale Set \c to a number > 0 to explicity load e.g. an @2x.png */
+  void PreloadBitmap(const char* fileNameOrResID, int targetScale = 0);
+
+  /** Starts parsing an SVG on a worker thread, so that a later call to LoadSVG() doesn't have to, see PreloadBitmap()
+   * @param fileNameOrResID A CString absolute path or resource ID */
+  void PreloadSVG(const char* fileNameOrResID, const char* units = "px", float dpi = 72.f);
+
+  /** @return \c true if resources passed to PreloadBitmap() or PreloadSVG() are still loading, or loaded and not yet in the cache, which
+   * happens at the next frame */
+  bool IsLoadingResources() const;
+
   /** @param fileNameOrResID A CString absolute path or resource ID
    * @return \c true on success */
   virtual bool LoadFont(const char* fileNameOrResID) { return false; }
@@ -1017,6 +1065,20 @@ protected:
   virtual APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) = 0;
   virtual APIBitmap* ScaleAPIBitmap(const APIBitmap* pBitmap, int scale) = 0;
   virtual APIBitmap* CreateAPIBitmap(int width, int height) = 0;
+
+  /** A function that loads a bitmap without using the IGraphics that made it, so that it can run on a worker thread */
+  typedef std::function<APIBitmap*()> APIBitmapLoaderFunc;
+
+  /** Drawing APIs that create bitmaps in memory, rather than in a context tied to the UI thread, override this so that PreloadBitmap()
+   * loads bitmaps on worker threads. The function returned does what LoadAPIBitmap() does, then what ScaleAPIBitmap() does if targetScale
+   * differs from scale, deleting the unscaled bitmap
+   * @return The function, or \c nullptr if bitmaps can only be loaded on the UI thread */
+  virtual APIBitmapLoaderFunc GetAPIBitmapLoader(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext, int targetScale) { return nullptr; }
+
+  /** Drawing APIs that can hold the frames of a multi frame bitmap in less memory than the bitmap they were loaded in override this. It is
+   * called by LoadBitmap() for bitmaps it has just loaded, before they are drawn
+   * @return The bitmap holding the frames, which replaces pBitmap in the cache, or \c nullptr to keep pBitmap */
+  virtual APIBitmap* PackAPIBitmap(const APIBitmap* pBitmap, int nStates, bool framesAreHorizontal) { return nullptr; }
     
   virtual int AlphaChannel() const = 0;
   virtual bool FlippedBitmap() const = 0;
@@ -1036,6 +1098,10 @@ protected:
   /** Search the static storage cache for a bitmap image resource matching the target scale */
   APIBitmap* SearchBitmapInCache(const char* fileName, int targetScale, int& sourceScale);
 
+  /** Replaces a bitmap that has just been added to the cache, and that nothing uses yet, by the one PackAPIBitmap() returns, if any
+   * @return The bitmap that is in the cache now */
+  APIBitmap* PackCachedBitmap(APIBitmap* pBitmap, const char* name, int nStates, bool framesAreHorizontal);
+
   virtual bool DoDrawMeasureText(const IText& text, const char* str, IRECT& bounds, const IBlend* pBlend = nullptr, bool measure = false) = 0;
     
   virtual float GetBackingPixelScale() const = 0;
@@ -1052,9 +1118,18 @@ protected:
   bool mTabletInput = false;
   float mCursorX = -1.f;
   float mCursorY = -1.f;
+  IDataColumns mDataColumns; // used by DrawData()
+  IRECT mDrawRegion; // set by DrawControl()
+  WDL_PtrList<IControl> mAnimatingControls; // controls with an animation function, see ScheduleAnimation()
+  TimePoint mFrameTime;
+  int mIdleTimerTicks = 0;
+  bool mTimerIdle = false;
+  IResourceLoader* mResourceLoader = nullptr; // created by the first PreloadBitmap() or PreloadSVG()
 
 private:
   virtual void PlatformResize() {}
+  /** Called by the draw loop to change the interval of the platform timer that calls IsDirty(), see IDLE_TIMER_TICKS */
+  virtual void PlatformSetTimerInterval(int milliseconds) {}
   virtual void DrawResize() {}
   
   void Draw(const IRECT& bounds, float scale);
@@ -18,6 +18,47 @@ static const int DEFAULT_FPS = 25; // TODO: default 60 FPS?
 // Only looked at if USE_IDLE_CALLS is defined.
 static const int IDLE_TICKS = 20;
 
+// If nothing is dirty or animating for this many timer ticks, the platform timer that redraws the UI slows down to IDLE_TIMER_INTERVAL_MS,
+// until a control is marked dirty or animated again. Controls that override IControl::IsDirty() to poll something are then only polled
+// every IDLE_TIMER_INTERVAL_MS. Define as 0 to keep the timer at the frame rate.
+#ifndef IDLE_TIMER_TICKS
+#define IDLE_TIMER_TICKS 10
+#endif
+
+#ifndef IDLE_TIMER_INTERVAL_MS
+#define IDLE_TIMER_INTERVAL_MS 250
+#endif
+
+// The number of worker threads IGraphics::PreloadBitmap() and IGraphics::PreloadSVG() load resources on. 0 for one per CPU core but one,
+// since the UI thread loads the resources it needs that no worker has started yet
+#ifndef RESOURCE_LOADER_THREADS
+#define RESOURCE_LOADER_THREADS 0
+#endif
+
+// Define FRAME_ATLAS as 1 for IGraphicsLice to hold the frames of bitmaps loaded with more than one frame in a LICEFrameAtlas, in which
+// identical frames are stored once. This trades drawing time for memory: with FRAME_ATLAS_COMPRESS the frames are stored compressed, and
+// the FRAME_ATLAS_HOT_FRAMES most recently drawn are kept decompressed. Define FRAME_ATLAS_COMPRESS as 0 to pack the frames into pages
+// FRAME_ATLAS_PAGE_WIDTH pixels wide and up to FRAME_ATLAS_PAGE_HEIGHT tall instead, which only saves memory if frames are repeated
+#ifndef FRAME_ATLAS
+#define FRAME_ATLAS 0
+#endif
+
+#ifndef FRAME_ATLAS_COMPRESS
+#define FRAME_ATLAS_COMPRESS 1
+#endif
+
+#ifndef FRAME_ATLAS_HOT_FRAMES
+#define FRAME_ATLAS_HOT_FRAMES 64
+#endif
+
+#ifndef FRAME_ATLAS_PAGE_WIDTH
+#define FRAME_ATLAS_PAGE_WIDTH 256
+#endif
+
+#ifndef FRAME_ATLAS_PAGE_HEIGHT
+#define FRAME_ATLAS_PAGE_HEIGHT 8192
+#endif
+
 #define DEFAULT_ANIMATION_DURATION 100
 
 #ifndef CONTROL_BOUNDS_COLOR
@@ -58,6 +99,9 @@ const int DEFAULT_TEXT_SIZE = 14;
   #elif defined OS_MAC
     const char* const DEFAULT_FONT = "Verdana";
     const int DEFAULT_TEXT_SIZE = 10;
+  #elif defined OS_LINUX && defined NO_IGRAPHICS // e.g. the headless bench target
+    const char* const DEFAULT_FONT = "Verdana";
+    const int DEFAULT_TEXT_SIZE = 10;
   #elif defined OS_LINUX
     #error NOT IMPLEMENTED
   #elif defined OS_WEB
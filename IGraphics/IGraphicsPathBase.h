@@ -101,8 +101,37 @@ public:
   
   void DrawData(const IColor& color, const IRECT& bounds, float* normYPoints, int nPoints, float* normXPoints, const IBlend* pBlend, float thickness) override
   {
+    if (nPoints < 2)
+      return;
+
     PathClear();
-    
+
+    const int nColumns = (int) std::ceil(bounds.W() * GetBackingPixelScale());
+
+    if (mDataColumns.Decimate(bounds, nColumns, normYPoints, nPoints, normXPoints, thickness))
+    {
+      // a single filled outline, along the tops of the column spans and back along their bottoms
+      const int first = mDataColumns.GetFirstColumn();
+      const int last = mDataColumns.GetLastColumn();
+      const float halfW = 0.5f * mDataColumns.GetColumnW();
+
+      PathMoveTo(mDataColumns.GetColumnL(first), mDataColumns.GetTop(first));
+
+      for (auto c = first; c <= last; c++)
+        PathLineTo(mDataColumns.GetColumnL(c) + halfW, mDataColumns.GetTop(c));
+
+      PathLineTo(mDataColumns.GetColumnL(last + 1), mDataColumns.GetTop(last));
+      PathLineTo(mDataColumns.GetColumnL(last + 1), mDataColumns.GetBottom(last));
+
+      for (auto c = last; c >= first; c--)
+        PathLineTo(mDataColumns.GetColumnL(c) + halfW, mDataColumns.GetBottom(c));
+
+      PathLineTo(mDataColumns.GetColumnL(first), mDataColumns.GetBottom(first));
+      PathClose();
+      PathFill(color, IFillOptions(), pBlend);
+      return;
+    }
+
     float xPos = bounds.L;
 
     PathMoveTo(xPos, bounds.B - (bounds.H() * normYPoints[0]));
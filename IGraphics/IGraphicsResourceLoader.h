@@ -0,0 +1,226 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IResourceLoader
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ptrlist.h"
+#include "wdlstring.h"
+
+/** Worker threads that load resources for IGraphics::PreloadBitmap() and IGraphics::PreloadSVG(). Each job has a key, e.g. the name of
+ * the resource. Workers run the jobs in the order they were added. When the UI thread needs a resource, Complete() runs its job on the
+ * UI thread if no worker has started it yet, or waits for the worker running it. Either way the result is then published, i.e. added to
+ * the cache IGraphics looks resources up in. PublishFinished() publishes the jobs that workers have finished, so that resources that are
+ * never waited for still end up in the cache. Only the UI thread adds, completes and publishes jobs. Jobs must not use the IGraphics, since
+ * the loader is deleted in ~IGraphics(), after the drawing and platform classes are gone. */
+class IResourceLoader
+{
+public:
+  /** A resource to load */
+  class Job
+  {
+  public:
+    Job(const char* key) : mKey(key) {}
+    virtual ~Job() {}
+
+    /** Loads the resource. Called on a worker thread, or on the UI thread by Complete() */
+    virtual void Run() = 0;
+
+    /** Adds the loaded resource to its cache. Called on the UI thread, after Run(). The job is deleted afterwards */
+    virtual void Publish() = 0;
+
+  private:
+    friend class IResourceLoader;
+    WDL_String mKey;
+    bool mStarted = false;
+    bool mFinished = false;
+  };
+
+  /** @param nThreads The number of worker threads, which are started when the first jobs are added. 0 for one per CPU core but one */
+  IResourceLoader(int nThreads = 0)
+  : mMaxThreads(nThreads > 0 ? nThreads : std::max((int) std::thread::hardware_concurrency() - 1, 1))
+  {
+  }
+
+  IResourceLoader(const IResourceLoader&) = delete;
+  IResourceLoader& operator=(const IResourceLoader&) = delete;
+
+  /** Waits for the jobs that workers are running, publishes all the finished jobs and deletes the rest */
+  ~IResourceLoader()
+  {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+
+    mWake.notify_all();
+
+    for (auto& thread : mThreads)
+      thread.join();
+
+    PublishFinished();
+    mJobs.Empty(true);
+  }
+
+  /** @return \c true if a job with this key has been added and not published yet */
+  bool Contains(const char* key)
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return Find(key) >= 0;
+  }
+
+  /** @return \c true if jobs have been added and not all published yet */
+  bool IsBusy()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mJobs.GetSize() > 0;
+  }
+
+  /** Queues a job for the workers. The loader owns it from now on */
+  void Add(Job* pJob)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mJobs.Add(pJob);
+
+      if ((int) mThreads.size() < mMaxThreads)
+        mThreads.emplace_back(&IResourceLoader::ThreadProc, this);
+    }
+
+    mWake.notify_one();
+  }
+
+  /** Makes sure the job with this key has run, running it on this thread if no worker has started it, then publishes it
+   * @return \c true if there was a job with this key */
+  bool Complete(const char* key)
+  {
+    Job* pJob = nullptr;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      const int idx = Find(key);
+
+      if (idx < 0)
+        return false;
+
+      pJob = mJobs.Get(idx);
+
+      if (pJob->mStarted)
+        mDone.wait(lock, [pJob]() { return pJob->mFinished; });
+      else
+        pJob->mStarted = true;
+
+      mJobs.Delete(mJobs.Find(pJob));
+    }
+
+    if (!pJob->mFinished)
+      pJob->Run();
+    else
+      mNFinished--;
+
+    pJob->Publish();
+    delete pJob;
+    return true;
+  }
+
+  /** Publishes the jobs that workers have finished. Cheap if there are none, so it can be called at every frame */
+  void PublishFinished()
+  {
+    if (!mNFinished.load())
+      return;
+
+    WDL_PtrList<Job> finished;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+
+      for (auto i = 0; i < mJobs.GetSize(); i++)
+      {
+        if (mJobs.Get(i)->mFinished)
+        {
+          finished.Add(mJobs.Get(i));
+          mJobs.Delete(i--);
+          mNFinished--;
+        }
+      }
+    }
+
+    for (auto i = 0; i < finished.GetSize(); i++)
+      finished.Get(i)->Publish();
+
+    finished.Empty(true);
+  }
+
+private:
+  int Find(const char* key) const
+  {
+    for (auto i = 0; i < mJobs.GetSize(); i++)
+    {
+      if (!strcmp(mJobs.Get(i)->mKey.Get(), key))
+        return i;
+    }
+
+    return -1;
+  }
+
+  void ThreadProc()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true)
+    {
+      Job* pJob = nullptr;
+
+      for (auto i = 0; i < mJobs.GetSize() && !pJob; i++)
+      {
+        if (!mJobs.Get(i)->mStarted)
+          pJob = mJobs.Get(i);
+      }
+
+      if (mStop)
+        return;
+
+      if (!pJob)
+      {
+        mWake.wait(lock);
+        continue;
+      }
+
+      pJob->mStarted = true;
+      lock.unlock();
+      pJob->Run();
+      lock.lock();
+      pJob->mFinished = true;
+      mNFinished++;
+      mDone.notify_all();
+    }
+  }
+
+  std::mutex mMutex;
+  std::condition_variable mWake; // a job was added, or the loader is stopping
+  std::condition_variable mDone; // a worker finished a job
+  WDL_PtrList<Job> mJobs; // added and not yet published, in the order they were added
+  std::vector<std::thread> mThreads;
+  std::atomic<int> mNFinished {0}; // jobs finished by workers and not yet published
+  const int mMaxThreads;
+  bool mStop = false;
+};
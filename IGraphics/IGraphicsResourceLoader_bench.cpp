@@ -0,0 +1,307 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of the time an editor's layout function spends loading bitmaps and SVGs, with and without
+ * IGraphics::PreloadBitmap() and IGraphics::PreloadSVG()
+ *
+ * -n film strip PNGs of -f frames of 128 x 128 pixels, available at @2x only, and -n SVGs of -p paths each are written to a temporary
+ * directory. An IGraphicsBench that loads PNGs with LICE, the way IGraphicsLice does, then loads them all at a screen scale of 1, so that
+ * each bitmap is decoded and scaled down, as a layout function does. This is done:
+ * - with LoadBitmap() and LoadSVG() only, i.e. on the UI thread,
+ * - with everything preloaded first, so that LoadBitmap() and LoadSVG() take over the jobs no worker has started and wait for the rest,
+ * - with everything preloaded, and loaded after the workers are done, as when the UI thread has other work to do, e.g. opening the window.
+ * The wall clock time of the layout and the time the UI thread spends in LoadBitmap() and LoadSVG() are printed for each, and for the last
+ * the time the workers took. Add -DRESOURCE_LOADER_THREADS=n to the build line to change the number of worker threads. A worker can only
+ * shorten the layout if there is a CPU core for it.
+ *
+ * Build on Linux with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -include cstdlib -DNOMINMAX -DNDEBUG -DNO_IGRAPHICS -DIGRAPHICS_LICE -D_LICE_NO_SYSBITMAPS_ -DSAMPLE_TYPE_DOUBLE -IWDL -IWDL/swell -IWDL/lice -IIPlug -IIGraphics -IIGraphics/Controls -IIGraphics/Platforms -IDependencies/IGraphics/NanoSVG/src -IDependencies/IGraphics/STB IGraphics/IGraphicsResourceLoader_bench.cpp IGraphics/IGraphics.cpp IGraphics/IControl.cpp IGraphics/IGraphicsEditorDelegate.cpp IGraphics/Controls/IControls.cpp IGraphics/Controls/IPopupMenuControl.cpp IGraphics/Controls/ITextEntryControl.cpp IPlug/IPlugParameter.cpp IPlug/IPlugPluginBase.cpp WDL/lice/lice.cpp WDL/lice/lice_line.cpp WDL/lice/lice_arc.cpp WDL/lice/lice_png.cpp $(ls WDL/libpng/*.c | grep -v pngtest) -lz -lpthread -o resourceloaderbench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "IGraphicsBench.h"
+
+struct Options
+{
+  int nResources = 50;
+  int nFrames = 32;
+  int nPaths = 200;
+};
+
+static double NowSeconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class PNGBitmap : public APIBitmap
+{
+public:
+  PNGBitmap(LICE_IBitmap* pBitmap, int scale) : APIBitmap(pBitmap, pBitmap->getWidth(), pBitmap->getHeight(), scale, 1.f) {}
+  ~PNGBitmap() { delete GetBitmap(); }
+};
+
+static LICE_IBitmap* ScalePNG(LICE_IBitmap* pSrc, int scale, int targetScale)
+{
+  const int w = (pSrc->getWidth() / scale) * targetScale;
+  const int h = (pSrc->getHeight() / scale) * targetScale;
+  LICE_MemBitmap* pDest = new LICE_MemBitmap(w, h);
+  LICE_ScaledBlit(pDest, pSrc, 0, 0, w, h, 0.f, 0.f, (float) pSrc->getWidth(), (float) pSrc->getHeight(), 1.f, LICE_BLIT_MODE_COPY | LICE_BLIT_FILTER_BILINEAR);
+  return pDest;
+}
+
+/** Loads PNGs the way IGraphicsLice does */
+class PNGBench : public IGraphicsBench
+{
+public:
+  using IGraphicsBench::IGraphicsBench;
+
+  bool BitmapExtSupported(const char* ext) override { return !strcmp(ext, "png"); }
+
+protected:
+  APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override
+  {
+    LICE_IBitmap* pBitmap = LICE_LoadPNG(fileNameOrResID);
+    return pBitmap ? new PNGBitmap(pBitmap, scale) : nullptr;
+  }
+
+  APIBitmap* ScaleAPIBitmap(const APIBitmap* pBitmap, int scale) override
+  {
+    return new PNGBitmap(ScalePNG(pBitmap->GetBitmap(), pBitmap->GetScale(), scale), scale);
+  }
+
+  APIBitmapLoaderFunc GetAPIBitmapLoader(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext, int targetScale) override
+  {
+    const WDL_String path(fileNameOrResID);
+
+    return [=]() -> APIBitmap* {
+      LICE_IBitmap* pBitmap = LICE_LoadPNG(path.Get());
+
+      if (pBitmap && targetScale != scale)
+      {
+        LICE_IBitmap* pScaled = ScalePNG(pBitmap, scale, targetScale);
+        delete pBitmap;
+        pBitmap = pScaled;
+      }
+
+      return pBitmap ? new PNGBitmap(pBitmap, targetScale) : nullptr;
+    };
+  }
+};
+
+// WDL's libpng is built without write support
+static bool WritePNG(const char* fileName, LICE_IBitmap* pBitmap)
+{
+  const int w = pBitmap->getWidth();
+  const int h = pBitmap->getHeight();
+  WDL_TypedBuf<unsigned char> raw, deflated;
+  unsigned char* pRaw = raw.Resize(h * (1 + 4 * w));
+
+  for (int y = 0; y < h; y++)
+  {
+    *pRaw++ = 0; // no filter
+
+    for (int x = 0; x < w; x++)
+    {
+      const LICE_pixel p = pBitmap->getBits()[y * pBitmap->getRowSpan() + x];
+      *pRaw++ = LICE_GETR(p);
+      *pRaw++ = LICE_GETG(p);
+      *pRaw++ = LICE_GETB(p);
+      *pRaw++ = LICE_GETA(p);
+    }
+  }
+
+  uLongf size = compressBound(raw.GetSize());
+
+  if (compress2(deflated.Resize((int) size), &size, raw.Get(), raw.GetSize(), 6) != Z_OK)
+    return false;
+
+  FILE* pFile = fopen(fileName, "wb");
+
+  if (!pFile)
+    return false;
+
+  auto writeChunk = [pFile](const char* type, const unsigned char* pData, uLong len) {
+    const unsigned char header[8] = { (unsigned char) (len >> 24), (unsigned char) (len >> 16), (unsigned char) (len >> 8), (unsigned char) len,
+                                      (unsigned char) type[0], (unsigned char) type[1], (unsigned char) type[2], (unsigned char) type[3] };
+    uLong crc = crc32(crc32(0, header + 4, 4), pData, (uInt) len);
+    const unsigned char footer[4] = { (unsigned char) (crc >> 24), (unsigned char) (crc >> 16), (unsigned char) (crc >> 8), (unsigned char) crc };
+    fwrite(header, 1, 8, pFile);
+    fwrite(pData, 1, len, pFile);
+    fwrite(footer, 1, 4, pFile);
+  };
+
+  const unsigned char ihdr[13] = { (unsigned char) (w >> 24), (unsigned char) (w >> 16), (unsigned char) (w >> 8), (unsigned char) w,
+                                   (unsigned char) (h >> 24), (unsigned char) (h >> 16), (unsigned char) (h >> 8), (unsigned char) h,
+                                   8, 6, 0, 0, 0 }; // 8 bit RGBA
+  fwrite("\x89PNG\r\n\x1a\n", 1, 8, pFile);
+  writeChunk("IHDR", ihdr, 13);
+  writeChunk("IDAT", deflated.Get(), size);
+  writeChunk("IEND", nullptr, 0);
+  fclose(pFile);
+  return true;
+}
+
+static bool WriteResources(const Options& o, const char* prefix)
+{
+  LICE_MemBitmap strip(256, 256 * o.nFrames);
+
+  for (int i = 0; i < o.nResources; i++)
+  {
+    LICE_Clear(&strip, LICE_RGBA(0, 0, 0, 0));
+
+    for (int f = 0; f < o.nFrames; f++)
+    {
+      const float angle = (float) (f + i) / (float) o.nFrames * 2.f * PI;
+      LICE_FillCircle(&strip, 128.f, 256.f * f + 128.f, 120.f, LICE_RGBA(40 + i % 200, 80, 160, 255), 1.f, LICE_BLIT_MODE_COPY, true);
+      LICE_FLine(&strip, 128.f, 256.f * f + 128.f, 128.f + 110.f * std::cos(angle), 256.f * f + 128.f + 110.f * std::sin(angle), LICE_RGBA(255, 255, 255, 255), 1.f, LICE_BLIT_MODE_COPY, true);
+    }
+
+    WDL_String name;
+    name.SetFormatted(64, "%sknob%d@2x.png", prefix, i);
+
+    if (!WritePNG(name.Get(), &strip))
+      return false;
+
+    name.SetFormatted(64, "%sicon%d.svg", prefix, i);
+    FILE* pFile = fopen(name.Get(), "w");
+
+    if (!pFile)
+      return false;
+
+    fprintf(pFile, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"100\" height=\"100\">\n");
+
+    for (int p = 0; p < o.nPaths; p++)
+      fprintf(pFile, "<path fill=\"#%06x\" d=\"M%d %d C %d %d, %d %d, %d %d S %d %d, %d %d Z\"/>\n", (i * 7919 + p * 104729) & 0xffffff,
+              p % 100, (p * 3) % 100, (p * 7) % 100, (p * 11) % 100, (p * 13) % 100, (p * 17) % 100, (p * 19) % 100, (p * 23) % 100,
+              (p * 29) % 100, (p * 31) % 100, (p * 37) % 100, (p * 41) % 100);
+
+    fprintf(pFile, "</svg>\n");
+    fclose(pFile);
+  }
+
+  return true;
+}
+
+enum class EMode { kLoadOnly, kPreload, kPreloadAndWait };
+
+static void Run(const Options& o, const char* prefix, EMode mode, const char* label)
+{
+  IGraphicsBench::Delegate dlg;
+  PNGBench g(dlg, 400, 400);
+  WDL_PtrList<IBitmap> bitmaps;
+  WDL_String name;
+
+  const double t0 = NowSeconds();
+
+  if (mode != EMode::kLoadOnly)
+  {
+    for (int i = 0; i < o.nResources; i++)
+    {
+      name.SetFormatted(64, "%sknob%d.png", prefix, i);
+      g.PreloadBitmap(name.Get());
+      name.SetFormatted(64, "%sicon%d.svg", prefix, i);
+      g.PreloadSVG(name.Get());
+    }
+  }
+
+  if (mode == EMode::kPreloadAndWait)
+  {
+    // the workers publish what they finish at each frame
+    while (g.RunFrame(), g.IsLoadingResources())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  const double t1 = NowSeconds();
+
+  for (int i = 0; i < o.nResources; i++)
+  {
+    name.SetFormatted(64, "%sknob%d.png", prefix, i);
+    bitmaps.Add(new IBitmap(g.LoadBitmap(name.Get(), o.nFrames)));
+    name.SetFormatted(64, "%sicon%d.svg", prefix, i);
+
+    if (!g.LoadSVG(name.Get()).IsValid())
+      printf("failed to load %s\n", name.Get());
+  }
+
+  const double t2 = NowSeconds();
+
+  for (int i = 0; i < bitmaps.GetSize(); i++)
+  {
+    if (!bitmaps.Get(i)->GetAPIBitmap())
+      printf("failed to load bitmap %d\n", i);
+    else
+      g.ReleaseBitmap(*bitmaps.Get(i));
+  }
+
+  bitmaps.Empty(true);
+  if (mode == EMode::kPreloadAndWait)
+    printf("%-40s layout %8.1f ms, in LoadBitmap() and LoadSVG() %8.1f ms, after the workers took %.1f ms\n", label, 1e3 * (t2 - t1), 1e3 * (t2 - t1), 1e3 * (t1 - t0));
+  else
+    printf("%-40s layout %8.1f ms, in LoadBitmap() and LoadSVG() %8.1f ms\n", label, 1e3 * (t2 - t0), 1e3 * (t2 - t1));
+}
+
+int main(int argc, char* argv[])
+{
+  Options o;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      o.nResources = std::max(atoi(argv[++i]), 1);
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      o.nFrames = std::max(atoi(argv[++i]), 1);
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      o.nPaths = std::max(atoi(argv[++i]), 1);
+    else
+    {
+      printf("usage: %s [-n bitmaps and SVGs] [-f frames per bitmap] [-p paths per SVG]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  char dir[] = "/tmp/resourceloaderbenchXXXXXX";
+
+  if (!mkdtemp(dir) || chdir(dir))
+  {
+    printf("can't create a temporary directory\n");
+    return 1;
+  }
+
+  // every run has its own files, as SVGs stay in the cache once loaded
+  const char* prefixes[] = { "a", "b", "c" };
+
+  for (const char* prefix : prefixes)
+  {
+    if (!WriteResources(o, prefix))
+    {
+      printf("can't write the resources to %s\n", dir);
+      return 1;
+    }
+  }
+
+  printf("%d PNGs of %d frames at @2x, loaded at 1x, and %d SVGs of %d paths, %u CPU cores\n", o.nResources, o.nFrames, o.nResources, o.nPaths, std::thread::hardware_concurrency());
+  Run(o, prefixes[0], EMode::kLoadOnly, "loaded on the UI thread");
+  Run(o, prefixes[1], EMode::kPreload, "preloaded, then loaded");
+  Run(o, prefixes[2], EMode::kPreloadAndWait, "preloaded, loaded once workers are done");
+
+  char cmd[64];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  return system(cmd);
+}
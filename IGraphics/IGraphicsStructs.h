@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <random>
 #include <chrono>
+#include <memory>
 
 #include "wdlstring.h"
 #include "ptrlist.h"
@@ -1049,6 +1050,11 @@ public:
     return *(mRects.GetFast() + idx);
   }
   
+  void Delete(int idx)
+  {
+    mRects.Delete(idx);
+  }
+  
   void Clear()
   {
     mRects.Resize(0);
@@ -1176,6 +1182,112 @@ private:
   WDL_TypedBuf<IRECT> mRects;
 };
 
+/** Reduces a data plot, as drawn by IGraphics::DrawData(), to one vertical span per pixel column, so that it can be drawn with a span per
+ * column or a single filled path however many points it has. Each span covers the minimum and maximum of the points in its column, and
+ * the line into the next column, so that the plot stays connected and no peak is lost */
+class IDataColumns
+{
+public:
+  /** @param bounds The rectangular region the data is plotted in, as for DrawData()
+   * @param nColumns The number of columns across bounds, normally its width in backing pixels
+   * @param normYPoints The y values, 0 is the bottom of bounds and 1 the top
+   * @param nPoints The number of values
+   * @param normXPoints Optional increasing x values from 0 (left) to 1 (right), if nullptr the points are evenly spaced
+   * @param thickness The line thickness, each span extends by half of it above and below
+   * @return \c true if the data was decimated, \c false if it has no more points than columns, in which case it is better drawn as a polyline */
+  bool Decimate(const IRECT& bounds, int nColumns, const float* normYPoints, int nPoints, const float* normXPoints = nullptr, float thickness = 1.f)
+  {
+    if (nColumns < 1 || nPoints < 2 || nPoints <= nColumns)
+      return false;
+
+    mNColumns = nColumns;
+    mL = bounds.L;
+    mColumnW = bounds.W() / (float) nColumns;
+    mSpans.Resize(2 * nColumns, false);
+
+    float* pSpans = mSpans.Get();
+    const float xScale = normXPoints ? (float) nColumns : (float) nColumns / (float) (nPoints - 1);
+
+    auto getX = [&](int i) { return normXPoints ? normXPoints[i] * xScale : (float) i * xScale; }; // in columns
+    auto getY = [&](int i) { return bounds.B - (bounds.H() * normYPoints[i]); };
+    auto extend = [pSpans](int col, float y) { pSpans[2 * col] = std::min(pSpans[2 * col], y); pSpans[2 * col + 1] = std::max(pSpans[2 * col + 1], y); };
+
+    float prevX = getX(0);
+    float prevY = getY(0);
+    int prevCol = Clip((int) prevX, 0, nColumns - 1);
+    pSpans[2 * prevCol] = pSpans[2 * prevCol + 1] = prevY;
+    mFirstColumn = prevCol;
+
+    for (auto i = 1; i < nPoints; i++)
+    {
+      const float x = getX(i);
+      const float y = getY(i);
+      const int col = Clip((int) x, prevCol, nColumns - 1);
+
+      if (col == prevCol)
+        extend(col, y);
+      else
+      {
+        // the y of the line from the previous point at the left edge of column c
+        const float slope = (y - prevY) / std::max(x - prevX, 1e-6f);
+        auto yAtEdge = [&](int c) { return prevY + slope * Clip((float) c - prevX, 0.f, x - prevX); };
+
+        float yEdge = yAtEdge(prevCol + 1);
+        extend(prevCol, yEdge);
+
+        // columns that the line crosses without a point in them
+        for (auto c = prevCol + 1; c < col; c++)
+        {
+          const float yNextEdge = yAtEdge(c + 1);
+          pSpans[2 * c] = std::min(yEdge, yNextEdge);
+          pSpans[2 * c + 1] = std::max(yEdge, yNextEdge);
+          yEdge = yNextEdge;
+        }
+
+        pSpans[2 * col] = std::min(yEdge, y);
+        pSpans[2 * col + 1] = std::max(yEdge, y);
+      }
+
+      prevX = x;
+      prevY = y;
+      prevCol = col;
+    }
+
+    mLastColumn = prevCol;
+
+    const float halfThickness = 0.5f * thickness;
+
+    for (auto c = mFirstColumn; c <= mLastColumn; c++)
+    {
+      pSpans[2 * c] -= halfThickness;
+      pSpans[2 * c + 1] += halfThickness;
+    }
+
+    return true;
+  }
+
+  /** @return The first column with data */
+  int GetFirstColumn() const { return mFirstColumn; }
+  /** @return The last column with data */
+  int GetLastColumn() const { return mLastColumn; }
+  /** @return The width of a column */
+  float GetColumnW() const { return mColumnW; }
+  /** @return The x coordinate of the left edge of column c */
+  float GetColumnL(int c) const { return mL + (float) c * mColumnW; }
+  /** @return The top of the span of column c */
+  float GetTop(int c) const { return mSpans.Get()[2 * c]; }
+  /** @return The bottom of the span of column c */
+  float GetBottom(int c) const { return mSpans.Get()[2 * c + 1]; }
+
+private:
+  WDL_TypedBuf<float> mSpans; // top and bottom of each column
+  int mNColumns = 0;
+  int mFirstColumn = 0;
+  int mLastColumn = -1;
+  float mL = 0.f;
+  float mColumnW = 1.f;
+};
+
 /** Used to store transformation matrices **/
 struct IMatrix
 {
@@ -0,0 +1,291 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IGraphicsBench
+ */
+
+#include <sys/stat.h>
+
+#include "IGraphics.h"
+#include "IGraphicsEditorDelegate.h"
+#include "lice.h"
+
+/** A headless IGraphics for command line benchmarks of controls and of the draw loop. There is no window: shapes are drawn with LICE into a
+ * LICE_MemBitmap, clipped to the region being redrawn the way a platform's paint call clips, and RunFrame() does what the platform class
+ * does at each display refresh. Text, bitmaps and SVGs are not drawn, and platform calls do nothing. LICE drops the part of an
+ * anti-aliased line that falls in the last pixel of a region, so lines on the edge of a region can differ slightly from a whole redraw.
+ * Compile with NO_IGRAPHICS and IGRAPHICS_LICE, plus _LICE_NO_SYSBITMAPS_ on Linux, and link IGraphics.cpp, IControl.cpp,
+ * IGraphicsEditorDelegate.cpp and the controls it includes, the IPlug sources they use and WDL/lice/lice.cpp, lice_line.cpp and
+ * lice_arc.cpp. See IVKeyboardControl_bench.cpp. Benchmarks that load bitmaps override the bitmap loading methods in a subclass,
+ * see IGraphicsResourceLoader_bench.cpp */
+class IGraphicsBench : public IGraphics
+{
+public:
+  /** A delegate with no parameters, for controls that are not linked to any */
+  class Delegate : public IGEditorDelegate
+  {
+  public:
+    Delegate(int nParams = 0) : IGEditorDelegate(nParams) {}
+    void BeginInformHostOfParamChangeFromUI(int paramIdx) override {}
+    void EndInformHostOfParamChangeFromUI(int paramIdx) override {}
+  };
+
+  IGraphicsBench(IGEditorDelegate& dlg, int w, int h, int fps = 0, float scale = 1.f)
+  : IGraphics(dlg, w, h, fps, scale)
+  , mDrawBitmap(w, h)
+  , mTimerInterval((int) std::round(1000. / FPS()))
+  {
+  }
+
+  /** What the platform class does at each display refresh: collects the dirty regions of the controls, sets them clean and redraws them
+   * @return \c true if anything was dirty */
+  bool RunFrame()
+  {
+    IRECTList rects;
+
+    if (!IsDirty(rects))
+      return false;
+
+    SetAllControlsClean();
+    Draw(rects);
+    return true;
+  }
+
+  /** @return The interval in milliseconds at which the platform timer would call RunFrame(), which IGraphics slows down while idle */
+  int GetTimerInterval() const { return mTimerInterval; }
+
+  /** @return The number of pixels in the regions prepared for drawing since the last call, counted once per control drawn in them */
+  int64_t GetAndResetPixelsDrawn() { const int64_t n = mPixelsDrawn; mPixelsDrawn = 0; return n; }
+
+  const char* GetDrawingAPIStr() override { return "LICE (headless)"; }
+  void* GetDrawContext() override { return &mDrawBitmap; }
+  float GetBackingPixelScale() const override { return 1.f; }
+
+  void DrawPoint(const IColor& color, float x, float y, const IBlend* pBlend) override
+  {
+    LICE_PutPixel(&mRegion, (int) X(x), (int) Y(y), LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend));
+  }
+
+  void DrawLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness) override
+  {
+    LICE_FLine(&mRegion, X(x1), Y(y1), X(x2), Y(y2), LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend), true);
+  }
+
+  void DrawDottedLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness, float dashLen) override
+  {
+    LICE_DashedLine(&mRegion, (int) X(x1), (int) Y(y1), (int) X(x2), (int) Y(y2), (int) dashLen, (int) dashLen, LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend), false);
+  }
+
+  void DrawTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend, float thickness) override
+  {
+    float x[3] = { x1, x2, x3 };
+    float y[3] = { y1, y2, y3 };
+    DrawConvexPolygon(color, x, y, 3, pBlend, thickness);
+  }
+
+  void DrawRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend, float thickness) override
+  {
+    const IRECT r = bounds.GetPixelAligned();
+    LICE_DrawRect(&mRegion, (int) X(r.L), (int) Y(r.T), (int) r.W(), (int) r.H(), LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend));
+  }
+
+  void DrawRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius, const IBlend* pBlend, float thickness) override
+  {
+    DrawRect(color, bounds, pBlend, thickness);
+  }
+
+  void DrawRoundRect(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, const IBlend* pBlend, float thickness) override
+  {
+    DrawRect(color, bounds, pBlend, thickness);
+  }
+
+  void DrawArc(const IColor& color, float cx, float cy, float r, float aMin, float aMax, const IBlend* pBlend, float thickness) override
+  {
+    LICE_Arc(&mRegion, X(cx), Y(cy), r, DegToRad(aMin), DegToRad(aMax), LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend), true);
+  }
+
+  void DrawCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend, float thickness) override
+  {
+    LICE_Circle(&mRegion, X(cx), Y(cy), r, LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend), true);
+  }
+
+  void DrawEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend, float thickness) override
+  {
+    DrawCircle(color, bounds.MW(), bounds.MH(), 0.5f * std::min(bounds.W(), bounds.H()), pBlend, thickness);
+  }
+
+  void DrawEllipse(const IColor& color, float x, float y, float r1, float r2, float angle, const IBlend* pBlend, float thickness) override
+  {
+    DrawCircle(color, x, y, std::min(r1, r2), pBlend, thickness);
+  }
+
+  void DrawConvexPolygon(const IColor& color, float* x, float* y, int nPoints, const IBlend* pBlend, float thickness) override
+  {
+    for (int i = 0; i < nPoints; i++)
+    {
+      const int j = (i + 1) % nPoints;
+      DrawLine(color, x[i], y[i], x[j], y[j], pBlend, thickness);
+    }
+  }
+
+  void DrawDottedRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend, float thickness, float dashLen) override
+  {
+    DrawRect(color, bounds, pBlend, thickness);
+  }
+
+  void FillTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend) override
+  {
+    LICE_FillTriangle(&mRegion, (int) X(x1), (int) Y(y1), (int) X(x2), (int) Y(y2), (int) X(x3), (int) Y(y3), LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend));
+  }
+
+  void FillRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend) override
+  {
+    const IRECT r = bounds.GetPixelAligned();
+    LICE_FillRect(&mRegion, (int) X(r.L), (int) Y(r.T), (int) r.W(), (int) r.H(), LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend));
+  }
+
+  void FillRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius, const IBlend* pBlend) override
+  {
+    FillRect(color, bounds, pBlend);
+  }
+
+  void FillRoundRect(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, const IBlend* pBlend) override
+  {
+    FillRect(color, bounds, pBlend);
+  }
+
+  void FillCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend) override
+  {
+    LICE_FillCircle(&mRegion, X(cx), Y(cy), r, LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend), true);
+  }
+
+  void FillEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend) override
+  {
+    FillCircle(color, bounds.MW(), bounds.MH(), 0.5f * std::min(bounds.W(), bounds.H()), pBlend);
+  }
+
+  void FillEllipse(const IColor& color, float x, float y, float r1, float r2, float angle, const IBlend* pBlend) override
+  {
+    FillCircle(color, x, y, std::min(r1, r2), pBlend);
+  }
+
+  void FillArc(const IColor& color, float cx, float cy, float r, float aMin, float aMax, const IBlend* pBlend) override
+  {
+    FillCircle(color, cx, cy, r, pBlend);
+  }
+
+  void FillConvexPolygon(const IColor& color, float* x, float* y, int nPoints, const IBlend* pBlend) override
+  {
+    WDL_TypedBuf<int> xy;
+    int* pXY = xy.Resize(2 * nPoints);
+
+    for (int i = 0; i < nPoints; i++)
+    {
+      pXY[i] = (int) X(x[i]);
+      pXY[nPoints + i] = (int) Y(y[i]);
+    }
+
+    LICE_FillConvexPolygon(&mRegion, pXY, pXY + nPoints, nPoints, LiceColor(color), BlendWeight(pBlend), LiceBlendMode(pBlend));
+  }
+
+  IColor GetPoint(int x, int y) override
+  {
+    const LICE_pixel p = LICE_GetPixel(&mDrawBitmap, x, y);
+    return IColor(LICE_GETA(p), LICE_GETR(p), LICE_GETG(p), LICE_GETB(p));
+  }
+
+  // Not drawn
+  void DrawSVG(ISVG& svg, const IRECT& bounds, const IBlend* pBlend) override {}
+  void DrawRotatedSVG(ISVG& svg, float destCentreX, float destCentreY, float width, float height, double angle, const IBlend* pBlend) override {}
+  void DrawBitmap(IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend) override {}
+  void DrawFittedBitmap(IBitmap& bitmap, const IRECT& bounds, const IBlend* pBlend) override {}
+  void DrawRotatedBitmap(IBitmap& bitmap, float destCentreX, float destCentreY, double angle, int yOffsetZeroDeg, const IBlend* pBlend) override {}
+  void DrawRotatedMask(IBitmap& base, IBitmap& mask, IBitmap& top, float x, float y, double angle, const IBlend* pBlend) override {}
+  bool BitmapExtSupported(const char* ext) override { return false; }
+
+  // No platform
+  void HideMouseCursor(bool hide, bool lock) override {}
+  void MoveMouseCursor(float x, float y) override {}
+  void SetMouseCursor(ECursor cursor) override {}
+  void ForceEndUserEdit() override {}
+  void* OpenWindow(void* pParentWnd) override { return nullptr; }
+  void CloseWindow() override {}
+  void* GetWindow() override { return nullptr; }
+  bool GetTextFromClipboard(WDL_String& str) override { return false; }
+  void UpdateTooltips() override {}
+  int ShowMessageBox(const char* str, const char* caption, EMessageBoxType type) override { return 0; }
+  void PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* extensions) override {}
+  void PromptForDirectory(WDL_String& dir) override {}
+  bool PromptForColor(IColor& color, const char* str) override { return false; }
+  bool OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure) override { return false; }
+
+  EResourceLocation OSFindResource(const char* fileNameOrResID, const char* type, WDL_String& result) override
+  {
+    struct stat st;
+
+    if (!CStringHasContents(fileNameOrResID) || stat(fileNameOrResID, &st))
+      return kNotFound;
+
+    result.Set(fileNameOrResID);
+    return kAbsolutePath;
+  }
+
+protected:
+  void CreatePlatformTextEntry(IControl& control, const IText& text, const IRECT& bounds, const char* str) override {}
+  IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT& bounds, IControl* pCaller) override { return nullptr; }
+
+  APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override { return nullptr; }
+  APIBitmap* ScaleAPIBitmap(const APIBitmap* pBitmap, int scale) override { return nullptr; }
+  APIBitmap* CreateAPIBitmap(int width, int height) override { return nullptr; }
+
+  int AlphaChannel() const override { return LICE_PIXEL_A; }
+  bool FlippedBitmap() const override { return false; }
+
+  void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override {}
+  void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override {}
+
+  bool DoDrawMeasureText(const IText& text, const char* str, IRECT& bounds, const IBlend* pBlend, bool measure) override
+  {
+    // roughly the size a font of text.mSize would take, so that text controls lay out
+    if (measure)
+      bounds = IRECT(bounds.L, bounds.T, bounds.L + 0.5f * text.mSize * (float) (str ? strlen(str) : 0), bounds.T + (float) text.mSize);
+
+    return true;
+  }
+
+private:
+  void PlatformSetTimerInterval(int milliseconds) override { mTimerInterval = milliseconds; }
+
+  void PrepareRegion(const IRECT& bounds) override
+  {
+    const IRECT r = bounds.GetPixelAligned();
+    mRegion = LICE_SubBitmap(&mDrawBitmap, (int) r.L, (int) r.T, (int) r.W(), (int) r.H());
+    mRegionX = std::max(r.L, 0.f); // as LICE_SubBitmap clamps it
+    mRegionY = std::max(r.T, 0.f);
+    mPixelsDrawn += mRegion.getWidth() * mRegion.getHeight();
+  }
+
+  float X(float x) const { return x - mRegionX; }
+  float Y(float y) const { return y - mRegionY; }
+
+  static LICE_pixel LiceColor(const IColor& color) { return LICE_RGBA(color.R, color.G, color.B, color.A); }
+  static int LiceBlendMode(const IBlend* pBlend) { return (pBlend && pBlend->mMethod == EBlendType::kBlendClobber) ? LICE_BLIT_MODE_COPY : LICE_BLIT_MODE_COPY | LICE_BLIT_USE_ALPHA; }
+
+  LICE_MemBitmap mDrawBitmap;
+  LICE_SubBitmap mRegion {&mDrawBitmap, 0, 0, 0, 0}; // the part of mDrawBitmap being redrawn, which LICE clips to
+  float mRegionX = 0.f;
+  float mRegionY = 0.f;
+  int64_t mPixelsDrawn = 0;
+  int mTimerInterval; // set by PlatformSetTimerInterval()
+};
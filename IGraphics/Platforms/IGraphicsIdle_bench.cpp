@@ -0,0 +1,163 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of the CPU an open editor uses while it is idle or animating little
+ *
+ * -n vector knobs, sliders, switches and buttons are attached to an IGraphicsBench, and its draw loop is run for -d seconds by a simulated
+ * platform timer, which sleeps until its next tick the way the timers of the platform classes do, and follows
+ * IGraphicsBench::GetTimerInterval() the way they follow IGraphics::PlatformSetTimerInterval(). This is done with nothing happening,
+ * with a knob being set from the delegate every -e milliseconds, as when its parameter is automated, and with a button being clicked
+ * every -e milliseconds, which starts its flash animation. The CPU time of the process (getrusage()) per second of wall clock time, the timer ticks per second and the frames drawn per second are
+ * printed for each. With -a the timer stays at the frame rate, as if IDLE_TIMER_TICKS was 0.
+ *
+ * Build on Linux with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -include cstdlib -DNOMINMAX -DNDEBUG -DNO_IGRAPHICS -DIGRAPHICS_LICE -D_LICE_NO_SYSBITMAPS_ -DSAMPLE_TYPE_DOUBLE -IWDL -IWDL/swell -IWDL/lice -IIPlug -IIGraphics -IIGraphics/Controls -IIGraphics/Platforms -IDependencies/IGraphics/NanoSVG/src -IDependencies/IGraphics/STB IGraphics/Platforms/IGraphicsIdle_bench.cpp IGraphics/IGraphics.cpp IGraphics/IControl.cpp IGraphics/IGraphicsEditorDelegate.cpp IGraphics/Controls/IControls.cpp IGraphics/Controls/IPopupMenuControl.cpp IGraphics/Controls/ITextEntryControl.cpp IPlug/IPlugParameter.cpp IPlug/IPlugPluginBase.cpp WDL/lice/lice.cpp WDL/lice/lice_line.cpp WDL/lice/lice_arc.cpp -lpthread -o idlebench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <sys/resource.h>
+
+#include "IGraphicsBench.h"
+#include "IControls.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+  int nControls = 1000;
+  int fps = 60;
+  double seconds = 5.;
+  int eventInterval = 500;
+  bool timerAtFrameRate = false;
+};
+
+static double CPUSeconds()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+/** Runs the draw loop of g for o.seconds, as a platform timer would, calling event every o.eventInterval milliseconds if it is set */
+static void Run(IGraphicsBench& g, const Options& o, const char* name, std::function<void()> event)
+{
+  auto getInterval = [&]() { return std::chrono::milliseconds(o.timerAtFrameRate ? 1000 / o.fps : g.GetTimerInterval()); };
+
+  g.RunFrame();
+
+  const double cpuStart = CPUSeconds();
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(o.seconds));
+  Clock::time_point nextTick = start + getInterval();
+  Clock::time_point nextEvent = start + std::chrono::milliseconds(o.eventInterval);
+  int ticks = 0, frames = 0;
+
+  while (true)
+  {
+    const bool isEvent = event && nextEvent < nextTick;
+    const Clock::time_point next = isEvent ? nextEvent : nextTick;
+
+    if (next >= end)
+      break;
+
+    std::this_thread::sleep_until(next);
+    const int interval = g.GetTimerInterval();
+
+    if (isEvent)
+    {
+      event();
+      nextEvent += std::chrono::milliseconds(o.eventInterval);
+    }
+    else
+    {
+      ticks++;
+      frames += g.RunFrame();
+      nextTick += getInterval();
+    }
+
+    // setting the interval of a platform timer restarts it
+    if (g.GetTimerInterval() != interval)
+      nextTick = Clock::now() + getInterval();
+  }
+
+  std::this_thread::sleep_until(end);
+  const double cpu = CPUSeconds() - cpuStart;
+  printf("%-28s CPU %8.3f ms per second (%.3f%%), %6.1f timer ticks and %6.1f frames per second\n", name, 1e3 * cpu / o.seconds,
+         100. * cpu / o.seconds, ticks / o.seconds, frames / o.seconds);
+}
+
+int main(int argc, char* argv[])
+{
+  Options o;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-a"))
+      o.timerAtFrameRate = true;
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      o.nControls = std::max(atoi(argv[++i]), 4);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      o.fps = Clip(atoi(argv[++i]), 1, 1000);
+    else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+      o.seconds = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-e") && i + 1 < argc)
+      o.eventInterval = std::max(atoi(argv[++i]), 1);
+    else
+    {
+      printf("usage: %s [-a] [-n controls] [-r fps] [-d seconds per run] [-e milliseconds between events]\n", argv[0]);
+      printf("  -a  keep the timer at the frame rate, as if IDLE_TIMER_TICKS was 0\n");
+      return 1;
+    }
+  }
+
+  IGraphicsBench::Delegate dlg;
+  const int columns = 40;
+  IGraphicsBench g(dlg, columns * 30, (o.nControls / columns + 1) * 30, o.fps);
+  g.AttachPanelBackground(COLOR_GRAY);
+
+  for (int i = 0; i < o.nControls; i++)
+  {
+    const IRECT r = IRECT(0.f, 0.f, 28.f, 28.f).GetTranslated((float) (i % columns) * 30.f, (float) (i / columns) * 30.f);
+
+    switch (i % 4)
+    {
+      case 0: g.AttachControl(new IVKnobControl(dlg, r, kNoParameter)); break;
+      case 1: g.AttachControl(new IVSliderControl(dlg, r, kNoParameter)); break;
+      case 2: g.AttachControl(new IVSwitchControl(dlg, r, kNoParameter)); break;
+      case 3: g.AttachControl(new IVButtonControl(dlg, r)); break;
+    }
+  }
+
+  IControl* pKnob = g.GetControl(1);
+  IControl* pButton = g.GetControl(4);
+
+  printf("%d controls, %d fps, %g seconds per run, timer %s\n", o.nControls, o.fps, o.seconds, o.timerAtFrameRate ? "at the frame rate" : "slowed down while idle");
+
+  Run(g, o, "idle", nullptr);
+
+  Run(g, o, "knob set from the delegate", [&]() {
+    pKnob->SetValueFromDelegate(pKnob->GetValue() > 0.5 ? 0.25 : 0.75);
+  });
+
+  Run(g, o, "button clicked, animated", [&]() {
+    const IRECT& r = pButton->GetRECT();
+    pButton->OnMouseDown(r.MW(), r.MH(), IMouseMod());
+  });
+
+  return 0;
+}
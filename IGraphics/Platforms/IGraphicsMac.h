@@ -31,6 +31,7 @@ public:
   void CloseWindow() override;
   bool WindowIsOpen() override;
   void PlatformResize() override;
+  void PlatformSetTimerInterval(int milliseconds) override;
   
   void PointToScreen(float& x, float& y);
   void ScreenToPoint(float& x, float& y);
@@ -249,6 +249,12 @@ bool IGraphicsMac::WindowIsOpen()
   return mView;
 }
 
+void IGraphicsMac::PlatformSetTimerInterval(int milliseconds)
+{
+  if (mView)
+    [(IGRAPHICS_VIEW*) mView setTimerInterval: (double) milliseconds / 1000.];
+}
+
 void IGraphicsMac::PlatformResize()
 {
   if (mView)
@@ -103,6 +103,7 @@ NSString* ToNSString(const char* cStr);
 - (void) drawRect: (NSRect) bounds;
 - (void) onTimer: (NSTimer*) pTimer;
 - (void) killTimer;
+- (void) setTimerInterval: (double) sec;
 //mouse
 - (void) getMouseXY: (NSEvent*) pEvent x: (float&) pX y: (float&) pY;
 - (IMouseInfo) getMouseLeft: (NSEvent*) pEvent;
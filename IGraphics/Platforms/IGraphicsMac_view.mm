@@ -638,6 +638,16 @@ inline int GetMouseOver(IGraphicsMac* pGraphics)
   mTimer = 0;
 }
 
+- (void) setTimerInterval: (double) sec
+{
+  if (!mTimer) // killed
+    return;
+
+  [mTimer invalidate];
+  mTimer = [NSTimer timerWithTimeInterval:sec target:self selector:@selector(onTimer:) userInfo:nil repeats:YES];
+  [[NSRunLoop currentRunLoop] addTimer: mTimer forMode: (NSString*) kCFRunLoopCommonModes];
+}
+
 - (void) removeFromSuperview
 {
   if (mTextFieldView)
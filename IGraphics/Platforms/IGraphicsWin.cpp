@@ -583,6 +583,13 @@ void IGraphicsWin::ForceEndUserEdit()
   mParamEditMsg = kCancel;
 }
 
+void IGraphicsWin::PlatformSetTimerInterval(int milliseconds)
+{
+  // the timer also polls mParamEditMsg, so it is not slowed down while the text edit window is open
+  if (mPlugWnd && !mParamEditWnd)
+    SetTimer(mPlugWnd, IPLUG_TIMER_ID, milliseconds, NULL); // replaces the timer set in WM_CREATE
+}
+
 #define SETPOS_FLAGS SWP_NOZORDER | SWP_NOMOVE | SWP_NOACTIVATE
 
 void IGraphicsWin::PlatformResize()
@@ -30,6 +30,7 @@ public:
   void ForceEndUserEdit() override;
 
   void PlatformResize() override;
+  void PlatformSetTimerInterval(int milliseconds) override;
 
   void CheckTabletInput(UINT msg);
     
@@ -97,23 +97,29 @@ void IPlugAPP::SendSysexMsgFromUI(const ISysEx& msg)
   SendSysEx(const_cast<ISysEx&>(msg));
 }
 
-void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
+void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames, const IMidiMsg* pMidiMsgs, int nMidiMsgs)
 {
   SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), false); //TODO: go elsewhere - enable inputs
   SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true); //TODO: go elsewhere
   AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), inputs, GetBlockSize());
   AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), outputs, GetBlockSize());
   
-  if(mMidiMsgsFromCallback.ElementsAvailable())
+  // messages from the editor have an offset of 0, so they go before the device MIDI to keep the block sorted
+  if(mMidiMsgsFromEditor.ElementsAvailable())
   {
     IMidiMsg msg;
-    
-    while (mMidiMsgsFromCallback.Pop(msg))
+
+    while (mMidiMsgsFromEditor.Pop(msg))
     {
       ProcessMidiMsg(msg);
-      mMidiMsgsFromProcessor.Push(msg); // queue incoming MIDI for UI
     }
   }
+
+  for (int i = 0; i < nMidiMsgs; i++)
+  {
+    ProcessMidiMsg(pMidiMsgs[i]);
+    mMidiMsgsFromProcessor.Push(pMidiMsgs[i]); // queue incoming MIDI for UI
+  }
   
   if(mSysExMsgsFromCallback.ElementsAvailable())
   {
@@ -127,16 +133,6 @@ void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
     }
   }
   
-  if(mMidiMsgsFromEditor.ElementsAvailable())
-  {
-    IMidiMsg msg;
-
-    while (mMidiMsgsFromEditor.Pop(msg))
-    {
-      ProcessMidiMsg(msg);
-    }
-  }
-
   //Do not handle Sysex messages here - SendSysexMsgFromUI overridden
 
   ProcessBuffers(0.0, GetBlockSize());
@@ -51,11 +51,13 @@ public:
   bool SendSysEx(const ISysEx& msg) override;
   
   //IPlugAPP
-  void AppProcess(double** inputs, double** outputs, int nFrames);
+  /** Processes a block of audio, called by IPlugAPPHost on the audio thread
+   * @param pMidiMsgs Incoming MIDI for the block, sorted by IMidiMsg::mOffset
+   * @param nMidiMsgs The number of messages in pMidiMsgs */
+  void AppProcess(double** inputs, double** outputs, int nFrames, const IMidiMsg* pMidiMsgs = nullptr, int nMidiMsgs = 0);
 
 private:
   IPlugAPPHost* mAppHost = nullptr;
-  IPlugQueue<IMidiMsg> mMidiMsgsFromCallback {MIDI_TRANSFER_SIZE};
   IPlugQueue<SysExData> mSysExMsgsFromCallback {SYSEX_TRANSFER_SIZE};
 
   friend class IPlugAPPHost;
@@ -28,10 +28,17 @@ UINT gSCROLLMSG;
 IPlugAPPHost::IPlugAPPHost()
 {
   mIPlug = MakePlug(this);
+  mBlockMidiMsgs.Resize(APP_MIDI_QUEUE_SIZE);
 }
 
 IPlugAPPHost::~IPlugAPPHost()
 {
+  if(mStreamErrorTimer)
+  {
+    mStreamErrorTimer->Stop();
+    DELETE_NULL(mStreamErrorTimer);
+  }
+
   mMidiIn->cancelCallback();
 
   DELETE_NULL(mMidiIn);
@@ -60,6 +67,8 @@ bool IPlugAPPHost::Init ()
   
   mIPlug->OnParamReset(kReset);
   mIPlug->OnActivate(true);
+
+  mStreamErrorTimer = Timer::Create([this](Timer& t) { ReportStreamErrors(); }, 1000);
   
   return true;
 }
@@ -471,6 +480,7 @@ bool IPlugAPPHost::SelectMIDIDevice(ERoute direction, const char* pPortName)
     if (mMidiIn)
     {
       mMidiIn->closePort();
+      mMidiClock.ResetIncoming();
 
       if (port == 0)
       {
@@ -563,14 +573,15 @@ bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_
     mDAC->closeStream();
   }
 
+  const int nPlugInputs = mIPlug->MaxNChannels(ERoute::kInput);
+  const int nPlugOutputs = mIPlug->MaxNChannels(ERoute::kOutput);
+
   RtAudio::StreamParameters iParams, oParams;
   iParams.deviceId = inId;
-  iParams.nChannels = 2; // TODO: flexible channel count
-  iParams.firstChannel = 0; // TODO: flexible channel count
+  iParams.firstChannel = 0; // TODO: flexible channel routing
 
   oParams.deviceId = outId;
-  oParams.nChannels = 2; // TODO: flexible channel count
-  oParams.firstChannel = 0; // TODO: flexible channel count
+  oParams.firstChannel = 0; // TODO: flexible channel routing
 
   mBufferSize = iovs; // mBufferSize may get changed by stream
 
@@ -582,15 +593,37 @@ bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_
 
   mBufIndex = 0;
   mSamplesElapsed = 0;
+  mVecElapsed = 0;
+  mMidiClock.Reset();
   mFadeMult = 0.;
   mSampleRate = (double) sr;
+
+  mInputFIFO.Resize(nPlugInputs * APP_SIGNAL_VECTOR_SIZE);
+  mOutputFIFO.Resize(nPlugOutputs * APP_SIGNAL_VECTOR_SIZE);
+  memset(mInputFIFO.Get(), 0, mInputFIFO.GetSize() * sizeof(double));
+  memset(mOutputFIFO.Get(), 0, mOutputFIFO.GetSize() * sizeof(double));
+  mInputPtrs.resize(nPlugInputs);
+  mOutputPtrs.resize(nPlugOutputs);
+
+  for (int c = 0; c < nPlugInputs; c++)
+    mInputPtrs[c] = mInputFIFO.Get() + c * APP_SIGNAL_VECTOR_SIZE;
+
+  for (int c = 0; c < nPlugOutputs; c++)
+    mOutputPtrs[c] = mOutputFIFO.Get() + c * APP_SIGNAL_VECTOR_SIZE;
   
   mIPlug->SetBlockSize(APP_SIGNAL_VECTOR_SIZE);
   mIPlug->SetSampleRate(mSampleRate);
 
   try
   {
-    mDAC->openStream(&oParams, &iParams, RTAUDIO_FLOAT64, sr, &mBufferSize, &AudioCallback, NULL, &options /*, &ErrorCallback */);
+    // open as many channels as the plug-in has, up to the number the devices have
+    mNDeviceInputs = std::min(nPlugInputs, (int) mDAC->getDeviceInfo(inId).inputChannels);
+    mNDeviceOutputs = std::min(nPlugOutputs, (int) mDAC->getDeviceInfo(outId).outputChannels);
+    iParams.nChannels = mNDeviceInputs;
+    oParams.nChannels = mNDeviceOutputs;
+
+    mDAC->openStream(mNDeviceOutputs ? &oParams : nullptr, mNDeviceInputs ? &iParams : nullptr, RTAUDIO_FLOAT64, sr, &mBufferSize, &AudioCallback, NULL, &options /*, &ErrorCallback */);
+    mProcessInPlace = (mBufferSize % APP_SIGNAL_VECTOR_SIZE) == 0; // the stream may have changed mBufferSize
     mDAC->startStream();
 
     mActiveState = mState;
@@ -637,58 +670,162 @@ bool IPlugAPPHost::InitMidi()
 // static
 int IPlugAPPHost::AudioCallback(void* pOutputBuffer, void* pInputBuffer, uint32_t nFrames, double streamTime, RtAudioStreamStatus status, void* pUserData)
 {
-  if ( status )
-    std::cout << "Stream underflow detected!" << std::endl;
-
   IPlugAPPHost* _this = sInstance;
 
+  if (status & RTAUDIO_INPUT_OVERFLOW)
+    _this->mInputOverflows.fetch_add(1, std::memory_order_relaxed);
+
+  if (status & RTAUDIO_OUTPUT_UNDERFLOW)
+    _this->mOutputUnderflows.fetch_add(1, std::memory_order_relaxed);
+
   double* pInputBufferD = static_cast<double*>(pInputBuffer);
   double* pOutputBufferD = static_cast<double*>(pOutputBuffer);
 
-  int inRightOffset = 0;
+  _this->mMidiClock.BeginBlock(streamTime, nFrames, _this->mSampleRate);
+
+  if (_this->mVecElapsed > APP_N_VECTOR_WAIT) // wait APP_N_VECTOR_WAIT * iovs before processing audio, to avoid clicks
+  {
+    _this->ProcessDeviceBuffers(pInputBufferD, pOutputBufferD, nFrames);
+    _this->ApplyOutputGain(pOutputBufferD, nFrames);
+  }
+  else if (pOutputBufferD)
+  {
+    memset(pOutputBufferD, 0, nFrames * _this->mNDeviceOutputs * sizeof(double));
+  }
+  
+  _this->mVecElapsed++;
+
+  return 0;
+}
 
-//  if(!mState.mAudioInIsMono)
-    inRightOffset = nFrames;
+void IPlugAPPHost::ProcessDeviceBuffers(const double* pInput, double* pOutput, int nFrames)
+{
+  const int blockSize = APP_SIGNAL_VECTOR_SIZE;
 
-  if (_this->mVecElapsed > APP_N_VECTOR_WAIT ) // wait APP_N_VECTOR_WAIT * iovs before processing audio, to avoid clicks
+  // a device that doesn't stick to the buffer size it was opened with drops back to the FIFOs, for good
+  if (mProcessInPlace && (nFrames % blockSize) != 0)
   {
-    for (int i=0; i<nFrames; i++)
+    mProcessInPlace = false;
+    mBufIndex = 0;
+    memset(mInputFIFO.Get(), 0, mInputFIFO.GetSize() * sizeof(double));
+    memset(mOutputFIFO.Get(), 0, mOutputFIFO.GetSize() * sizeof(double));
+
+    for (int c = 0; c < mNDeviceInputs; c++)
+      mInputPtrs[c] = mInputFIFO.Get() + c * blockSize;
+
+    for (int c = 0; c < mNDeviceOutputs; c++)
+      mOutputPtrs[c] = mOutputFIFO.Get() + c * blockSize;
+  }
+
+  if (mProcessInPlace)
+  {
+    // point the plug-in at each block of the device buffers. Channels the devices don't have stay on the FIFOs, inputs there are silent
+    for (int pos = 0; pos < nFrames; pos += blockSize)
     {
-      _this->mBufIndex %= APP_SIGNAL_VECTOR_SIZE;
+      for (int c = 0; c < mNDeviceInputs; c++)
+        mInputPtrs[c] = const_cast<double*>(pInput) + c * nFrames + pos;
 
-      if (_this->mBufIndex == 0)
-      {
-        double* inputs[2] = {pInputBufferD + i, pInputBufferD + inRightOffset + i};
-        double* outputs[2] = {pOutputBufferD + i, pOutputBufferD + nFrames + i};
+      for (int c = 0; c < mNDeviceOutputs; c++)
+        mOutputPtrs[c] = pOutput + c * nFrames + pos;
 
-        _this->mIPlug->AppProcess(inputs, outputs, APP_SIGNAL_VECTOR_SIZE);
+      const int nMidiMsgs = CollectMidiMsgs(mMidiClock.GetBlockStart() + pos);
+      mIPlug->AppProcess(mInputPtrs.data(), mOutputPtrs.data(), blockSize, mBlockMidiMsgs.Get(), nMidiMsgs);
+      mSamplesElapsed += blockSize;
+    }
 
-        _this->mSamplesElapsed += APP_SIGNAL_VECTOR_SIZE;
-      }
+    return;
+  }
 
-      // fade in
-      if (_this->mFadeMult < 1.)
-      {
-        _this->mFadeMult += (1. / nFrames);
-      }
+  int pos = 0;
 
-      pOutputBufferD[i] *= _this->mFadeMult;
-      pOutputBufferD[i + nFrames] *= _this->mFadeMult;
+  while (pos < nFrames)
+  {
+    const int n = std::min<int>(blockSize - mBufIndex, nFrames - pos);
+
+    for (int c = 0; c < mNDeviceInputs; c++)
+      memcpy(mInputPtrs[c] + mBufIndex, pInput + c * nFrames + pos, n * sizeof(double));
+
+    for (int c = 0; c < mNDeviceOutputs; c++)
+      memcpy(pOutput + c * nFrames + pos, mOutputPtrs[c] + mBufIndex, n * sizeof(double));
 
-      pOutputBufferD[i] *= APP_MULT;
-      pOutputBufferD[i + nFrames] *= APP_MULT;
+    mBufIndex += n;
+    pos += n;
 
-      _this->mBufIndex++;
+    if (mBufIndex == blockSize)
+    {
+      // the block holds the input from the last blockSize samples
+      const int nMidiMsgs = CollectMidiMsgs(mMidiClock.GetBlockStart() + pos - blockSize);
+      mIPlug->AppProcess(mInputPtrs.data(), mOutputPtrs.data(), blockSize, mBlockMidiMsgs.Get(), nMidiMsgs);
+      mSamplesElapsed += blockSize;
+      mBufIndex = 0;
     }
   }
-  else
+}
+
+int IPlugAPPHost::CollectMidiMsgs(int64_t blockStart)
+{
+  const int64_t blockEnd = blockStart + APP_SIGNAL_VECTOR_SIZE;
+  int nMsgs = 0;
+
+  // messages arrive in time order, so they come out sorted by offset. Any that are late go at the start of the block
+  while (nMsgs < mBlockMidiMsgs.GetSize() && mMidiMsgsFromCallback.ElementsAvailable())
   {
-    memset(pOutputBufferD, 0, nFrames * APP_NUM_CHANNELS * sizeof(double));
+    const TimedMidiMsg& next = mMidiMsgsFromCallback.Peek();
+    const int64_t position = mMidiClock.GetSamplePosition(next.mTime);
+
+    if (position >= blockEnd)
+      break;
+
+    IMidiMsg& msg = mBlockMidiMsgs.Get()[nMsgs++];
+    msg = next.mMsg;
+    msg.mOffset = (int) std::max<int64_t>(position - blockStart, 0);
+
+    TimedMidiMsg popped;
+    mMidiMsgsFromCallback.Pop(popped);
   }
-  
-  _this->mVecElapsed++;
 
-  return 0;
+  return nMsgs;
+}
+
+void IPlugAPPHost::ApplyOutputGain(double* pOutput, int nFrames)
+{
+  if (mFadeMult < 1.)
+  {
+    // fade in over one device buffer
+    const double start = mFadeMult;
+    const double step = 1. / nFrames;
+
+    for (int c = 0; c < mNDeviceOutputs; c++)
+    {
+      double* pChan = pOutput + c * nFrames;
+
+      for (int i = 0; i < nFrames; i++)
+        pChan[i] *= std::min(start + (i + 1) * step, 1.) * APP_MULT;
+    }
+
+    mFadeMult = std::min(start + nFrames * step, 1.);
+  }
+  else if (APP_MULT != 1)
+  {
+    const int n = nFrames * mNDeviceOutputs;
+
+    for (int i = 0; i < n; i++)
+      pOutput[i] *= APP_MULT;
+  }
+}
+
+void IPlugAPPHost::ReportStreamErrors()
+{
+  const uint32_t inputOverflows = mInputOverflows.load(std::memory_order_relaxed);
+  const uint32_t outputUnderflows = mOutputUnderflows.load(std::memory_order_relaxed);
+
+  if (inputOverflows != mReportedInputOverflows || outputUnderflows != mReportedOutputUnderflows)
+  {
+    std::cout << "Stream overflow/underflow detected! (" << (inputOverflows - mReportedInputOverflows) << " input overflows, "
+              << (outputUnderflows - mReportedOutputUnderflows) << " output underflows)" << std::endl;
+    mReportedInputOverflows = inputOverflows;
+    mReportedOutputUnderflows = outputUnderflows;
+  }
 }
 
 // static
@@ -714,9 +851,9 @@ void IPlugAPPHost::MIDICallback(double deltatime, std::vector<uint8_t>* pMsg, vo
   }
   else
   {
-    IMidiMsg msg(0, pMsg->at(0), pMsg->at(1), pMsg->at(2));
+    TimedMidiMsg msg { IMidiMsg(0, pMsg->at(0), pMsg->size() > 1 ? pMsg->at(1) : 0, pMsg->size() > 2 ? pMsg->at(2) : 0), _this->mMidiClock.StampIncoming(deltatime) };
     
-    _this->mIPlug->mMidiMsgsFromCallback.Push(msg);
+    _this->mMidiMsgsFromCallback.Push(msg);
   }
 }
 
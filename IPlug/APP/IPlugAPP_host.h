@@ -32,6 +32,8 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <atomic>
 
 #include "RtAudio.h"
 #include "RtMidi.h"
@@ -43,6 +45,7 @@
 #include "IPlugConstants.h"
 
 #include "IPlugAPP.h"
+#include "IPlugAPP_midiclock.h"
 
 #include "config.h"
 
@@ -71,6 +74,11 @@ extern HWND gHWND;
 extern HINSTANCE gHINSTANCE;
 extern UINT gSCROLLMSG;
 
+/** The number of incoming MIDI messages that can be waiting for the audio callback. They wait up to two device buffers */
+#ifndef APP_MIDI_QUEUE_SIZE
+#define APP_MIDI_QUEUE_SIZE 1024
+#endif
+
 class IPlugAPP;
 
 /** A class that hosts an IPlug as a standalone app and provides Audio/Midi I/O */
@@ -152,6 +160,13 @@ public:
     bool operator!=(const AppState& rhs) { return !operator==(rhs); }
   };
   
+  /** An incoming MIDI message, stamped on the IPlugAPPMidiClock::Now() clock */
+  struct TimedMidiMsg
+  {
+    IMidiMsg mMsg;
+    double mTime;
+  };
+
   static IPlugAPPHost* Create();
   static IPlugAPPHost* sInstance;
   
@@ -201,6 +216,22 @@ public:
   bool SelectMIDIDevice(ERoute direction, const char* portName);
   
   static int AudioCallback(void* pOutputBuffer, void* pInputBuffer, uint32_t nFrames, double streamTime, RtAudioStreamStatus status, void* pUserData);
+
+  /** Feeds a device buffer of any size through the plug-in in blocks of APP_SIGNAL_VECTOR_SIZE. Called on the audio thread
+   * @param pInput Non-interleaved device input, mNDeviceInputs channels of nFrames
+   * @param pOutput Non-interleaved device output, mNDeviceOutputs channels of nFrames */
+  void ProcessDeviceBuffers(const double* pInput, double* pOutput, int nFrames);
+
+  /** Pops the incoming MIDI messages that belong in a block into mBlockMidiMsgs, with their offsets in the block. Called on the audio thread
+   * @param blockStart The sample position of the block's first input sample, counted from the start of the stream
+   * @return The number of messages */
+  int CollectMidiMsgs(int64_t blockStart);
+
+  /** Applies the fade in and APP_MULT to the device output. Called on the audio thread */
+  void ApplyOutputGain(double* pOutput, int nFrames);
+
+  /** Logs input overflows and output underflows counted by the audio callback. Called on the main thread */
+  void ReportStreamErrors();
   static void MIDICallback(double deltatime, std::vector<uint8_t>* pMsg, void* pUserData);
   static void ErrorCallback(RtAudioError::Type type, const std::string& errorText);
 
@@ -229,6 +260,30 @@ private:
   uint32_t mVecElapsed = 0;
   uint32_t mBufferSize = 512;
   uint32_t mBufIndex; // index for signal vector, loops from 0 to mSigVS
+
+  /** The number of channels the stream was opened with, which is the plug-in's channel count, limited to what the devices have */
+  int mNDeviceInputs = 0;
+  int mNDeviceOutputs = 0;
+  /** When the device buffer size is a multiple of APP_SIGNAL_VECTOR_SIZE the plug-in processes the device buffers directly.
+   * Otherwise the signal goes through mInputFIFO and mOutputFIFO, which adds APP_SIGNAL_VECTOR_SIZE samples of latency */
+  bool mProcessInPlace = true;
+  /** One APP_SIGNAL_VECTOR_SIZE block per plug-in channel. Also used for the channels the devices don't have */
+  WDL_TypedBuf<double> mInputFIFO;
+  WDL_TypedBuf<double> mOutputFIFO;
+  std::vector<double*> mInputPtrs;
+  std::vector<double*> mOutputPtrs;
+
+  /** Counted on the audio thread and logged by ReportStreamErrors(), so that the callback doesn't do any I/O */
+  std::atomic<uint32_t> mInputOverflows {0};
+  std::atomic<uint32_t> mOutputUnderflows {0};
+  uint32_t mReportedInputOverflows = 0;
+  uint32_t mReportedOutputUnderflows = 0;
+  Timer* mStreamErrorTimer = nullptr;
+
+  /** Incoming MIDI is stamped in MIDICallback() and placed in the blocks of the audio stream by mMidiClock */
+  IPlugAPPMidiClock mMidiClock;
+  IPlugQueue<TimedMidiMsg> mMidiMsgsFromCallback {APP_MIDI_QUEUE_SIZE};
+  WDL_TypedBuf<IMidiMsg> mBlockMidiMsgs;
   
   /** The index of the operating systems default input device, -1 if not detected */
   int32_t mDefaultInputDev = -1;
@@ -0,0 +1,134 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Places MIDI messages received by RtMidi at sample positions in the audio stream of the standalone app
+ *
+ * The MIDI thread stamps each message with a monotonic clock (StampIncoming()). The audio callback relates that clock to its stream
+ * time (BeginBlock()), and each message is placed one device buffer after it arrived (GetSamplePosition()). That is a constant latency
+ * of one device buffer, instead of a jitter of up to one APP_SIGNAL_VECTOR_SIZE block.
+ *
+ * Both the MIDI driver and the audio callback deliver late by a varying amount, so each relationship between clocks is estimated
+ * with the smallest offset seen, which slowly rises to follow clock drift.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+class IPlugAPPMidiClock
+{
+public:
+  /** @return The monotonic clock, in seconds */
+  static double Now()
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /** Forget the relationship between the clocks, e.g. when the audio stream is restarted and its stream time starts from 0 again.
+   * Must not be called while the audio callback is running */
+  void Reset()
+  {
+    mStreamOffset.Reset();
+    mBlockStart = 0;
+    mNextBlockStart = 0;
+  }
+
+  /** Forget the driver's timeline, when a different MIDI input port is opened. Must not be called while the MIDI callback is running */
+  void ResetIncoming()
+  {
+    mDriverOffset.Reset();
+    mDriverTime = 0.;
+    mNMidiMsgs = 0;
+  }
+
+  /** Call on the MIDI thread for each message received
+   * @param deltaTime RtMidi's time since the previous message in seconds, as measured by the driver
+   * @return The time the message was received, on the Now() clock */
+  double StampIncoming(double deltaTime)
+  {
+    const double now = Now();
+
+    // RtMidi reports 0 for the first message, after which the driver's timeline is the sum of the deltas
+    mDriverTime = (mNMidiMsgs++ && deltaTime > 0.) ? mDriverTime + deltaTime : mDriverTime;
+
+    // the earliest the driver has delivered is the best estimate of where its timeline is on ours. It is never after now
+    return mDriverTime + mDriverOffset.Update(now - mDriverTime, now);
+  }
+
+  /** Call on the audio thread at the start of each device callback
+   * @param streamTime RtAudio's stream time, the time of the first sample of the buffer in seconds
+   * @param nFrames The size of the device buffer
+   * @param sampleRate The stream's sample rate */
+  void BeginBlock(double streamTime, int nFrames, double sampleRate)
+  {
+    const double now = Now();
+    mStreamStart = streamTime + mStreamOffset.Update(now - streamTime, now);
+    mSampleRate = sampleRate;
+    mBlockFrames = nFrames;
+    mBlockStart = mNextBlockStart;
+    mNextBlockStart += nFrames;
+  }
+
+  /** @return The position of the first sample of the device buffer, counted from the start of the stream */
+  int64_t GetBlockStart() const { return mBlockStart; }
+
+  /** Call on the audio thread after BeginBlock()
+   * @param time A time from StampIncoming()
+   * @return The sample position, counted from the start of the stream, that a message received at time should be processed at.
+   * Messages received during the previous device buffer are in the current one, those received after the current callback started
+   * are in the next one */
+  int64_t GetSamplePosition(double time) const
+  {
+    return mBlockStart + mBlockFrames + (int64_t) std::floor((time - mStreamStart) * mSampleRate);
+  }
+
+private:
+  /** Tracks the minimum of a noisy offset between two clocks, rising by at most kMaxDrift per second to follow drift */
+  struct MinOffset
+  {
+    static constexpr double kMaxDrift = 0.001;
+
+    double Update(double offset, double now)
+    {
+      if (!mValid || offset < mOffset + kMaxDrift * (now - mTime))
+        mOffset = offset;
+      else
+        mOffset += kMaxDrift * (now - mTime);
+
+      mTime = now;
+      mValid = true;
+      return mOffset;
+    }
+
+    void Reset() { mValid = false; }
+
+    double mOffset = 0.;
+    double mTime = 0.;
+    bool mValid = false;
+  };
+
+  // MIDI thread only
+  MinOffset mDriverOffset;
+  double mDriverTime = 0.;
+  uint64_t mNMidiMsgs = 0;
+
+  // audio thread only
+  MinOffset mStreamOffset;
+  double mStreamStart = 0.;
+  double mSampleRate = 44100.;
+  int mBlockFrames = 0;
+  int64_t mBlockStart = 0;
+  int64_t mNextBlockStart = 0;
+};
@@ -0,0 +1,237 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line tool that measures how accurately the standalone app places incoming MIDI in the audio stream
+ *
+ * Notes are sent through a virtual RtMidi output port and received on an input connected to it, then placed in a simulated audio
+ * stream by IPlugAPPMidiClock, exactly as IPlugAPPHost does. The placement error of each note is its sample position minus the ideal one,
+ * which is the time it was sent plus one device buffer. It is printed as a distribution, next to the error of the old placement,
+ * at the start of the first device buffer processed after the note arrived.
+ *
+ * Build on Linux (ALSA) with:
+ *
+ *   g++ -O2 -std=c++11 -D__LINUX_ALSA__ -IIPlug -IIPlug/APP -IWDL -IDependencies/IPlug/RTMidi \
+ *     IPlug/APP/IPlugAPP_midijitter.cpp Dependencies/IPlug/RTMidi/RtMidi.cpp -lasound -lpthread -o midijitter
+ *
+ * or on macOS with -D__MACOSX_CORE__ and -framework CoreMIDI -framework CoreAudio -framework CoreFoundation. Windows MIDI has no
+ * virtual ports, so use -s there, which calls the MIDI callback directly and only measures the placement.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "RtMidi.h"
+#include "IPlugQueue.h"
+#include "IPlugAPP_midiclock.h"
+
+#define JITTER_PORT_NAME "iPlug MIDI jitter"
+
+struct Received
+{
+  int mIdx;
+  double mTime;
+};
+
+struct Tester
+{
+  IPlugAPPMidiClock mClock;
+  IPlugQueue<Received> mReceived {1024};
+  std::vector<double> mSendTimes;
+  std::atomic<int> mNReceived {0};
+};
+
+static void MidiCallback(double deltaTime, std::vector<unsigned char>* pMsg, void* pUserData)
+{
+  Tester* pTester = (Tester*) pUserData;
+  const int idx = pTester->mNReceived++;
+  pTester->mReceived.Push({ idx, pTester->mClock.StampIncoming(deltaTime) });
+}
+
+static void PrintDistribution(const char* name, std::vector<double>& errors)
+{
+  if (errors.empty())
+  {
+    printf("%-10s no notes placed\n", name);
+    return;
+  }
+
+  std::sort(errors.begin(), errors.end());
+  const size_t n = errors.size();
+  double mean = 0.;
+
+  for (double e : errors)
+    mean += e;
+
+  mean /= n;
+
+  auto percentile = [&](double p) { return errors[std::min(n - 1, (size_t) (p * n))]; };
+
+  printf("%-10s mean %8.1f  min %8.1f  p1 %8.1f  p50 %8.1f  p99 %8.1f  max %8.1f  spread (p99 - p1) %7.1f samples\n",
+         name, mean, errors.front(), percentile(0.01), percentile(0.5), percentile(0.99), errors.back(), percentile(0.99) - percentile(0.01));
+}
+
+int main(int argc, char* argv[])
+{
+  int nNotes = 1000;
+  int bufferSize = 256;
+  double sampleRate = 44100.;
+  double intervalMs = 7.;
+  bool simulate = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-s"))
+      simulate = true;
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nNotes = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      bufferSize = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      sampleRate = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-i") && i + 1 < argc)
+      intervalMs = atof(argv[++i]);
+    else
+    {
+      printf("usage: %s [-s] [-n notes] [-b device buffer size] [-r sample rate] [-i mean interval ms]\n", argv[0]);
+      printf("  -s  call the MIDI callback directly, instead of looping back through a virtual port\n");
+      return 1;
+    }
+  }
+
+  Tester tester;
+  tester.mSendTimes.resize(nNotes);
+  RtMidiIn* pMidiIn = nullptr;
+  RtMidiOut* pMidiOut = nullptr;
+
+  if (!simulate)
+  {
+    try
+    {
+      pMidiOut = new RtMidiOut();
+      pMidiOut->openVirtualPort(JITTER_PORT_NAME);
+      pMidiIn = new RtMidiIn();
+
+      int port = -1;
+
+      for (unsigned int i = 0; i < pMidiIn->getPortCount(); i++)
+      {
+        if (pMidiIn->getPortName(i).find(JITTER_PORT_NAME) != std::string::npos)
+          port = (int) i;
+      }
+
+      if (port < 0)
+      {
+        printf("could not find the virtual port, try -s\n");
+        return 1;
+      }
+
+      pMidiIn->setCallback(&MidiCallback, &tester);
+      pMidiIn->openPort(port);
+    }
+    catch (RtMidiError& error)
+    {
+      error.printMessage();
+      return 1;
+    }
+  }
+
+  const double blockDuration = bufferSize / sampleRate;
+  std::atomic<bool> running {true};
+  std::vector<double> errors, oldErrors;
+  double streamStart = 0.;
+
+  // the audio thread: a device callback every bufferSize samples, woken up by the OS like a real one
+  std::thread audioThread([&]() {
+    streamStart = IPlugAPPMidiClock::Now();
+    int64_t callbackIdx = 0;
+
+    while (running)
+    {
+      const double deadline = streamStart + callbackIdx * blockDuration;
+      std::this_thread::sleep_for(std::chrono::duration<double>(std::max(0., deadline - IPlugAPPMidiClock::Now())));
+
+      tester.mClock.BeginBlock(callbackIdx * blockDuration, bufferSize, sampleRate);
+      const int64_t blockStart = tester.mClock.GetBlockStart();
+      Received received;
+
+      // the same placement as IPlugAPPHost::CollectMidiMsgs(), done for the whole device buffer
+      while (tester.mReceived.ElementsAvailable())
+      {
+        received = tester.mReceived.Peek();
+        const int64_t position = tester.mClock.GetSamplePosition(received.mTime);
+
+        if (position >= blockStart + bufferSize)
+          break;
+
+        tester.mReceived.Pop(received);
+
+        if (received.mIdx >= nNotes)
+          continue;
+
+        const double ideal = (tester.mSendTimes[received.mIdx] - streamStart) * sampleRate + bufferSize;
+        errors.push_back(blockStart + std::max<int64_t>(position - blockStart, 0) - ideal);
+      }
+
+      callbackIdx++;
+    }
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::mt19937 rng(1);
+  std::exponential_distribution<double> interval(1. / intervalMs);
+  std::vector<unsigned char> msg { 0x90, 60, 100 };
+  double lastSend = 0.;
+
+  for (int i = 0; i < nNotes; i++)
+  {
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(std::min(interval(rng), 10. * intervalMs)));
+    const double now = IPlugAPPMidiClock::Now();
+    tester.mSendTimes[i] = now;
+    msg[1] = (unsigned char) (i % 128);
+
+    if (simulate)
+    {
+      MidiCallback(i ? now - lastSend : 0., &msg, &tester);
+    }
+    else
+    {
+      pMidiOut->sendMessage(&msg);
+    }
+
+    lastSend = now;
+
+    // the old placement: the first block processed after the note arrived, which is the start of the next device callback
+    const double sinceStart = now - streamStart;
+    const double nextCallback = std::ceil(sinceStart / blockDuration) * blockDuration;
+    oldErrors.push_back((nextCallback - sinceStart) * sampleRate - bufferSize);
+  }
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(3. * blockDuration + 0.1));
+  running = false;
+  audioThread.join();
+
+  delete pMidiIn;
+  delete pMidiOut;
+
+  printf("%d notes, %d/%d received, device buffer %d, %.0f Hz%s\n", nNotes, (int) errors.size(), tester.mNReceived.load(), bufferSize,
+         sampleRate, simulate ? ", simulated MIDI" : "");
+  PrintDistribution("timestamped", errors);
+  PrintDistribution("old", oldErrors);
+  return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ ==============================================================================
+ 
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers. 
+ 
+ See LICENSE.txt for  more info.
+ 
+ ==============================================================================
+*/
+
+#include "IPlugBench.h"
+
+IPlugBench::IPlugBench(IPlugInstanceInfo instanceInfo, IPlugConfig c)
+: IPlugAPIBase(c, kAPIBENCH)
+, IPlugProcessor<PLUG_SAMPLE_DST>(c, kAPIBENCH)
+{
+  Trace(TRACELOC, "%s%s", c.pluginName, c.channelIOStr);
+
+  SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), true);
+  SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true);
+
+  SetBlockSize(DEFAULT_BLOCK_SIZE);
+  SetHost("bench", c.vendorVersion);
+}
+
+void IPlugBench::BenchReset(double sampleRate, int blockSize)
+{
+  SetSampleRate(sampleRate);
+  SetBlockSize(blockSize);
+  OnReset();
+  OnActivate(true);
+}
+
+void IPlugBench::BenchSetParameterValue(int paramIdx, double normalizedValue, int sampleOffset)
+{
+  ENTER_PARAMS_MUTEX;
+  GetParam(paramIdx)->SetNormalized(normalizedValue);
+  OnParamChange(paramIdx, kHost, sampleOffset);
+  LEAVE_PARAMS_MUTEX;
+}
+
+void IPlugBench::BenchProcess(PLUG_SAMPLE_DST** inputs, PLUG_SAMPLE_DST** outputs, int nFrames)
+{
+  AttachBuffers(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), inputs, nFrames);
+  AttachBuffers(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), outputs, nFrames);
+
+  if(GetBypassed())
+    PassThroughBuffers(PLUG_SAMPLE_DST(0.), nFrames);
+  else
+    ProcessBuffers(PLUG_SAMPLE_DST(0.), nFrames);
+}
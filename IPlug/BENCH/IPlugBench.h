@@ -0,0 +1,77 @@
+/*
+ ==============================================================================
+ 
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers. 
+ 
+ See LICENSE.txt for  more info.
+ 
+ ==============================================================================
+*/
+
+#ifndef _IPLUGAPI_
+#define _IPLUGAPI_
+
+/**
+ * @file
+ * @copydoc IPlugBench
+ */
+
+#include "IPlugPlatform.h"
+#include "IPlugAPIBase.h"
+#include "IPlugProcessor.h"
+
+/** Used to pass various instance info to the API class */
+struct IPlugInstanceInfo
+{};
+
+/** Headless benchmark API base class for an IPlug plug-in. There is no host, audio device or UI: the plug-in is driven directly
+ * by the command line tool in IPlugBench_main.cpp, which renders audio files or synthetic input through ProcessBlock() and reports timing.
+ * Build with BENCH_API and NO_IGRAPHICS, see common-bench.mk
+ * @ingroup APIClasses */
+class IPlugBench : public IPlugAPIBase
+                 , public IPlugProcessor<PLUG_SAMPLE_DST>
+{
+public:
+  IPlugBench(IPlugInstanceInfo instanceInfo, IPlugConfig config);
+
+  //IPlugAPIBase
+  void BeginInformHostOfParamChange(int idx) override {};
+  void InformHostOfParamChange(int idx, double normalizedValue) override {};
+  void EndInformHostOfParamChange(int idx) override {};
+  void InformHostOfProgramChange() override {};
+
+  //IPlugProcessor
+  bool SendMidiMsg(const IMidiMsg& msg) override { mNMidiMsgsOut++; return true; }
+  bool SendSysEx(const ISysEx& msg) override { mNMidiMsgsOut++; return true; }
+
+  //IPlugBench
+  /** Prepare the plug-in to process, in the same order as a host would: sample rate and block size, then OnReset() and OnActivate()
+   * @param sampleRate The sample rate
+   * @param blockSize The maximum block size that will be passed to BenchProcess() */
+  void BenchReset(double sampleRate, int blockSize);
+
+  /** Set a parameter, as host automation does on the audio thread. Call before BenchProcess() for the block it belongs to
+   * @param paramIdx The parameter index
+   * @param normalizedValue The new normalized value
+   * @param sampleOffset The offset in the next block */
+  void BenchSetParameterValue(int paramIdx, double normalizedValue, int sampleOffset);
+
+  /** Queue a MIDI message for the next block, msg.mOffset is the offset in that block */
+  void BenchProcessMidiMsg(const IMidiMsg& msg) { ProcessMidiMsg(msg); }
+
+  /** Process one block
+   * @param inputs MaxNChannels(ERoute::kInput) input buffers
+   * @param outputs MaxNChannels(ERoute::kOutput) output buffers
+   * @param nFrames The number of frames, must not exceed the block size passed to BenchReset() */
+  void BenchProcess(PLUG_SAMPLE_DST** inputs, PLUG_SAMPLE_DST** outputs, int nFrames);
+
+  /** @return The number of MIDI and SysEx messages sent by the plug-in */
+  int GetNMidiMsgsOut() const { return mNMidiMsgsOut; }
+
+private:
+  int mNMidiMsgsOut = 0;
+};
+
+IPlugBench* MakePlug();
+
+#endif
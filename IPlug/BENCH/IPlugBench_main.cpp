@@ -0,0 +1,784 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line driver for the headless IPlugBench API.
+ * Renders an audio file or a synthetic signal, plus an optional MIDI file and parameter automation, through the plug-in at one or more
+ * sample rates and block sizes, then reports the throughput (x realtime), the per block processing time percentiles and, when built with
+ * RT_GUARD=1, the number of heap allocations made on the audio path, which are detected and listed by IRTGuard (see IPlugRTGuard.h).
+ * Run with --help for the options.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+#include "wdlstring.h"
+#include "wavwrite.h"
+
+#include "IPlugPlatform.h"
+#include "IPlugBench.h"
+#include "IPlugRTGuard.h"
+
+#include "config.h"
+
+#pragma mark - Input files
+
+struct AudioFile
+{
+  int nChans = 0;
+  double sampleRate = 0.;
+  std::vector<float> samples; // interleaved
+  int NFrames() const { return nChans ? (int) samples.size() / nChans : 0; }
+};
+
+static uint32_t ReadLE(const uint8_t* p, int nBytes)
+{
+  uint32_t v = 0;
+
+  for (auto i = nBytes - 1; i >= 0; i--)
+    v = (v << 8) | p[i];
+
+  return v;
+}
+
+/** Reads 16, 24 or 32 bit integer and 32 bit float PCM WAV files */
+static bool ReadWAV(const char* path, AudioFile& file, WDL_String& error)
+{
+  FILE* fp = fopen(path, "rb");
+
+  if(!fp)
+  {
+    error.SetFormatted(1024, "could not open %s", path);
+    return false;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t buf[65536];
+  size_t n;
+
+  while((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    data.insert(data.end(), buf, buf + n);
+
+  fclose(fp);
+
+  if(data.size() < 12 || memcmp(data.data(), "RIFF", 4) || memcmp(data.data() + 8, "WAVE", 4))
+  {
+    error.SetFormatted(1024, "%s is not a WAV file", path);
+    return false;
+  }
+
+  int format = 0, bitsPerSample = 0;
+  size_t pos = 12;
+
+  while(pos + 8 <= data.size())
+  {
+    const uint8_t* pChunk = data.data() + pos;
+    const size_t chunkSize = ReadLE(pChunk + 4, 4);
+    const uint8_t* pBody = pChunk + 8;
+    const size_t available = std::min(chunkSize, data.size() - pos - 8);
+
+    if(!memcmp(pChunk, "fmt ", 4) && available >= 16)
+    {
+      format = (int) ReadLE(pBody, 2);
+      file.nChans = (int) ReadLE(pBody + 2, 2);
+      file.sampleRate = (double) ReadLE(pBody + 4, 4);
+      bitsPerSample = (int) ReadLE(pBody + 14, 2);
+
+      if(format == 0xFFFE && available >= 26) // WAVE_FORMAT_EXTENSIBLE, the format is in the sub format GUID
+        format = (int) ReadLE(pBody + 24, 2);
+    }
+    else if(!memcmp(pChunk, "data", 4) && file.nChans > 0)
+    {
+      const int bytesPerSample = bitsPerSample / 8;
+      const bool isFloat = format == 3 && bitsPerSample == 32;
+
+      if((format != 1 && !isFloat) || (bytesPerSample < 2 || bytesPerSample > 4))
+      {
+        error.SetFormatted(1024, "%s: unsupported sample format %i, %i bits", path, format, bitsPerSample);
+        return false;
+      }
+
+      const size_t nSamples = available / bytesPerSample;
+      file.samples.resize(nSamples);
+
+      for (size_t s = 0; s < nSamples; s++)
+      {
+        const uint8_t* p = pBody + s * bytesPerSample;
+
+        if(isFloat)
+        {
+          uint32_t bits = ReadLE(p, 4);
+          memcpy(&file.samples[s], &bits, 4);
+        }
+        else
+        {
+          // shift into the top of an int32 to sign extend
+          const int32_t v = (int32_t) (ReadLE(p, bytesPerSample) << (32 - bitsPerSample));
+          file.samples[s] = (float) (v / 2147483648.);
+        }
+      }
+
+      return true;
+    }
+
+    pos += 8 + chunkSize + (chunkSize & 1);
+  }
+
+  error.SetFormatted(1024, "%s has no audio data", path);
+  return false;
+}
+
+struct TimedMidiMsg
+{
+  double time; // seconds
+  IMidiMsg msg;
+};
+
+static uint32_t ReadVarLen(const std::vector<uint8_t>& data, size_t& pos, size_t end)
+{
+  uint32_t v = 0;
+
+  while(pos < end)
+  {
+    const uint8_t b = data[pos++];
+    v = (v << 7) | (b & 0x7F);
+
+    if(!(b & 0x80))
+      break;
+  }
+
+  return v;
+}
+
+/** Reads the channel messages from a format 0 or 1 standard MIDI file, with their times in seconds. SysEx messages are skipped */
+static bool ReadMIDIFile(const char* path, std::vector<TimedMidiMsg>& msgs, WDL_String& error)
+{
+  FILE* fp = fopen(path, "rb");
+
+  if(!fp)
+  {
+    error.SetFormatted(1024, "could not open %s", path);
+    return false;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t buf[65536];
+  size_t n;
+
+  while((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    data.insert(data.end(), buf, buf + n);
+
+  fclose(fp);
+
+  auto ReadBE = [&](size_t pos, int nBytes) {
+    uint32_t v = 0;
+    for (auto i = 0; i < nBytes; i++) v = (v << 8) | data[pos + i];
+    return v;
+  };
+
+  if(data.size() < 14 || memcmp(data.data(), "MThd", 4))
+  {
+    error.SetFormatted(1024, "%s is not a MIDI file", path);
+    return false;
+  }
+
+  const int nTracks = (int) ReadBE(10, 2);
+  const uint16_t division = (uint16_t) ReadBE(12, 2);
+
+  struct Event { uint64_t tick; int order; bool isTempo; uint32_t tempo; IMidiMsg msg; };
+  std::vector<Event> events;
+
+  size_t pos = 8 + ReadBE(4, 4);
+
+  for (auto t = 0; t < nTracks && pos + 8 <= data.size(); t++)
+  {
+    const size_t trackLen = ReadBE(pos + 4, 4);
+    const size_t end = std::min(pos + 8 + trackLen, data.size());
+    const bool isTrack = !memcmp(data.data() + pos, "MTrk", 4);
+    size_t p = pos + 8;
+    pos = end;
+
+    if(!isTrack)
+      continue;
+
+    uint64_t tick = 0;
+    uint8_t runningStatus = 0;
+
+    while(p < end)
+    {
+      tick += ReadVarLen(data, p, end);
+
+      if(p >= end)
+        break;
+
+      uint8_t status = data[p];
+
+      if(status == 0xFF) // meta event
+      {
+        const uint8_t type = data[p + 1];
+        p += 2;
+        const uint32_t len = ReadVarLen(data, p, end);
+
+        if(type == 0x51 && len == 3 && p + 3 <= end)
+          events.push_back({ tick, (int) events.size(), true, ReadBE(p, 3), IMidiMsg() });
+
+        p += len;
+        continue;
+      }
+      else if(status == 0xF0 || status == 0xF7) // sysex
+      {
+        p++;
+        p += ReadVarLen(data, p, end);
+        continue;
+      }
+
+      if(status & 0x80)
+      {
+        runningStatus = status;
+        p++;
+      }
+      else
+        status = runningStatus;
+
+      const int nDataBytes = ((status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0) ? 1 : 2;
+
+      if(p + nDataBytes > end)
+        break;
+
+      IMidiMsg msg(0, status, data[p], nDataBytes == 2 ? data[p + 1] : 0);
+      events.push_back({ tick, (int) events.size(), false, 0, msg });
+      p += nDataBytes;
+    }
+  }
+
+  std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.tick != b.tick ? a.tick < b.tick : a.order < b.order; });
+
+  double secondsPerTick;
+  const bool smpte = division & 0x8000;
+
+  if(smpte)
+    secondsPerTick = 1. / ((double) (256 - (division >> 8)) * (double) (division & 0xFF));
+  else
+    secondsPerTick = 0.5 / (double) division; // 120 bpm until the first tempo event
+
+  double time = 0.;
+  uint64_t lastTick = 0;
+
+  for (auto& e : events)
+  {
+    time += (double) (e.tick - lastTick) * secondsPerTick;
+    lastTick = e.tick;
+
+    if(e.isTempo)
+    {
+      if(!smpte)
+        secondsPerTick = (double) e.tempo / 1000000. / (double) division;
+    }
+    else
+      msgs.push_back({ time, e.msg });
+  }
+
+  return true;
+}
+
+struct AutomationPoint
+{
+  double time; // seconds
+  int paramIdx;
+  double value; // normalized
+};
+
+/** Reads an automation script: one point per line, "seconds paramIdx normalizedValue". Lines starting with # are ignored */
+static bool ReadAutomation(const char* path, std::vector<AutomationPoint>& points, WDL_String& error)
+{
+  FILE* fp = fopen(path, "r");
+
+  if(!fp)
+  {
+    error.SetFormatted(1024, "could not open %s", path);
+    return false;
+  }
+
+  char line[1024];
+  int lineNumber = 0;
+
+  while(fgets(line, sizeof(line), fp))
+  {
+    lineNumber++;
+    AutomationPoint point;
+
+    const char* p = line;
+    while(*p == ' ' || *p == '\t') p++;
+
+    if(*p == '#' || *p == '\n' || *p == '\r' || !*p)
+      continue;
+
+    if(sscanf(p, "%lf %d %lf", &point.time, &point.paramIdx, &point.value) != 3)
+    {
+      error.SetFormatted(1024, "%s:%i: expected \"seconds paramIdx normalizedValue\"", path, lineNumber);
+      fclose(fp);
+      return false;
+    }
+
+    points.push_back(point);
+  }
+
+  fclose(fp);
+
+  std::stable_sort(points.begin(), points.end(), [](const AutomationPoint& a, const AutomationPoint& b) { return a.time < b.time; });
+  return true;
+}
+
+#pragma mark - Options
+
+struct LFO
+{
+  int paramIdx;
+  double freq;
+};
+
+struct Options
+{
+  std::vector<double> sampleRates { 48000. };
+  std::vector<int> blockSizes { 512 };
+  double duration = 10.;
+  int repeats = 1;
+  const char* inputPath = nullptr;
+  const char* signal = "noise";
+  const char* midiPath = nullptr;
+  const char* automationPath = nullptr;
+  const char* outputPath = nullptr;
+  std::vector<LFO> lfos;
+  bool json = false;
+  bool failOnViolation = false;
+  bool rtGuardSelfTest = false;
+};
+
+static void PrintUsage(const char* name)
+{
+  printf("Usage: %s [options]\n\n", name);
+  printf("  -r, --sample-rates LIST   comma separated sample rates to test (default 48000)\n");
+  printf("  -b, --block-sizes LIST    comma separated block sizes to test (default 512)\n");
+  printf("  -d, --duration SECONDS    length of the synthetic input (default 10)\n");
+  printf("  -n, --repeats N           render each configuration N times, the results are combined (default 1)\n");
+  printf("  -i, --input FILE          WAV file to use as input, at its own length, without resampling\n");
+  printf("  -s, --signal TYPE         synthetic input: noise, sine or silence (default noise)\n");
+  printf("  -m, --midi FILE           standard MIDI file to play\n");
+  printf("  -a, --automation FILE     automation script, one \"seconds paramIdx normalizedValue\" per line\n");
+  printf("  -l, --lfo IDX:HZ          sweep a parameter with a sine LFO, once per block, can be repeated\n");
+  printf("  -o, --output FILE         write the output of the last run to a 24 bit WAV file\n");
+  printf("      --json                print the results as JSON\n");
+  printf("      --fail-on-violation   exit with an error if the plug-in allocates memory, takes a lock or calls code flagged with\n");
+  printf("                            RT_GUARD_FLAG while processing, for CI. The violations are listed on stderr. Needs RT_GUARD=1\n");
+  printf("      --rt-guard-self-test  only check that RT_GUARD detects an allocation on the audio thread, then exit\n");
+}
+
+template <class T, class F>
+static bool ParseList(const char* str, std::vector<T>& list, F convert)
+{
+  list.clear();
+  WDL_String copy(str);
+
+  for (char* tok = strtok(copy.Get(), ","); tok; tok = strtok(nullptr, ","))
+  {
+    const T v = convert(tok);
+
+    if(v <= 0)
+      return false;
+
+    list.push_back(v);
+  }
+
+  return !list.empty();
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options)
+{
+  for (auto i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    auto Is = [arg](const char* shortName, const char* longName) { return !strcmp(arg, shortName) || !strcmp(arg, longName); };
+    bool ok = true;
+
+    if(Is("-h", "--help"))
+      return false;
+    else if(Is("--json", "--json"))
+    {
+      options.json = true;
+      continue;
+    }
+    else if(Is("--fail-on-violation", "--fail-on-violation"))
+    {
+      options.failOnViolation = true;
+      continue;
+    }
+    else if(Is("--rt-guard-self-test", "--rt-guard-self-test"))
+    {
+      options.rtGuardSelfTest = true;
+      continue;
+    }
+    else if(!value)
+      ok = false;
+    else if(Is("-r", "--sample-rates"))
+      ok = ParseList(value, options.sampleRates, [](const char* s) { return atof(s); });
+    else if(Is("-b", "--block-sizes"))
+      ok = ParseList(value, options.blockSizes, [](const char* s) { return atoi(s); });
+    else if(Is("-d", "--duration"))
+      ok = (options.duration = atof(value)) > 0.;
+    else if(Is("-n", "--repeats"))
+      ok = (options.repeats = atoi(value)) > 0;
+    else if(Is("-i", "--input"))
+      options.inputPath = value;
+    else if(Is("-s", "--signal"))
+    {
+      options.signal = value;
+      ok = !strcmp(value, "noise") || !strcmp(value, "sine") || !strcmp(value, "silence");
+    }
+    else if(Is("-m", "--midi"))
+      options.midiPath = value;
+    else if(Is("-a", "--automation"))
+      options.automationPath = value;
+    else if(Is("-o", "--output"))
+      options.outputPath = value;
+    else if(Is("-l", "--lfo"))
+    {
+      LFO lfo;
+      ok = sscanf(value, "%d:%lf", &lfo.paramIdx, &lfo.freq) == 2;
+      options.lfos.push_back(lfo);
+    }
+    else
+      ok = false;
+
+    if(!ok)
+    {
+      fprintf(stderr, "invalid argument: %s %s\n", arg, value ? value : "");
+      return false;
+    }
+
+    i++;
+  }
+
+  return true;
+}
+
+#pragma mark - Benchmark
+
+struct Result
+{
+  double sampleRate;
+  int blockSize;
+  int nBlocks;
+  double audioSeconds;
+  double processSeconds;
+  double p50, p90, p99, p999, max; // per block processing time, in microseconds
+  double maxLoad; // worst block time relative to its duration
+  uint64_t nAllocations;
+};
+
+static Result Run(IPlugBench& plug, const Options& options, double sampleRate, int blockSize, const AudioFile& input,
+                  const std::vector<TimedMidiMsg>& midi, const std::vector<AutomationPoint>& automation, WaveWriter* pWriter)
+{
+  const int nIns = plug.MaxNChannels(ERoute::kInput);
+  const int nOuts = plug.MaxNChannels(ERoute::kOutput);
+  const int64_t nFramesTotal = input.nChans ? input.NFrames() : (int64_t) (options.duration * sampleRate);
+
+  std::vector<std::vector<PLUG_SAMPLE_DST>> inBufs(nIns, std::vector<PLUG_SAMPLE_DST>(blockSize));
+  std::vector<std::vector<PLUG_SAMPLE_DST>> outBufs(nOuts, std::vector<PLUG_SAMPLE_DST>(blockSize));
+  std::vector<PLUG_SAMPLE_DST*> inPtrs(nIns), outPtrs(nOuts);
+  std::vector<float> interleaved(nOuts * blockSize);
+
+  for (auto c = 0; c < nIns; c++) inPtrs[c] = inBufs[c].data();
+  for (auto c = 0; c < nOuts; c++) outPtrs[c] = outBufs[c].data();
+
+  std::vector<double> blockTimes;
+  blockTimes.reserve(options.repeats * (size_t) (nFramesTotal / blockSize + 1));
+
+  Result result {};
+  result.sampleRate = sampleRate;
+  result.blockSize = blockSize;
+#ifdef RT_GUARD
+  const uint64_t nAllocationsBefore = IRTGuard::Get().GetCount(IRTGuard::kAllocation);
+#endif
+
+  for (auto r = 0; r < options.repeats; r++)
+  {
+    plug.BenchReset(sampleRate, blockSize);
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    size_t midiIdx = 0, automationIdx = 0;
+    const bool writeOutput = pWriter && r == options.repeats - 1;
+
+    for (int64_t pos = 0; pos < nFramesTotal; pos += blockSize)
+    {
+      const int nFrames = (int) std::min<int64_t>(blockSize, nFramesTotal - pos);
+      const double blockEndTime = (double) (pos + nFrames) / sampleRate;
+
+      // prepare the input outside of the timed section
+      for (auto c = 0; c < nIns; c++)
+      {
+        for (auto s = 0; s < nFrames; s++)
+        {
+          if(input.nChans)
+            inBufs[c][s] = input.samples[(size_t) (pos + s) * input.nChans + (c % input.nChans)];
+          else if(!strcmp(options.signal, "noise"))
+            inBufs[c][s] = noise(rng);
+          else if(!strcmp(options.signal, "sine"))
+            inBufs[c][s] = (PLUG_SAMPLE_DST) (0.5 * std::sin(2. * PI * 440. * (double) (pos + s) / sampleRate));
+          else
+            inBufs[c][s] = 0.;
+        }
+      }
+
+      const auto start = std::chrono::steady_clock::now();
+      {
+        IRTGuardScope rtGuard; // parameter changes and MIDI are checked as well as processing
+
+        for (auto& lfo : options.lfos)
+          plug.BenchSetParameterValue(lfo.paramIdx, 0.5 + 0.5 * std::sin(2. * PI * lfo.freq * (double) pos / sampleRate), 0);
+
+        for (; automationIdx < automation.size() && automation[automationIdx].time < blockEndTime; automationIdx++)
+        {
+          const AutomationPoint& point = automation[automationIdx];
+          const int offset = Clip((int) (point.time * sampleRate - (double) pos), 0, nFrames - 1);
+          plug.BenchSetParameterValue(point.paramIdx, point.value, offset);
+        }
+
+        for (; midiIdx < midi.size() && midi[midiIdx].time < blockEndTime; midiIdx++)
+        {
+          IMidiMsg msg = midi[midiIdx].msg;
+          msg.mOffset = Clip((int) (midi[midiIdx].time * sampleRate - (double) pos), 0, nFrames - 1);
+          plug.BenchProcessMidiMsg(msg);
+        }
+
+        plug.BenchProcess(inPtrs.data(), outPtrs.data(), nFrames);
+      }
+
+      const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      blockTimes.push_back(elapsed);
+      result.processSeconds += elapsed;
+      result.maxLoad = std::max(result.maxLoad, elapsed / ((double) nFrames / sampleRate));
+
+      if(writeOutput)
+      {
+        for (auto s = 0; s < nFrames; s++)
+          for (auto c = 0; c < nOuts; c++)
+            interleaved[s * nOuts + c] = (float) outBufs[c][s];
+
+        pWriter->WriteFloats(interleaved.data(), nFrames * nOuts);
+      }
+    }
+
+    result.audioSeconds += (double) nFramesTotal / sampleRate;
+  }
+
+  std::sort(blockTimes.begin(), blockTimes.end());
+
+  auto Percentile = [&](double p) {
+    if(blockTimes.empty())
+      return 0.;
+    const size_t idx = std::min(blockTimes.size() - 1, (size_t) (p * (double) blockTimes.size()));
+    return blockTimes[idx] * 1e6;
+  };
+
+  result.nBlocks = (int) blockTimes.size();
+  result.p50 = Percentile(0.5);
+  result.p90 = Percentile(0.9);
+  result.p99 = Percentile(0.99);
+  result.p999 = Percentile(0.999);
+  result.max = blockTimes.empty() ? 0. : blockTimes.back() * 1e6;
+#ifdef RT_GUARD
+  result.nAllocations = IRTGuard::Get().GetCount(IRTGuard::kAllocation) - nAllocationsBefore;
+#endif
+
+  return result;
+}
+
+#ifdef RT_GUARD
+/** Allocates inside an IRTGuardScope before anything else has used the guard, as a host's audio thread might before a plug-in is
+ * constructed, and checks that the allocation was recorded rather than crashing while the guard is constructed from inside its hook.
+ * Where the C allocator is hooked, aligned allocations must be recorded too */
+static bool CheckRTGuard()
+{
+  {
+    IRTGuardScope rtGuard;
+    std::vector<int>* volatile pVector = new std::vector<int>(100);
+    delete pVector;
+  }
+
+  const uint64_t nAllocations = IRTGuard::Get().GetCount(IRTGuard::kAllocation);
+  bool detected = nAllocations > 0;
+
+  if(!detected)
+    fprintf(stderr, "RT_GUARD: an allocation on the audio thread was not detected\n");
+
+#if defined OS_LINUX && defined __GLIBC__ // see RT_GUARD_HOOKS_MALLOC
+  {
+    IRTGuardScope rtGuard;
+    void* pMemaligned = nullptr;
+
+    if(!posix_memalign(&pMemaligned, 64, 256))
+    {
+      void* volatile pEscaped = pMemaligned;
+      free(pEscaped);
+    }
+
+    void* volatile pAligned = aligned_alloc(64, 256);
+    free(pAligned);
+  }
+
+  if(IRTGuard::Get().GetCount(IRTGuard::kAllocation) != nAllocations + 2)
+  {
+    fprintf(stderr, "RT_GUARD: posix_memalign() or aligned_alloc() on the audio thread was not detected\n");
+    detected = false;
+  }
+#endif
+
+  IRTGuard::Get().Clear();
+
+  if(detected)
+    printf("RT_GUARD: allocations on the audio thread are detected\n");
+
+  return detected;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+  Options options;
+
+  if(!ParseOptions(argc, argv, options))
+  {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+#ifdef RT_GUARD
+  if(options.rtGuardSelfTest)
+    return CheckRTGuard() ? 0 : 1;
+#else
+  if(options.rtGuardSelfTest || options.failOnViolation)
+  {
+    fprintf(stderr, "--rt-guard-self-test and --fail-on-violation need a bench built with RT_GUARD=1\n");
+    return 1;
+  }
+#endif
+
+  WDL_String error;
+  AudioFile input;
+  std::vector<TimedMidiMsg> midi;
+  std::vector<AutomationPoint> automation;
+
+  if((options.inputPath && !ReadWAV(options.inputPath, input, error))
+     || (options.midiPath && !ReadMIDIFile(options.midiPath, midi, error))
+     || (options.automationPath && !ReadAutomation(options.automationPath, automation, error)))
+  {
+    fprintf(stderr, "%s\n", error.Get());
+    return 1;
+  }
+
+  IPlugBench* pPlug = MakePlug();
+
+  for (auto& point : automation)
+  {
+    if(point.paramIdx < 0 || point.paramIdx >= pPlug->NParams())
+    {
+      fprintf(stderr, "automation: no parameter %i\n", point.paramIdx);
+      return 1;
+    }
+  }
+
+  for (auto& lfo : options.lfos)
+  {
+    if(lfo.paramIdx < 0 || lfo.paramIdx >= pPlug->NParams())
+    {
+      fprintf(stderr, "lfo: no parameter %i\n", lfo.paramIdx);
+      return 1;
+    }
+  }
+
+  WaveWriter* pWriter = nullptr;
+
+  if(options.outputPath)
+  {
+    pWriter = new WaveWriter(options.outputPath, 24, pPlug->MaxNChannels(ERoute::kOutput), (int) options.sampleRates.back(), 0);
+
+    if(!pWriter->Status())
+    {
+      fprintf(stderr, "could not open %s for writing\n", options.outputPath);
+      return 1;
+    }
+  }
+
+  const char* precision = sizeof(PLUG_SAMPLE_DST) == sizeof(double) ? "double" : "float";
+#ifdef RT_GUARD
+  const bool rtGuard = true;
+#else
+  const bool rtGuard = false;
+#endif
+
+  if(options.json)
+    printf("{\n  \"plugin\": \"%s\",\n  \"precision\": \"%s\",\n  \"rtGuard\": %s,\n  \"results\": [\n", PLUG_NAME, precision, rtGuard ? "true" : "false");
+  else
+  {
+    printf("%s, %s precision, %i in, %i out%s\n", PLUG_NAME, precision, pPlug->MaxNChannels(ERoute::kInput), pPlug->MaxNChannels(ERoute::kOutput),
+           rtGuard ? "" : ", allocations are only counted with RT_GUARD=1");
+    printf("%8s %6s %8s %10s %9s %9s %9s %9s %9s %9s %8s\n", "rate", "block", "blocks", "x realtime", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us", "max load", "allocs");
+  }
+
+  bool first = true;
+
+  for (auto sampleRate : options.sampleRates)
+  {
+    for (auto blockSize : options.blockSizes)
+    {
+      const bool isLast = sampleRate == options.sampleRates.back() && blockSize == options.blockSizes.back();
+      const Result r = Run(*pPlug, options, sampleRate, blockSize, input, midi, automation, isLast ? pWriter : nullptr);
+      const double realtime = r.processSeconds > 0. ? r.audioSeconds / r.processSeconds : 0.;
+
+      if(options.json)
+      {
+        printf("%s    { \"sampleRate\": %g, \"blockSize\": %i, \"blocks\": %i, \"xRealtime\": %.2f, \"p50us\": %.2f, \"p90us\": %.2f, \"p99us\": %.2f, \"p999us\": %.2f, \"maxus\": %.2f, \"maxLoad\": %.4f, \"allocations\": %llu }",
+               first ? "" : ",\n", r.sampleRate, r.blockSize, r.nBlocks, realtime, r.p50, r.p90, r.p99, r.p999, r.max, r.maxLoad, (unsigned long long) r.nAllocations);
+      }
+      else
+      {
+        printf("%8g %6i %8i %10.1f %9.2f %9.2f %9.2f %9.2f %9.2f %9.4f %8llu\n",
+               r.sampleRate, r.blockSize, r.nBlocks, realtime, r.p50, r.p90, r.p99, r.p999, r.max, r.maxLoad, (unsigned long long) r.nAllocations);
+      }
+
+      first = false;
+    }
+  }
+
+  if(options.json)
+    printf("\n  ]\n}\n");
+
+  delete pWriter;
+  delete pPlug; // prints the RT_GUARD report, if there were any violations
+
+#ifdef RT_GUARD
+  if(options.failOnViolation && IRTGuard::Get().GetTotalCount())
+    return 1;
+#endif
+
+  return 0;
+}
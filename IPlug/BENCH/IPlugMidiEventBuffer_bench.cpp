@@ -0,0 +1,163 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of IMidiEventBuffer against IMidiQueue with dense, out of order MIDI
+ *
+ * Each of -n blocks (200 by default) of -b samples (512 by default) gets -e messages (10000 by default), which are added to both
+ * containers and read back in sub-blocks of -s samples (64 by default), as a synth that renders in sub-blocks would. The messages arrive
+ * in order, as 16 interleaved streams that are each in order (e.g. the channels of an MPE controller), or in random order.
+ * The mean time per block of each container is printed.
+ *
+ * Both containers must return every message in the same order, stable by offset, or the benchmark fails.
+ *
+ * Build with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -DNOMINMAX -IIPlug -IWDL IPlug/BENCH/IPlugMidiEventBuffer_bench.cpp -o midibench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "IPlugPlatform.h"
+#include "IPlugMidi.h"
+
+enum EOrder
+{
+  kInOrder = 0,
+  kInterleaved,
+  kRandom,
+  kNumOrders
+};
+
+static std::vector<IMidiMsg> MakeBlock(EOrder order, int nEvents, int blockSize, std::mt19937& rng)
+{
+  std::vector<IMidiMsg> msgs(nEvents);
+
+  for (auto i = 0; i < nEvents; i++)
+  {
+    int offset;
+
+    if (order == kInOrder)
+      offset = (int) ((long long) i * blockSize / nEvents);
+    else if (order == kInterleaved) // stream i % 16 lags the others by its channel
+      offset = (int) ((long long) ((i / 16) * 16 + 15 - i % 16) * blockSize / nEvents);
+    else
+      offset = (int) (rng() % blockSize);
+
+    msgs[i] = IMidiMsg(std::min(offset, blockSize - 1), 0xB0 | (i & 15), i & 127, (i >> 7) & 127);
+  }
+
+  return msgs;
+}
+
+/** Folds a message into a checksum of the order the messages were read in */
+static unsigned long long Hash(unsigned long long hash, const IMidiMsg& msg)
+{
+  return hash * 1099511628211ull + ((unsigned long long) msg.mOffset << 24 | msg.mStatus << 16 | msg.mData1 << 8 | msg.mData2);
+}
+
+int main(int argc, char* argv[])
+{
+  int nBlocks = 200;
+  int blockSize = 512;
+  int subBlockSize = 64;
+  int nEvents = 10000;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nBlocks = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      blockSize = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      subBlockSize = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-e") && i + 1 < argc)
+      nEvents = std::max(1, atoi(argv[++i]));
+    else
+    {
+      printf("usage: %s [-n blocks] [-b block size] [-s sub-block size] [-e messages per block]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%d blocks of %d samples, %d messages per block, read in sub-blocks of %d samples\n\n", nBlocks, blockSize, nEvents, subBlockSize);
+
+  const char* orderNames[kNumOrders] = { "in order", "16 interleaved streams", "random" };
+  int failed = 0;
+
+  for (auto o = 0; o < kNumOrders; o++)
+  {
+    std::mt19937 rng(1);
+    std::vector<std::vector<IMidiMsg>> blocks;
+
+    for (auto b = 0; b < nBlocks; b++)
+      blocks.push_back(MakeBlock((EOrder) o, nEvents, blockSize, rng));
+
+    IMidiQueue queue(nEvents);
+    IMidiEventBuffer buffer(nEvents);
+    unsigned long long queueHash = 0, bufferHash = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& block : blocks)
+    {
+      for (auto& msg : block)
+        queue.Add(msg);
+
+      for (auto s = 0; s < blockSize; s += subBlockSize)
+      {
+        while (!queue.Empty() && queue.Peek().mOffset < s + subBlockSize)
+        {
+          queueHash = Hash(queueHash, queue.Peek());
+          queue.Remove();
+        }
+      }
+
+      queue.Flush(blockSize);
+    }
+
+    const double queueTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / nBlocks;
+    start = std::chrono::steady_clock::now();
+
+    for (auto& block : blocks)
+    {
+      buffer.Add(block.data(), (int) block.size());
+
+      for (auto s = 0; s < blockSize; s += subBlockSize)
+      {
+        const IMidiEventBuffer::Span events = buffer.PopUntil(s + subBlockSize);
+
+        for (auto i = 0; i < events.GetSize(); i++)
+          bufferHash = Hash(bufferHash, events.Get(i));
+      }
+
+      buffer.Flush(blockSize);
+    }
+
+    const double bufferTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / nBlocks;
+
+    printf("%-24s IMidiQueue %9.1f us/block  IMidiEventBuffer %8.1f us/block  %6.1fx\n", orderNames[o], queueTime, bufferTime, queueTime / bufferTime);
+
+    if (queueHash != bufferHash || buffer.GetNDropped())
+    {
+      printf("FAILED: IMidiEventBuffer didn't return the messages in the order IMidiQueue did (%d dropped)\n", buffer.GetNDropped());
+      failed++;
+    }
+  }
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,284 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of IMsgRing between a processor process and a UI process over POSIX shared memory
+ *
+ * The tool forks. The child plays the processor: every block it writes -b parameter and control values into an IMsgRing in shared memory
+ * and flushes once, with -d bytes of control message data every 8th record. The parent plays the UI, reading the ring every -p
+ * microseconds, the way a controller's timer would. Records per second, bytes per second and the latency from being written to being
+ * read are printed. With -l the child instead formats each value with "%f" and writes it to a pipe as its own message, which is how
+ * IPlugWAM and the distributed VST3 processor used to send values.
+ *
+ * Build on Linux or macOS with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -DNOMINMAX -IIPlug -IWDL IPlug/BENCH/IPlugMsgRing_bench.cpp -lpthread -lrt -o msgringbench
+ *
+ * (without -lrt on macOS)
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <sys/wait.h>
+
+#include "IPlugPlatform.h"
+#include "IPlugMsgRing.h"
+#include "IPlugSharedMemory.h"
+
+#define BENCH_SHM_NAME "/iplug-msgring-bench"
+
+static int64_t NowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Options
+{
+  int nBlocks = 20000;
+  int perBlock = 64;
+  int dataSize = 64;
+  uint32_t capacity = 1 << 20;
+  double pollUs = 1000.;
+  double blockUs = 0.; // 0: as fast as possible
+  bool legacy = false;
+};
+
+static void WaitForBlock(const Options& o, int64_t start, int block)
+{
+  if (o.blockUs > 0.)
+  {
+    const int64_t deadline = start + (int64_t) (1e3 * o.blockUs * block);
+    std::this_thread::sleep_for(std::chrono::nanoseconds(std::max<int64_t>(0, deadline - NowNs())));
+  }
+}
+
+/** The processor: writes the records of each block, then flushes. Waits for space if the ring is full, so that nothing is lost */
+static int RunRingProducer(const Options& o)
+{
+  ISharedMemory shm;
+  IMsgRing ring;
+
+  if (!shm.Open(BENCH_SHM_NAME, IMsgRing::GetMemorySize(o.capacity)) || !ring.Attach(shm.Get(), shm.GetSize()))
+    return 1;
+
+  std::vector<uint8_t> data(o.dataSize, 0x55);
+  const int64_t start = NowNs();
+
+  for (int block = 0; block < o.nBlocks; block++)
+  {
+    WaitForBlock(o, start, block);
+
+    for (int i = 0; i < o.perBlock; i++)
+    {
+      // the value of each record is the time it was written
+      while (true)
+      {
+        const double now = (double) NowNs();
+        bool added;
+
+        if (o.dataSize && i % 8 == 7)
+          added = ring.Add(kMsgControlMsg, 0, i, 0, now, o.dataSize, data.data());
+        else if (i & 1)
+          added = ring.AddControlValue(i, now);
+        else
+          added = ring.AddParamValue(i, now, true);
+
+        if (added)
+          break;
+
+        ring.Flush();
+        std::this_thread::yield();
+      }
+    }
+
+    ring.Flush();
+  }
+
+  while (!ring.AddArbitraryMsg(-1, kNoTag, 0, nullptr)) // the end
+    std::this_thread::yield();
+
+  ring.Flush();
+  return 0;
+}
+
+static int RunPipeProducer(const Options& o, int fd)
+{
+  const int64_t start = NowNs();
+  char buf[256];
+
+  for (int block = 0; block < o.nBlocks; block++)
+  {
+    WaitForBlock(o, start, block);
+
+    for (int i = 0; i < o.perBlock; i++)
+    {
+      // a verb, the index and the value as text, plus the time it was written
+      const int len = snprintf(buf, sizeof(buf), "%s %i %f %lld\n", (i & 1) ? "SCVFD" : "SPVFD", i, 0.5, (long long) NowNs());
+
+      if (write(fd, buf, len) != len)
+        return 1;
+    }
+  }
+
+  close(fd);
+  return 0;
+}
+
+static void PrintResults(const char* name, std::vector<double>& latencies, int64_t nBytes, double seconds)
+{
+  std::sort(latencies.begin(), latencies.end());
+  const size_t n = latencies.size();
+  auto percentile = [&](double p) { return n ? latencies[std::min(n - 1, (size_t) (p * n))] : 0.; };
+
+  printf("%s: %d messages in %.2f s, %.0f messages/s, %.1f MB/s\n", name, (int) n, seconds, n / seconds, 1e-6 * nBytes / seconds);
+  printf("  latency us: p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n", percentile(0.5), percentile(0.9), percentile(0.99), n ? latencies.back() : 0.);
+}
+
+int main(int argc, char* argv[])
+{
+  Options o;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-l"))
+      o.legacy = true;
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      o.nBlocks = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      o.perBlock = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+      o.dataSize = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      o.capacity = (uint32_t) atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      o.pollUs = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      o.blockUs = atof(argv[++i]);
+    else
+    {
+      printf("usage: %s [-l] [-n blocks] [-b messages per block] [-d control message bytes] [-c ring bytes] [-p UI poll us] [-t block us]\n", argv[0]);
+      printf("  -l  send each value as text through a pipe, one write per message\n");
+      return 1;
+    }
+  }
+
+  std::vector<double> latencies;
+  latencies.reserve((size_t) o.nBlocks * o.perBlock);
+  int64_t nBytes = 0;
+  int64_t start, end;
+
+  if (o.legacy)
+  {
+    int fds[2];
+
+    if (pipe(fds))
+      return 1;
+
+    const pid_t pid = fork();
+
+    if (pid == 0)
+    {
+      close(fds[0]);
+      _exit(RunPipeProducer(o, fds[1]));
+    }
+
+    close(fds[1]);
+    start = NowNs();
+    std::vector<char> buf(65536);
+    std::string line;
+    ssize_t len;
+
+    while (true)
+    {
+      std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(o.pollUs));
+
+      if ((len = read(fds[0], buf.data(), buf.size())) <= 0)
+        break;
+
+      nBytes += len;
+
+      for (ssize_t i = 0; i < len; i++)
+      {
+        if (buf[i] != '\n')
+        {
+          line += buf[i];
+          continue;
+        }
+
+        char verb[16];
+        int idx;
+        double value;
+        long long sent;
+
+        if (sscanf(line.c_str(), "%15s %i %lf %lld", verb, &idx, &value, &sent) == 4)
+          latencies.push_back(1e-3 * (NowNs() - sent));
+
+        line.clear();
+      }
+    }
+
+    end = NowNs();
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+  }
+  else
+  {
+    ISharedMemory shm;
+    IMsgRing ring;
+
+    if (!shm.Create(BENCH_SHM_NAME, IMsgRing::GetMemorySize(o.capacity)) || !ring.Init(shm.Get(), shm.GetSize()))
+    {
+      printf("could not create the shared memory\n");
+      return 1;
+    }
+
+    const pid_t pid = fork();
+
+    if (pid == 0)
+      _exit(RunRingProducer(o));
+
+    start = NowNs();
+    bool done = false;
+
+    while (!done)
+    {
+      std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(o.pollUs));
+
+      ring.Read([&](const IMsgRecord& record) {
+        nBytes += record.mSize;
+
+        if (record.mType == kMsgArbitraryMsg && record.mTag == -1)
+          done = true;
+        else
+          latencies.push_back(1e-3 * (NowNs() - (int64_t) record.mValue));
+      });
+
+      if (!done && waitpid(pid, nullptr, WNOHANG) == pid && !ring.ElementsAvailable())
+      {
+        printf("the processor process failed\n");
+        return 1;
+      }
+    }
+
+    end = NowNs();
+    waitpid(pid, nullptr, 0);
+  }
+
+  PrintResults(o.legacy ? "one text message per value, pipe" : "IMsgRing, shared memory", latencies, nBytes, 1e-9 * (end - start));
+  return 0;
+}
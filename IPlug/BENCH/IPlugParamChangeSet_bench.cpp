@@ -0,0 +1,190 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of IParamChangeSet against the IPlugQueue it replaced, for parameter changes sent from the audio thread to the UI
+ *
+ * A plug-in with -p parameters (2000 by default) has -k audio blocks (2 by default) per UI timer tick, for -t ticks (600 by default).
+ * In each block either 50 or all of the parameters change, as under dense automation. The changes are pushed to an IPlugQueue of
+ * PARAM_TRANSFER_SIZE, as IPlugAPIBase used to, and to an IParamChangeSet, and both are drained at each tick. The time per change pushed
+ * and per tick drained is printed, with the number of changes dropped and how often the UI was left with a stale value after a tick.
+ *
+ * Two checks make the benchmark fail:
+ * - the UI must be up to date with IParamChangeSet after every tick
+ * - changes pushed from two threads at once, while a third drains, must all end up with their final value
+ *
+ * Build with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -DNOMINMAX -IIPlug -IWDL IPlug/BENCH/IPlugParamChangeSet_bench.cpp -lpthread -o paramchangebench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugQueue.h"
+#include "IPlugParamChangeSet.h"
+
+static double Seconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Two threads push to disjoint halves of the parameters while this thread drains, then a last drain must leave every parameter at its final value */
+static bool CheckConcurrentPush(int nParams, int nRounds)
+{
+  IParamChangeSet set(nParams);
+  std::vector<double> ui(nParams, -1.);
+  std::atomic<int> nRunning {2};
+
+  auto pushHalf = [&](int first, int last) {
+    for (auto r = 1; r <= nRounds; r++)
+    {
+      for (auto p = first; p < last; p++)
+        set.Push(p, r / (double) nRounds);
+    }
+
+    nRunning--;
+  };
+
+  std::thread a(pushHalf, 0, nParams / 2);
+  std::thread b(pushHalf, nParams / 2, nParams);
+
+  auto drain = [&]() { set.Drain([&](const IParamChange& change) { ui[change.paramIdx] = change.value; }); };
+
+  while (nRunning)
+    drain();
+
+  a.join();
+  b.join();
+  drain();
+
+  for (auto p = 0; p < nParams; p++)
+  {
+    if (ui[p] != 1.)
+    {
+      printf("FAILED: after pushes from two threads parameter %d shows %g, not its final value 1\n", p, ui[p]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int nParams = 2000;
+  int nTicks = 600;
+  int blocksPerTick = 2;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      nParams = std::max(2, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      nTicks = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+      blocksPerTick = std::max(1, atoi(argv[++i]));
+    else
+    {
+      printf("usage: %s [-p parameters] [-t UI ticks] [-k audio blocks per tick]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (!CheckConcurrentPush(nParams, 1000))
+    return 1;
+
+  int failed = 0;
+
+  for (auto nChanged : { std::min(50, nParams), nParams })
+  {
+    IPlugQueue<IParamChange> queue(PARAM_TRANSFER_SIZE);
+    IParamChangeSet set(nParams);
+    std::vector<double> latest(nParams, 0.), queueUI(nParams, 0.), setUI(nParams, 0.);
+    double queuePush = 0., setPush = 0., queueDrain = 0., setDrain = 0.;
+    long long nPushed = 0, nDropped = 0, queueStale = 0, setStale = 0;
+    int next = 0;
+
+    for (auto t = 0; t < nTicks; t++)
+    {
+      for (auto b = 0; b < blocksPerTick; b++)
+      {
+        const double value = (t * blocksPerTick + b + 1) * 1e-6;
+        const double t0 = Seconds();
+
+        for (auto i = 0; i < nChanged; i++)
+        {
+          if (!queue.Push(IParamChange { (next + i) % nParams, value, true }))
+            nDropped++;
+        }
+
+        const double t1 = Seconds();
+
+        for (auto i = 0; i < nChanged; i++)
+          set.Push((next + i) % nParams, value);
+
+        const double t2 = Seconds();
+
+        for (auto i = 0; i < nChanged; i++)
+          latest[(next + i) % nParams] = value;
+
+        next = (next + nChanged) % nParams;
+        nPushed += nChanged;
+        queuePush += t1 - t0;
+        setPush += t2 - t1;
+      }
+
+      const double t0 = Seconds();
+      IParamChange change {};
+
+      while (queue.ElementsAvailable())
+      {
+        queue.Pop(change);
+        queueUI[change.paramIdx] = change.value;
+      }
+
+      const double t1 = Seconds();
+      set.Drain([&](const IParamChange& c) { setUI[c.paramIdx] = c.value; });
+      const double t2 = Seconds();
+
+      queueDrain += t1 - t0;
+      setDrain += t2 - t1;
+
+      for (auto p = 0; p < nParams; p++)
+      {
+        queueStale += queueUI[p] != latest[p];
+        setStale += setUI[p] != latest[p];
+      }
+    }
+
+    printf("%d of %d parameters change per block, %d blocks per UI tick, %d ticks\n", nChanged, nParams, blocksPerTick, nTicks);
+    printf("  IPlugQueue       push %6.1f ns/change  drain %7.1f us/tick  dropped %8lld  stale after a tick %5.1f%%\n",
+           1e9 * queuePush / nPushed, 1e6 * queueDrain / nTicks, nDropped, 100. * queueStale / ((double) nTicks * nParams));
+    printf("  IParamChangeSet  push %6.1f ns/change  drain %7.1f us/tick  dropped %8d  stale after a tick %5.1f%%\n",
+           1e9 * setPush / nPushed, 1e6 * setDrain / nTicks, 0, 100. * setStale / ((double) nTicks * nParams));
+
+    if (setStale)
+    {
+      printf("FAILED: IParamChangeSet left the UI with stale values\n");
+      failed++;
+    }
+  }
+
+  return failed ? 1 : 0;
+}
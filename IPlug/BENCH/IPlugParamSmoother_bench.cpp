@@ -0,0 +1,229 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of IParamSmoother with many parameters, only a few of them moving
+ *
+ * -p parameters (500 by default) opt into smoothing and -m of them (10 by default) get a new target every 8 blocks, as under automation.
+ * One of the moving parameters also gets a sample accurate point in every block. The time of IParamSmoother::ProcessBlock() is measured,
+ * and compared with a per-sample one-pole for every parameter, which is what a plug-in without the smoother would run.
+ *
+ * Before timing, two checks make the benchmark fail:
+ * - a SetTarget() that sets the value from before some sample accurate points must still be heard
+ * - a block longer than the maximum block size, rendered in chunks, must match the same block rendered in one go
+ *
+ * Build with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -DNOMINMAX -IIPlug -IWDL IPlug/BENCH/IPlugParamSmoother_bench.cpp -o smootherbench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "IPlugPlatform.h"
+#include "IPlugParamSmoother.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_SMOOTHING_MS 20.
+
+struct BlockStats
+{
+  double mean = 0.;
+  double p99 = 0.;
+  double max = 0.;
+};
+
+static BlockStats GetStats(std::vector<double>& times)
+{
+  std::sort(times.begin(), times.end());
+  BlockStats stats;
+
+  for (auto t : times)
+    stats.mean += t;
+
+  stats.mean /= times.size();
+  stats.p99 = times[std::min(times.size() - 1, (size_t) (0.99 * times.size()))];
+  stats.max = times.back();
+  return stats;
+}
+
+static void PrintStats(const char* name, std::vector<double>& times, int blockSize)
+{
+  const BlockStats stats = GetStats(times);
+  const double budget = 1e6 * blockSize / BENCH_SAMPLE_RATE;
+  printf("%-28s mean %8.2f us (%5.2f%% of the block)  p99 %8.2f us  max %8.2f us\n", name, stats.mean, 100. * stats.mean / budget, stats.p99, stats.max);
+}
+
+/** The UI sets a parameter back to the value it had before the host moved it with sample accurate points */
+static bool CheckTargetAfterPoints()
+{
+  IParamSmoother smoother;
+  smoother.SetSmoothing(0, 1., IParamSmoother::kCurveLinear, 0.5, 1.);
+  smoother.Reset(BENCH_SAMPLE_RATE, 64);
+
+  smoother.SetTarget(0, 0.9, 0);
+
+  for (auto i = 0; i < 100; i++)
+    smoother.ProcessBlock(64);
+
+  smoother.SetTarget(0, 0.5);
+
+  for (auto i = 0; i < 100; i++)
+    smoother.ProcessBlock(64);
+
+  if (smoother.GetValue(0) != 0.5)
+  {
+    printf("FAILED: SetTarget(0.5) after automation to 0.9 left the value at %g\n", smoother.GetValue(0));
+    return false;
+  }
+
+  return true;
+}
+
+/** Renders a block four times the maximum block size in chunks, and compares it with the same block rendered in one go */
+static bool CheckChunkedBlock()
+{
+  const int maxBlockSize = 64;
+  const int nFrames = 4 * maxBlockSize;
+  const int offsets[] = { 10, 70, 130, 200, 255 };
+  const double values[] = { 0.2, 0.8, 0.1, 0.6, 0.3 };
+
+  IParamSmoother chunked, whole;
+  std::vector<sample> chunkedOut, wholeOut;
+
+  for (auto pSmoother : { &chunked, &whole })
+  {
+    pSmoother->SetSmoothing(0, 1., IParamSmoother::kCurveExponential, 0., 1.);
+    pSmoother->Reset(BENCH_SAMPLE_RATE, pSmoother == &chunked ? maxBlockSize : nFrames);
+
+    for (auto p = 0; p < 5; p++)
+      pSmoother->SetTarget(0, values[p], offsets[p]);
+  }
+
+  for (auto offset = 0; offset < nFrames;)
+  {
+    const int n = chunked.ProcessBlock(nFrames - offset);
+    chunkedOut.insert(chunkedOut.end(), chunked.GetValues(0), chunked.GetValues(0) + n);
+    offset += n;
+  }
+
+  whole.ProcessBlock(nFrames);
+  wholeOut.assign(whole.GetValues(0), whole.GetValues(0) + nFrames);
+
+  if (chunkedOut != wholeOut)
+  {
+    printf("FAILED: a %d frame block rendered in chunks of %d doesn't match the block rendered in one go\n", nFrames, maxBlockSize);
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int nParams = 500;
+  int nMoving = 10;
+  int nBlocks = 20000;
+  int blockSize = 512;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      nParams = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+      nMoving = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nBlocks = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      blockSize = atoi(argv[++i]);
+    else
+    {
+      printf("usage: %s [-p smoothed parameters] [-m moving parameters] [-n blocks] [-b block size]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  nMoving = std::max(0, std::min(nMoving, nParams));
+
+  if (!CheckTargetAfterPoints() || !CheckChunkedBlock())
+    return 1;
+
+  printf("%d smoothed parameters, %d moving, %d blocks of %d samples at %d Hz\n", nParams, nMoving, nBlocks, blockSize, BENCH_SAMPLE_RATE);
+
+  IParamSmoother smoother;
+
+  for (auto p = 0; p < nParams; p++)
+    smoother.SetSmoothing(p, BENCH_SMOOTHING_MS, IParamSmoother::kCurveExponential, 0.5, 1.);
+
+  smoother.Reset(BENCH_SAMPLE_RATE, blockSize);
+
+  // a plug-in without the smoother: one one-pole per parameter, run for every sample
+  const double coeff = 1. - std::exp(-1. / (BENCH_SMOOTHING_MS * 0.001 * BENCH_SAMPLE_RATE));
+  std::vector<double> naiveCurrent(nParams, 0.5), naiveTarget(nParams, 0.5);
+  std::vector<sample> naiveRows(nParams * blockSize);
+
+  std::vector<double> smootherTimes(nBlocks), naiveTimes(nBlocks);
+  double checksum = 0.;
+
+  for (auto block = 0; block < nBlocks; block++)
+  {
+    if (block % 8 == 0)
+    {
+      const double value = (block / 8) % 2 ? 0.25 : 0.75;
+
+      for (auto p = 0; p < nMoving; p++)
+      {
+        smoother.SetTarget(p, value);
+        naiveTarget[p] = value;
+      }
+    }
+
+    if (nMoving)
+      smoother.SetTarget(0, (block % 2) ? 0.1 : 0.9, blockSize / 2);
+
+    auto start = std::chrono::steady_clock::now();
+    smoother.ProcessBlock(blockSize);
+    smootherTimes[block] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      sample* pRow = naiveRows.data() + p * blockSize;
+      double current = naiveCurrent[p];
+      const double target = naiveTarget[p];
+
+      for (auto s = 0; s < blockSize; s++)
+      {
+        current += coeff * (target - current);
+        pRow[s] = (sample) current;
+      }
+
+      naiveCurrent[p] = current;
+    }
+
+    naiveTimes[block] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    // read the rows, so that neither loop is optimised away
+    checksum += smoother.GetValues(nParams - 1)[blockSize - 1] + naiveRows[nParams * blockSize - 1];
+  }
+
+  PrintStats("IParamSmoother", smootherTimes, blockSize);
+  PrintStats("per-sample one-pole", naiveTimes, blockSize);
+  printf("(checksum %g)\n", checksum);
+
+  return 0;
+}
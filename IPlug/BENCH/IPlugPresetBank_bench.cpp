@@ -0,0 +1,254 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of IPresetBank with a large bank of presets
+ *
+ * A plug-in with -p parameters (500 by default) writes -n presets (10000 by default) with IPresetBankWriter, opens the bank and
+ * measures Find(), Restore() on the main thread, and recall from the "audio" thread with RequestRecall() and ProcessRecall(), both for random
+ * presets and for stepping to the next preset, which the worker has prefetched. For each recall the time from the request until ProcessRecall()
+ * finds the preset ready, and the time ProcessRecall() takes to apply it, are printed.
+ *
+ * After every recall OnIdle() must tell the UI and the host about exactly the parameters that the recall changed, or the benchmark fails.
+ *
+ * Build with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -DNDEBUG -DNOMINMAX -DNO_IGRAPHICS -IIPlug -IWDL IPlug/BENCH/IPlugPresetBank_bench.cpp \
+ *     IPlug/IPlugPluginBase.cpp IPlug/IPlugParameter.cpp -lpthread -o presetbankbench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "IPlugPresetBank.h"
+
+/** Just enough of a plug-in to recall presets into, which counts the parameter changes that reach the UI and the host */
+class BankPlug : public IPluginBase
+{
+public:
+  BankPlug(int nParams)
+  : IPluginBase(nParams, 0)
+  , mUIChanges(nParams)
+  , mHostChanges(nParams)
+  {
+    InitParamRange(0, nParams - 1, 0, "P%i", 0.5, 0., 1., 0.001);
+  }
+
+  void BeginInformHostOfParamChangeFromUI(int paramIdx) override {}
+  void EndInformHostOfParamChangeFromUI(int paramIdx) override {}
+
+  void OnParamChangeUI(int paramIdx, EParamSource source) override { mUIChanges[paramIdx]++; }
+  void InformHostOfParamChangeFromPlug(int paramIdx) override { mHostChanges[paramIdx]++; }
+
+  void ClearChanges()
+  {
+    std::fill(mUIChanges.begin(), mUIChanges.end(), 0);
+    std::fill(mHostChanges.begin(), mHostChanges.end(), 0);
+  }
+
+  std::vector<int> mUIChanges;
+  std::vector<int> mHostChanges;
+};
+
+struct RecallStats
+{
+  double mWait = 0.;
+  double mApply = 0.;
+  double mMaxApply = 0.;
+};
+
+static double Micros(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+/** Recalls a preset as the audio thread would, then updates the UI and host as the main thread would, and checks that exactly the
+ * parameters whose values changed were sent on */
+static bool Recall(IPresetBank& bank, BankPlug& plug, int idx, RecallStats& stats)
+{
+  std::vector<double> before(plug.NParams());
+
+  for (auto i = 0; i < plug.NParams(); i++)
+    before[i] = plug.GetParam(i)->Value();
+
+  plug.ClearChanges();
+
+  const auto requested = std::chrono::steady_clock::now();
+  bank.RequestRecall(idx);
+  auto ready = requested;
+
+  do
+    ready = std::chrono::steady_clock::now();
+  while (!bank.ProcessRecall());
+
+  const auto applied = std::chrono::steady_clock::now();
+  const double apply = Micros(ready, applied);
+  stats.mWait += Micros(requested, ready);
+  stats.mApply += apply;
+  stats.mMaxApply = std::max(stats.mMaxApply, apply);
+
+  if (!bank.OnIdle() || bank.GetCurrentIdx() != idx)
+  {
+    printf("FAILED: preset %d was recalled, but OnIdle() didn't make it the current preset\n", idx);
+    return false;
+  }
+
+  for (auto i = 0; i < plug.NParams(); i++)
+  {
+    const int expected = plug.GetParam(i)->Value() != before[i] ? 1 : 0;
+
+    if (plug.mUIChanges[i] != expected || plug.mHostChanges[i] != expected)
+    {
+      printf("FAILED: recalling preset %d sent parameter %d to the UI %d times and to the host %d times, expected %d\n",
+             idx, i, plug.mUIChanges[i], plug.mHostChanges[i], expected);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int nParams = 500;
+  int nPresets = 10000;
+  int nRecalls = 200;
+  const char* path = "presetbank_bench.ipbk";
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      nParams = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nPresets = std::max(2, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      nRecalls = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      path = argv[++i];
+    else
+    {
+      printf("usage: %s [-p parameters] [-n presets] [-r recalls per test] [-f bank file to write]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  BankPlug plug(nParams);
+  std::mt19937 rng(1);
+  char name[64];
+
+  IPresetBankWriter writer;
+
+  if (!writer.Open(path))
+  {
+    printf("FAILED: couldn't write %s\n", path);
+    return 1;
+  }
+
+  // most presets leave some parameters at their defaults, so that a recall doesn't change every parameter
+  for (auto p = 0; p < nPresets; p++)
+  {
+    for (auto i = 0; i < nParams; i++)
+      plug.GetParam(i)->Set(rng() % 4 ? (rng() % 1000) / 1000. : 0.5);
+
+    IByteChunk chunk;
+    plug.SerializeState(chunk);
+    snprintf(name, sizeof(name), "Preset %05d", p);
+    writer.Add(name, chunk);
+  }
+
+  if (!writer.Close())
+  {
+    printf("FAILED: couldn't write %s\n", path);
+    return 1;
+  }
+
+  plug.DefaultParamValues();
+  IPresetBank bank(plug);
+
+  auto start = std::chrono::steady_clock::now();
+  const bool opened = bank.Open(path);
+  const double openTime = Micros(start, std::chrono::steady_clock::now());
+  remove(path); // the mapping keeps the file's data until Close()
+
+  if (!opened || bank.NPresets() != nPresets)
+  {
+    printf("FAILED: couldn't open the bank\n");
+    return 1;
+  }
+
+  printf("%d presets of %d parameters, %d recalls per test\n\n", nPresets, nParams, nRecalls);
+  printf("Open()                              %8.1f us\n", openTime);
+
+  std::vector<int> indices(nRecalls);
+  std::vector<std::string> names(nRecalls);
+
+  for (auto r = 0; r < nRecalls; r++)
+  {
+    indices[r] = (int) (rng() % nPresets);
+    snprintf(name, sizeof(name), "Preset %05d", indices[r]);
+    names[r] = name;
+  }
+
+  start = std::chrono::steady_clock::now();
+
+  for (auto r = 0; r < nRecalls; r++)
+  {
+    if (bank.Find(names[r].c_str()) != indices[r])
+    {
+      printf("FAILED: Find(\"%s\") didn't find preset %d\n", names[r].c_str(), indices[r]);
+      return 1;
+    }
+  }
+
+  printf("Find()                              %8.3f us\n", Micros(start, std::chrono::steady_clock::now()) / nRecalls);
+
+  start = std::chrono::steady_clock::now();
+
+  for (auto r = 0; r < nRecalls; r++)
+    bank.Restore(indices[r]);
+
+  printf("Restore(), random presets           %8.1f us\n", Micros(start, std::chrono::steady_clock::now()) / nRecalls);
+
+  RecallStats random, next;
+
+  for (auto r = 0; r < nRecalls; r++)
+  {
+    if (!Recall(bank, plug, indices[r], random))
+      return 1;
+  }
+
+  int idx = nPresets / 2;
+
+  for (auto r = 0; r < nRecalls; r++)
+  {
+    // give the worker time to prefetch, as a host would between program changes
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    if (!Recall(bank, plug, idx, next))
+      return 1;
+
+    idx = (idx + 1) % nPresets;
+  }
+
+  printf("recall, random presets              request to ready %8.1f us  apply %8.1f us (max %8.1f us)\n",
+         random.mWait / nRecalls, random.mApply / nRecalls, random.mMaxApply);
+  printf("recall, next preset (prefetched)    request to ready %8.1f us  apply %8.1f us (max %8.1f us)\n",
+         next.mWait / nRecalls, next.mApply / nRecalls, next.mMaxApply);
+
+  return 0;
+}
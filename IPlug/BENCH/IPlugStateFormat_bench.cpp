@@ -0,0 +1,160 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of saving and loading plug-in state in the legacy and tagged state formats
+ *
+ * A plug-in with -p parameters (5000 by default) saves and loads its state -n times in each EStateFormat, first with every parameter
+ * away from its default, then with -d of them (250 by default), which is where kStateFormatDelta helps. Loading includes
+ * OnParamReset(kPresetRecall), as in a host. The chunk size and the mean time of SerializeState() and UnserializeState() are printed.
+ * Every load is checked against the saved values, and a chunk from a plug-in where two parameters share a stable ID must be rejected.
+ *
+ * Build with:
+ *
+ *   gcc -O2 -c WDL/zlib/adler32.c WDL/zlib/compress.c WDL/zlib/crc32.c WDL/zlib/deflate.c WDL/zlib/inffast.c WDL/zlib/inflate.c \
+ *     WDL/zlib/inftrees.c WDL/zlib/trees.c WDL/zlib/uncompr.c WDL/zlib/zutil.c
+ *   g++ -O2 -std=c++14 -Wno-multichar -DNDEBUG -DNOMINMAX -DNO_IGRAPHICS -DSTATE_COMPRESSION -IIPlug -IWDL IPlug/BENCH/IPlugStateFormat_bench.cpp \
+ *     IPlug/IPlugPluginBase.cpp IPlug/IPlugParameter.cpp adler32.o compress.o crc32.o deflate.o inffast.o inflate.o inftrees.o trees.o \
+ *     uncompr.o zutil.o -o statebench
+ *
+ * Without -DSTATE_COMPRESSION and the zlib sources, the compressed formats are written uncompressed.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "IPlugPluginBase.h"
+
+/** Just enough of a plug-in to save and load state, without an API class */
+class StatePlug : public IPluginBase
+{
+public:
+  StatePlug(int nParams)
+  : IPluginBase(nParams, 0)
+  {
+    InitParamRange(0, nParams - 1, 0, "P%i", 0.5, 0., 1., 0.001);
+  }
+
+  void BeginInformHostOfParamChangeFromUI(int paramIdx) override {}
+  void EndInformHostOfParamChangeFromUI(int paramIdx) override {}
+};
+
+int main(int argc, char* argv[])
+{
+  int nParams = 5000;
+  int nDelta = 250;
+  int nRepeats = 200;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      nParams = std::max(2, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+      nDelta = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nRepeats = std::max(1, atoi(argv[++i]));
+    else
+    {
+      printf("usage: %s [-p parameters] [-d parameters changed for the delta run] [-n saves and loads per format]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  nDelta = std::max(0, std::min(nDelta, nParams));
+
+  const int formats[] = {
+    kStateFormatLegacy,
+    kStateFormatTagged,
+    kStateFormatTagged | kStateFormatDelta,
+    kStateFormatTagged | kStateFormatCompressed,
+    kStateFormatTagged | kStateFormatCompressed | kStateFormatDelta
+  };
+
+  const char* formatNames[] = { "legacy", "tagged", "tagged+delta", "tagged+zlib", "tagged+zlib+delta" };
+
+  StatePlug plug(nParams);
+  std::mt19937 rng(1);
+  std::vector<double> saved(nParams);
+  int failed = 0;
+
+  printf("%d parameters, %d saves and loads per format%s\n\n", nParams, nRepeats,
+#ifdef STATE_COMPRESSION
+         "");
+#else
+         ", built without STATE_COMPRESSION");
+#endif
+
+  for (auto nChanged : { nParams, nDelta })
+  {
+    plug.DefaultParamValues();
+
+    for (auto i = 0; i < nChanged; i++)
+      plug.GetParam(i)->Set((rng() % 1000) / 1000.);
+
+    for (auto i = 0; i < nParams; i++)
+      saved[i] = plug.GetParam(i)->Value();
+
+    for (auto f = 0; f < 5; f++)
+    {
+      plug.SetStateFormat(formats[f]);
+      IByteChunk chunk;
+
+      const auto t0 = std::chrono::steady_clock::now();
+
+      for (auto r = 0; r < nRepeats; r++)
+      {
+        chunk.Clear();
+        plug.SerializeState(chunk);
+      }
+
+      const auto t1 = std::chrono::steady_clock::now();
+
+      for (auto r = 0; r < nRepeats; r++)
+        plug.UnserializeState(chunk, 0);
+
+      const auto t2 = std::chrono::steady_clock::now();
+
+      for (auto i = 0; i < nParams; i++)
+      {
+        if (plug.GetParam(i)->Value() != saved[i])
+        {
+          printf("FAILED: %s didn't restore parameter %d\n", formatNames[f], i);
+          failed++;
+          break;
+        }
+      }
+
+      printf("%5d changed  %-18s %8d bytes  save %8.1f us  load %8.1f us\n", nChanged, formatNames[f], chunk.Size(),
+             std::chrono::duration<double, std::micro>(t1 - t0).count() / nRepeats,
+             std::chrono::duration<double, std::micro>(t2 - t1).count() / nRepeats);
+    }
+  }
+
+  // two parameters that share a stable ID would load into one slot
+  plug.SetStateFormat(kStateFormatTagged);
+  plug.GetParam(0)->SetStableID(nParams + 1);
+  plug.GetParam(1)->SetStableID(nParams + 1);
+  IByteChunk chunk;
+  IParamSnapshot snapshot;
+  plug.SerializeState(chunk);
+
+  if (plug.PrepareParamSnapshot(chunk, 0, snapshot) >= 0)
+  {
+    printf("FAILED: a chunk from a plug-in with duplicate stable IDs was accepted\n");
+    failed++;
+  }
+
+  return failed ? 1 : 0;
+}
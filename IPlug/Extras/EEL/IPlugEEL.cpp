@@ -0,0 +1,457 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <cstring>
+#include <algorithm>
+
+#include "IPlugEEL.h"
+
+static_assert((NSEEL_RAM_ITEMSPERBLOCK % EEL_VECTOR_SIZE) == 0, "EEL_VECTOR_SIZE must divide a VM RAM block, so that channel buffers are contiguous");
+static_assert((EEL_AUDIO_RAM_OFFSET + (2 * EEL_MAX_CHANNELS * EEL_VECTOR_SIZE)) <= (NSEEL_RAM_BLOCKS_DEFAULTMAX * NSEEL_RAM_ITEMSPERBLOCK), "EEL audio buffers don't fit in VM RAM");
+
+// NS-EEL host stubs. Each IPlugEEL program has its own VM and GRAM, so this only serialises compilation and RAM allocation
+static WDL_Mutex sEELMutex;
+void NSEEL_HOSTSTUB_EnterMutex() { sEELMutex.Enter(); }
+void NSEEL_HOSTSTUB_LeaveMutex() { sEELMutex.Leave(); }
+
+enum EEELSection
+{
+  kEELSectionInit = 0,
+  kEELSectionSlider,
+  kEELSectionBlock,
+  kEELSectionSample,
+  kEELSectionProcess,
+  kNumEELSections
+};
+
+static const char* EELSectionStrs[kNumEELSections] = { "@init", "@slider", "@block", "@sample", "@process" };
+
+#pragma mark - Program
+
+IPlugEEL::Program::Program(int nInputs, int nOutputs)
+: mNInputs(std::min(nInputs, EEL_MAX_CHANNELS))
+, mNOutputs(std::min(nOutputs, EEL_MAX_CHANNELS))
+{
+  mVM = NSEEL_VM_alloc();
+  NSEEL_VM_SetGRAM(mVM, &mGRAM);
+}
+
+IPlugEEL::Program::~Program()
+{
+  NSEEL_CODEHANDLE handles[] = { mInitCode, mSliderCode, mBlockCode, mSampleCode, mProcessCode };
+
+  for (auto h : handles)
+  {
+    if (h)
+      NSEEL_code_free(h);
+  }
+
+  if (mVM)
+    NSEEL_VM_free(mVM);
+
+  NSEEL_VM_FreeGRAM(&mGRAM);
+}
+
+bool IPlugEEL::Program::Compile(const char* code, const WDL_PtrList<WDL_String>& paramVars, WDL_String& error)
+{
+  mSrate = NSEEL_VM_regvar(mVM, "srate");
+  mSamplesBlock = NSEEL_VM_regvar(mVM, "samplesblock");
+  mNumInputs = NSEEL_VM_regvar(mVM, "num_inputs");
+  mNumOutputs = NSEEL_VM_regvar(mVM, "num_outputs");
+  *mNumInputs = mNInputs;
+  *mNumOutputs = mNOutputs;
+
+  *NSEEL_VM_regvar(mVM, "inbuf") = EEL_AUDIO_RAM_OFFSET;
+  *NSEEL_VM_regvar(mVM, "outbuf") = EEL_AUDIO_RAM_OFFSET + EEL_MAX_CHANNELS * EEL_VECTOR_SIZE;
+  *NSEEL_VM_regvar(mVM, "bufstride") = EEL_VECTOR_SIZE;
+
+  WDL_String name;
+  for (auto c = 0; c < std::max(mNInputs, mNOutputs); c++)
+  {
+    name.SetFormatted(16, "spl%i", c);
+    mSpl[c] = NSEEL_VM_regvar(mVM, name.Get());
+  }
+
+  for (auto p = 0; p < std::min(paramVars.GetSize(), EEL_MAX_PARAMS); p++)
+  {
+    WDL_String* pVarName = paramVars.Get(p);
+
+    if (pVarName && pVarName->GetLength())
+      mParamVars[p] = NSEEL_VM_regvar(mVM, pVarName->Get());
+  }
+
+  // split the source into sections. Anything before the first section marker is treated as @init
+  WDL_String sections[kNumEELSections];
+  int sectionLine[kNumEELSections] = {};
+  int section = kEELSectionInit;
+  int line = 0;
+  const char* pLine = code;
+
+  while (pLine && *pLine)
+  {
+    const char* pEnd = strchr(pLine, '\n');
+    const int len = pEnd ? (int) (pEnd - pLine) : (int) strlen(pLine);
+
+    if (*pLine == '@')
+    {
+      for (auto s = 0; s < kNumEELSections; s++)
+      {
+        const int tokLen = (int) strlen(EELSectionStrs[s]);
+
+        if (len >= tokLen && !strncmp(pLine, EELSectionStrs[s], tokLen))
+        {
+          section = s;
+          sectionLine[s] = line;
+          sections[s].Set("");
+
+          if (len > tokLen) // WDL_String treats a length of 0 as "everything"
+            sections[s].Append(pLine + tokLen, len - tokLen);
+
+          sections[s].Append("\n");
+          break;
+        }
+      }
+    }
+    else
+    {
+      if (len > 0)
+        sections[section].Append(pLine, len);
+
+      sections[section].Append("\n");
+    }
+
+    line++;
+    pLine = pEnd ? pEnd + 1 : nullptr;
+  }
+
+  NSEEL_CODEHANDLE* handles[kNumEELSections] = { &mInitCode, &mSliderCode, &mBlockCode, &mSampleCode, &mProcessCode };
+
+  for (auto s = 0; s < kNumEELSections; s++)
+  {
+    if (!sections[s].GetLength())
+      continue;
+
+    // functions defined in @init are visible to the other sections
+    const int flags = (s == kEELSectionInit) ? NSEEL_CODE_COMPILE_FLAG_COMMONFUNCS : 0;
+    *handles[s] = NSEEL_code_compile_ex(mVM, sections[s].Get(), sectionLine[s], flags);
+
+    if (!*handles[s])
+    {
+      const char* pErr = NSEEL_code_getcodeerror(mVM);
+      error.SetFormatted(1024, "%s: %s", EELSectionStrs[s], pErr ? pErr : "unknown error");
+      return false;
+    }
+  }
+
+  if (mProcessCode)
+  {
+    // touch the audio buffers now, so that the audio thread never allocates VM RAM for them
+    for (auto c = 0; c < EEL_MAX_CHANNELS; c++)
+    {
+      int valid = 0;
+
+      if (c < mNInputs)
+      {
+        mInRAM[c] = NSEEL_VM_getramptr(mVM, EEL_AUDIO_RAM_OFFSET + c * EEL_VECTOR_SIZE, &valid);
+
+        if (!mInRAM[c] || valid < EEL_VECTOR_SIZE)
+        {
+          error.Set("@process: failed to allocate VM RAM for audio buffers");
+          return false;
+        }
+      }
+
+      if (c < mNOutputs)
+      {
+        mOutRAM[c] = NSEEL_VM_getramptr(mVM, EEL_AUDIO_RAM_OFFSET + (EEL_MAX_CHANNELS + c) * EEL_VECTOR_SIZE, &valid);
+
+        if (!mOutRAM[c] || valid < EEL_VECTOR_SIZE)
+        {
+          error.Set("@process: failed to allocate VM RAM for audio buffers");
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+void IPlugEEL::Program::Init(double sampleRate)
+{
+  mSampleRate = sampleRate;
+  *mSrate = sampleRate;
+
+  if (mInitCode)
+    NSEEL_code_execute(mInitCode);
+}
+
+#pragma mark - IPlugEEL
+
+IPlugEEL::IPlugEEL(const char* name, int maxNInputs, int maxNOutputs)
+: mMaxNInputs(maxNInputs)
+, mMaxNOutputs(maxNOutputs)
+{
+  assert(maxNInputs <= EEL_MAX_CHANNELS && maxNOutputs <= EEL_MAX_CHANNELS);
+
+  mName.Set(name);
+
+  for (auto p = 0; p < EEL_MAX_PARAMS; p++)
+    mParamValues[p].store(0.);
+}
+
+IPlugEEL::~IPlugEEL()
+{
+  if (mCompileThread.joinable())
+    mCompileThread.join();
+
+  delete mPending.exchange(nullptr);
+  DELETE_NULL(mActive);
+  OnIdle();
+
+  mParamVarNames.Empty(true);
+}
+
+void IPlugEEL::MapParameter(int paramIdx, const char* varName)
+{
+  assert(paramIdx >= 0 && paramIdx < EEL_MAX_PARAMS);
+
+  WDL_MutexLock lock(&mCompileMutex);
+
+  while (mParamVarNames.GetSize() <= paramIdx)
+    mParamVarNames.Add(new WDL_String());
+
+  mParamVarNames.Get(paramIdx)->Set(varName);
+}
+
+IPlugEEL::Program* IPlugEEL::CreateProgram(const char* code)
+{
+  WDL_MutexLock lock(&mCompileMutex);
+
+  Program* pProgram = new Program(mMaxNInputs, mMaxNOutputs);
+  WDL_String error;
+
+  if (!pProgram->Compile(code, mParamVarNames, error))
+  {
+    DBGMSG("IPlugEEL-%s: compile error %s\n", mName.Get(), error.Get());
+    mLastError.Set(error.Get());
+    delete pProgram;
+    return nullptr;
+  }
+
+  mLastError.Set("");
+
+  for (auto p = 0; p < EEL_MAX_PARAMS; p++)
+  {
+    if (pProgram->mParamVars[p])
+      *pProgram->mParamVars[p] = mParamValues[p].load();
+  }
+
+  pProgram->Init(mSampleRate.load());
+
+  return pProgram;
+}
+
+bool IPlugEEL::Compile(const char* code)
+{
+  Program* pProgram = CreateProgram(code);
+
+  if (pProgram)
+    Publish(pProgram);
+
+  return pProgram != nullptr;
+}
+
+void IPlugEEL::CompileAsync(const char* code)
+{
+  if (mCompileThread.joinable())
+    mCompileThread.join();
+
+  WDL_String codeStr(code);
+
+  mCompileThread = std::thread([this, codeStr]() {
+    Compile(codeStr.Get());
+  });
+}
+
+void IPlugEEL::GetLastError(WDL_String& str)
+{
+  WDL_MutexLock lock(&mCompileMutex);
+  str.Set(mLastError.Get());
+}
+
+void IPlugEEL::Publish(Program* pProgram)
+{
+  // if the audio thread hasn't picked up the previous program, it never will, so we own it
+  Program* pStale = mPending.exchange(pProgram);
+  delete pStale;
+}
+
+void IPlugEEL::Retire(Program* pProgram)
+{
+  // the caller has checked there is space in the queue
+  mRetired.Push(pProgram);
+}
+
+void IPlugEEL::OnIdle()
+{
+  Program* pProgram = nullptr;
+
+  while (mRetired.ElementsAvailable())
+  {
+    mRetired.Pop(pProgram);
+    delete pProgram;
+  }
+}
+
+void IPlugEEL::SetSampleRate(double sampleRate)
+{
+  mSampleRate.store(sampleRate);
+  mResetRequested.store(true);
+}
+
+void IPlugEEL::SetParameterValue(int paramIdx, double value)
+{
+  if (paramIdx < 0 || paramIdx >= EEL_MAX_PARAMS)
+    return;
+
+  mParamValues[paramIdx].store(value, std::memory_order_relaxed);
+  mParamsChanged.store(true, std::memory_order_release);
+}
+
+void IPlugEEL::UpdateParamVars(Program* pProgram, bool force)
+{
+  const bool changed = mParamsChanged.exchange(false, std::memory_order_acquire);
+
+  if (!(changed || force))
+    return;
+
+  for (auto p = 0; p < EEL_MAX_PARAMS; p++)
+  {
+    if (pProgram->mParamVars[p])
+      *pProgram->mParamVars[p] = mParamValues[p].load(std::memory_order_relaxed);
+  }
+
+  if (pProgram->mSliderCode)
+    NSEEL_code_execute(pProgram->mSliderCode);
+}
+
+void IPlugEEL::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
+{
+  bool forceParamUpdate = false;
+
+  // only take the new program if we are sure we can hand the old one back to the main thread
+  if (mPending.load(std::memory_order_acquire) && mRetired.ElementsAvailable() < EEL_RETIRE_QUEUE_SIZE)
+  {
+    Program* pNew = mPending.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (pNew)
+    {
+      if (mActive)
+        Retire(mActive);
+
+      mActive = pNew;
+      mHasProgram.store(true);
+      forceParamUpdate = true;
+    }
+  }
+
+  Program* pProgram = mActive;
+
+  if (!pProgram)
+  {
+    for (auto c = 0; c < mMaxNOutputs; c++)
+      memset(outputs[c], 0, nFrames * sizeof(sample));
+
+    return;
+  }
+
+  const double sampleRate = mSampleRate.load();
+
+  if (mResetRequested.exchange(false) || pProgram->mSampleRate != sampleRate)
+  {
+    pProgram->Init(sampleRate);
+    forceParamUpdate = true;
+  }
+
+  UpdateParamVars(pProgram, forceParamUpdate);
+
+  *pProgram->mSamplesBlock = nFrames;
+
+  if (pProgram->mBlockCode)
+    NSEEL_code_execute(pProgram->mBlockCode);
+
+  if (pProgram->mProcessCode)
+  {
+    ProcessVectors(pProgram, inputs, outputs, nFrames);
+  }
+  else if (pProgram->mSampleCode)
+  {
+    ProcessSamples(pProgram, inputs, outputs, nFrames);
+  }
+  else
+  {
+    for (auto c = 0; c < pProgram->mNOutputs; c++)
+    {
+      if (c < pProgram->mNInputs)
+        memcpy(outputs[c], inputs[c], nFrames * sizeof(sample));
+      else
+        memset(outputs[c], 0, nFrames * sizeof(sample));
+    }
+  }
+}
+
+void IPlugEEL::ProcessVectors(Program* pProgram, sample** inputs, sample** outputs, int nFrames)
+{
+  for (auto offset = 0; offset < nFrames; offset += EEL_VECTOR_SIZE)
+  {
+    const int n = std::min(nFrames - offset, EEL_VECTOR_SIZE);
+
+    for (auto c = 0; c < pProgram->mNInputs; c++)
+    {
+      EEL_F* pDest = pProgram->mInRAM[c];
+      const sample* pSrc = inputs[c] + offset;
+
+      for (auto s = 0; s < n; s++)
+        pDest[s] = (EEL_F) pSrc[s];
+    }
+
+    *pProgram->mSamplesBlock = n;
+    NSEEL_code_execute(pProgram->mProcessCode);
+
+    for (auto c = 0; c < pProgram->mNOutputs; c++)
+    {
+      const EEL_F* pSrc = pProgram->mOutRAM[c];
+      sample* pDest = outputs[c] + offset;
+
+      for (auto s = 0; s < n; s++)
+        pDest[s] = (sample) pSrc[s];
+    }
+  }
+}
+
+void IPlugEEL::ProcessSamples(Program* pProgram, sample** inputs, sample** outputs, int nFrames)
+{
+  const int nIn = pProgram->mNInputs;
+  const int nOut = pProgram->mNOutputs;
+  const int nChans = std::max(nIn, nOut);
+  EEL_F** pSpl = pProgram->mSpl;
+
+  for (auto s = 0; s < nFrames; s++)
+  {
+    for (auto c = 0; c < nChans; c++)
+      *pSpl[c] = c < nIn ? (EEL_F) inputs[c][s] : 0.;
+
+    NSEEL_code_execute(pProgram->mSampleCode);
+
+    for (auto c = 0; c < nOut; c++)
+      outputs[c][s] = (sample) *pSpl[c];
+  }
+}
@@ -0,0 +1,171 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugEEL
+ */
+
+#include <atomic>
+#include <thread>
+
+#include "ns-eel.h"
+#include "wdlstring.h"
+#include "ptrlist.h"
+#include "mutex.h"
+
+#include "IPlugConstants.h"
+#include "IPlugLogger.h"
+#include "IPlugQueue.h"
+
+#ifndef EEL_MAX_PARAMS
+#define EEL_MAX_PARAMS 128
+#endif
+
+#ifndef EEL_MAX_CHANNELS
+#define EEL_MAX_CHANNELS 64
+#endif
+
+/** The number of frames handed to the @process section in one call. Longer host blocks are split */
+#ifndef EEL_VECTOR_SIZE
+#define EEL_VECTOR_SIZE 1024
+#endif
+
+/** Audio buffers for the @process section live at the top of VM RAM, so that scripts are free to use low memory as in JSFX */
+#ifndef EEL_AUDIO_RAM_OFFSET
+#define EEL_AUDIO_RAM_OFFSET ((NSEEL_RAM_BLOCKS_DEFAULTMAX - 4) * NSEEL_RAM_ITEMSPERBLOCK)
+#endif
+
+#define EEL_RETIRE_QUEUE_SIZE 16
+
+/** This class hosts DSP written in WDL's EEL2 language, which is JIT compiled to native code.
+ * Scripts use JSFX style sections:
+ * - \@init is run after compilation and whenever the sample rate changes
+ * - \@slider is run at the start of a block if any mapped parameter changed
+ * - \@block is run once per block, before any audio is processed
+ * - \@sample is run once per sample frame, with the audio in the variables spl0, spl1 ... splN
+ * - \@process is a block vectorised alternative to \@sample, it is run once per EEL_VECTOR_SIZE frames with the audio in VM RAM.
+ *   Input channel c starts at inbuf + c * bufstride and output channel c at outbuf + c * bufstride. samplesblock holds the frame count.
+ *
+ * Compilation happens off the audio thread (either on the calling thread via Compile() or a worker thread via CompileAsync()).
+ * The new program is initialised at the current sample rate, then published to the audio thread through an atomic pointer and
+ * swapped in at the start of the next block. Programs that have been replaced are handed back to be freed in OnIdle(), which should be called on the main thread.
+ *
+ * NOTE: WDL/eel2/nseel-caltab.c, nseel-cfunc.c, nseel-compiler.c, nseel-eval.c, nseel-lextab.c, nseel-ram.c and nseel-yylex.c must be compiled in your project,
+ * as well as the asm-nseel-x64 object file on x86_64, unless EEL_TARGET_PORTABLE is defined
+ * NOTE: scripts that touch new VM RAM regions will allocate on the audio thread, just like in JSFX */
+class IPlugEEL
+{
+  class Program
+  {
+  public:
+    Program(int nInputs, int nOutputs);
+    ~Program();
+
+    bool Compile(const char* code, const WDL_PtrList<WDL_String>& paramVars, WDL_String& error);
+    void Init(double sampleRate);
+
+    NSEEL_VMCTX mVM = nullptr;
+    void* mGRAM = nullptr;
+    NSEEL_CODEHANDLE mInitCode = nullptr;
+    NSEEL_CODEHANDLE mSliderCode = nullptr;
+    NSEEL_CODEHANDLE mBlockCode = nullptr;
+    NSEEL_CODEHANDLE mSampleCode = nullptr;
+    NSEEL_CODEHANDLE mProcessCode = nullptr;
+
+    EEL_F* mSrate = nullptr;
+    EEL_F* mSamplesBlock = nullptr;
+    EEL_F* mNumInputs = nullptr;
+    EEL_F* mNumOutputs = nullptr;
+    EEL_F* mSpl[EEL_MAX_CHANNELS] = {};
+    EEL_F* mParamVars[EEL_MAX_PARAMS] = {};
+    EEL_F* mInRAM[EEL_MAX_CHANNELS] = {};
+    EEL_F* mOutRAM[EEL_MAX_CHANNELS] = {};
+
+    int mNInputs;
+    int mNOutputs;
+    double mSampleRate = 0.;
+  };
+
+public:
+  IPlugEEL(const char* name, int maxNInputs = 2, int maxNOutputs = 2);
+  ~IPlugEEL();
+
+  IPlugEEL(const IPlugEEL&) = delete;
+  IPlugEEL& operator=(const IPlugEEL&) = delete;
+
+  /** Link an IPlug parameter index to a script variable. Must be called before Compile(), the mapping is baked into the compiled program.
+   * @param paramIdx The index that will be passed to SetParameterValue()
+   * @param varName The name of the variable in the script */
+  void MapParameter(int paramIdx, const char* varName);
+
+  /** Compile a script on the calling thread and publish it to the audio thread. Do not call this on the audio thread.
+   * @param code The EEL2 source code including section markers
+   * @return \c true on success. On failure the current program keeps running and the error is available via GetLastError() */
+  bool Compile(const char* code);
+
+  /** Compile a script on a worker thread and publish it to the audio thread when it is ready.
+   * Any compilation already in progress will be finished first
+   * @param code The EEL2 source code including section markers */
+  void CompileAsync(const char* code);
+
+  /** @return \c true if a script has been compiled and swapped into the audio path */
+  bool IsRunning() const { return mHasProgram.load(); }
+
+  /** @param str Will be set to the last compilation error, or an empty string */
+  void GetLastError(WDL_String& str);
+
+  /** Call this from OnReset(). The active program's \@init section will be re-run on the audio thread at the start of the next block
+   * @param sampleRate The new sample rate */
+  void SetSampleRate(double sampleRate);
+
+  /** Set the value of a mapped parameter, can be called on any thread.
+   * @param paramIdx The parameter index passed to MapParameter()
+   * @param value The non-normalized value that will be written to the script variable */
+  void SetParameterValue(int paramIdx, double value);
+
+  /** Call this from the main thread, e.g. in OnIdle(), to free programs that have been swapped out of the audio path */
+  void OnIdle();
+
+  /** Process a block of audio with the active program. Outputs are silent until a program has been compiled successfully.
+   * @param inputs The input channel buffers
+   * @param outputs The output channel buffers
+   * @param nFrames The number of sample frames to process */
+  void ProcessBlock(sample** inputs, sample** outputs, int nFrames);
+
+private:
+  Program* CreateProgram(const char* code);
+  void Publish(Program* pProgram);
+  void Retire(Program* pProgram);
+  void UpdateParamVars(Program* pProgram, bool force);
+  void ProcessVectors(Program* pProgram, sample** inputs, sample** outputs, int nFrames);
+  void ProcessSamples(Program* pProgram, sample** inputs, sample** outputs, int nFrames);
+
+  WDL_String mName;
+  int mMaxNInputs;
+  int mMaxNOutputs;
+  WDL_PtrList<WDL_String> mParamVarNames;
+
+  std::atomic<double> mSampleRate{DEFAULT_SAMPLE_RATE};
+  std::atomic<bool> mResetRequested{false};
+  std::atomic<double> mParamValues[EEL_MAX_PARAMS];
+  std::atomic<bool> mParamsChanged{true};
+
+  Program* mActive = nullptr; // only touched by the audio thread
+  std::atomic<Program*> mPending{nullptr};
+  std::atomic<bool> mHasProgram{false};
+  IPlugQueue<Program*> mRetired{EEL_RETIRE_QUEUE_SIZE};
+
+  std::thread mCompileThread;
+  WDL_Mutex mCompileMutex;
+  WDL_String mLastError;
+};
@@ -0,0 +1,328 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of a biquad chain compiled by IPlugEEL against the same chain in C++
+ *
+ * A chain of -s (4 by default) transposed direct form II lowpass biquads filters stereo noise, in C++, in an EEL2 \@sample section
+ * and in an EEL2 \@process section. The cutoff is swept every -m blocks, so the coefficients are recalculated in \@slider as they would be
+ * under automation. The time of each block is measured and the EEL2 outputs are compared with the C++ output, so a script that
+ * doesn't run the same filter makes the benchmark fail.
+ *
+ * Build on Linux x86_64 with:
+ *
+ *   g++ -O2 -std=c++14 -DNOMINMAX -DNSEEL_LOOPFUNC_SUPPORT_MAXLEN=0 -IIPlug -IIPlug/Extras/EEL -IWDL -IWDL/eel2 -c \
+ *     IPlug/Extras/EEL/IPlugEEL_bench.cpp IPlug/Extras/EEL/IPlugEEL.cpp
+ *   gcc -O2 -DNSEEL_LOOPFUNC_SUPPORT_MAXLEN=0 -c WDL/eel2/nseel-caltab.c WDL/eel2/nseel-cfunc.c WDL/eel2/nseel-compiler.c \
+ *     WDL/eel2/nseel-eval.c WDL/eel2/nseel-lextab.c WDL/eel2/nseel-ram.c WDL/eel2/nseel-yylex.c
+ *   g++ *.o asm-nseel-x64.o -lpthread -o eelbench
+ *
+ * where asm-nseel-x64.o is built from WDL/eel2 with "php a2x64.php elf64" and nasm. On macOS link WDL/eel2/asm-nseel-x64-macho.o instead.
+ * Add -DEEL_TARGET_PORTABLE to all of the above to measure the EEL2 interpreter instead of the JIT.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "IPlugEEL.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_MAX_STAGES 16
+#define BENCH_Q 0.707
+
+enum EBenchParams
+{
+  kParamCutoff = 0,
+  kParamQ,
+  kParamStages
+};
+
+// the @sample and @process sections keep the filter state of channel c at c * 64 in VM RAM
+static const char* kSampleScript = R"(@slider
+w0 = 2 * $pi * cutoff / srate;
+cosw = cos(w0);
+alpha = sin(w0) / (2 * q);
+a0 = 1 + alpha;
+b0 = (1 - cosw) / 2 / a0;
+b1 = (1 - cosw) / a0;
+b2 = b0;
+a1 = -2 * cosw / a0;
+a2 = (1 - alpha) / a0;
+@sample
+x = spl0;
+s = 0;
+loop(stages,
+  y = b0 * x + s[0];
+  s[0] = b1 * x - a1 * y + s[1];
+  s[1] = b2 * x - a2 * y;
+  x = y;
+  s += 2;
+);
+spl0 = x;
+x = spl1;
+s = 64;
+loop(stages,
+  y = b0 * x + s[0];
+  s[0] = b1 * x - a1 * y + s[1];
+  s[1] = b2 * x - a2 * y;
+  x = y;
+  s += 2;
+);
+spl1 = x;
+)";
+
+static const char* kProcessScript = R"(@slider
+w0 = 2 * $pi * cutoff / srate;
+cosw = cos(w0);
+alpha = sin(w0) / (2 * q);
+a0 = 1 + alpha;
+b0 = (1 - cosw) / 2 / a0;
+b1 = (1 - cosw) / a0;
+b2 = b0;
+a1 = -2 * cosw / a0;
+a2 = (1 - alpha) / a0;
+@process
+ch = 0;
+loop(2,
+  src = inbuf + ch * bufstride;
+  dst = outbuf + ch * bufstride;
+  memcpy(dst, src, samplesblock);
+  s = ch * 64;
+  loop(stages,
+    z1 = s[0];
+    z2 = s[1];
+    i = 0;
+    loop(samplesblock,
+      x = dst[i];
+      y = b0 * x + z1;
+      z1 = b1 * x - a1 * y + z2;
+      z2 = b2 * x - a2 * y;
+      dst[i] = y;
+      i += 1;
+    );
+    s[0] = z1;
+    s[1] = z2;
+    s += 2;
+  );
+  ch += 1;
+);
+)";
+
+/** The same chain as the scripts, with the coefficients calculated in the same order */
+class BiquadChain
+{
+public:
+  void SetParams(double cutoff, double q, int nStages)
+  {
+    const double w0 = 2. * PI * cutoff / BENCH_SAMPLE_RATE;
+    const double cosw = std::cos(w0);
+    const double alpha = std::sin(w0) / (2. * q);
+    const double a0 = 1. + alpha;
+    mB0 = (1. - cosw) / 2. / a0;
+    mB1 = (1. - cosw) / a0;
+    mB2 = mB0;
+    mA1 = -2. * cosw / a0;
+    mA2 = (1. - alpha) / a0;
+    mNStages = nStages;
+  }
+
+  void ProcessBlock(sample** inputs, sample** outputs, int nFrames)
+  {
+    for (auto c = 0; c < 2; c++)
+    {
+      double* pState = mState[c];
+
+      for (auto s = 0; s < nFrames; s++)
+      {
+        double x = inputs[c][s];
+
+        for (auto st = 0; st < mNStages; st++)
+        {
+          const double y = mB0 * x + pState[2 * st];
+          pState[2 * st] = mB1 * x - mA1 * y + pState[2 * st + 1];
+          pState[2 * st + 1] = mB2 * x - mA2 * y;
+          x = y;
+        }
+
+        outputs[c][s] = (sample) x;
+      }
+    }
+  }
+
+private:
+  double mB0 = 0., mB1 = 0., mB2 = 0., mA1 = 0., mA2 = 0.;
+  int mNStages = 0;
+  double mState[2][2 * BENCH_MAX_STAGES] = {};
+};
+
+struct BlockStats
+{
+  double mean = 0.;
+  double p99 = 0.;
+  double max = 0.;
+};
+
+static BlockStats GetStats(std::vector<double>& times)
+{
+  std::sort(times.begin(), times.end());
+  BlockStats stats;
+
+  for (auto t : times)
+    stats.mean += t;
+
+  stats.mean /= times.size();
+  stats.p99 = times[std::min(times.size() - 1, (size_t) (0.99 * times.size()))];
+  stats.max = times.back();
+  return stats;
+}
+
+static void PrintStats(const char* name, std::vector<double>& times, int blockSize, double reference)
+{
+  const BlockStats stats = GetStats(times);
+  const double budget = 1e6 * blockSize / BENCH_SAMPLE_RATE;
+  printf("%-20s mean %8.1f us (%5.1f%% of the block, %5.2fx C++)  p99 %8.1f us  max %8.1f us\n",
+         name, stats.mean, 100. * stats.mean / budget, reference > 0. ? stats.mean / reference : 1., stats.p99, stats.max);
+}
+
+static double CutoffForBlock(int block, int sweepBlocks)
+{
+  return 200. + 4000. * (1. + std::sin(0.1 * (block / sweepBlocks)));
+}
+
+int main(int argc, char* argv[])
+{
+  int nBlocks = 10000;
+  int blockSize = 512;
+  int nStages = 4;
+  int sweepBlocks = 16;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nBlocks = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      blockSize = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      nStages = std::max(1, std::min(BENCH_MAX_STAGES, atoi(argv[++i])));
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+      sweepBlocks = std::max(1, atoi(argv[++i]));
+    else
+    {
+      printf("usage: %s [-n blocks] [-b block size] [-s biquad stages, 1 to %d] [-m blocks between cutoff changes]\n", argv[0], BENCH_MAX_STAGES);
+      return 1;
+    }
+  }
+
+#ifdef EEL_TARGET_PORTABLE
+  const char* engine = "interpreter";
+#else
+  const char* engine = "JIT";
+#endif
+
+  printf("%d stage biquad chain, 2 channels, %d blocks of %d samples at %d Hz, cutoff changes every %d blocks, EEL2 %s\n",
+         nStages, nBlocks, blockSize, BENCH_SAMPLE_RATE, sweepBlocks, engine);
+
+  std::vector<sample> inBuf(2 * nBlocks * blockSize);
+  srand(1);
+
+  for (auto& s : inBuf)
+    s = 2. * rand() / RAND_MAX - 1.;
+
+  enum EVariant { kCPP = 0, kEELSample, kEELProcess, kNumVariants };
+  const char* variantNames[kNumVariants] = { "C++", "EEL2 @sample", "EEL2 @process" };
+  const char* scripts[kNumVariants] = { nullptr, kSampleScript, kProcessScript };
+
+  std::vector<sample> outBufs[kNumVariants];
+  std::vector<double> times[kNumVariants];
+  double cppMean = 0.;
+  double maxDiff[kNumVariants] = {};
+  int failed = 0;
+
+  for (auto v = 0; v < kNumVariants; v++)
+  {
+    BiquadChain cpp;
+    IPlugEEL eel("bench");
+
+    if (scripts[v])
+    {
+      eel.MapParameter(kParamCutoff, "cutoff");
+      eel.MapParameter(kParamQ, "q");
+      eel.MapParameter(kParamStages, "stages");
+      eel.SetSampleRate(BENCH_SAMPLE_RATE);
+      eel.SetParameterValue(kParamCutoff, CutoffForBlock(0, sweepBlocks));
+      eel.SetParameterValue(kParamQ, BENCH_Q);
+      eel.SetParameterValue(kParamStages, nStages);
+
+      if (!eel.Compile(scripts[v]))
+      {
+        WDL_String error;
+        eel.GetLastError(error);
+        printf("FAILED: %s didn't compile: %s\n", variantNames[v], error.Get());
+        return 1;
+      }
+    }
+
+    outBufs[v].resize(inBuf.size());
+    times[v].resize(nBlocks);
+
+    for (auto block = 0; block < nBlocks; block++)
+    {
+      sample* inputs[2] = { inBuf.data() + 2 * block * blockSize, inBuf.data() + (2 * block + 1) * blockSize };
+      sample* outputs[2] = { outBufs[v].data() + 2 * block * blockSize, outBufs[v].data() + (2 * block + 1) * blockSize };
+      const double cutoff = CutoffForBlock(block, sweepBlocks);
+
+      const auto start = std::chrono::steady_clock::now();
+
+      if (scripts[v])
+      {
+        if (block % sweepBlocks == 0)
+          eel.SetParameterValue(kParamCutoff, cutoff);
+
+        eel.ProcessBlock(inputs, outputs, blockSize);
+      }
+      else
+      {
+        if (block % sweepBlocks == 0)
+          cpp.SetParams(cutoff, BENCH_Q, nStages);
+
+        cpp.ProcessBlock(inputs, outputs, blockSize);
+      }
+
+      times[v][block] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (scripts[v])
+    {
+      for (size_t s = 0; s < inBuf.size(); s++)
+        maxDiff[v] = std::max(maxDiff[v], (double) std::fabs(outBufs[v][s] - outBufs[kCPP][s]));
+
+      if (maxDiff[v] > 1e-9)
+        failed++;
+    }
+
+    PrintStats(variantNames[v], times[v], blockSize, cppMean);
+
+    if (v == kCPP)
+      cppMean = GetStats(times[v]).mean;
+  }
+
+  printf("\nlargest difference from the C++ output: @sample %g, @process %g\n", maxDiff[kEELSample], maxDiff[kEELProcess]);
+
+  if (failed)
+    printf("FAILED: the EEL2 output doesn't match the C++ output\n");
+
+  return failed ? 1 : 0;
+}
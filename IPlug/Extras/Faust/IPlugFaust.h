@@ -23,6 +23,12 @@
 
 #include "Oversampler.h"
 
+#ifdef FAUST_POLY
+#include "IPlugFaustPolyDSP.h"
+#else
+class FaustPolyDSP;
+#endif
+
 #ifndef DEFAULT_FAUST_LIBRARY_PATH
   #if defined OS_MAC || defined OS_LINUX
   #define DEFAULT_FAUST_LIBRARY_PATH "/usr/local/share/faust/"
@@ -32,7 +38,8 @@
 #endif
 
 /** This abstract interface is used by the IPlug FAUST architecture file and the IPlug libfaust JIT compiling class FaustGen
- * In order to provide a consistent interface to FAUST DSP whether using the JIT compiler or a compiled C++ class */
+ * In order to provide a consistent interface to FAUST DSP whether using the JIT compiler or a compiled C++ class
+ * If FAUST_POLY is defined, FAUST_BLOCKs with more than one voice (or DSP with "nvoices" metadata) are played polyphonically via MidiSynth, see FaustPolyDSP */
 class IPlugFaust : public UI, public Meta
 {
 public:
@@ -75,6 +82,14 @@ public:
   void FreeDSP()
   {
     DELETE_NULL(mDSP);
+    mPolyDSP = nullptr;
+  }
+  
+  /** Call this before Init() to render the voices of a polyphonic DSP in parallel
+   * @param nThreads The number of threads to use including the audio thread, 0 or 1 renders everything on the audio thread */
+  void SetVoiceRenderThreads(int nThreads)
+  {
+    mNVoiceRenderThreads = nThreads;
   }
   
   void SetOverSamplingRate(int rate)
@@ -95,9 +110,10 @@ public:
       mDSP->init(((int) sampleRate) * multiplier);
   }
 
-  void ProcessMidiMsg(const IMidiMsg& msg)
+  /** Send a MIDI message to a polyphonic DSP. Call this on the audio thread, before ProcessBlock() */
+  virtual void ProcessMidiMsg(const IMidiMsg& msg)
   {
-//    TODO:
+    SendMidiMsgToPolyDSP(mPolyDSP, msg);
   }
 
   virtual void ProcessBlock(sample** inputs, sample** outputs, int nFrames)
@@ -106,6 +122,8 @@ public:
     {
       assert(mDSP->getSampleRate() != 0); // did you forget to call SetSampleRate?
       
+      UpdateZones(mZones, mParams);
+      
       if(mOverSampler)
         mOverSampler->ProcessBlock(inputs, outputs, nFrames, 1 /* DOESN'T YET WORK WITH MC */,
                                    [&](sample** inputs, sample** outputs, int nFrames)
@@ -118,6 +136,7 @@ public:
 //    else silence?
   }
 
+  /** Parameter values are written to the FAUST zones at the start of the next ProcessBlock(), so this can be called from any thread */
   void SetParameterValueNormalised(int paramIdx, double normalizedValue)
   {
     if(paramIdx > kNoParameter && paramIdx >= NParams())
@@ -127,11 +146,6 @@ public:
     else
     {
       mParams.Get(paramIdx)->SetNormalized(normalizedValue);
-    
-      if(mZones.GetSize() == NParams())
-        *(mZones.Get(paramIdx)) = mParams.Get(paramIdx)->Value();
-      else
-        DBGMSG("IPlugFaust-%s:: Missing zone for parameter %s\n", mName.Get(), mParams.Get(paramIdx)->GetNameForHost());
     }
   }
   
@@ -142,11 +156,6 @@ public:
     assert(paramIdx < NParams()); // Seems like we don't have enough parameters!
     
     mParams.Get(paramIdx)->Set(nonNormalizedValue);
-
-    if(mZones.GetSize() == NParams())
-      *(mZones.Get(paramIdx)) = nonNormalizedValue;
-    else
-      DBGMSG("IPlugFaust-%s:: Missing zone for parameter %s\n", mName.Get(), mParams.Get(paramIdx)->GetNameForHost());
     }
     else
       DBGMSG("SetParameterValue called with no FAUST params\n");
@@ -154,12 +163,10 @@ public:
 
   void SetParameterValue(const char* labelToLookup, double nonNormalizedValue)
   {
-    FAUSTFLOAT* dest = nullptr;
-    dest = mMap.Get(labelToLookup, nullptr);
-//    mParams.Get(paramIdx)->Set(nonNormalizedValue); // TODO: we are not updating the IPlug parameter
+    const int idx = FindExistingParameterWithName(labelToLookup);
 
-    if(dest)
-      *dest = nonNormalizedValue;
+    if(idx > -1)
+      mParams.Get(idx)->Set(nonNormalizedValue);
     else
       DBGMSG("IPlugFaust-%s:: No parameter named %s\n", mName.Get(), labelToLookup);
   }
@@ -183,6 +190,15 @@ public:
       assert(plugParamIdx + p < pPlug->NParams()); // plugin needs to have enough params!
 
       IParam* pParam = pPlug->GetParam(plugParamIdx + p);
+      
+      if(ParamsMatch(*pParam, *mParams.Get(p))) // re-initialising a parameter that didn't change would reset its value while it is in use
+      {
+        if(setToDefault)
+          pParam->SetToDefault();
+        
+        continue;
+      }
+      
       const double currentValueNormalised = pParam->GetNormalized();
       pParam->Init(*mParams.Get(p));
       if(setToDefault)
@@ -248,10 +264,10 @@ protected:
   {
     IParam* pParam = nullptr;
     
-    const int idx = FindExistingParameterWithName(label);
+    const int idx = FindParameterWithName(*mpUIParams, label);
     
     if(idx > -1)
-      pParam = mParams.Get(idx);
+      pParam = mpUIParams->Get(idx);
     else
       pParam = new IParam();
     
@@ -275,12 +291,85 @@ protected:
     }
     
     if(idx == -1)
-      mParams.Add(pParam);
+      mpUIParams->Add(pParam);
     
-    mZones.Add(zone);
+    mpUIZones->Add(zone);
   }
   
-  void BuildParameterMap()
+  /** @return \c true if the two parameters have the same name, type, range and default, so that one can stand in for the other */
+  static bool ParamsMatch(const IParam& a, const IParam& b)
+  {
+    return a.Type() == b.Type() && strcmp(a.GetNameForHost(), b.GetNameForHost()) == 0
+        && a.GetMin() == b.GetMin() && a.GetMax() == b.GetMax() && a.GetStep() == b.GetStep() && a.GetDefault() == b.GetDefault();
+  }
+  
+  /** Wrap a monophonic DSP in a FaustPolyDSP, if the FAUST_BLOCK or the DSP's "nvoices" metadata asks for more than one voice
+   * @param pMonoDSP The DSP, ownership passes to the returned DSP
+   * @param pPolyDSP Set to the FaustPolyDSP, or nullptr if pMonoDSP is returned
+   * @return The DSP to run */
+  ::dsp* CreatePolyDSPIfNeeded(::dsp* pMonoDSP, FaustPolyDSP*& pPolyDSP)
+  {
+    struct VoicesMeta : public Meta
+    {
+      void declare(const char* key, const char* value) override
+      {
+        if(strcmp(key, "nvoices") == 0)
+          nVoices = atoi(value);
+      }
+      
+      int nVoices = 0;
+    };
+    
+    pPolyDSP = nullptr;
+    
+    int nVoices = mNVoices;
+    
+    if(nVoices <= 1)
+    {
+      VoicesMeta meta;
+      pMonoDSP->metadata(&meta);
+      nVoices = meta.nVoices;
+    }
+    
+    if(nVoices < 1 || (nVoices == 1 && mNVoices == 1))
+      return pMonoDSP;
+    
+#ifdef FAUST_POLY
+    pPolyDSP = new FaustPolyDSP(pMonoDSP, nVoices, mNVoiceRenderThreads);
+    return pPolyDSP;
+#else
+    DBGMSG("IPlugFaust-%s:: %i voices requested, but FAUST_POLY is not defined\n", mName.Get(), nVoices);
+    return pMonoDSP;
+#endif
+  }
+  
+  void SendMidiMsgToPolyDSP(FaustPolyDSP* pPolyDSP, const IMidiMsg& msg)
+  {
+#ifdef FAUST_POLY
+    if(pPolyDSP)
+    {
+      IMidiMsg scaledMsg = msg;
+      
+      if(mOverSampler) // the DSP runs at the oversampled rate
+        scaledMsg.mOffset *= mOverSampler->GetRate();
+      
+      pPolyDSP->ProcessMidiMsg(scaledMsg);
+    }
+#endif
+  }
+  
+  /** Copy parameter values to the FAUST zones they are linked to. Zones and parameters are paired by index */
+  static void UpdateZones(const WDL_PtrList<FAUSTFLOAT>& zones, const WDL_PtrList<IParam>& params)
+  {
+    const int n = std::min(zones.GetSize(), params.GetSize());
+    
+    for(auto i = 0; i < n; i++)
+    {
+      *(zones.Get(i)) = (FAUSTFLOAT) params.Get(i)->Value();
+    }
+  }
+  
+  void BuildParameterMap(bool setToDefault = true)
   {
     for(auto p = 0; p < NParams(); p++)
     {
@@ -289,7 +378,7 @@ protected:
     
     if(mIPlugParamStartIdx > -1 && mPlug != nullptr) // if we've allready linked parameters
     {
-      CreateIPlugParameters(mPlug, mIPlugParamStartIdx);
+      CreateIPlugParameters(mPlug, mIPlugParamStartIdx, -1, setToDefault);
     }
     
     for(auto p = 0; p < NParams(); p++)
@@ -298,11 +387,16 @@ protected:
     }
   }
 
-  int FindExistingParameterWithName(const char* name) // TODO: this needs to check meta data too - incase of grouping
+  int FindExistingParameterWithName(const char* name)
   {
-    for(auto p = 0; p < NParams(); p++)
+    return FindParameterWithName(mParams, name);
+  }
+  
+  static int FindParameterWithName(const WDL_PtrList<IParam>& params, const char* name) // TODO: this needs to check meta data too - incase of grouping
+  {
+    for(auto p = 0; p < params.GetSize(); p++)
     {
-      if(strcmp(name, mParams.Get(p)->GetNameForHost()) == 0)
+      if(strcmp(name, params.Get(p)->GetNameForHost()) == 0)
       {
         return p;
       }
@@ -315,9 +409,13 @@ protected:
   WDL_String mName;
   int mNVoices;
   ::dsp* mDSP = nullptr;
+  FaustPolyDSP* mPolyDSP = nullptr; // not owned, this is mDSP if it is polyphonic
+  int mNVoiceRenderThreads = 0;
   MidiUI* mMidiUI = nullptr;
   WDL_PtrList<IParam> mParams;
   WDL_PtrList<FAUSTFLOAT> mZones;
+  WDL_PtrList<IParam>* mpUIParams = &mParams; // buildUserInterface() adds parameters and zones to these lists, FaustGen points them elsewhere to build a new DSP's parameters
+  WDL_PtrList<FAUSTFLOAT>* mpUIZones = &mZones;
   WDL_StringKeyedArray<FAUSTFLOAT*> mMap; // map is used for setting FAUST parameters by name, also used to reconnect existing parameters
   int mIPlugParamStartIdx = -1; // if this is negative, it means there is no linking
   IPlugAPIBase* mPlug = nullptr;
@@ -16,8 +16,6 @@
 #include "IPlugUtilities.h"
 
 #include "faust/dsp/libfaust.h"
-#define LLVM_DSP
-#include "faust/dsp/poly-dsp.h"
 
 //#ifndef OS_WIN
 //#include "faust/sound-file.h"
@@ -46,6 +44,14 @@ FaustGen::Factory::Factory(const char* name, const char* libraryPath, const char
 
 FaustGen::Factory::~Factory()
 {
+  if(mCompileThread.joinable())
+    mCompileThread.join();
+  
+  llvm_dsp_factory* pCompiled = mCompiledFactory.exchange(nullptr);
+  
+  if(pCompiled)
+    deleteDSPFactory(pCompiled);
+  
   FreeDSPFactory();
   mSourceCodeStr.Set("");
   mBitCodeStr.Set("");
@@ -66,6 +72,33 @@ void FaustGen::Factory::FreeDSPFactory()
     deleteDSPFactory(mLLVMFactory); // this is commented in faustgen~
     mLLVMFactory = nullptr;
   }
+  
+  FreeRetiredFactories();
+}
+
+void FaustGen::Factory::FreeRetiredFactories()
+{
+  for (auto it = mRetiredFactories.begin(); it != mRetiredFactories.end();)
+  {
+    bool inUse = false;
+    
+    for (auto inst : mInstances)
+    {
+      if(inst->UsesFactory(*it))
+      {
+        inUse = true;
+        break;
+      }
+    }
+    
+    if(!inUse)
+    {
+      deleteDSPFactory(*it);
+      it = mRetiredFactories.erase(it);
+    }
+    else
+      ++it;
+  }
 }
 
 llvm_dsp_factory* FaustGen::Factory::CreateFactoryFromBitCode()
@@ -85,7 +118,8 @@ llvm_dsp_factory* FaustGen::Factory::CreateFactoryFromBitCode()
   */
 }
 
-llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
+// This may be called on the compile worker thread, so it must not touch the instances
+llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode(std::string& error)
 {
   WDL_String name;
   name.SetFormatted(64, "FaustGen-%d", mInstanceIdx);
@@ -94,7 +128,6 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
   PrintCompileOptions();
 
   // Prepare compile options
-  string error;
   const char* argv[64];
 
   const int N = (int) mCompileOptions.size();
@@ -124,22 +157,10 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
 
   if (pFactory)
   {
-    // Update all instances
-    for (auto inst : mInstances)
-    {
-      inst->SetErrored(false);
-    }
-    
     return pFactory;
   }
   else
   {
-    // Update all instances
-    for (auto inst : mInstances)
-    {
-      inst->SetErrored(true);
-    }
-
     //WHAT IS THIS?
 //    if (mInstances.begin() != mInstances.end())
 //    {
@@ -150,25 +171,10 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
   }
 }
 
-::dsp *FaustGen::Factory::CreateDSPInstance(int nVoices)
+// Polyphony is handled by FaustGen, see IPlugFaust::CreatePolyDSPIfNeeded()
+::dsp *FaustGen::Factory::CreateDSPInstance()
 {
-  ::dsp* pMonoDSP = mLLVMFactory->createDSPInstance();
-
-  // Check 'nvoices' metadata
-  if (nVoices == 0)
-  {
-    FMeta meta;
-    pMonoDSP->metadata(&meta);
-    std::string numVoices = meta.get("nvoices", "0");
-    nVoices = atoi(numVoices.c_str());
-    if (nVoices < 0)
-      nVoices = 0;
-  }
-
-  if (nVoices > 0)
-    return new mydsp_poly(pMonoDSP, nVoices, true);
-  else
-    return pMonoDSP;
+  return mLLVMFactory->createDSPInstance();
 }
 
 ::dsp *FaustGen::Factory::GetDSP(int maxInputs, int maxOutputs)
@@ -201,7 +207,14 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
   // Otherwise tries to create from source code
   if (mSourceCodeStr.GetLength())
   {
-    mLLVMFactory = CreateFactoryFromSourceCode();
+    mLLVMFactory = CreateFactoryFromSourceCode(error);
+    
+    // Update all instances
+    for (auto inst : mInstances)
+    {
+      inst->SetErrored(mLLVMFactory == nullptr);
+    }
+    
     if (mLLVMFactory)
     {
       pDSP = CreateDSPInstance();
@@ -374,6 +387,24 @@ void FaustGen::Factory::RemoveInstance(FaustGen* pDSP)
 }
 
 bool FaustGen::Factory::LoadFile(const char* file)
+{
+  if(ReadFile(file))
+  {
+    // Update all instances
+    for (auto inst : mInstances)
+    {
+      inst->Init();
+    }
+    
+    return true;
+  }
+  
+  assert(0); // The FAUST_BLOCK file was not found
+  
+  return false;
+}
+
+bool FaustGen::Factory::ReadFile(const char* file)
 {
   // Delete the existing Faust module
   //FreeDSPFactory();
@@ -408,20 +439,38 @@ bool FaustGen::Factory::LoadFile(const char* file)
     
     mInputDSPFile.Set(file);
     
-    // Update all instances
-    for (auto inst : mInstances)
-    {
-      inst->Init();
-    }
-    
     return true;
   }
   
-  assert(0); // The FAUST_BLOCK file was not found
-  
   return false;
 }
 
+void FaustGen::Factory::CompileAsync()
+{
+  if(mCompileThread.joinable())
+    mCompileThread.join();
+  
+  mCompiling = true;
+  
+  mCompileThread = std::thread([this]() {
+    std::string error;
+    llvm_dsp_factory* pNewFactory = CreateFactoryFromSourceCode(error);
+    mCompiledFactory.store(pNewFactory);
+    mCompiling.store(false);
+  });
+}
+
+bool FaustGen::Factory::CollectCompiledFactory(llvm_dsp_factory*& pNewFactory)
+{
+  if(mCompiling.load() || !mCompileThread.joinable())
+    return false;
+  
+  mCompileThread.join();
+  pNewFactory = mCompiledFactory.exchange(nullptr);
+  
+  return true;
+}
+
 bool FaustGen::Factory::WriteToFile(const char* file)
 {
   return false;
@@ -498,32 +547,200 @@ FaustGen::~FaustGen()
     mFactory->RemoveInstance(this);
 }
 
+void FaustGen::SetMaxChannelCount(int maxNInputs, int maxNOutputs)
+{
+  mMaxNInputs = maxNInputs;
+  mMaxNOutputs = maxNOutputs;
+  
+  // scratch buffers for the crossfade are allocated here, so that the audio thread doesn't need to
+  mFadeBuffer.Resize(std::max(maxNOutputs, 1) * FAUSTGEN_FADE_CHUNK_SIZE);
+  mFadeInputPtrs.Resize(std::max(maxNInputs, 1));
+  mFadeOutputPtrs.Resize(std::max(maxNOutputs, 1));
+  mFadeBufferPtrs.Resize(std::max(maxNOutputs, 1));
+}
+
 void FaustGen::Init()
 {
-  mZones.Empty(); // remove existing pointers to zones
+  FaustPolyDSP* pPolyDSP = nullptr;
+  ::dsp* pDSP = CreatePolyDSPIfNeeded(mFactory->GetDSP(mMaxNInputs, mMaxNOutputs), pPolyDSP);
+  assert(pDSP);
+
+  Publish(CreateDSPInstance(pDSP, pPolyDSP, false));
+  mInitialized = true;
   
-  mDSP = mFactory->GetDSP(mMaxNInputs, mMaxNOutputs);
-  assert(mDSP);
+  if(mPlug)
+    mPlug->OnParamReset(EParamSource::kRecompile);
+}
 
+FaustGen::DSPInstance* FaustGen::CreateDSPInstance(::dsp* pDSP, FaustPolyDSP* pPolyDSP, bool keepParamValues)
+{
+  DSPInstance* pInstance = new DSPInstance;
+  
+  // build the new DSP's parameters in a list of their own. The current parameters are read by the audio thread until the new DSP is swapped in, so they must not be re-initialised
+  WDL_PtrList<IParam> newParams;
+  mpUIParams = &newParams;
+  mpUIZones = &pInstance->mZones;
+  
 //    AddMidiHandler();
 //    mDSP->buildUserInterface(mMidiUI);
-  mDSP->buildUserInterface(this);
-  mDSP->init(DEFAULT_SAMPLE_RATE);
-
-  assert((mDSP->getNumInputs() <= mMaxNInputs) && (mDSP->getNumOutputs() <= mMaxNOutputs)); // don't have enough buffers to process the DSP
+  pDSP->buildUserInterface(this);
   
-  if ((mFactory->mNInputs != mDSP->getNumInputs()) || (mFactory->mNOutputs != mDSP->getNumOutputs()))
+  mpUIParams = &mParams;
+  mpUIZones = &mZones;
+  
+  assert((pDSP->getNumInputs() <= mMaxNInputs) && (pDSP->getNumOutputs() <= mMaxNOutputs)); // don't have enough buffers to process the DSP
+  
+  if ((mFactory->mNInputs != pDSP->getNumInputs()) || (mFactory->mNOutputs != pDSP->getNumOutputs()))
   {
     //TODO: do something when I/O is wrong
   }
   
-  BuildParameterMap(); // build a new map based on updated code
-  mInitialized = true;
+  // carry over the current values by name. Parameters that didn't change are shared with the running DSP, changed ones start from the current value
+  for(auto p = 0; p < newParams.GetSize(); p++)
+  {
+    IParam* pNewParam = newParams.Get(p);
+    const int existingIdx = keepParamValues ? FindExistingParameterWithName(pNewParam->GetNameForHost()) : -1;
+    
+    if(existingIdx > -1)
+    {
+      IParam* pExistingParam = mParams.Get(existingIdx);
+      
+      if(ParamsMatch(*pExistingParam, *pNewParam))
+      {
+        delete pNewParam;
+        pNewParam = pExistingParam;
+      }
+      else
+        pNewParam->Set(pExistingParam->Value());
+    }
+    
+    pInstance->mParams.Add(pNewParam);
+  }
+  
+  // parameters that were replaced stay alive until no DSP instance uses them
+  for(auto p = 0; p < mParams.GetSize(); p++)
+  {
+    if(pInstance->mParams.Find(mParams.Get(p)) < 0)
+      mRetiredParams.Add(mParams.Get(p));
+  }
+  
+  mParams.Empty();
+  mZones.Empty();
+  
+  for(auto p = 0; p < pInstance->mParams.GetSize(); p++)
+  {
+    mParams.Add(pInstance->mParams.Get(p));
+    mZones.Add(pInstance->mZones.Get(p));
+  }
+  
+  BuildParameterMap(!keepParamValues); // build a new map based on updated code
+  
+  pInstance->mDSP = pDSP;
+  pInstance->mPolyDSP = pPolyDSP;
+  pInstance->mFactory = mFactory->mLLVMFactory;
+  pInstance->mSampleRate = GetDSPSampleRate();
+  pDSP->init((int) pInstance->mSampleRate);
+  
+  UpdateZones(pInstance->mZones, pInstance->mParams);
+
+  return pInstance;
+}
+
+void FaustGen::Publish(DSPInstance* pInstance)
+{
+  mDSP = pInstance->mDSP; // not owned, points at the latest DSP for the benefit of IPlugFaust methods that query it
+  mPolyDSP = pInstance->mPolyDSP;
+  mLiveInstances.Add(pInstance);
+  
+  DSPInstance* pStale = mPending.exchange(pInstance);
+  
+  // a previous DSP that the audio thread never picked up
+  if(pStale)
+    mLiveInstances.Delete(mLiveInstances.Find(pStale), true);
+}
+
+void FaustGen::HotSwap()
+{
+  FaustPolyDSP* pPolyDSP = nullptr;
+  ::dsp* pDSP = CreatePolyDSPIfNeeded(mFactory->CreateDSPInstance(), pPolyDSP);
+  Publish(CreateDSPInstance(pDSP, pPolyDSP, true));
+  SetErrored(false);
   
   if(mPlug)
     mPlug->OnParamReset(EParamSource::kRecompile);
 }
 
+void FaustGen::CollectRetiredDSPs()
+{
+  DSPInstance* pInstance = nullptr;
+  
+  while(mRetired.Pop(pInstance))
+  {
+    mLiveInstances.Delete(mLiveInstances.Find(pInstance), true);
+    
+    DBGMSG("FaustGen-%s: DSP swapped, worst case block time since recompile: %.3f ms\n", mName.Get(), GetWorstCaseBlockTime());
+  }
+  
+  for(auto p = mRetiredParams.GetSize() - 1; p >= 0; p--)
+  {
+    if(!UsesParam(mRetiredParams.Get(p)))
+      mRetiredParams.Delete(p, true);
+  }
+}
+
+bool FaustGen::UsesParam(IParam* pParam) const
+{
+  for(auto i = 0; i < mLiveInstances.GetSize(); i++)
+  {
+    if(mLiveInstances.Get(i)->mParams.Find(pParam) > -1)
+      return true;
+  }
+  
+  return false;
+}
+
+bool FaustGen::UsesFactory(llvm_dsp_factory* pFactory) const
+{
+  for(auto i = 0; i < mLiveInstances.GetSize(); i++)
+  {
+    if(mLiveInstances.Get(i)->mFactory == pFactory)
+      return true;
+  }
+  
+  return false;
+}
+
+void FaustGen::FreeDSP()
+{
+  mActive = nullptr;
+  mFadingOut = nullptr;
+  mPending.store(nullptr);
+  
+  DSPInstance* pInstance = nullptr;
+  while(mRetired.Pop(pInstance)) {}
+  
+  mLiveInstances.Empty(true);
+  mRetiredParams.Empty(true);
+  mDSP = nullptr;
+  mPolyDSP = nullptr;
+}
+
+double FaustGen::GetDSPSampleRate() const
+{
+  int multiplier = 1;
+  
+  if(mOverSampler)
+    multiplier = mOverSampler->GetRate();
+  
+  return ((int) mSampleRate.load()) * multiplier;
+}
+
+void FaustGen::SetSampleRate(double sampleRate)
+{
+  mSampleRate.store(sampleRate);
+  mResetRequested.store(true);
+}
+
 void FaustGen::GetDrawPath(WDL_String& path)
 {
   assert(!CStringHasContents(mFactory->mDrawPath.Get()));
@@ -582,37 +799,77 @@ bool FaustGen::CompileCPP()
   return true;
 }
 
+// Called on the main thread. Compilation happens on the factory's worker thread, so this never blocks for long
 void FaustGen::OnTimer(Timer& timer)
 {
-  WDL_String* pInputFile;
-  bool recompile = false;
+  bool recompiled = false;
 
   for (auto f : Factory::sFactoryMap)
   {
-    pInputFile = &f.second->mInputDSPFile;
+    Factory* pFactory = f.second;
+    llvm_dsp_factory* pNewFactory = nullptr;
+    
+    if(pFactory->CollectCompiledFactory(pNewFactory))
+    {
+      if(pNewFactory)
+      {
+        DBGMSG("FaustGen-%s: JIT compilation succeeded, swapping DSP\n", pFactory->mName.Get());
+        
+        if(pFactory->mLLVMFactory)
+          pFactory->mRetiredFactories.push_back(pFactory->mLLVMFactory);
+        
+        pFactory->mLLVMFactory = pNewFactory;
+        pFactory->mBitCodeStr.Set("");
+        
+        for (auto inst : pFactory->mInstances)
+        {
+          inst->HotSwap();
+        }
+        
+        recompiled = true;
+      }
+      else
+        DBGMSG("FaustGen-%s: JIT compilation failed, keeping the previous DSP\n", pFactory->mName.Get());
+    }
+    
+    for (auto inst : pFactory->mInstances)
+    {
+      inst->CollectRetiredDSPs();
+    }
+    
+    pFactory->FreeRetiredFactories();
+    
+    if(pFactory->IsCompiling())
+      continue; // changes made during a compile are picked up on the next tick after it finishes
+    
+    WDL_String* pInputFile = &pFactory->mInputDSPFile;
     StatType buf;
     GetStat(pInputFile->Get(), &buf);
-    StatTime oldTime = f.second->mPreviousTime;
+    StatTime oldTime = pFactory->mPreviousTime;
     StatTime newTime = GetModifiedTime(buf);
 
     if(!Equal(newTime, oldTime))
     {
-      WDL_MutexLock lock(&mMutex);
-
-      recompile = true;
-      f.second->FreeDSPFactory();
-      DBGMSG("FaustGen-%s: File change detected ----------------------------------\n", mName.Get());
-      DBGMSG("FaustGen-%s: JIT compiling %s\n", mName.Get(), pInputFile->Get());
-      f.second->LoadFile(pInputFile->Get());
-      Init();
+      DBGMSG("FaustGen-%s: File change detected ----------------------------------\n", pFactory->mName.Get());
+      
+      if(pFactory->ReadFile(pInputFile->Get()))
+      {
+        DBGMSG("FaustGen-%s: JIT compiling %s\n", pFactory->mName.Get(), pInputFile->Get());
+        
+        for (auto inst : pFactory->mInstances)
+        {
+          inst->ResetWorstCaseBlockTime();
+        }
+        
+        pFactory->CompileAsync();
+      }
     }
       
-    f.second->mPreviousTime = newTime;
+    pFactory->mPreviousTime = newTime;
   }
 
-  if(recompile)
+  if(recompiled)
   {
-    // TODO: should check for successfull JIT
     DBGMSG("FaustGen-%s: Statically compiling all FAUST blocks\n", mName.Get());
     CompileCPP();
   }
@@ -638,13 +895,130 @@ void FaustGen::SetAutoRecompile(bool enable)
   sAutoRecompile = enable;
 }
 
+void FaustGen::SwapInPendingDSP()
+{
+  // swap in a newly published DSP, unless we are still fading out the last one or there is no room to hand the old one back
+  if(!mFadingOut && mPending.load() && mRetired.ElementsAvailable() < FAUSTGEN_RETIRE_QUEUE_SIZE - 1)
+  {
+    DSPInstance* pNew = mPending.exchange(nullptr);
+    
+    if(pNew)
+    {
+      mFadingOut = mActive;
+      mFadePos = 0;
+      mActive = pNew;
+    }
+  }
+}
+
+void FaustGen::ProcessMidiMsg(const IMidiMsg& msg)
+{
+  SwapInPendingDSP(); // so that messages go to the DSP that will process the next block
+  
+  if(mActive)
+    SendMidiMsgToPolyDSP(mActive->mPolyDSP, msg);
+}
+
 void FaustGen::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
-  WDL_MutexLock lock(&mMutex);
-  if(!mErrored)
-    IPlugFaust::ProcessBlock(inputs, outputs, nFrames);
+  const auto startTime = std::chrono::high_resolution_clock::now();
+  
+  SwapInPendingDSP();
+  
+  if(mActive)
+  {
+    const double sampleRate = GetDSPSampleRate();
+    
+    if(mResetRequested.exchange(false) || mActive->mSampleRate != sampleRate)
+    {
+      mActive->mSampleRate = sampleRate;
+      mActive->mDSP->init((int) sampleRate);
+      
+      if(mFadingOut) // no point fading from a DSP that is running at the wrong rate
+      {
+        mRetired.Push(mFadingOut);
+        mFadingOut = nullptr;
+      }
+    }
+  }
+  
+  if(!mErrored && mActive)
+  {
+    UpdateZones(mActive->mZones, mActive->mParams);
+    
+    if(mOverSampler)
+      mOverSampler->ProcessBlock(inputs, outputs, nFrames, 1 /* DOESN'T YET WORK WITH MC */,
+                                 [&](sample** inputs, sample** outputs, int nFrames)
+                                 {
+                                   Compute(inputs, outputs, nFrames);
+                                 });
+    else
+      Compute(inputs, outputs, nFrames);
+  }
   else
-    memset(outputs[0], 0, nFrames * mMaxNOutputs * sizeof(sample));
+  {
+    for (auto c = 0; c < mMaxNOutputs; c++)
+      memset(outputs[c], 0, nFrames * sizeof(sample));
+  }
+  
+  const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+  
+  if(elapsed > mWorstCaseBlockTime.load())
+    mWorstCaseBlockTime.store(elapsed);
+}
+
+void FaustGen::Compute(sample** inputs, sample** outputs, int nFrames)
+{
+  if(!mFadingOut)
+  {
+    mActive->mDSP->compute(nFrames, inputs, outputs);
+    return;
+  }
+  
+  // crossfade from the old DSP to the new one, the old one is rendered to scratch buffers in chunks
+  const int nNewOutputs = mActive->mDSP->getNumOutputs();
+  const int nOldOutputs = mFadingOut->mDSP->getNumOutputs();
+  // only offset the input channels the host gave us and one of the DSPs reads, instruments get no input pointers at all
+  const int nInputs = std::min(mMaxNInputs, std::max(mActive->mDSP->getNumInputs(), mFadingOut->mDSP->getNumInputs()));
+  sample** pInputs = nInputs > 0 ? mFadeInputPtrs.Get() : nullptr;
+  
+  for (auto s = 0; s < nFrames; s += FAUSTGEN_FADE_CHUNK_SIZE)
+  {
+    const int chunkSize = std::min(nFrames - s, FAUSTGEN_FADE_CHUNK_SIZE);
+    
+    for (auto c = 0; c < nInputs; c++)
+      mFadeInputPtrs.Get()[c] = inputs[c] + s;
+    
+    for (auto c = 0; c < nNewOutputs; c++)
+      mFadeOutputPtrs.Get()[c] = outputs[c] + s;
+    
+    for (auto c = 0; c < nOldOutputs; c++)
+      mFadeBufferPtrs.Get()[c] = mFadeBuffer.Get() + (c * FAUSTGEN_FADE_CHUNK_SIZE);
+    
+    // the old DSP runs first, in case inputs and outputs are the same buffers
+    mFadingOut->mDSP->compute(chunkSize, pInputs, mFadeBufferPtrs.Get());
+    mActive->mDSP->compute(chunkSize, pInputs, mFadeOutputPtrs.Get());
+    
+    for (auto c = 0; c < nNewOutputs; c++)
+    {
+      sample* pOut = mFadeOutputPtrs.Get()[c];
+      const sample* pOld = mFadeBufferPtrs.Get()[c];
+      
+      for (auto i = 0; i < chunkSize; i++)
+      {
+        const sample gain = (sample) std::min(mFadePos + i, FAUSTGEN_CROSSFADE_SAMPLES) / (sample) FAUSTGEN_CROSSFADE_SAMPLES;
+        pOut[i] = pOut[i] * gain + (c < nOldOutputs ? pOld[i] * (1. - gain) : 0.);
+      }
+    }
+    
+    mFadePos += chunkSize;
+  }
+  
+  if(mFadePos >= FAUSTGEN_CROSSFADE_SAMPLES)
+  {
+    mRetired.Push(mFadingOut);
+    mFadingOut = nullptr;
+  }
 }
 
 #endif // #ifndef FAUST_COMPILED
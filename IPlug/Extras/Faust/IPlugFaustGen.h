@@ -26,6 +26,9 @@ typedef IPlugFaust FaustGen; // not used, except for CompileCPP();
 #include <set>
 #include <vector>
 #include <map>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 #include "IPlugPlatform.h"
 #include "IPlugConstants.h"
@@ -61,8 +64,10 @@ static inline Time TimeZero() { return (Time) 0; }
 #include "faust/dsp/llvm-dsp.h"
 #include "IPlugFaust.h"
 #include "IPlugTimer.h"
+#include "IPlugQueue.h"
 
 #include "mutex.h"
+#include "heapbuf.h"
 
 #ifndef OS_WIN
 #include <libgen.h>
@@ -77,6 +82,14 @@ static inline Time TimeZero() { return (Time) 0; }
 #define FAUST_CLASS_PREFIX "F"
 #define FAUST_RECOMPILE_INTERVAL 5000 //ms
 
+/** The length of the crossfade between the old and the new DSP, when a recompiled DSP is swapped in (in samples at the DSP rate) */
+#ifndef FAUSTGEN_CROSSFADE_SAMPLES
+#define FAUSTGEN_CROSSFADE_SAMPLES 1024
+#endif
+
+#define FAUSTGEN_FADE_CHUNK_SIZE 256
+#define FAUSTGEN_RETIRE_QUEUE_SIZE 16
+
 #ifndef FAUST_EXE
   #define FAUST_EXE "/usr/local/bin/faust"
 #endif
@@ -109,7 +122,7 @@ class FaustGen : public IPlugFaust
     ~Factory();
 
     llvm_dsp_factory* CreateFactoryFromBitCode();
-    llvm_dsp_factory* CreateFactoryFromSourceCode();
+    llvm_dsp_factory* CreateFactoryFromSourceCode(std::string& error);
     
     
     /** If DSP allready exists will return it, otherwise create it
@@ -126,12 +139,26 @@ class FaustGen : public IPlugFaust
 
     void UpdateSourceCode(const char* str);
 
-    ::dsp* CreateDSPInstance(int nVoices = 0);
+    ::dsp* CreateDSPInstance();
     void AddInstance(FaustGen* pDSP) { mInstances.insert(pDSP); }
     void RemoveInstance(FaustGen* pDSP);
 
     bool LoadFile(const char* file);
+    bool ReadFile(const char* file);
     bool WriteToFile(const char* file);
+
+    /** Compile the current source code on a worker thread. The running DSP is left untouched */
+    void CompileAsync();
+
+    /** Check whether a worker thread compile has finished. Call on the main thread.
+     * @param pNewFactory Set to the new LLVM factory, or nullptr if compilation failed
+     * @return \c true if a compile job finished since the last call */
+    bool CollectCompiledFactory(llvm_dsp_factory*& pNewFactory);
+
+    /** Delete LLVM factories that were replaced by a recompile, once no instance is using DSP created by them */
+    void FreeRetiredFactories();
+
+    bool IsCompiling() const { return mCompiling.load(); }
     void SetCompileOptions(std::initializer_list<const char*> options);
 
   private:
@@ -171,6 +198,10 @@ class FaustGen : public IPlugFaust
     set<FaustGen*> mInstances;
 
     llvm_dsp_factory* mLLVMFactory = nullptr;
+    vector<llvm_dsp_factory*> mRetiredFactories;
+    std::thread mCompileThread;
+    std::atomic<bool> mCompiling {false};
+    std::atomic<llvm_dsp_factory*> mCompiledFactory {nullptr};
     //  midi_handler mMidiHandler;
     WDL_FastString mSourceCodeStr;
     WDL_FastString mBitCodeStr;
@@ -200,11 +231,12 @@ public:
   /** Call this method after constructing the class to inform FaustGen what the maximum I/O count is
    * @param maxNInputs Specify a number here to tell FaustGen the maximum number of inputs the hosting code can accommodate
    * @param maxNOutputs Specify a number here to tell FaustGen the maximum number of outputs the hosting code can accommodate */
-  void SetMaxChannelCount(int maxNInputs, int maxNOutputs) override { mMaxNInputs = maxNInputs; mMaxNOutputs = maxNOutputs; }
+  void SetMaxChannelCount(int maxNInputs, int maxNOutputs) override;
   
   /** Call this method after constructing the class to JIT compile */
   void Init() override;
 
+  /** Synchronously load and compile a file. Must not be called while audio is being processed, SetAutoRecompile() hot-swaps changes safely */
   void LoadFile(const char* path) { mFactory->FreeDSPFactory(); mFactory->LoadFile(path); }
   
   /** This method allows SVG files generated by a specific instance of FaustGen can be located. The path to the SVG file for process.svg will be returned, if drawPath has been specified in the constructor.
@@ -216,24 +248,79 @@ public:
    * @return \c true on success */
   static bool CompileCPP();
 
+  /** When enabled, .dsp files are checked for changes every FAUST_RECOMPILE_INTERVAL ms. Changed files are JIT compiled on a worker thread,
+   * then the new DSP is crossfaded in on the audio thread, carrying over the current parameter values */
   void SetAutoRecompile(bool enable);
   
   void OnTimer(Timer& timer);
   
+  /** Call this from OnReset(). The DSP will be re-initialised on the audio thread at the start of the next block */
+  void SetSampleRate(double sampleRate);
+  
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   
+  void ProcessMidiMsg(const IMidiMsg& msg) override;
+  
   void SetErrored(bool errored) { mErrored = errored; }
   
+  /** Frees all DSP instances owned by this FaustGen. Must not be called while audio is being processed */
+  void FreeDSP();
+  
+  /** @return The longest ProcessBlock() call in milliseconds since the last call to ResetWorstCaseBlockTime(). Used to check that recompiles don't disturb the audio thread */
+  double GetWorstCaseBlockTime() const { return mWorstCaseBlockTime.load(); }
+  
+  void ResetWorstCaseBlockTime() { mWorstCaseBlockTime.store(0.); }
+
 private:
+  /** A DSP created from a particular LLVM factory, along with the zones and IPlug parameters linked to it.
+   * It is built on the main thread, owned by the audio thread once swapped in, and handed back to the main thread to be deleted */
+  struct DSPInstance
+  {
+    ~DSPInstance() { delete mDSP; }
+    
+    ::dsp* mDSP = nullptr;
+    FaustPolyDSP* mPolyDSP = nullptr; // not owned, this is mDSP if it is polyphonic
+    llvm_dsp_factory* mFactory = nullptr;
+    WDL_PtrList<FAUSTFLOAT> mZones;
+    WDL_PtrList<IParam> mParams; // not owned, these are IPlugFaust::mParams, or were until a recompile replaced them (see mRetiredParams)
+    double mSampleRate = 0.;
+  };
+  
+  DSPInstance* CreateDSPInstance(::dsp* pDSP, FaustPolyDSP* pPolyDSP, bool keepParamValues);
+  void Publish(DSPInstance* pInstance);
+  void HotSwap();
+  void CollectRetiredDSPs();
+  bool UsesParam(IParam* pParam) const;
+  bool UsesFactory(llvm_dsp_factory* pFactory) const;
+  double GetDSPSampleRate() const;
+  void SwapInPendingDSP();
+  void Compute(sample** inputs, sample** outputs, int nFrames);
+
   Factory* mFactory = nullptr;
   static Timer* sTimer;
   static int sFaustGenCounter;
   static bool sAutoRecompile;
   int mMaxNInputs = -1;
   int mMaxNOutputs = -1;
-  bool mErrored = false;
+  std::atomic<bool> mErrored {false};
+  
+  std::atomic<double> mSampleRate {DEFAULT_SAMPLE_RATE};
+  std::atomic<bool> mResetRequested {false};
+  
+  DSPInstance* mActive = nullptr; // only touched by the audio thread
+  DSPInstance* mFadingOut = nullptr; // only touched by the audio thread
+  int mFadePos = 0;
+  std::atomic<DSPInstance*> mPending {nullptr};
+  IPlugQueue<DSPInstance*> mRetired {FAUSTGEN_RETIRE_QUEUE_SIZE};
+  WDL_PtrList<DSPInstance> mLiveInstances; // all instances that have been published and not yet deleted, only touched by the main thread
+  WDL_PtrList<IParam> mRetiredParams; // parameters replaced by a recompile, deleted once no live instance uses them
+  
+  WDL_TypedBuf<sample> mFadeBuffer;
+  WDL_TypedBuf<sample*> mFadeInputPtrs;
+  WDL_TypedBuf<sample*> mFadeOutputPtrs;
+  WDL_TypedBuf<sample*> mFadeBufferPtrs;
   
-  WDL_Mutex mMutex;
+  std::atomic<double> mWorstCaseBlockTime {0.};
 };
 
 #endif // #ifndef FAUST_COMPILED
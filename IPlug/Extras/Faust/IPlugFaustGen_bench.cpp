@@ -0,0 +1,202 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of the audio thread while FaustGen recompiles and hot-swaps a DSP
+ *
+ * An audio thread calls FaustGen::ProcessBlock() at the pace of a real device, while the main thread rewrites a .dsp file -n times and calls
+ * FaustGen::OnTimer() every 10 ms, as the recompile timer would. For each recompile this prints the time until the new DSP is heard,
+ * the worst case block time measured here and by FaustGen::GetWorstCaseBlockTime(), and the number of samples where a parameter value glitched.
+ * The DSP outputs the sum of its sliders on the first channel, and the version of the code on the second. "gain" and the -p extra sliders
+ * are the same in every version, so they are carried over as they are. The range of "offset" changes in every version, so it is replaced.
+ * All of them are set away from their defaults, so a parameter that is reset during a swap shows up on the first channel.
+ *
+ * FaustGen currently builds on macOS only. Build with libfaust installed:
+ *
+ *   clang++ -O2 -std=c++14 -DOS_MAC -DBENCH_API -DNO_IGRAPHICS -DNOMINMAX -IIPlug -IIPlug/Extras -IIPlug/Extras/Faust -IWDL -I/usr/local/include \
+ *     IPlug/Extras/Faust/IPlugFaustGen_bench.cpp IPlug/Extras/Faust/IPlugFaustGen.cpp IPlug/IPlugParameter.cpp IPlug/IPlugPluginBase.cpp -L/usr/local/lib -lfaust -o faustgenbench
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "IPlugFaustGen.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_GAIN 0.8
+#define BENCH_OFFSET 0.1
+#define BENCH_EXTRA 0.01
+
+static bool WriteDSPFile(const char* path, int version, int nExtraParams)
+{
+  FILE* fp = fopen(path, "w");
+
+  if (!fp)
+    return false;
+
+  fprintf(fp, "import(\"stdfaust.lib\");\n");
+  fprintf(fp, "gain = hslider(\"gain\", 0.5, 0, 1, 0.01);\n");
+  fprintf(fp, "offset = hslider(\"offset\", 0, 0, %d, 0.01);\n", 1 + version);
+  fprintf(fp, "process = gain + offset");
+
+  for (auto p = 0; p < nExtraParams; p++)
+    fprintf(fp, " + hslider(\"p%d\", 0, 0, 1, 0.01)", p);
+
+  fprintf(fp, ", %d;\n", version);
+  fclose(fp);
+  return true;
+}
+
+static double NowMs()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char* argv[])
+{
+  int nRecompiles = 20;
+  int blockSize = 64;
+  int nExtraParams = 512; // a wider window for the audio thread to catch a parameter being reset
+  double timeoutMs = 10000.;
+  const char* path = "/tmp/faustgen_bench.dsp";
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nRecompiles = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      blockSize = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      nExtraParams = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      timeoutMs = 1000. * atof(argv[++i]);
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      path = argv[++i];
+    else
+    {
+      printf("usage: %s [-n recompiles] [-b block size] [-p extra parameters] [-t seconds to wait for each swap] [-f .dsp file to write]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (!WriteDSPFile(path, 0, nExtraParams))
+  {
+    printf("could not write %s\n", path);
+    return 1;
+  }
+
+  FaustGen faust("bench", path);
+  faust.SetMaxChannelCount(0, 2); // like an instrument, the host passes no input channels
+  faust.Init();
+  faust.SetSampleRate(BENCH_SAMPLE_RATE);
+  faust.SetParameterValue("gain", BENCH_GAIN);
+  faust.SetParameterValue("offset", BENCH_OFFSET);
+
+  for (auto p = 0; p < nExtraParams; p++)
+  {
+    WDL_String name;
+    name.SetFormatted(32, "p%d", p);
+    faust.SetParameterValue(name.Get(), BENCH_EXTRA);
+  }
+
+  const double expected = BENCH_GAIN + BENCH_OFFSET + nExtraParams * BENCH_EXTRA;
+
+  std::vector<sample> outBuf(2 * blockSize);
+  sample* outputs[2] = { outBuf.data(), outBuf.data() + blockSize };
+
+  std::atomic<bool> running {true};
+  std::atomic<int> heardVersion {0};
+  std::atomic<int> glitches {0};
+  std::atomic<double> worstBlockMs {0.};
+
+  // the audio thread, paced like a device
+  std::thread audio([&]() {
+    const double blockMs = 1000. * blockSize / BENCH_SAMPLE_RATE;
+    double deadline = NowMs();
+
+    while (running)
+    {
+      deadline += blockMs;
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(std::max(0., deadline - NowMs())));
+
+      const double start = NowMs();
+      faust.ProcessBlock(nullptr, outputs, blockSize);
+      const double elapsed = NowMs() - start;
+
+      if (elapsed > worstBlockMs.load())
+        worstBlockMs.store(elapsed);
+
+      for (auto s = 0; s < blockSize; s++)
+      {
+        if (std::fabs(outputs[0][s] - expected) > 1e-6)
+          glitches++;
+      }
+
+      heardVersion.store((int) std::lround(outputs[1][blockSize - 1]));
+    }
+  });
+
+  Timer* pTimer = Timer::Create(nullptr, 10);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  printf("worst case block time before recompiling: %.3f ms, %d glitched samples\n\n", worstBlockMs.load(), glitches.load());
+  printf("%8s %12s %20s %24s %10s\n", "version", "swap ms", "worst block ms", "GetWorstCaseBlockTime", "glitches");
+
+  double sumWorst = 0., maxWorst = 0.;
+  int totalGlitches = glitches.exchange(0);
+  int failed = 0;
+
+  for (auto v = 1; v <= nRecompiles; v++)
+  {
+    worstBlockMs.store(0.);
+    WriteDSPFile(path, v, nExtraParams);
+    const double start = NowMs();
+
+    while (heardVersion.load() != v && NowMs() - start < timeoutMs)
+    {
+      faust.OnTimer(*pTimer);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // let the crossfade finish and the old DSP be collected
+    for (auto i = 0; i < 10; i++)
+    {
+      faust.OnTimer(*pTimer);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    if (heardVersion.load() != v)
+    {
+      printf("%8d timed out\n", v);
+      failed++;
+      continue;
+    }
+
+    const int nGlitches = glitches.exchange(0);
+    totalGlitches += nGlitches;
+    sumWorst += worstBlockMs.load();
+    maxWorst = std::max(maxWorst, worstBlockMs.load());
+    printf("%8d %12.1f %20.3f %24.3f %10d\n", v, NowMs() - start, worstBlockMs.load(), faust.GetWorstCaseBlockTime(), nGlitches);
+  }
+
+  running = false;
+  audio.join();
+  faust.FreeDSP();
+  delete pTimer;
+
+  printf("\nworst case block time during a recompile: mean %.3f ms, max %.3f ms (block is %.3f ms), %d glitched samples\n",
+         sumWorst / std::max(1, nRecompiles - failed), maxWorst, 1000. * blockSize / BENCH_SAMPLE_RATE, totalGlitches);
+
+  return (failed || totalGlitches) ? 1 : 0;
+}
@@ -0,0 +1,540 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc FaustPolyDSP
+ */
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cassert>
+
+#include "heapbuf.h"
+
+#include "MidiSynth.h"
+
+#define FAUST_POLY_MAX_BLOCK_SIZE 512
+#define FAUST_POLY_MAX_SEGMENTS 64
+#define FAUST_POLY_MAX_CHANNELS 64
+
+/** A voice is considered finished once its output stays below this level for FAUST_POLY_SILENCE_SAMPLES after the gate is released */
+#define FAUST_POLY_SILENCE_THRESHOLD 0.00001
+#define FAUST_POLY_SILENCE_SAMPLES 512
+
+/** Collects the UI description of a FAUST DSP, so that it can be replayed to another UI or used to pair the zones of DSP clones */
+class FaustUICollector : public UI
+{
+public:
+  enum EItemType { kOpenTabBox, kOpenHorizontalBox, kOpenVerticalBox, kCloseBox, kButton, kCheckButton, kVSlider, kHSlider, kNumEntry, kHBargraph, kVBargraph };
+
+  struct Item
+  {
+    EItemType type;
+    std::string label;
+    FAUSTFLOAT* zone;
+    FAUSTFLOAT init, min, max, step;
+  };
+
+  void openTabBox(const char* label) override { Add(kOpenTabBox, label); }
+  void openHorizontalBox(const char* label) override { Add(kOpenHorizontalBox, label); }
+  void openVerticalBox(const char* label) override { Add(kOpenVerticalBox, label); }
+  void closeBox() override { Add(kCloseBox, ""); }
+  void addButton(const char* label, FAUSTFLOAT* zone) override { Add(kButton, label, zone); }
+  void addCheckButton(const char* label, FAUSTFLOAT* zone) override { Add(kCheckButton, label, zone); }
+  void addVerticalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) override { Add(kVSlider, label, zone, init, min, max, step); }
+  void addHorizontalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) override { Add(kHSlider, label, zone, init, min, max, step); }
+  void addNumEntry(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) override { Add(kNumEntry, label, zone, init, min, max, step); }
+  void addHorizontalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max) override { Add(kHBargraph, label, zone, 0., min, max); }
+  void addVerticalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max) override { Add(kVBargraph, label, zone, 0., min, max); }
+  void addSoundfile(const char* label, const char* filename, Soundfile** sf_zone) override {}
+
+  /** Replay the collected items to another UI
+   * @param pUI The UI to build
+   * @param filter Items for which this returns \c true are skipped */
+  void Replay(UI* pUI, const std::function<bool(const Item&)>& filter) const
+  {
+    for (auto& item : mItems)
+    {
+      if(filter && filter(item))
+        continue;
+
+      const char* label = item.label.c_str();
+
+      switch (item.type)
+      {
+        case kOpenTabBox: pUI->openTabBox(label); break;
+        case kOpenHorizontalBox: pUI->openHorizontalBox(label); break;
+        case kOpenVerticalBox: pUI->openVerticalBox(label); break;
+        case kCloseBox: pUI->closeBox(); break;
+        case kButton: pUI->addButton(label, item.zone); break;
+        case kCheckButton: pUI->addCheckButton(label, item.zone); break;
+        case kVSlider: pUI->addVerticalSlider(label, item.zone, item.init, item.min, item.max, item.step); break;
+        case kHSlider: pUI->addHorizontalSlider(label, item.zone, item.init, item.min, item.max, item.step); break;
+        case kNumEntry: pUI->addNumEntry(label, item.zone, item.init, item.min, item.max, item.step); break;
+        case kHBargraph: pUI->addHorizontalBargraph(label, item.zone, item.min, item.max); break;
+        case kVBargraph: pUI->addVerticalBargraph(label, item.zone, item.min, item.max); break;
+        default: break;
+      }
+    }
+  }
+
+  /** @return The zone of the first item with this label, or nullptr */
+  FAUSTFLOAT* FindZone(const char* label) const
+  {
+    for (auto& item : mItems)
+    {
+      if(item.zone && item.label == label)
+        return item.zone;
+    }
+
+    return nullptr;
+  }
+
+  std::vector<Item> mItems;
+
+private:
+  void Add(EItemType type, const char* label, FAUSTFLOAT* zone = nullptr, FAUSTFLOAT init = 0., FAUSTFLOAT min = 0., FAUSTFLOAT max = 0., FAUSTFLOAT step = 0.)
+  {
+    mItems.push_back({type, label, zone, init, min, max, step});
+  }
+};
+
+/** A SynthVoice that runs a clone of a FAUST DSP. The DSP's "freq", "gate" and "gain" zones are driven by the VoiceAllocator, following the FAUST polyphony conventions.
+ * Work is recorded as segments, which are either rendered straight away or later on by the FaustPolyDSP render threads */
+class FaustVoice : public SynthVoice
+{
+public:
+  FaustVoice(::dsp* pDSP, int nOutputs)
+  : mDSP(pDSP)
+  , mNOutputs(nOutputs)
+  {
+    mDSP->buildUserInterface(&mUI);
+    mFreqZone = mUI.FindZone("freq");
+    mGateZone = mUI.FindZone("gate");
+    mGainZone = mUI.FindZone("gain");
+
+    mBuffer.Resize(std::max(nOutputs, 1) * FAUST_POLY_MAX_BLOCK_SIZE);
+    mBufferPtrs.Resize(std::max(nOutputs, 1));
+
+    for (auto c = 0; c < nOutputs; c++)
+      mBufferPtrs.Get()[c] = mBuffer.Get() + (c * FAUST_POLY_MAX_BLOCK_SIZE);
+  }
+
+  ~FaustVoice()
+  {
+    delete mDSP;
+  }
+
+  bool GetBusy() const override
+  {
+    return mGateOn || mReleasing;
+  }
+
+  void Trigger(double level, bool isRetrigger) override
+  {
+    mLevel = level;
+    mRetrigger = mGateOn || mReleasing; // the gate must go low for a sample, so that envelopes restart
+    mGateOn = true;
+    mReleasing = false;
+    mSilentSamples = 0;
+  }
+
+  void Release() override
+  {
+    if(!GetBusy()) // e.g. SoftKillAllVoices() on a voice that never played, which would otherwise render silence until it is detected
+      return;
+
+    mGateOn = false;
+    mReleasing = true;
+    mSilentSamples = 0;
+  }
+
+  void SetSampleRate(double sampleRate) override
+  {
+    mDSP->init((int) sampleRate);
+  }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    if(mNSegments == FAUST_POLY_MAX_SEGMENTS)
+    {
+      Render(inputs);
+      Accumulate(outputs, nOutputs);
+    }
+
+    Segment& seg = mSegments[mNSegments++];
+    seg.startIdx = startIdx;
+    seg.nFrames = nFrames;
+    seg.freq = 440. * pow(2., mInputs[kVoiceControlPitch].endValue + mInputs[kVoiceControlPitchBend].endValue);
+    seg.gate = mGateOn ? 1. : 0.;
+    seg.gain = mLevel * mGain;
+    seg.retrigger = mRetrigger;
+    mRetrigger = false;
+
+    if(!mDeferred)
+    {
+      Render(inputs);
+      Accumulate(outputs, nOutputs);
+    }
+  }
+
+  /** Render any recorded segments into the voice buffer. Safe to call from a render thread */
+  void Render(sample** inputs)
+  {
+    for (auto s = mNRendered; s < mNSegments; s++)
+    {
+      const Segment& seg = mSegments[s];
+
+      if(mFreqZone) *mFreqZone = seg.freq;
+      if(mGainZone) *mGainZone = seg.gain;
+
+      int offset = 0;
+
+      if(seg.retrigger && mGateZone)
+      {
+        *mGateZone = 0.;
+        Compute(inputs, seg.startIdx, 1);
+        offset = 1;
+      }
+
+      if(mGateZone) *mGateZone = seg.gate;
+
+      Compute(inputs, seg.startIdx + offset, seg.nFrames - offset);
+      UpdateSilence(seg.startIdx, seg.nFrames);
+    }
+
+    mNRendered = mNSegments;
+  }
+
+  /** Add the rendered segments to the output and clear the segment list. Only called on the audio thread */
+  void Accumulate(sample** outputs, int nOutputs)
+  {
+    const int nChans = std::min(nOutputs, mNOutputs);
+
+    for (auto s = 0; s < mNRendered; s++)
+    {
+      const Segment& seg = mSegments[s];
+
+      for (auto c = 0; c < nChans; c++)
+      {
+        const sample* pIn = mBufferPtrs.Get()[c] + seg.startIdx;
+        sample* pOut = outputs[c] + seg.startIdx;
+
+        for (auto i = 0; i < seg.nFrames; i++)
+          pOut[i] += pIn[i];
+      }
+    }
+
+    mNSegments = mNRendered = 0;
+  }
+
+  bool HasWork() const { return mNSegments > 0; }
+  void SetDeferred(bool deferred) { mDeferred = deferred; }
+  FaustUICollector& GetUI() { return mUI; }
+
+private:
+  struct Segment
+  {
+    int startIdx;
+    int nFrames;
+    FAUSTFLOAT freq;
+    FAUSTFLOAT gate;
+    FAUSTFLOAT gain;
+    bool retrigger;
+  };
+
+  void Compute(sample** inputs, int startIdx, int nFrames)
+  {
+    if(nFrames <= 0)
+      return;
+
+    sample* ins[FAUST_POLY_MAX_CHANNELS];
+    sample* outs[FAUST_POLY_MAX_CHANNELS];
+    const int nIns = std::min(mDSP->getNumInputs(), FAUST_POLY_MAX_CHANNELS);
+    const int nOuts = std::min(mNOutputs, FAUST_POLY_MAX_CHANNELS);
+
+    for (auto c = 0; c < nIns; c++)
+      ins[c] = inputs[c] + startIdx;
+
+    for (auto c = 0; c < nOuts; c++)
+      outs[c] = mBufferPtrs.Get()[c] + startIdx;
+
+    mDSP->compute(nFrames, ins, outs);
+  }
+
+  void UpdateSilence(int startIdx, int nFrames)
+  {
+    if(!mReleasing)
+      return;
+
+    sample peak = 0.;
+
+    for (auto c = 0; c < mNOutputs; c++)
+    {
+      const sample* pBuf = mBufferPtrs.Get()[c] + startIdx;
+
+      for (auto i = 0; i < nFrames; i++)
+        peak = std::max(peak, (sample) std::fabs(pBuf[i]));
+    }
+
+    if(peak < FAUST_POLY_SILENCE_THRESHOLD)
+      mSilentSamples += nFrames;
+    else
+      mSilentSamples = 0;
+
+    if(mSilentSamples >= FAUST_POLY_SILENCE_SAMPLES)
+      mReleasing = false;
+  }
+
+  ::dsp* mDSP;
+  FaustUICollector mUI;
+  FAUSTFLOAT* mFreqZone = nullptr;
+  FAUSTFLOAT* mGateZone = nullptr;
+  FAUSTFLOAT* mGainZone = nullptr;
+  int mNOutputs;
+  WDL_TypedBuf<sample> mBuffer;
+  WDL_TypedBuf<sample*> mBufferPtrs;
+  Segment mSegments[FAUST_POLY_MAX_SEGMENTS];
+  int mNSegments = 0;
+  int mNRendered = 0;
+  double mLevel = 0.;
+  int mSilentSamples = 0;
+  bool mGateOn = false;
+  bool mReleasing = false;
+  bool mRetrigger = false;
+  bool mDeferred = false;
+};
+
+/** A FAUST DSP that plays N clones of a monophonic FAUST DSP as voices of a MidiSynth.
+ * It exposes the UI of the monophonic DSP, minus the "freq", "gate" and "gain" controls. The zones of that UI are copied to every voice before each block,
+ * and voices that are not busy are skipped. Voices can optionally be rendered in parallel on a pool of threads.
+ * Because it is a ::dsp itself, IPlugFaust and FaustGen treat it like any other DSP.
+ * NOTE: MidiSynth.cpp and VoiceAllocator.cpp must be compiled in your project */
+class FaustPolyDSP : public ::dsp
+{
+public:
+  /** @param pMonoDSP The DSP to clone for each voice. FaustPolyDSP takes ownership of it
+   * @param nVoices The number of voices
+   * @param nRenderThreads If this is more than 1, voices are rendered in parallel by this many threads, including the audio thread */
+  FaustPolyDSP(::dsp* pMonoDSP, int nVoices, int nRenderThreads = 0)
+  : mMonoDSP(pMonoDSP)
+  , mSynth(VoiceAllocator::kPolyModePoly)
+  {
+    assert(nVoices <= kMaxJobs);
+    mMonoDSP->buildUserInterface(&mUI);
+
+    for (auto v = 0; v < nVoices; v++)
+    {
+      FaustVoice* pVoice = new FaustVoice(mMonoDSP->clone(), mMonoDSP->getNumOutputs());
+      pVoice->SetDeferred(nRenderThreads > 1);
+      mVoices.push_back(pVoice);
+      mSynth.AddVoice(pVoice, 0);
+    }
+
+    mVoiceJobs.resize(nVoices);
+
+    for (auto t = 1; t < nRenderThreads; t++)
+      mRenderThreads.push_back(std::thread(&FaustPolyDSP::RenderThreadLoop, this));
+  }
+
+  ~FaustPolyDSP()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mRenderMutex);
+      mQuit = true;
+    }
+
+    mRenderCV.notify_all();
+
+    for (auto& t : mRenderThreads)
+      t.join();
+
+    for (auto pVoice : mVoices)
+      delete pVoice;
+
+    delete mMonoDSP;
+  }
+
+  /** Queue a MIDI message for the voices. Call on the audio thread before compute() */
+  void ProcessMidiMsg(const IMidiMsg& msg)
+  {
+    mSynth.AddMidiMsgToQueue(msg);
+  }
+
+  int getNumInputs() override { return mMonoDSP->getNumInputs(); }
+  int getNumOutputs() override { return mMonoDSP->getNumOutputs(); }
+  int getSampleRate() override { return mMonoDSP->getSampleRate(); }
+
+  void buildUserInterface(UI* pUI) override
+  {
+    mUI.Replay(pUI, [](const FaustUICollector::Item& item) {
+      return item.label == "freq" || item.label == "gate" || item.label == "gain";
+    });
+  }
+
+  void init(int sampleRate) override
+  {
+    mMonoDSP->init(sampleRate);
+    mSynth.SetSampleRateAndBlockSize(sampleRate, FAUST_POLY_MAX_BLOCK_SIZE); // calls init() on each voice
+  }
+
+  void instanceInit(int sampleRate) override
+  {
+    mMonoDSP->instanceInit(sampleRate);
+    mSynth.SetSampleRateAndBlockSize(sampleRate, FAUST_POLY_MAX_BLOCK_SIZE);
+  }
+
+  void instanceConstants(int sampleRate) override { mMonoDSP->instanceConstants(sampleRate); }
+  void instanceResetUserInterface() override { mMonoDSP->instanceResetUserInterface(); }
+  void instanceClear() override { mSynth.Reset(); }
+  void metadata(Meta* pMeta) override { mMonoDSP->metadata(pMeta); }
+
+  ::dsp* clone() override { return new FaustPolyDSP(mMonoDSP->clone(), (int) mVoices.size(), (int) mRenderThreads.size() + 1); }
+
+  void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) override
+  {
+    const int nInputs = getNumInputs();
+    const int nOutputs = getNumOutputs();
+
+    for (auto c = 0; c < nOutputs; c++)
+      memset(outputs[c], 0, count * sizeof(FAUSTFLOAT));
+
+    UpdateVoiceZones();
+
+    for (auto s = 0; s < count; s += FAUST_POLY_MAX_BLOCK_SIZE)
+    {
+      const int blockSize = std::min(count - s, FAUST_POLY_MAX_BLOCK_SIZE);
+
+      for (auto c = 0; c < nInputs && c < FAUST_POLY_MAX_CHANNELS; c++)
+        mInputPtrs[c] = inputs[c] + s;
+
+      for (auto c = 0; c < nOutputs && c < FAUST_POLY_MAX_CHANNELS; c++)
+        mOutputPtrs[c] = outputs[c] + s;
+
+      mSynth.ProcessBlock(mInputPtrs, mOutputPtrs, nInputs, nOutputs, blockSize);
+
+      if(mRenderThreads.size())
+        RenderVoices(nOutputs);
+    }
+  }
+
+private:
+  /** Copy the values of the shared controls to every voice, including idle ones that may be triggered during this block. Items are paired by position, since the voices are clones */
+  void UpdateVoiceZones()
+  {
+    for (auto pVoice : mVoices)
+    {
+      const std::vector<FaustUICollector::Item>& src = mUI.mItems;
+      const std::vector<FaustUICollector::Item>& dst = pVoice->GetUI().mItems;
+
+      for (auto i = 0; i < src.size() && i < dst.size(); i++)
+      {
+        if(src[i].zone && dst[i].zone)
+          *dst[i].zone = *src[i].zone;
+      }
+    }
+  }
+
+  void RenderVoices(int nOutputs)
+  {
+    int nJobs = 0;
+
+    for (auto pVoice : mVoices)
+    {
+      if(pVoice->HasWork())
+        mVoiceJobs[nJobs++] = pVoice;
+    }
+
+    if(nJobs == 0)
+      return;
+
+    // publish the jobs, then wake the render threads. The audio thread renders too, so it never waits on a thread that didn't wake up.
+    // The job count is in the same word as the generation, so a thread still looking at the last block sees the last block's count
+    mJobsDone.store(0);
+    const uint64_t generation = (mWork.load() >> 32) + 1;
+    mWork.store((generation << 32) | ((uint64_t) nJobs << 16));
+    mRenderCV.notify_all();
+
+    DoRenderJobs(generation);
+
+    while(mJobsDone.load() < nJobs)
+      std::this_thread::yield();
+
+    for (auto j = 0; j < nJobs; j++)
+      mVoiceJobs[j]->Accumulate(mOutputPtrs, nOutputs);
+  }
+
+  void DoRenderJobs(uint64_t generation)
+  {
+    while(true)
+    {
+      uint64_t work = mWork.load();
+
+      if((work >> 32) != generation)
+        return;
+
+      const int jobIdx = (int) (work & kMaxJobs);
+      const int nJobs = (int) ((work >> 16) & kMaxJobs);
+
+      if(jobIdx >= nJobs)
+        return;
+
+      // claiming a job is tied to the generation and its count, so a thread that wakes up late can't take a job from the next block
+      if(mWork.compare_exchange_weak(work, work + 1))
+      {
+        mVoiceJobs[jobIdx]->Render(mInputPtrs);
+        mJobsDone.fetch_add(1);
+      }
+    }
+  }
+
+  void RenderThreadLoop()
+  {
+    uint64_t lastGeneration = 0;
+
+    while(true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mRenderMutex);
+        mRenderCV.wait(lock, [&]() { return mQuit || (mWork.load() >> 32) != lastGeneration; });
+
+        if(mQuit)
+          return;
+      }
+
+      lastGeneration = mWork.load() >> 32;
+      DoRenderJobs(lastGeneration);
+    }
+  }
+
+  ::dsp* mMonoDSP;
+  FaustUICollector mUI;
+  MidiSynth mSynth;
+  std::vector<FaustVoice*> mVoices;
+  sample* mInputPtrs[FAUST_POLY_MAX_CHANNELS] = {};
+  sample* mOutputPtrs[FAUST_POLY_MAX_CHANNELS] = {};
+
+  std::vector<std::thread> mRenderThreads;
+  static constexpr int kMaxJobs = 0xFFFF;
+  std::vector<FaustVoice*> mVoiceJobs;
+  std::atomic<uint64_t> mWork {0}; // generation in the high 32 bits, then the number of jobs and the next job index in 16 bits each
+  std::atomic<int> mJobsDone {0};
+  std::mutex mRenderMutex;
+  std::condition_variable mRenderCV;
+  bool mQuit = false;
+};
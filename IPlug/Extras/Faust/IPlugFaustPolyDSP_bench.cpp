@@ -0,0 +1,418 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of FaustPolyDSP against a hand-written SynthVoice
+ *
+ * Both synths play the same saw -> one pole lowpass -> envelope voice, written once in the style of the FAUST C++ backend and once by hand,
+ * on -v voices (32 by default). A voice starts in each block until all of them play, so the number of render jobs changes from block to block,
+ * then every -r blocks half of them are released and retriggered. The time of each block is measured for the hand-written voices,
+ * for FaustPolyDSP rendering on the audio thread, and for FaustPolyDSP rendering on -t threads. The output of the threaded run is compared with
+ * the output of the single threaded run, so a voice that is rendered twice or skipped makes the benchmark fail.
+ * Voices are retriggered before their release ends, because render threads only see that a voice fell silent at the end of a block.
+ *
+ * Build with:
+ *
+ *   g++ -O2 -std=c++14 -DOS_LINUX -DNOMINMAX -IIPlug -IIPlug/Extras/Synth -IIPlug/Extras/Faust -IWDL IPlug/Extras/Faust/IPlugFaustPolyDSP_bench.cpp \
+ *     IPlug/Extras/Synth/MidiSynth.cpp IPlug/Extras/Synth/VoiceAllocator.cpp -lpthread -o faustpolybench
+ *
+ * or with -DOS_MAC on macOS. If the FAUST headers are on the include path they are used, otherwise the few declarations FaustPolyDSP needs are defined here.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+
+#define FAUSTFLOAT sample
+
+#if defined __has_include && __has_include("faust/dsp/dsp.h") && __has_include("faust/gui/UI.h")
+#include "faust/dsp/dsp.h"
+#include "faust/gui/UI.h"
+#include "faust/gui/meta.h"
+#else
+struct Soundfile;
+
+struct Meta
+{
+  virtual ~Meta() {}
+  virtual void declare(const char* key, const char* value) = 0;
+};
+
+struct UI
+{
+  virtual ~UI() {}
+  virtual void openTabBox(const char* label) = 0;
+  virtual void openHorizontalBox(const char* label) = 0;
+  virtual void openVerticalBox(const char* label) = 0;
+  virtual void closeBox() = 0;
+  virtual void addButton(const char* label, FAUSTFLOAT* zone) = 0;
+  virtual void addCheckButton(const char* label, FAUSTFLOAT* zone) = 0;
+  virtual void addVerticalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) = 0;
+  virtual void addHorizontalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) = 0;
+  virtual void addNumEntry(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) = 0;
+  virtual void addHorizontalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max) = 0;
+  virtual void addVerticalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max) = 0;
+  virtual void addSoundfile(const char* label, const char* filename, Soundfile** sf_zone) = 0;
+  virtual void declare(FAUSTFLOAT* zone, const char* key, const char* val) {}
+};
+
+class dsp
+{
+public:
+  virtual ~dsp() {}
+  virtual int getNumInputs() = 0;
+  virtual int getNumOutputs() = 0;
+  virtual void buildUserInterface(UI* ui_interface) = 0;
+  virtual int getSampleRate() = 0;
+  virtual void init(int sample_rate) = 0;
+  virtual void instanceInit(int sample_rate) = 0;
+  virtual void instanceConstants(int sample_rate) = 0;
+  virtual void instanceResetUserInterface() = 0;
+  virtual void instanceClear() = 0;
+  virtual dsp* clone() = 0;
+  virtual void metadata(Meta* m) = 0;
+  virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) = 0;
+};
+#endif
+
+#include "IPlugFaustPolyDSP.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_N_OUTPUTS 2
+
+/** The voice as the FAUST C++ backend would write it for
+ * process = os.sawtooth(freq) : fi.lowpass1(cutoff) : *(gain * si.smooth(ba.tau2pole(0.01), gate)) <: _,_; */
+class mydsp : public ::dsp
+{
+public:
+  void metadata(Meta* m) override { m->declare("name", "benchvoice"); }
+  int getNumInputs() override { return 0; }
+  int getNumOutputs() override { return BENCH_N_OUTPUTS; }
+  int getSampleRate() override { return fSampleRate; }
+
+  void instanceConstants(int sample_rate) override
+  {
+    fSampleRate = sample_rate;
+    fConst0 = 1. / double(fSampleRate);
+    fConst1 = std::exp(-1. / (0.01 * double(fSampleRate)));
+    fConst2 = 1. - fConst1;
+    fConst3 = 6.283185307179586 / double(fSampleRate);
+  }
+
+  void instanceResetUserInterface() override
+  {
+    fHslider0 = FAUSTFLOAT(440.);
+    fButton0 = FAUSTFLOAT(0.);
+    fHslider1 = FAUSTFLOAT(0.5);
+    fHslider2 = FAUSTFLOAT(2000.);
+  }
+
+  void instanceClear() override
+  {
+    fRec0 = fRec1 = fRec2 = fRec3 = 0.;
+  }
+
+  void init(int sample_rate) override { instanceInit(sample_rate); }
+
+  void instanceInit(int sample_rate) override
+  {
+    instanceConstants(sample_rate);
+    instanceResetUserInterface();
+    instanceClear();
+  }
+
+  ::dsp* clone() override { return new mydsp(); }
+
+  void buildUserInterface(UI* ui_interface) override
+  {
+    ui_interface->openVerticalBox("benchvoice");
+    ui_interface->addHorizontalSlider("cutoff", &fHslider2, FAUSTFLOAT(2000.), FAUSTFLOAT(20.), FAUSTFLOAT(20000.), FAUSTFLOAT(1.));
+    ui_interface->addHorizontalSlider("freq", &fHslider0, FAUSTFLOAT(440.), FAUSTFLOAT(20.), FAUSTFLOAT(20000.), FAUSTFLOAT(0.01));
+    ui_interface->addHorizontalSlider("gain", &fHslider1, FAUSTFLOAT(0.5), FAUSTFLOAT(0.), FAUSTFLOAT(1.), FAUSTFLOAT(0.01));
+    ui_interface->addButton("gate", &fButton0);
+    ui_interface->closeBox();
+  }
+
+  void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) override
+  {
+    FAUSTFLOAT* output0 = outputs[0];
+    FAUSTFLOAT* output1 = outputs[1];
+    const double fSlow0 = fConst0 * double(fHslider0);
+    const double fSlow1 = double(fHslider1);
+    const double fSlow2 = fConst2 * double(fButton0);
+    const double fSlow3 = 1. / (1. + 1. / std::tan(fConst3 * 0.5 * double(fHslider2)));
+    const double fSlow4 = 1. - 2. * fSlow3;
+
+    for (int i0 = 0; i0 < count; i0 = i0 + 1)
+    {
+      const double fTemp0 = fRec0 + fSlow0;
+      fRec0 = fTemp0 - std::floor(fTemp0);
+      const double fTemp1 = 2. * fRec0 - 1.;
+      fRec1 = fSlow3 * fTemp1 + fSlow3 * fRec2 + fSlow4 * fRec1;
+      fRec2 = fTemp1;
+      fRec3 = fSlow2 + fConst1 * fRec3;
+      const double fTemp2 = fSlow1 * fRec3 * fRec1;
+      output0[i0] = FAUSTFLOAT(fTemp2);
+      output1[i0] = FAUSTFLOAT(fTemp2);
+    }
+  }
+
+private:
+  FAUSTFLOAT fHslider0, fButton0, fHslider1, fHslider2;
+  int fSampleRate = 0;
+  double fConst0, fConst1, fConst2, fConst3;
+  double fRec0 = 0., fRec1 = 0., fRec2 = 0., fRec3 = 0.;
+};
+
+/** The same voice written by hand as a SynthVoice */
+class SawVoice : public SynthVoice
+{
+public:
+  bool GetBusy() const override
+  {
+    return mGateOn || mEnv > FAUST_POLY_SILENCE_THRESHOLD;
+  }
+
+  void Trigger(double level, bool isRetrigger) override
+  {
+    mLevel = level;
+    mGateOn = true;
+  }
+
+  void Release() override
+  {
+    mGateOn = false;
+  }
+
+  void SetSampleRate(double sampleRate) override
+  {
+    mInvSampleRate = 1. / sampleRate;
+    mEnvCoeff = std::exp(-1. / (0.01 * sampleRate));
+    mOmegaScale = 6.283185307179586 / sampleRate;
+  }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    const double freq = 440. * pow(2., mInputs[kVoiceControlPitch].endValue + mInputs[kVoiceControlPitchBend].endValue);
+    const double inc = freq * mInvSampleRate;
+    const double gain = mLevel * mGain;
+    const double envTarget = (mGateOn ? 1. : 0.) * (1. - mEnvCoeff);
+    const double b = 1. / (1. + 1. / std::tan(mOmegaScale * 0.5 * mCutoff));
+    const double a = 1. - 2. * b;
+    sample* pOut0 = outputs[0];
+    sample* pOut1 = outputs[1];
+
+    for (auto s = startIdx; s < startIdx + nFrames; s++)
+    {
+      mPhase += inc;
+      mPhase -= std::floor(mPhase);
+      const double saw = 2. * mPhase - 1.;
+      mLP = b * (saw + mLastSaw) + a * mLP;
+      mLastSaw = saw;
+      mEnv = envTarget + mEnvCoeff * mEnv;
+      const double out = gain * mEnv * mLP;
+      pOut0[s] += out;
+      pOut1[s] += out;
+    }
+  }
+
+  double mCutoff = 2000.;
+
+private:
+  double mInvSampleRate = 0.;
+  double mEnvCoeff = 0.;
+  double mOmegaScale = 0.;
+  double mLevel = 0.;
+  double mPhase = 0.;
+  double mLP = 0.;
+  double mLastSaw = 0.;
+  double mEnv = 0.;
+  bool mGateOn = false;
+};
+
+struct BlockStats
+{
+  double mean = 0.;
+  double p99 = 0.;
+  double max = 0.;
+};
+
+static BlockStats GetStats(std::vector<double>& times)
+{
+  std::sort(times.begin(), times.end());
+  BlockStats stats;
+
+  for (auto t : times)
+    stats.mean += t;
+
+  stats.mean /= times.size();
+  stats.p99 = times[std::min(times.size() - 1, (size_t) (0.99 * times.size()))];
+  stats.max = times.back();
+  return stats;
+}
+
+/** Starts voice v in block v. Once they all play, releases half of them every retriggerBlocks blocks, to retrigger them the block after */
+static void MakeBlockMidi(int block, int nVoices, int retriggerBlocks, int blockSize, const std::function<void(const IMidiMsg&)>& send)
+{
+  IMidiMsg msg;
+
+  for (auto v = 0; v < nVoices; v++)
+  {
+    const int note = 36 + v;
+    const int offset = (v * 7) % blockSize;
+
+    if(block == v)
+      msg.MakeNoteOnMsg(note, 100, offset);
+    else if(block <= nVoices)
+      continue;
+    else if(v % 2 && block % retriggerBlocks == 0)
+      msg.MakeNoteOffMsg(note, offset);
+    else if(v % 2 && block % retriggerBlocks == 1)
+      msg.MakeNoteOnMsg(note, 64 + v, offset);
+    else
+      continue;
+
+    send(msg);
+  }
+}
+
+static void PrintStats(const char* name, std::vector<double>& times, int blockSize)
+{
+  const BlockStats stats = GetStats(times);
+  const double budget = 1e6 * blockSize / BENCH_SAMPLE_RATE;
+  printf("%-32s mean %8.1f us (%5.1f%% of the block)  p99 %8.1f us  max %8.1f us\n", name, stats.mean, 100. * stats.mean / budget, stats.p99, stats.max);
+}
+
+int main(int argc, char* argv[])
+{
+  int nVoices = 32;
+  int nBlocks = 2000;
+  int blockSize = 512;
+  int nThreads = 4;
+  int retriggerBlocks = 4;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-v") && i + 1 < argc)
+      nVoices = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nBlocks = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      blockSize = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      nThreads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      retriggerBlocks = std::min(std::max(2, atoi(argv[++i])), 8); // a release lasts about 10 blocks of 512
+    else
+    {
+      printf("usage: %s [-v voices] [-n blocks] [-b block size] [-t render threads] [-r blocks between retriggers, 2 to 8]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%d voices, %d blocks of %d samples at %d Hz, %d render threads\n", nVoices, nBlocks, blockSize, BENCH_SAMPLE_RATE, nThreads);
+
+  WDL_TypedBuf<sample> outBuf;
+  outBuf.Resize(BENCH_N_OUTPUTS * blockSize);
+  sample* outputs[BENCH_N_OUTPUTS];
+
+  for (auto c = 0; c < BENCH_N_OUTPUTS; c++)
+    outputs[c] = outBuf.Get() + c * blockSize;
+
+  std::vector<double> times(nBlocks);
+
+  auto timeBlock = [&](int block, const std::function<void()>& process) {
+    const auto start = std::chrono::steady_clock::now();
+    process();
+    times[block] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  // hand-written voices
+  {
+    std::vector<SawVoice*> voices;
+    MidiSynth synth(VoiceAllocator::kPolyModePoly);
+
+    for (auto v = 0; v < nVoices; v++)
+    {
+      voices.push_back(new SawVoice());
+      synth.AddVoice(voices.back(), 0);
+    }
+
+    synth.SetSampleRateAndBlockSize(BENCH_SAMPLE_RATE, blockSize);
+
+    for (auto b = 0; b < nBlocks; b++)
+    {
+      MakeBlockMidi(b, nVoices, retriggerBlocks, blockSize, [&](const IMidiMsg& msg) { synth.AddMidiMsgToQueue(msg); });
+
+      timeBlock(b, [&]() {
+        for (auto c = 0; c < BENCH_N_OUTPUTS; c++)
+          memset(outputs[c], 0, blockSize * sizeof(sample));
+
+        synth.ProcessBlock(nullptr, outputs, 0, BENCH_N_OUTPUTS, blockSize);
+      });
+    }
+
+    PrintStats("hand-written SynthVoice", times, blockSize);
+
+    for (auto pVoice : voices)
+      delete pVoice;
+  }
+
+  // FaustPolyDSP, rendered on the audio thread and then on the render threads. The outputs of both are kept to compare them
+  std::vector<sample> reference;
+  double maxDiff = 0.;
+
+  for (auto threads : { 0, nThreads })
+  {
+    if(threads == nThreads && nThreads < 2)
+      break;
+
+    FaustPolyDSP poly(new mydsp(), nVoices, threads);
+    poly.init(BENCH_SAMPLE_RATE);
+
+    for (auto b = 0; b < nBlocks; b++)
+    {
+      MakeBlockMidi(b, nVoices, retriggerBlocks, blockSize, [&](const IMidiMsg& msg) { poly.ProcessMidiMsg(msg); });
+      timeBlock(b, [&]() { poly.compute(blockSize, nullptr, outputs); });
+
+      for (auto s = 0; s < blockSize; s++)
+      {
+        if(threads == 0)
+          reference.push_back(outputs[0][s]);
+        else
+          maxDiff = std::max(maxDiff, std::fabs(outputs[0][s] - reference[(size_t) b * blockSize + s]));
+      }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), threads ? "FaustPolyDSP, %d render threads" : "FaustPolyDSP, audio thread", threads);
+    PrintStats(name, times, blockSize);
+  }
+
+  if(nThreads > 1)
+  {
+    printf("largest difference between the threaded and single threaded output: %g\n", maxDiff);
+
+    if(maxDiff > 1e-9)
+    {
+      printf("FAILED: the threaded render doesn't match\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
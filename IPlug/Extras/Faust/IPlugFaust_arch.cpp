@@ -23,7 +23,7 @@ public:
 
 	void Init() override
 	{
-		mDSP = new FAUSTCLASS();
+		mDSP = CreatePolyDSPIfNeeded(new FAUSTCLASS(), mPolyDSP);
 		mDSP->buildUserInterface(this);
 		BuildParameterMap();
 		mInitialized = true;
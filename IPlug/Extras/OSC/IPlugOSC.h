@@ -19,450 +19,673 @@
 
 #include <cstring>
 #include <ctime>
-#include <unistd.h>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
 #include <functional>
 
+#ifdef OS_WIN
+#include <winsock2.h>
+#define OSC_POLL WSAPoll
+#else
+#include <unistd.h>
+#include <poll.h>
+#define OSC_POLL poll
+#endif
+
 #include "jnetlib/jnetlib.h"
 
 #include "IPlugOSC_msg.h"
 #include "IPlugTimer.h"
+#include "IPlugQueue.h"
+
+/** The largest UDP packet that is received, packets are truncated to this size */
+#ifndef OSC_MAX_PACKET_SIZE
+#define OSC_MAX_PACKET_SIZE 16384
+#endif
+
+/** The most messages delivered from one packet, including the messages of nested bundles */
+#ifndef OSC_MAX_MSGS_PER_PACKET
+#define OSC_MAX_MSGS_PER_PACKET 64
+#endif
 
-class IODevice
+/** The size of the buffer that holds received packets until they are processed, in bytes */
+#ifndef OSC_RECEIVE_BUFFER_SIZE
+#define OSC_RECEIVE_BUFFER_SIZE (1024 * 1024)
+#endif
+
+/** The number of messages that can wait to be sent, per destination */
+#ifndef OSC_SEND_QUEUE_SIZE
+#define OSC_SEND_QUEUE_SIZE 256
+#endif
+
+/** The number of packets read with one recvmmsg() call on Linux */
+#define OSC_RECEIVE_BATCH 16
+
+/** A network thread that does all OSC socket I/O for an OSCInterface.
+ * It sleeps in poll() until a listening socket has data, a message is queued with Send(), or a destination's pacing interval is over.
+ * Received packets are copied to a ring buffer, and parsed in place, bundles included, into OscMessageRead views that are stored next to
+ * the packet. ProcessIncoming() hands those views to one consumer thread without locks or allocations, so it can be called at any rate.
+ * Messages queued with Send() are gathered into bundles up to the destination's packet size. A destination receives at most one packet per
+ * send interval, which paces the output without ever sleeping on the calling thread.
+ * Listeners and destinations must be added while the thread is stopped */
+class OSCIOThread
 {
-protected:
-  IODevice ()
+public:
+  OSCIOThread()
   {
-    m_has_input = false;
-    m_has_output = false;
-    m_last_open_time = 0.0;
+    mReceiveBuf.Resize(OSC_RECEIVE_BUFFER_SIZE);
+    mBatchBuf.Resize(OSC_RECEIVE_BATCH * OSC_MAX_PACKET_SIZE);
+
+    // a loopback socket that Send() and Stop() write to, to wake up poll() on every platform
+    mWakeSock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (mWakeSock != INVALID_SOCKET)
+    {
+      memset(&mWakeAddr, 0, sizeof(mWakeAddr));
+      mWakeAddr.sin_family = AF_INET;
+      mWakeAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+      socklen_t len = (socklen_t) sizeof(mWakeAddr);
+
+      if (bind(mWakeSock, (struct sockaddr*) &mWakeAddr, sizeof(mWakeAddr)) || getsockname(mWakeSock, (struct sockaddr*) &mWakeAddr, &len))
+      {
+        closesocket(mWakeSock);
+        mWakeSock = INVALID_SOCKET;
+      }
+      else
+        SET_SOCK_BLOCK(mWakeSock, false);
+    }
+
+    mSendSock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (mSendSock != INVALID_SOCKET)
+    {
+      int on = 1;
+      setsockopt(mSendSock, SOL_SOCKET, SO_BROADCAST, (char*) &on, sizeof(on));
+      SET_SOCK_BLOCK(mSendSock, false);
+    }
   }
-  
-  struct rec
+
+  ~OSCIOThread()
   {
-    void (*callback)(void *d1, int dev_idx, char type, int msglen, void *msg); // type=0 for MIDI, 1=osc
-    void *data1;
-    int dev_idx;
-  };
-  
-  WDL_TypedBuf<rec> m_instances;
-public:
-  double m_last_open_time;
-  bool m_has_input, m_has_output;
-  
-  virtual ~IODevice () {};
-  virtual void start() {}
-  virtual void run_input(WDL_FastString& textOut)=0;
-  virtual void run_output(WDL_FastString& textOut)=0;
-  virtual const char *get_type()=0;
-  
-  virtual void oscSend(const char *src, int len) {}
-  //  virtual void midiSend(const unsigned char *buf, int len) {}
-  
-  virtual void addinst(void (*callback)(void *d1, int dev_idx, char type, int msglen, void *msg), void *d1, int dev_idx)
+    Stop();
+
+    for (auto& listener : mListeners)
+      closesocket(listener.mSock);
+
+    if (mSendSock != INVALID_SOCKET)
+      closesocket(mSendSock);
+
+    if (mWakeSock != INVALID_SOCKET)
+      closesocket(mWakeSock);
+  }
+
+  OSCIOThread(const OSCIOThread&) = delete;
+  OSCIOThread& operator=(const OSCIOThread&) = delete;
+
+  /** Binds a socket to receive packets on
+   * @return The index of the listener, passed to ProcessIncoming()'s function, or -1 on failure */
+  int AddListener(const struct sockaddr_in& addr)
   {
-    const rec r = {callback, d1, dev_idx};
-    m_instances.Add(r);
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock == INVALID_SOCKET)
+      return -1;
+
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, (char*) &on, sizeof(on));
+
+    if (bind(sock, (struct sockaddr*) &addr, sizeof(addr)))
+    {
+      closesocket(sock);
+      return -1;
+    }
+
+    SET_SOCK_BLOCK(sock, false);
+    mListeners.push_back({ sock, addr });
+    return (int) mListeners.size() - 1;
   }
-  
-  virtual void onMessage(char type, const unsigned char *msg, int len)
+
+  /** @return The index of the listener bound to addr, or -1 */
+  int FindListener(const struct sockaddr_in& addr) const
   {
-    const int n=m_instances.GetSize();
-    const rec *r = m_instances.Get();
-    for (int x=0;x<n; x++)
-      if (r[x].callback) r[x].callback(r[x].data1,r[x].dev_idx, type, len, (void*)msg);
+    for (int i = 0; i < (int) mListeners.size(); i++)
+    {
+      if (mListeners[i].mAddr.sin_port == addr.sin_port && mListeners[i].mAddr.sin_addr.s_addr == addr.sin_addr.s_addr)
+        return i;
+    }
+
+    return -1;
   }
-};
 
-class OSCDevice : public IODevice
-{
-public:
-  OSCDevice(const char* dest, int maxpacket, int sendsleep, struct sockaddr_in* listen_addr)
+  /** Adds a destination that messages can be sent to
+   * @param maxPacketSize Messages are gathered into bundles of up to this size, in bytes
+   * @param sendIntervalMs The minimum time between two packets to this destination
+   * @return The index of the destination, to pass to Send() */
+  int AddDestination(const struct sockaddr_in& addr, int maxPacketSize = 1024, int sendIntervalMs = 10)
   {
-    m_has_input = true;
-    m_has_output = false;
-    
-    //    m_has_output = m_has_input = true;
-    memset(&m_sendaddr, 0, sizeof(m_sendaddr));
-    m_maxpacketsz = maxpacket > 0 ? maxpacket : 1024;
-    m_sendsleep = sendsleep >= 0 ? sendsleep : 10;
-    m_sendsock = socket(AF_INET, SOCK_DGRAM, 0);
-    
-    if (m_sendsock == INVALID_SOCKET)
+    mDestinations.emplace_back(new Destination(addr, maxPacketSize > 0 ? maxPacketSize : 1024, sendIntervalMs > 0 ? sendIntervalMs : 0));
+    return (int) mDestinations.size() - 1;
+  }
+
+  /** @return The index of the destination at addr, or -1 */
+  int FindDestination(const struct sockaddr_in& addr) const
+  {
+    for (int i = 0; i < (int) mDestinations.size(); i++)
     {
-      //TODO:
+      if (mDestinations[i]->mAddr.sin_port == addr.sin_port && mDestinations[i]->mAddr.sin_addr.s_addr == addr.sin_addr.s_addr)
+        return i;
     }
-    else if (listen_addr)
+
+    return -1;
+  }
+
+  int NListeners() const { return (int) mListeners.size(); }
+  int NDestinations() const { return (int) mDestinations.size(); }
+
+  bool Start()
+  {
+    if (mThread.joinable())
+      return true;
+
+    if (mWakeSock == INVALID_SOCKET)
+      return false;
+
+    mRunning = true;
+    mThread = std::thread(&OSCIOThread::ThreadFunc, this);
+    return true;
+  }
+
+  void Stop()
+  {
+    if (!mThread.joinable())
+      return;
+
+    mRunning = false;
+    Wake();
+    mThread.join();
+  }
+
+  bool IsRunning() const { return mThread.joinable(); }
+
+  /** Queues a message to be sent by the network thread. Call from one thread only. Never blocks
+   * @param destIdx The index of a destination, or -1 to send to all destinations
+   * @return \c false if the message is too long, or a destination's queue is full */
+  bool Send(const char* pMsg, int len, int destIdx = -1)
+  {
+    if (len < 1 || len > MAX_OSC_MSG_LEN)
+      return false;
+
+    // a member, so that a full sized message isn't needed on the caller's stack
+    mOutgoingMsg.mSize = len;
+    memcpy(mOutgoingMsg.mData, pMsg, len);
+    bool success = true;
+
+    for (int i = 0; i < (int) mDestinations.size(); i++)
     {
-      m_recvaddr = *listen_addr;
-      int on = 1;
-      setsockopt(m_sendsock, SOL_SOCKET, SO_BROADCAST, (char*)&on, sizeof(on));
-      if (!bind(m_sendsock, (struct sockaddr*)&m_recvaddr, sizeof(struct sockaddr)))
+      if (destIdx >= 0 && i != destIdx)
+        continue;
+
+      if (!mDestinations[i]->mQueue.Push(mOutgoingMsg))
       {
-        SET_SOCK_BLOCK(m_sendsock, false);
+        mNSendDropped++;
+        success = false;
       }
-      else
+    }
+
+    Wake();
+    return success;
+  }
+
+  /** Calls func(OscMessageRead& msg, int listenerIdx) for each message received since the last call.
+   * Call from one thread only, e.g. a timer or the audio thread. It doesn't lock or allocate
+   * @return The number of messages */
+  template <typename F>
+  int ProcessIncoming(F func)
+  {
+    int nMsgs = 0;
+    uint64_t tail = mReceiveTail.load(std::memory_order_relaxed);
+    const uint64_t head = mReceiveHead.load(std::memory_order_acquire);
+    const int capacity = mReceiveBuf.GetSize();
+
+    while (tail < head)
+    {
+      const int offset = (int) (tail % capacity);
+
+      if (capacity - offset < (int) sizeof(PacketHeader) || GetPacket(offset)->mSize < 0)
       {
-        closesocket(m_sendsock);
-        m_sendsock = INVALID_SOCKET;
+        tail += capacity - offset; // wrapped
+        continue;
       }
+
+      PacketHeader* pPacket = GetPacket(offset);
+      OscMessageRead* pMsgs = GetMsgs(pPacket);
+
+      for (int i = 0; i < pPacket->mNMsgs; i++)
+        func(pMsgs[i], pPacket->mListener);
+
+      nMsgs += pPacket->mNMsgs;
+      tail += pPacket->mSize;
     }
-    else
+
+    mReceiveTail.store(tail, std::memory_order_release);
+    return nMsgs;
+  }
+
+  /** @return The number of packets dropped because the receive buffer was full */
+  int GetNReceiveDropped() const { return mNReceiveDropped; }
+
+  /** @return The number of messages dropped because a send queue was full */
+  int GetNSendDropped() const { return mNSendDropped; }
+
+private:
+  struct Listener
+  {
+    SOCKET mSock;
+    struct sockaddr_in mAddr;
+  };
+
+  struct OutgoingMsg
+  {
+    int mSize;
+    char mData[MAX_OSC_MSG_LEN];
+  };
+
+  struct Destination
+  {
+    Destination(const struct sockaddr_in& addr, int maxPacketSize, int sendIntervalMs)
+    : mAddr(addr)
+    , mInterval(std::chrono::milliseconds(sendIntervalMs))
+    , mQueue(OSC_SEND_QUEUE_SIZE)
     {
-      m_dest.Set(dest);
-      
-      WDL_String tmp(dest);
-      int sendport = 0;
-      char *p = strstr(tmp.Get(),":");
-      if (p)
+      mPacket.Resize(std::max(maxPacketSize, kBundleHeaderSize + (int) sizeof(int) + MAX_OSC_MSG_LEN));
+      mMaxPacketSize = maxPacketSize;
+    }
+
+    struct sockaddr_in mAddr;
+    std::chrono::steady_clock::duration mInterval;
+    std::chrono::steady_clock::time_point mNextSend;
+    IPlugQueue<OutgoingMsg> mQueue;
+    OutgoingMsg mNext; // popped from the queue, but didn't fit in the last packet
+    bool mHasNext = false;
+    WDL_TypedBuf<char> mPacket; // a bundle header, then each message prefixed with its size
+    int mMaxPacketSize;
+    int mPacketSize = kBundleHeaderSize;
+    int mNPacketMsgs = 0;
+  };
+
+  /** Stored in the receive buffer before the packet data, which is followed by mNMsgs OscMessageRead views into it */
+  struct PacketHeader
+  {
+    int mSize; // the size of the whole record, or -1 where the buffer wraps
+    int mListener;
+    int mDataSize;
+    int mNMsgs;
+  };
+
+  static constexpr int kBundleHeaderSize = 16;
+  static constexpr int kMaxBundleDepth = 8;
+
+  static int Align8(int size) { return (size + 7) & ~7; }
+
+  PacketHeader* GetPacket(int offset) { return (PacketHeader*) (mReceiveBuf.Get() + offset); }
+  static OscMessageRead* GetMsgs(PacketHeader* pPacket) { return (OscMessageRead*) ((char*) (pPacket + 1) + Align8(pPacket->mDataSize)); }
+
+  void Wake()
+  {
+    if (!mWakePending.exchange(true))
+    {
+      const char byte = 0;
+      sendto(mWakeSock, &byte, 1, 0, (struct sockaddr*) &mWakeAddr, sizeof(mWakeAddr));
+    }
+  }
+
+  void ThreadFunc()
+  {
+    JNL::open_socketlib();
+
+    std::vector<struct pollfd> fds(mListeners.size() + 1);
+
+    for (size_t i = 0; i < mListeners.size(); i++)
+      fds[i].fd = mListeners[i].mSock;
+
+    fds.back().fd = mWakeSock;
+
+    for (auto& fd : fds)
+      fd.events = POLLIN;
+
+    int timeoutMs = -1;
+
+    while (mRunning)
+    {
+      if (OSC_POLL(fds.data(), (unsigned long) fds.size(), timeoutMs) < 0 && ERRNO != EINTR)
+        break;
+
+      if (fds.back().revents & POLLIN)
       {
-        *p++ = 0;
-        sendport = atoi(p);
+        char buf[64];
+
+        while (recv(mWakeSock, buf, sizeof(buf), 0) > 0) {}
+
+        // cleared after draining, a Wake() from now on sends a new datagram. Anything queued before is handled below
+        mWakePending = false;
       }
-      if (!sendport) sendport=8000;
-      
-      m_sendaddr.sin_family = AF_INET;
-      m_sendaddr.sin_addr.s_addr = inet_addr(tmp.Get());
-      m_sendaddr.sin_port = htons(sendport);
-      
-      int on = 1;
-      setsockopt(m_sendsock, SOL_SOCKET, SO_BROADCAST, (char*)&on, sizeof(on));
-      SET_SOCK_BLOCK(m_sendsock, false);
+
+      for (size_t i = 0; i < mListeners.size(); i++)
+      {
+        if (fds[i].revents & POLLIN)
+          ReadListener((int) i);
+      }
+
+      timeoutMs = SendPackets();
     }
   }
-  
-  virtual ~OSCDevice()
+
+  /** Reads all pending packets of a listener into the receive buffer */
+  void ReadListener(int listenerIdx)
   {
-    if (m_sendsock != INVALID_SOCKET)
+    const SOCKET sock = mListeners[listenerIdx].mSock;
+
+    while (true)
     {
-      shutdown(m_sendsock, SHUT_RDWR);
-      closesocket(m_sendsock);
-      m_sendsock = INVALID_SOCKET;
+#ifdef OS_LINUX
+      struct mmsghdr msgs[OSC_RECEIVE_BATCH];
+      struct iovec iovecs[OSC_RECEIVE_BATCH];
+
+      for (int i = 0; i < OSC_RECEIVE_BATCH; i++)
+      {
+        iovecs[i].iov_base = mBatchBuf.Get() + i * OSC_MAX_PACKET_SIZE;
+        iovecs[i].iov_len = OSC_MAX_PACKET_SIZE;
+        memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+
+      const int nPackets = recvmmsg(sock, msgs, OSC_RECEIVE_BATCH, MSG_DONTWAIT, nullptr);
+
+      if (nPackets < 1)
+        return;
+
+      for (int i = 0; i < nPackets; i++)
+        StorePacket(listenerIdx, mBatchBuf.Get() + i * OSC_MAX_PACKET_SIZE, (int) msgs[i].msg_len);
+
+      if (nPackets < OSC_RECEIVE_BATCH)
+        return;
+#else
+      const int len = (int) recv(sock, mBatchBuf.Get(), OSC_MAX_PACKET_SIZE, 0);
+
+      if (len < 1)
+        return;
+
+      StorePacket(listenerIdx, mBatchBuf.Get(), len);
+#endif
     }
   }
-  
-  virtual void run_input(WDL_FastString &textOut)
+
+  /** Copies a packet to the receive buffer, parses it in place and makes it available to ProcessIncoming() */
+  void StorePacket(int listenerIdx, const char* pData, int len)
   {
-    if (m_sendsock == INVALID_SOCKET) return;
-    struct sockaddr *p = m_dest.GetLength() ? nullptr : (struct sockaddr *) &m_sendaddr;
-    for (;;)
+    const int capacity = mReceiveBuf.GetSize();
+    const int maxSize = (int) sizeof(PacketHeader) + Align8(len) + OSC_MAX_MSGS_PER_PACKET * (int) sizeof(OscMessageRead);
+    const uint64_t head = mReceiveHead.load(std::memory_order_relaxed);
+    const uint64_t tail = mReceiveTail.load(std::memory_order_acquire);
+    const int offset = (int) (head % capacity);
+    const int skip = capacity - offset < maxSize ? capacity - offset : 0;
+
+    if (head + skip + maxSize - tail > (uint64_t) capacity)
     {
-      char buf[16384];
-      buf[0] = 0;
-      socklen_t plen = (socklen_t) sizeof(m_sendaddr);
-      const int len = (int)recvfrom(m_sendsock, buf, sizeof(buf), 0, p, p?&plen:nullptr);
-      if (len<1) break;
-      
-      onMessage(1,(const unsigned char *)buf,len);
+      mNReceiveDropped++;
+      return;
     }
+
+    if (skip >= (int) sizeof(PacketHeader))
+      GetPacket(offset)->mSize = -1;
+
+    PacketHeader* pPacket = GetPacket(skip ? 0 : offset);
+    pPacket->mListener = listenerIdx;
+    pPacket->mDataSize = len;
+    pPacket->mNMsgs = 0;
+    char* pPacketData = (char*) (pPacket + 1);
+    memcpy(pPacketData, pData, len);
+    AddMsgs(pPacket, pPacketData, len, 0);
+    pPacket->mSize = (int) sizeof(PacketHeader) + Align8(len) + pPacket->mNMsgs * (int) sizeof(OscMessageRead);
+
+    mReceiveHead.store(head + skip + pPacket->mSize, std::memory_order_release);
   }
-  
-  virtual void run_output(WDL_FastString &results)
+
+  /** Creates views for the messages in buf, recursing into bundles */
+  void AddMsgs(PacketHeader* pPacket, char* buf, int len, int depth)
   {
-    static char hdr[16] = { '#', 'b', 'u', 'n', 'd', 'l', 'e', 0, 0, 0, 0, 0, 1, 0, 0, 0 };
-    
-    // send m_sendq as UDP blocks
-    if (m_sendq.Available() <= 16)
+    if (len >= kBundleHeaderSize && !memcmp(buf, "#bundle", 8))
     {
-      if (m_sendq.Available() > 0) m_sendq.Clear();
-      return;
+      int pos = kBundleHeaderSize; // skip the time tag, messages are delivered as soon as they arrive
+
+      while (pos + (int) sizeof(int) <= len)
+      {
+        int size;
+        memcpy(&size, buf + pos, sizeof(int));
+        OSC_MAKEINTMEM4BE(&size);
+        pos += sizeof(int);
+
+        if (size < 1 || pos + size > len)
+          break;
+
+        if (depth < kMaxBundleDepth)
+          AddMsgs(pPacket, buf + pos, size, depth + 1);
+
+        pos += size;
+      }
     }
-    // m_sendq should begin with a 16 byte pad, then messages in OSC
-    
-    char* packetstart = (char*) m_sendq.Get();
-    int packetlen = 16;
-    bool hasbundle = false;
-    m_sendq.Advance(16); // skip bundle for now, but keep it around
-    
-    SET_SOCK_BLOCK(m_sendsock, true);
-    
-    while (m_sendq.Available() >= sizeof(int))
+    else if (pPacket->mNMsgs < OSC_MAX_MSGS_PER_PACKET)
+    {
+      OscMessageRead* pMsg = new (GetMsgs(pPacket) + pPacket->mNMsgs) OscMessageRead(buf, len);
+      const char* pAddress = pMsg->GetMessage();
+
+      if (pAddress && *pAddress)
+        pPacket->mNMsgs++;
+    }
+  }
+
+  /** Sends the queued messages of all destinations that are not waiting for their send interval
+   * @return The time until the next destination may send, for poll(), or -1 if nothing is waiting */
+  int SendPackets()
+  {
+    const auto now = std::chrono::steady_clock::now();
+    int timeoutMs = -1;
+
+    for (auto& pDest : mDestinations)
     {
-      int len = *(int*) m_sendq.Get(); // not advancing
-      OSC_MAKEINTMEM4BE((char*)&len);
-      
-      if (len < 1 || len > MAX_OSC_MSG_LEN || len > m_sendq.Available()) break;
-      
-      if (packetlen > 16 && packetlen+sizeof(int)+len > m_maxpacketsz)
+      Destination& dest = *pDest;
+
+      while (true)
       {
-        // packet is full
-        if (!hasbundle)
+        while (dest.mHasNext || dest.mQueue.Pop(dest.mNext))
         {
-          packetstart += 20;
-          packetlen -= 20;
+          dest.mHasNext = true;
+
+          if (dest.mNPacketMsgs && dest.mPacketSize + (int) sizeof(int) + dest.mNext.mSize > dest.mMaxPacketSize)
+            break;
+
+          int size = dest.mNext.mSize;
+          OSC_MAKEINTMEM4BE(&size);
+          memcpy(dest.mPacket.Get() + dest.mPacketSize, &size, sizeof(int));
+          memcpy(dest.mPacket.Get() + dest.mPacketSize + sizeof(int), dest.mNext.mData, dest.mNext.mSize);
+          dest.mPacketSize += (int) sizeof(int) + dest.mNext.mSize;
+          dest.mNPacketMsgs++;
+          dest.mHasNext = false;
+        }
+
+        if (!dest.mNPacketMsgs)
+          break;
+
+        if (now < dest.mNextSend)
+        {
+          const int waitMs = (int) std::chrono::duration_cast<std::chrono::milliseconds>(dest.mNextSend - now).count() + 1;
+          timeoutMs = timeoutMs < 0 ? waitMs : std::min(timeoutMs, waitMs);
+          break;
+        }
+
+        // a single message is sent on its own, several as a bundle to be processed immediately
+        const char* pData = dest.mPacket.Get();
+        int len = dest.mPacketSize;
+
+        if (dest.mNPacketMsgs == 1)
+        {
+          pData += kBundleHeaderSize + sizeof(int);
+          len -= kBundleHeaderSize + sizeof(int);
         }
         else
         {
-          memcpy(packetstart, hdr, 16);
+          static const char hdr[kBundleHeaderSize] = { '#', 'b', 'u', 'n', 'd', 'l', 'e', 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+          memcpy(dest.mPacket.Get(), hdr, kBundleHeaderSize);
         }
-        
-        sendto(m_sendsock, packetstart, packetlen, 0, (struct sockaddr*)&m_sendaddr, sizeof(m_sendaddr));
-        if (m_sendsleep>0) Sleep(m_sendsleep);
-        
-        packetstart = (char*) m_sendq.Get()-16; // safe since we padded the queue start
-        packetlen = 16;
-        hasbundle = false;
-      }
-      
-      if (packetlen > 16) hasbundle = true;
-      m_sendq.Advance(sizeof(int)+len);
-      packetlen += sizeof(int)+len;
-    }
-    
-    if (packetlen > 16)
-    {
-      if (!hasbundle)
-      {
-        packetstart += 20;
-        packetlen -= 20;
-      }
-      else
-      {
-        memcpy(packetstart,hdr,16);
+
+        if (sendto(mSendSock, pData, len, 0, (struct sockaddr*) &dest.mAddr, sizeof(dest.mAddr)) < 0 && ERRNO == EWOULDBLOCK)
+        {
+          // the socket buffer is full, try again shortly
+          timeoutMs = timeoutMs < 0 ? 1 : std::min(timeoutMs, 1);
+          break;
+        }
+
+        dest.mPacketSize = kBundleHeaderSize;
+        dest.mNPacketMsgs = 0;
+        dest.mNextSend = now + dest.mInterval;
       }
-      sendto(m_sendsock, packetstart, packetlen, 0, (struct sockaddr*) &m_sendaddr, sizeof(m_sendaddr));
-      if (m_sendsleep > 0) Sleep(m_sendsleep);
     }
-    SET_SOCK_BLOCK(m_sendsock, false);
-    
-    m_sendq.Clear();
-  }
-  
-  virtual void oscSend(const char* src, int len)
-  {
-    if (!m_sendq.GetSize()) m_sendq.Add(nullptr,16);
-    
-    int tlen = len;
-    OSC_MAKEINTMEM4BE(&tlen);
-    m_sendq.Add(&tlen,sizeof(tlen));
-    m_sendq.Add(src,len);
+
+    return timeoutMs;
   }
-  
-  virtual const char* get_type() { return "OSC"; }
-  
-  SOCKET m_sendsock;
-  int m_maxpacketsz, m_sendsleep;
-  struct sockaddr_in m_sendaddr;
-  WDL_Queue m_sendq;
-  WDL_String m_dest;
-  
-  struct sockaddr_in m_recvaddr;
-  WDL_Queue m_recvq;
-};
 
-WDL_PtrList<IODevice > g_devices;
+  std::vector<Listener> mListeners;
+  std::vector<std::unique_ptr<Destination>> mDestinations;
+  SOCKET mSendSock = INVALID_SOCKET;
+  SOCKET mWakeSock = INVALID_SOCKET;
+  struct sockaddr_in mWakeAddr;
+  std::atomic<bool> mWakePending {false};
+  std::atomic<bool> mRunning {false};
+  std::thread mThread;
 
-class OSCReciever;
+  // network thread only, except the positions
+  WDL_TypedBuf<char> mBatchBuf;
+  WDL_TypedBuf<char> mReceiveBuf;
+  std::atomic<uint64_t> mReceiveHead {0};
+  std::atomic<uint64_t> mReceiveTail {0};
+  std::atomic<int> mNReceiveDropped {0};
+
+  // sending thread only
+  OutgoingMsg mOutgoingMsg;
+  std::atomic<int> mNSendDropped {0};
+};
 
 class OSCInterface
 {
 public:
+  /** @param updateRateMs How often received messages are passed to OnOSCMessage() on the main thread, or 0 to process them elsewhere */
   OSCInterface(int updateRateMs = 100)
   {
     JNL::open_socketlib();
     
-    if(mTimer == nullptr)
+    if(updateRateMs > 0)
       mTimer = Timer::Create(std::bind(&OSCInterface::OnTimer, this, std::placeholders::_1), updateRateMs);
   }
   
   virtual ~OSCInterface()
   {
     if(mTimer != nullptr)
-      delete mTimer;
-    
+      mTimer->Stop();
+
+    mIO.Stop();
+
+    delete mTimer;
     mTimer = nullptr;
   }
   
-  static void MessageCallback(void *d1, int dev_idx, char type, int msglen, void *msg);
-  
   void CreateReciever(WDL_String& results, int port = 8000)
   {
     const char buf[] = "127.0.0.1";
     
     struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
     addr.sin_addr.s_addr=INADDR_ANY;
     addr.sin_family = AF_INET;
     if (buf[0] && buf[0] != '*') addr.sin_addr.s_addr = inet_addr(buf);
     if (addr.sin_addr.s_addr == INADDR_NONE) addr.sin_addr.s_addr = INADDR_ANY;
     addr.sin_port = htons(port);
     
-    int x;
-    bool is_reuse = false;
-    OSCDevice *r = nullptr;
-    for (x = 0; x < g_devices.GetSize(); x++)
-    {
-      IODevice  *dev = g_devices.Get(x);
-      if (dev && !strcmp(dev->get_type(),"OSC") && dev->m_has_input)
-      {
-        OSCDevice *od = (OSCDevice *)dev;
-        if (od->m_recvaddr.sin_port == addr.sin_port && od->m_recvaddr.sin_addr.s_addr == addr.sin_addr.s_addr)
-        {
-          r=od;
-          is_reuse=true;
-          
-          results.AppendFormatted(1024,"\tAttached to already-opened listener '%s:%i'\r\n", buf, port);
-          
-          break;
-        }
-      }
-    }
-    
-    if (!r)
-    {
-      r = new OSCDevice(nullptr, 0, -1, &addr);
-      if (r->m_sendsock == INVALID_SOCKET)
-      {
-        delete r;
-        r = nullptr;
-        results.AppendFormatted(1024,"\tError listening for '%s:%i'\r\n", buf, port);
-      }
-      else
-      {
-        results.AppendFormatted(1024,"\tListening on '%s:%i'\r\n", buf, port);
-      }
-    }
-    
-    if (r)
+    if (mIO.FindListener(addr) >= 0)
     {
-      r->addinst(MessageCallback, this, m_devs.GetSize());
-      m_devs.Add(r);
-      
-      if (!is_reuse)
-        g_devices.Add(r);
+      results.AppendFormatted(1024,"\tAlready listening on '%s:%i'\r\n", buf, port);
+      return;
     }
+
+    mIO.Stop();
+
+    if (mIO.AddListener(addr) < 0)
+      results.AppendFormatted(1024,"\tError listening for '%s:%i'\r\n", buf, port);
+    else
+      results.AppendFormatted(1024,"\tListening on '%s:%i'\r\n", buf, port);
+
+    mIO.Start();
   }
   
-  void CreateSender(WDL_String& results, const char* ip = "127.0.0.1", int port = 8000)
+  /** Adds a destination. Messages sent with SendMsg() go to all destinations unless one is specified
+   * @param maxPacketSize Messages are gathered into bundles of up to this size, in bytes
+   * @param sendIntervalMs The minimum time between two packets to this destination
+   * @return The index of the destination, or -1 on failure */
+  int CreateSender(WDL_String& results, const char* ip = "127.0.0.1", int port = 8000, int maxPacketSize = 1024, int sendIntervalMs = 10)
   {
-    WDL_String dp;
-    dp.SetFormatted(256, "%s:%i", ip, port);
-    OSCDevice *r = nullptr;
-    bool is_reuse = false;
-    for (auto x=0; x<g_devices.GetSize(); x++)
-    {
-      IODevice *d = g_devices.Get(x);
-      if (d && !strcmp(d->get_type(),"OSC") && d->m_has_output)
-      {
-        OSCDevice *p = (OSCDevice *)d;
-        if (!strcmp(p->m_dest.Get(), dp.Get()))
-        {
-          is_reuse = true;
-          r = p; // reuse!
-          break;
-        }
-      }
-    }
-    
-    if (!r)
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(ip);
+    addr.sin_port = htons(port ? port : 8000);
+
+    int idx = mIO.FindDestination(addr);
+
+    if (idx < 0)
     {
-      is_reuse = false;
-      r = new OSCDevice(dp.Get(), 0, -1, nullptr);
-      if (r->m_sendsock == INVALID_SOCKET)
+      mIO.Stop();
+      idx = mIO.AddDestination(addr, maxPacketSize, sendIntervalMs);
+
+      if (!mIO.Start())
       {
-        results.AppendFormatted(1024,"\tWarning: failed creating destination for output '%s' OSC '%s'\r\n", dp.Get(), dp.Get());
-        delete r;
-        r = nullptr;
+        results.AppendFormatted(1024,"\tWarning: failed creating destination for output '%s:%i'\r\n", ip, port);
+        return -1;
       }
     }
-    
-    if (r)
-    {
-      r->addinst(MessageCallback, this, m_devs.GetSize());
-      m_devs.Add(r);
-      
-      if (!is_reuse)
-        g_devices.Add(r);
-    }
+
+    return idx;
   }
   
 public:
-  void SendMsg(const char* msg, int len)
+  /** Queues a message to be sent on the network thread. Never blocks
+   * @param destIdx A destination index from CreateSender(), or -1 for all destinations */
+  void SendMsg(const char* msg, int len, int destIdx = -1)
   {
-    g_devices.Get(0)->oscSend(msg, len); // TODO: device 0?
+    mIO.Send(msg, len, destIdx);
   }
   
-  struct incomingEvent
-  {
-    IODevice* dev_ptr;
-    int sz; // size of msg[], 1..3 for midi, anything for OSC
-    char type; // 0=midi, 1=OSC
-    unsigned char msg[3];
-  };
-  
   virtual void OnOSCMessage(OscMessageRead& msg) {};
+
+  /** Gives access to the network thread, e.g. to call OSCIOThread::ProcessIncoming() from a thread other than the main thread.
+   * In that case, set updateRateMs to 0 on construction, so that the timer doesn't consume the messages */
+  OSCIOThread& GetIOThread() { return mIO; }
   
 private:
   void OnTimer(Timer& timer)
   {
-    if(mInputProc)
-      mInputProc();
-    
-    if (m_incoming_events.GetSize())
-    {
-      static WDL_HeapBuf tmp;
-      
-      m_incoming_events_mutex.Enter();
-      tmp.CopyFrom(&m_incoming_events,false);
-      m_incoming_events.Resize(0,false);
-      m_incoming_events_mutex.Leave();
-      
-      int pos=0;
-      const int endpos = tmp.GetSize();
-      while (pos < endpos+1 - sizeof(incomingEvent))
-      {
-        incomingEvent *evt = (incomingEvent*) ((char *)tmp.Get()+pos);
-        
-        const int this_sz = ((sizeof(incomingEvent) + (evt->sz-3)) + 7) & ~7;
-        
-        if (pos+this_sz > endpos) break;
-        pos += this_sz;
-        
-        int rd_pos = 0;
-        int rd_sz = evt->sz;
-        if (evt->sz > 20 && !strcmp((char*)evt->msg, "#bundle"))
-        {
-          rd_sz = *(int *)(evt->msg+16);
-          OSC_MAKEINTMEM4BE(&rd_sz);
-          rd_pos += 20;
-        }
-        //        if (m_var_msgs[3]) m_var_msgs[3][0] = evt->dev_ptr ? *evt->dev_ptr : -1.0;
-        
-        while (rd_pos + rd_sz <= evt->sz && rd_sz>=0)
-        {
-          OscMessageRead rmsg((char*)evt->msg + rd_pos, rd_sz);
-          
-          const char *mstr = rmsg.GetMessage();
-          if (mstr && *mstr)
-          {
-            OnOSCMessage(rmsg);
-          }
-          
-          rd_pos += rd_sz+4;
-          if (rd_pos >= evt->sz) break;
-          
-          rd_sz = *(int *)(evt->msg+rd_pos-4);
-          OSC_MAKEINTMEM4BE(&rd_sz);
-        }
-      }
-    }
-    
-    if(mOutputProc)
-      mOutputProc();
+    mIO.ProcessIncoming([this](OscMessageRead& msg, int listenerIdx) {
+      OnOSCMessage(msg);
+    });
   }
   
-  // these are non-owned refs
-  WDL_PtrList<IODevice> m_devs;
-protected:
-  static Timer* mTimer;
-  WDL_FastString results;
-  std::function<void()> mInputProc = nullptr;
-  std::function<void()> mOutputProc = nullptr;
-  WDL_HeapBuf m_incoming_events;  // incomingEvent list, each is 8-byte aligned
-  WDL_Mutex m_incoming_events_mutex;
-  static const int DEVICE_INDEX_BASE = 0x400000;
+  OSCIOThread mIO;
+  Timer* mTimer = nullptr;
 };
 
-Timer* OSCInterface::mTimer = nullptr;
-
 class OSCSender : public OSCInterface
 {
 public:
@@ -471,18 +694,13 @@ public:
     WDL_String str;
     CreateSender(str, destIP, port);
     DBGMSG("%s\n", str.Get());
-    mOutputProc = [&]()
-    {
-      for (auto x = 0; x < g_devices.GetSize(); x++)
-        g_devices.Get(x)->run_output(results);  // send queued messages
-    };
   }
   
-  void SendOSCMessage(OscMessageWrite& msg)
+  void SendOSCMessage(OscMessageWrite& msg, int destIdx = -1)
   {
     int msgLength;
     const char* msgStr = msg.GetBuffer(&msgLength);
-    SendMsg(msgStr, msgLength);
+    SendMsg(msgStr, msgLength, destIdx);
   }
 };
 
@@ -494,54 +712,7 @@ public:
     WDL_String str;
     CreateReciever(str, port);
     DBGMSG("%s\n", str.Get());
-    
-    mInputProc = [&]()
-    {
-      //      const int sizeOfData = results.GetLength();
-      
-      for (auto x = 0; x < g_devices.GetSize(); x++)
-        g_devices.Get(x)->run_input(results);
-      
-      //      if (results.GetLength() != sizeOfData) // if some input device added results
-      //      {
-      //        OscMessageRead msg{mReadBuf, sizeOfData};
-      //        OnOSCMessage(msg);
-      //      }
-    };
   }
   
   virtual void OnOSCMessage(OscMessageRead& msg) = 0;
-  
-private:
-  const char* mTest = "TEST";
-  char mReadBuf[MAX_OSC_MSG_LEN] = {};
 };
-
-//static
-void OSCInterface::MessageCallback(void *d1, int dev_idx, char type, int len, void *msg)
-{
-  OSCInterface* _this  = (OSCInterface *) d1;
-  
-  if (_this && msg)
-  {
-    if (_this->m_incoming_events.GetSize() < 65536*8)
-    {
-      const int this_sz = ((sizeof(incomingEvent) + (len-3)) + 7) & ~7;
-      
-      _this->m_incoming_events_mutex.Enter();
-      const int oldsz = _this->m_incoming_events.GetSize();
-      _this->m_incoming_events.Resize(oldsz + this_sz,false);
-      
-      if (_this->m_incoming_events.GetSize() == oldsz+this_sz)
-      {
-        incomingEvent *item=(incomingEvent *) ((char *)_this->m_incoming_events.Get() + oldsz);
-        item->dev_ptr = _this->m_devs.Get(dev_idx);
-        item->sz = len;
-        item->type = type;
-        memcpy(item->msg,msg,len);
-      }
-      _this->m_incoming_events_mutex.Leave();
-    }
-  }
-}
-
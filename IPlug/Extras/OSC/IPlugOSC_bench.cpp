@@ -0,0 +1,284 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of OSC throughput and end-to-end latency over loopback
+ *
+ * One OSCIOThread sends /bench messages to another one's listener. A consumer thread calls ProcessIncoming() every poll interval,
+ * the way OSCInterface's timer does, and measures the time from Send() to the message being processed.
+ * By default messages are sent as fast as the send queue takes them, with -r they are sent at a fixed rate, -c messages per tick.
+ * With -l, the old design is emulated instead: a 100 ms timer that flushes the send queue with a 10 ms sleep between packets,
+ * and a 100 ms timer that polls the socket.
+ *
+ * Build with:
+ *
+ *   g++ -O2 -std=c++14 -DOS_LINUX -DNOMINMAX -IIPlug -IIPlug/Extras/OSC -IWDL -IWDL/swell IPlug/Extras/OSC/IPlugOSC_bench.cpp \
+ *     IPlug/Extras/OSC/IPlugOSC_msg.cpp WDL/jnetlib/util.cpp -lpthread -o oscbench
+ *
+ * or with -DOS_MAC on macOS.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "IPlugPlatform.h"
+#include "IPlugLogger.h"
+#include "IPlugOSC.h"
+
+#define BENCH_PORT 9100
+
+static int64_t NowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int WriteBenchMsg(char* pDst, int seq)
+{
+  const int64_t now = NowNs();
+  OscMessageWrite msg;
+  msg.PushWord("/bench");
+  msg.PushIntArg(seq);
+  msg.PushIntArg((int) (now >> 32));
+  msg.PushIntArg((int) (now & 0xFFFFFFFF));
+  int len;
+  const char* pMsg = msg.GetBuffer(&len);
+  memcpy(pDst, pMsg, len);
+  return len;
+}
+
+static bool ReadBenchMsg(OscMessageRead& msg, std::vector<double>& latencies)
+{
+  const int* pSeq = msg.PopIntArg(false);
+  const int* pHi = msg.PopIntArg(false);
+  const int* pLo = msg.PopIntArg(false);
+
+  if (!pSeq || !pHi || !pLo)
+    return false;
+
+  const int64_t sent = ((int64_t) *pHi << 32) | (uint32_t) *pLo;
+  latencies.push_back(1e-3 * (NowNs() - sent));
+  return true;
+}
+
+static void PrintResults(const char* name, std::vector<double>& latencies, int nSent, double seconds)
+{
+  std::sort(latencies.begin(), latencies.end());
+  const size_t n = latencies.size();
+  auto percentile = [&](double p) { return n ? latencies[std::min(n - 1, (size_t) (p * n))] : 0.; };
+
+  printf("%s: %d sent, %d received in %.2f s, %.0f messages/s\n", name, nSent, (int) n, seconds, n / seconds);
+  printf("  latency us: p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n", percentile(0.5), percentile(0.9), percentile(0.99), n ? latencies.back() : 0.);
+}
+
+int main(int argc, char* argv[])
+{
+  int nMsgs = 200000;
+  double rate = 0.;
+  int perTick = 8;
+  double pollMs = 1.;
+  int sendIntervalMs = 0;
+  bool legacy = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-l"))
+      legacy = true;
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      nMsgs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      rate = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      perTick = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      pollMs = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      sendIntervalMs = atoi(argv[++i]);
+    else
+    {
+      printf("usage: %s [-l] [-n messages] [-r ticks/s -c messages per tick] [-p consumer poll ms] [-s send interval ms]\n", argv[0]);
+      printf("  -l  emulate the old timer driven sender and receiver\n");
+      return 1;
+    }
+  }
+
+  JNL::open_socketlib();
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = htons(BENCH_PORT);
+
+  std::vector<double> latencies;
+  latencies.reserve(nMsgs);
+  std::atomic<bool> sending {true};
+  char msgBuf[MAX_OSC_MSG_LEN];
+
+  // paces the producer, either flat out or at the tick rate
+  auto produce = [&](std::function<bool(const char*, int)> send) {
+    const int64_t start = NowNs();
+
+    for (int seq = 0; seq < nMsgs; )
+    {
+      if (rate > 0.)
+      {
+        const int64_t deadline = start + (int64_t) (1e9 * (seq / perTick) / rate);
+        std::this_thread::sleep_for(std::chrono::nanoseconds(std::max<int64_t>(0, deadline - NowNs())));
+
+        for (int i = 0; i < perTick && seq < nMsgs; i++, seq++)
+        {
+          const int len = WriteBenchMsg(msgBuf, seq);
+          send(msgBuf, len);
+        }
+      }
+      else
+      {
+        const int len = WriteBenchMsg(msgBuf, seq);
+
+        if (send(msgBuf, len))
+          seq++;
+        else
+          std::this_thread::yield(); // the send queue is full
+      }
+    }
+
+    sending = false;
+  };
+
+  const int64_t start = NowNs();
+  int64_t lastReceived = start;
+
+  if (legacy)
+  {
+    // the old OSCDevice: a non-blocking socket read from a timer, and a queue flushed from a timer with a sleep after each packet
+    SOCKET recvSock = socket(AF_INET, SOCK_DGRAM, 0);
+    bind(recvSock, (struct sockaddr*) &addr, sizeof(addr));
+    SET_SOCK_BLOCK(recvSock, false);
+    SOCKET sendSock = socket(AF_INET, SOCK_DGRAM, 0);
+    WDL_Mutex queueMutex;
+    WDL_TypedBuf<char> queue;
+
+    std::thread producer(produce, [&](const char* pMsg, int len) {
+      WDL_MutexLock lock(&queueMutex);
+      int size = len;
+      OSC_MAKEINTMEM4BE(&size);
+      queue.Add((const char*) &size, sizeof(int));
+      queue.Add(pMsg, len);
+      return true;
+    });
+
+    std::thread sender([&]() {
+      WDL_TypedBuf<char> packet;
+
+      while (sending || queue.GetSize())
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        WDL_TypedBuf<char> pending;
+
+        {
+          WDL_MutexLock lock(&queueMutex);
+          pending.Resize(queue.GetSize());
+          memcpy(pending.Get(), queue.Get(), queue.GetSize());
+          queue.Resize(0, false);
+        }
+
+        int pos = 0;
+
+        while (pos < pending.GetSize())
+        {
+          static const char hdr[16] = { '#', 'b', 'u', 'n', 'd', 'l', 'e', 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+          packet.Resize(0, false);
+          packet.Add(hdr, 16);
+
+          while (pos < pending.GetSize())
+          {
+            int size;
+            memcpy(&size, pending.Get() + pos, sizeof(int));
+            OSC_MAKEINTMEM4BE(&size);
+
+            if (packet.GetSize() > 16 && packet.GetSize() + (int) sizeof(int) + size > 1024)
+              break;
+
+            packet.Add(pending.Get() + pos, sizeof(int) + size);
+            pos += sizeof(int) + size;
+          }
+
+          sendto(sendSock, packet.Get(), packet.GetSize(), 0, (struct sockaddr*) &addr, sizeof(addr));
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+      }
+    });
+
+    while (sending || NowNs() - lastReceived < 1000000000)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      char buf[16384];
+      int len;
+
+      while ((len = (int) recv(recvSock, buf, sizeof(buf), 0)) > 0)
+      {
+        lastReceived = NowNs();
+        int pos = 16;
+
+        while (pos + (int) sizeof(int) <= len)
+        {
+          int size;
+          memcpy(&size, buf + pos, sizeof(int));
+          OSC_MAKEINTMEM4BE(&size);
+          OscMessageRead msg(buf + pos + sizeof(int), size);
+          ReadBenchMsg(msg, latencies);
+          pos += sizeof(int) + size;
+        }
+      }
+    }
+
+    producer.join();
+    sender.join();
+    closesocket(recvSock);
+    closesocket(sendSock);
+  }
+  else
+  {
+    OSCIOThread receiver;
+    OSCIOThread sender;
+
+    if (receiver.AddListener(addr) < 0)
+    {
+      printf("could not listen on port %d\n", BENCH_PORT);
+      return 1;
+    }
+
+    sender.AddDestination(addr, 1024, sendIntervalMs);
+    receiver.Start();
+    sender.Start();
+
+    std::thread producer(produce, [&](const char* pMsg, int len) { return sender.Send(pMsg, len); });
+
+    // the consumer, e.g. OSCInterface's timer
+    while (sending || NowNs() - lastReceived < 200000000)
+    {
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(pollMs));
+
+      if (receiver.ProcessIncoming([&](OscMessageRead& msg, int listenerIdx) { ReadBenchMsg(msg, latencies); }))
+        lastReceived = NowNs();
+    }
+
+    producer.join();
+    printf("receive buffer full: %d packets dropped, send queue full: %d times\n", receiver.GetNReceiveDropped(), sender.GetNSendDropped());
+  }
+
+  const double seconds = 1e-9 * (lastReceived - start);
+  PrintResults(legacy ? "old timer design" : "OSCIOThread", latencies, nMsgs, seconds);
+  return 0;
+}
@@ -22,6 +22,8 @@
 #include "heapbuf.h"
 #include "ptrlist.h"
 
+#include "IPlugRTGuard.h"
+
 using namespace hiir;
 
 template<typename T = double>
@@ -168,6 +170,7 @@ public:
       func(mUp2BufferPtrs.GetList(), mDown2BufferPtrs.GetList(), nFrames);
 
       // TODO: move pointers in a better way! TODO: this doesn't actually work
+      RT_GUARD_FLAG("WDL_PtrList allocated per block");
       WDL_PtrList<T> nextInputPtrs;
       WDL_PtrList<T> nextOutputPtrs;
 
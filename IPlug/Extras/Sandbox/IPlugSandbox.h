@@ -0,0 +1,535 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Runs a plug-in's DSP in a child process, with audio buffers and events in shared memory
+ *
+ * IPlugSandboxHost lives in the plug-in that the host loaded. It starts a child process, which runs an IPlugSandboxChild, and forwards
+ * each block to it: the inputs and the block's events are written to shared memory, the child is woken up, and the host waits for the
+ * outputs. If the child crashes or doesn't answer in time the block is silent, the host process carries on, and IsRunning() returns
+ * false so that the plug-in can show it and Restart() the child.
+ *
+ * The shared memory starts with an ISandboxShared header, followed by the input and output buffers and two IMsgRings, one for events
+ * to the child (parameter changes, MIDI, SysEx) and one for messages from it. Each side waits on its own sequence number, with a futex
+ * on Linux, after spinning for a few microseconds if there is more than one core. Other POSIX systems poll the sequence number instead, every 20 us.
+ *
+ * A plug-in built with the headless IPlugBench API and IPlugSandbox_child.cpp is a ready made child, see there.
+ * Windows is not supported yet.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "IPlugPlatform.h"
+
+#ifdef OS_WIN
+  #error "IPlugSandbox is not implemented on Windows yet"
+#endif
+
+#include <spawn.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#ifdef OS_LINUX
+  #include <sched.h>
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+#endif
+
+#include "IPlugConstants.h"
+#include "IPlugMsgRing.h"
+#include "IPlugSharedMemory.h"
+
+extern char** environ;
+
+/** The size of each of the two event rings, in bytes */
+#ifndef SANDBOX_RING_SIZE
+#define SANDBOX_RING_SIZE 65536
+#endif
+
+/** How long each side spins before it sleeps, waiting for the other, in microseconds. There is no spinning on single core machines */
+#ifndef SANDBOX_SPIN_US
+#define SANDBOX_SPIN_US 20
+#endif
+
+/** The first argument of a child's command line */
+#define SANDBOX_ARG "--iplug-sandbox"
+
+enum ESandboxCommand : uint32_t
+{
+  kSandboxProcess = 1,
+  kSandboxReset,
+  kSandboxQuit
+};
+
+/** The start of the shared memory of a sandbox */
+struct ISandboxShared
+{
+  static constexpr uint32_t kMagic = 0x58425350; // "PSBX"
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t mMagic;
+  uint32_t mVersion;
+  uint32_t mSampleSize; // sizeof(sample), both processes must process in the same precision
+  int32_t mNInputs;
+  int32_t mNOutputs;
+  int32_t mMaxBlockSize;
+  uint32_t mRingSize;
+  uint32_t mCommand; // ESandboxCommand
+  double mSampleRate;
+  int32_t mNFrames;
+  alignas(64) std::atomic<uint32_t> mRequest; // incremented by the host for each command
+  alignas(64) std::atomic<uint32_t> mReply; // set to mRequest by the child when it has carried out the command
+
+  /** The offsets of the parts of the shared memory */
+  struct Layout
+  {
+    size_t mInputs, mOutputs, mToChild, mToHost, mSize;
+
+    Layout(int nInputs, int nOutputs, int maxBlockSize, uint32_t ringSize)
+    {
+      auto align = [](size_t v) { return (v + 63) & ~(size_t) 63; };
+      mInputs = align(sizeof(ISandboxShared));
+      mOutputs = align(mInputs + (size_t) nInputs * maxBlockSize * sizeof(sample));
+      mToChild = align(mOutputs + (size_t) nOutputs * maxBlockSize * sizeof(sample));
+      mToHost = align(mToChild + IMsgRing::GetMemorySize(ringSize));
+      mSize = mToHost + IMsgRing::GetMemorySize(ringSize);
+    }
+  };
+
+  /** Waits until word no longer holds value, spinning first
+   * @param timeoutNs The longest time to wait in ns, -1 to wait forever
+   * @return \c false if it timed out */
+  static bool WaitWhile(std::atomic<uint32_t>& word, uint32_t value, int64_t timeoutNs)
+  {
+    using clock = std::chrono::steady_clock;
+    static const bool spin = std::thread::hardware_concurrency() > 1; // on one core, spinning only keeps the other side from running
+    const auto start = clock::now();
+    const auto spinEnd = start + std::chrono::microseconds(spin ? SANDBOX_SPIN_US : 0);
+
+    while (word.load(std::memory_order_acquire) == value)
+    {
+      const auto now = clock::now();
+
+      if (now < spinEnd)
+        continue;
+
+      const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+
+      if (timeoutNs >= 0 && elapsed >= timeoutNs)
+        return false;
+
+#ifdef OS_LINUX
+      const int64_t remaining = timeoutNs >= 0 ? timeoutNs - elapsed : 0;
+      struct timespec ts = { (time_t) (remaining / 1000000000), (long) (remaining % 1000000000) };
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, value, timeoutNs >= 0 ? &ts : nullptr, nullptr, 0);
+#else
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+#endif
+    }
+
+    return true;
+  }
+
+  static void Wake(std::atomic<uint32_t>& word)
+  {
+#ifdef OS_LINUX
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+  }
+};
+
+/** The DSP side of a sandbox, implemented in the child process */
+class ISandboxProcessor
+{
+public:
+  virtual ~ISandboxProcessor() {}
+
+  /** Called before the first block
+   * @param nInputs, nOutputs The number of buffers ProcessBlock() gets */
+  virtual void OnReset(double sampleRate, int maxBlockSize, int nInputs, int nOutputs) = 0;
+
+  /** Called for each event of the next block: kMsgParamValue with the normalized value and the sample offset in mTag, kMsgMidiMsg
+   * and kMsgSysEx, or kMsgArbitraryMsg */
+  virtual void OnMsg(const IMsgRecord& record) = 0;
+
+  virtual void ProcessBlock(sample** inputs, sample** outputs, int nFrames) = 0;
+};
+
+/** The child process side of a sandbox */
+class IPlugSandboxChild
+{
+public:
+  /** @return \c true if the command line is that of a child started by IPlugSandboxHost */
+  static bool IsSandboxCommandLine(int argc, char* argv[])
+  {
+    return argc >= 3 && !strcmp(argv[1], SANDBOX_ARG);
+  }
+
+  /** Carries out the host's commands until it quits or goes away
+   * @return The process exit code */
+  int Run(int argc, char* argv[], ISandboxProcessor& processor)
+  {
+    if (!IsSandboxCommandLine(argc, argv))
+      return 1;
+
+    const pid_t parent = getppid();
+    const int cpu = argc >= 4 ? atoi(argv[3]) : -1;
+    ISharedMemory shm;
+
+    if (!shm.Open(argv[2], sizeof(ISandboxShared)))
+      return 1;
+
+    ISandboxShared* pShared = static_cast<ISandboxShared*>(shm.Get());
+
+    if (pShared->mMagic != ISandboxShared::kMagic || pShared->mVersion != ISandboxShared::kVersion || pShared->mSampleSize != sizeof(sample))
+      return 1;
+
+    const ISandboxShared::Layout layout(pShared->mNInputs, pShared->mNOutputs, pShared->mMaxBlockSize, pShared->mRingSize);
+
+    if (!shm.Open(argv[2], layout.mSize))
+      return 1;
+
+    pShared = static_cast<ISandboxShared*>(shm.Get());
+    uint8_t* pMem = static_cast<uint8_t*>(shm.Get());
+
+    if (!mToChild.Attach(pMem + layout.mToChild, IMsgRing::GetMemorySize(pShared->mRingSize))
+        || !mToHost.Attach(pMem + layout.mToHost, IMsgRing::GetMemorySize(pShared->mRingSize)))
+      return 1;
+
+    if (pShared->mNInputs > kMaxChannels || pShared->mNOutputs > kMaxChannels)
+      return 1;
+
+    mNInputs = pShared->mNInputs;
+    mNOutputs = pShared->mNOutputs;
+
+    for (int c = 0; c < mNInputs; c++)
+      mInputs[c] = reinterpret_cast<sample*>(pMem + layout.mInputs) + c * pShared->mMaxBlockSize;
+
+    for (int c = 0; c < mNOutputs; c++)
+      mOutputs[c] = reinterpret_cast<sample*>(pMem + layout.mOutputs) + c * pShared->mMaxBlockSize;
+
+    PinToCPU(cpu);
+
+    uint32_t request = pShared->mReply.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+      if (!ISandboxShared::WaitWhile(pShared->mRequest, request, 1000000000))
+      {
+        if (getppid() != parent) // the host process is gone
+          return 0;
+
+        continue;
+      }
+
+      request = pShared->mRequest.load(std::memory_order_acquire);
+      const uint32_t command = pShared->mCommand;
+
+      if (command == kSandboxReset)
+        processor.OnReset(pShared->mSampleRate, pShared->mMaxBlockSize, mNInputs, mNOutputs);
+      else if (command == kSandboxProcess)
+      {
+        mToChild.Read([&](const IMsgRecord& record) { processor.OnMsg(record); });
+        processor.ProcessBlock(mInputs, mOutputs, pShared->mNFrames);
+        mToHost.Flush();
+      }
+
+      pShared->mReply.store(request, std::memory_order_release);
+      ISandboxShared::Wake(pShared->mReply);
+
+      if (command == kSandboxQuit)
+        return 0;
+    }
+  }
+
+  /** Messages to the host, e.g. MIDI output. Add them in ISandboxProcessor::ProcessBlock(), they are flushed at the end of it */
+  IMsgRing& GetMsgsToHost() { return mToHost; }
+
+private:
+  static constexpr int kMaxChannels = 64;
+
+  static void PinToCPU(int cpu)
+  {
+#ifdef OS_LINUX
+    if (cpu >= 0)
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+
+      if (sched_setaffinity(0, sizeof(set), &set))
+        perror("IPlugSandboxChild: sched_setaffinity");
+    }
+#endif
+  }
+
+  IMsgRing mToChild;
+  IMsgRing mToHost;
+  int mNInputs = 0;
+  int mNOutputs = 0;
+  sample* mInputs[kMaxChannels] = {};
+  sample* mOutputs[kMaxChannels] = {};
+};
+
+/** The host process side of a sandbox. Start(), Stop() and Restart() are called on the main thread while the plug-in is not processing,
+ * e.g. in OnReset(). IsRunning() is polled on the main thread, which owns the child process and reaps it. The other methods are called on the audio thread */
+class IPlugSandboxHost
+{
+public:
+  IPlugSandboxHost() = default;
+  IPlugSandboxHost(const IPlugSandboxHost&) = delete;
+  IPlugSandboxHost& operator=(const IPlugSandboxHost&) = delete;
+
+  ~IPlugSandboxHost() { Stop(); }
+
+  /** Starts the child process and waits for it to reset
+   * @param childPath The child executable, it is started with the arguments SANDBOX_ARG, the shared memory name and cpu
+   * @param cpu The CPU to pin the child to on Linux, -1 for any
+   * @return \c false if the child could not be started, or didn't answer within a few seconds */
+  bool Start(const char* childPath, int nInputs, int nOutputs, int maxBlockSize, double sampleRate, int cpu = -1)
+  {
+    Stop();
+
+    if (nInputs < 0 || nOutputs < 0 || nInputs > kMaxChannels || nOutputs > kMaxChannels || maxBlockSize <= 0)
+      return false;
+
+    mChildPath.Set(childPath);
+    mNInputs = nInputs;
+    mNOutputs = nOutputs;
+    mMaxBlockSize = maxBlockSize;
+    mSampleRate = sampleRate;
+    mCPU = cpu;
+    mNConsecutiveMissed = 0;
+    mChildFailed.store(false);
+
+    static std::atomic<int> sInstance {0};
+    char name[64];
+    snprintf(name, sizeof(name), "/iplug-sbx-%d-%d", (int) getpid(), sInstance++);
+
+    const ISandboxShared::Layout layout(nInputs, nOutputs, maxBlockSize, SANDBOX_RING_SIZE);
+
+    if (!mShm.Create(name, layout.mSize))
+      return false;
+
+    uint8_t* pMem = static_cast<uint8_t*>(mShm.Get());
+    mShared = new (pMem) ISandboxShared;
+    mShared->mSampleSize = sizeof(sample);
+    mShared->mNInputs = nInputs;
+    mShared->mNOutputs = nOutputs;
+    mShared->mMaxBlockSize = maxBlockSize;
+    mShared->mRingSize = SANDBOX_RING_SIZE;
+    mShared->mSampleRate = sampleRate;
+    mShared->mCommand = kSandboxReset;
+    mShared->mNFrames = 0;
+    mShared->mRequest.store(0, std::memory_order_relaxed);
+    mShared->mReply.store(0, std::memory_order_relaxed);
+    mShared->mVersion = ISandboxShared::kVersion;
+    mShared->mMagic = ISandboxShared::kMagic;
+
+    mToChild.Init(pMem + layout.mToChild, IMsgRing::GetMemorySize(SANDBOX_RING_SIZE));
+    mToHost.Init(pMem + layout.mToHost, IMsgRing::GetMemorySize(SANDBOX_RING_SIZE));
+    mInputs = reinterpret_cast<sample*>(pMem + layout.mInputs);
+    mOutputs = reinterpret_cast<sample*>(pMem + layout.mOutputs);
+
+    char cpuStr[16];
+    snprintf(cpuStr, sizeof(cpuStr), "%d", cpu);
+    char* argv[] = { const_cast<char*>(childPath), const_cast<char*>(SANDBOX_ARG), name, cpuStr, nullptr };
+
+    if (posix_spawn(&mPID, childPath, nullptr, nullptr, argv, environ))
+    {
+      mPID = -1;
+      Stop();
+      return false;
+    }
+
+    mRunning.store(true);
+
+    if (!SendCommand(kSandboxReset, 0, 5000000000LL))
+    {
+      Stop();
+      return false;
+    }
+
+    return true;
+  }
+
+  /** Starts a new child with the settings of the last Start(), e.g. after it crashed */
+  bool Restart()
+  {
+    WDL_String path(mChildPath);
+    return Start(path.Get(), mNInputs, mNOutputs, mMaxBlockSize, mSampleRate, mCPU);
+  }
+
+  /** Asks the child to quit, and kills it if it doesn't */
+  void Stop()
+  {
+    if (mPID > 0)
+    {
+      if (mRunning.load() && !mChildFailed.load() && !mPending)
+        SendCommand(kSandboxQuit, 0, 1000000000LL);
+
+      ReapChild(true);
+    }
+
+    mRunning.store(false);
+    mPending = false;
+    mShared = nullptr;
+    mShm.Close();
+  }
+
+  /** Poll this from the main thread, e.g. in OnIdle(). A child that has exited is reaped here, and one that the audio thread gave up on is killed
+   * @return \c false if the child crashed, hung or was never started */
+  bool IsRunning()
+  {
+    if (mRunning.load() && mPID > 0)
+      ReapChild(mChildFailed.load());
+
+    return mRunning.load();
+  }
+
+  /** @return The number of blocks that were silent because the child didn't answer in time */
+  int GetNMissedBlocks() const { return mNMissedBlocks.load(std::memory_order_relaxed); }
+
+  /** Sets how long ProcessBlock() waits for the child, by default as long as the block lasts in real time */
+  void SetTimeout(double ms) { mTimeoutMs = ms; }
+
+  /** Queues a parameter change for the next block, IMsgRecord::mTag is the sample offset */
+  bool AddParamChange(int paramIdx, double normalizedValue, int sampleOffset = 0)
+  {
+    return mToChild.Add(kMsgParamValue, IMsgRecord::kNormalized, paramIdx, sampleOffset, normalizedValue);
+  }
+
+  /** Queues a MIDI message for the next block, msg.mOffset is the offset in that block */
+  bool AddMidiMsg(const IMidiMsg& msg) { return mToChild.AddMidiMsg(msg); }
+  bool AddSysEx(const ISysEx& msg) { return mToChild.AddSysEx(msg.mOffset, msg.mSize, msg.mData); }
+  bool AddArbitraryMsg(int messageTag, int dataSize, const void* pData) { return mToChild.AddArbitraryMsg(messageTag, kNoTag, dataSize, pData); }
+
+  /** Processes a block in the child
+   * @return \c false if the outputs are silent, because the child didn't answer in time or isn't running */
+  bool ProcessBlock(sample** inputs, sample** outputs, int nFrames)
+  {
+    const bool running = mRunning.load(std::memory_order_acquire) && !mChildFailed.load(std::memory_order_relaxed);
+
+    if (running && mPending && mShared->mReply.load(std::memory_order_acquire) == mShared->mRequest.load(std::memory_order_relaxed))
+      mPending = false; // the late block is done, the buffers are ours again
+
+    if (!running || mPending || nFrames > mMaxBlockSize)
+    {
+      OnMissedBlock();
+      ClearOutputs(outputs, nFrames);
+      return false;
+    }
+
+    for (int c = 0; c < mNInputs; c++)
+      memcpy(mInputs + c * mMaxBlockSize, inputs[c], nFrames * sizeof(sample));
+
+    const int64_t timeoutNs = (int64_t) (1e6 * (mTimeoutMs > 0. ? mTimeoutMs : 1e3 * nFrames / mSampleRate));
+
+    if (!SendCommand(kSandboxProcess, nFrames, timeoutNs))
+    {
+      mPending = true;
+      OnMissedBlock();
+      ClearOutputs(outputs, nFrames);
+      return false;
+    }
+
+    for (int c = 0; c < mNOutputs; c++)
+      memcpy(outputs[c], mOutputs + c * mMaxBlockSize, nFrames * sizeof(sample));
+
+    mNConsecutiveMissed = 0;
+    return true;
+  }
+
+  /** Calls func(const IMsgRecord&) for each message the child sent since the last call */
+  template <typename F>
+  int ReadMsgsFromChild(F func) { return mToHost.Read(func); }
+
+private:
+  static constexpr int kMaxChannels = 64;
+
+  bool SendCommand(ESandboxCommand command, int nFrames, int64_t timeoutNs)
+  {
+    mToChild.Flush();
+    mShared->mCommand = command;
+    mShared->mNFrames = nFrames;
+    const uint32_t request = mShared->mRequest.load(std::memory_order_relaxed);
+    mShared->mRequest.store(request + 1, std::memory_order_release);
+    ISandboxShared::Wake(mShared->mRequest);
+    return ISandboxShared::WaitWhile(mShared->mReply, request, timeoutNs);
+  }
+
+  /** Called on the audio thread. A crashed child never answers, so after the first missed block mPending keeps the audio thread from waiting on it again */
+  void OnMissedBlock()
+  {
+    if (!mRunning.load(std::memory_order_relaxed) || mChildFailed.load(std::memory_order_relaxed))
+      return;
+
+    mNMissedBlocks.fetch_add(1, std::memory_order_relaxed);
+
+    // a child that has been late for this long has crashed or hung, the main thread reaps it in IsRunning()
+    if (++mNConsecutiveMissed * 1e3 * mMaxBlockSize / mSampleRate > 1000.)
+      mChildFailed.store(true, std::memory_order_release);
+  }
+
+  /** Called on the main thread only
+   * @param kill If \c true the child is killed if it is still alive, otherwise it is only reaped if it has exited */
+  void ReapChild(bool kill)
+  {
+    int status;
+
+    if (waitpid(mPID, &status, WNOHANG) != mPID)
+    {
+      if (!kill)
+        return;
+
+      ::kill(mPID, SIGKILL);
+      waitpid(mPID, &status, 0);
+    }
+
+    mPID = -1;
+    mRunning.store(false, std::memory_order_release);
+  }
+
+  void ClearOutputs(sample** outputs, int nFrames)
+  {
+    for (int c = 0; c < mNOutputs; c++)
+      memset(outputs[c], 0, nFrames * sizeof(sample));
+  }
+
+  ISharedMemory mShm;
+  ISandboxShared* mShared = nullptr;
+  IMsgRing mToChild;
+  IMsgRing mToHost;
+  sample* mInputs = nullptr;
+  sample* mOutputs = nullptr;
+  pid_t mPID = -1; // only touched on the main thread
+  std::atomic<bool> mRunning {false}; // cleared on the main thread when the child is reaped
+  std::atomic<bool> mChildFailed {false}; // set on the audio thread when the child has stopped answering
+  std::atomic<int> mNMissedBlocks {0};
+  bool mPending = false; // the child still has the last block
+  int mNConsecutiveMissed = 0; // only touched on the audio thread
+  double mTimeoutMs = 0.;
+
+  WDL_String mChildPath;
+  int mNInputs = 0;
+  int mNOutputs = 0;
+  int mMaxBlockSize = 0;
+  double mSampleRate = 44100.;
+  int mCPU = -1;
+};
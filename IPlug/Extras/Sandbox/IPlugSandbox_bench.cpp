@@ -0,0 +1,267 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark of the round trip latency and CPU cost that IPlugSandboxHost adds to each block
+ *
+ * Processes -n blocks of -b frames through a simple filter, first in process, then in a sandbox child, which is this executable started
+ * again with the sandbox arguments (or the sandbox child given with -x, e.g. a plug-in built with IPlugSandbox_child.cpp). Prints the
+ * distribution of the time each ProcessBlock() call takes, and the CPU time per block of both processes. With -p, blocks are issued
+ * at the pace of a real audio device instead of back to back, so that the child sleeps between blocks as it would in a host.
+ * With -k, the child crashes at that block, to show the host carrying on, and then restarts it.
+ *
+ * Build on Linux with:
+ *
+ *   g++ -O2 -std=c++14 -Wno-multichar -DNOMINMAX -DSAMPLE_TYPE_FLOAT -IIPlug -IWDL IPlug/Extras/Sandbox/IPlugSandbox_bench.cpp -lpthread -lrt -o sandboxbench
+ *
+ * Use the same SAMPLE_TYPE as the child given with -x.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <sys/resource.h>
+
+#include "IPlugSandbox.h"
+
+struct Options
+{
+  int nBlocks = 20000;
+  int blockSize = 64;
+  double sampleRate = 48000.;
+  int nChans = 2;
+  int work = 1;
+  int crashAt = -1;
+  int cpu = -1;
+  bool paced = false;
+  const char* childPath = nullptr;
+};
+
+/** A one pole low pass filter, run work times per sample */
+class FilterProcessor : public ISandboxProcessor
+{
+public:
+  FilterProcessor(int work, int crashAt)
+  : mWork(work), mCrashAt(crashAt)
+  {
+  }
+
+  void OnReset(double sampleRate, int maxBlockSize, int nInputs, int nOutputs) override
+  {
+    mNChans = std::min(nInputs, nOutputs);
+    mState.assign(mNChans, 0.);
+    mBlock = 0;
+  }
+
+  void OnMsg(const IMsgRecord& record) override
+  {
+    if (record.mType == kMsgParamValue)
+      mCoeff = 0.01 + 0.98 * record.mValue;
+  }
+
+  void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override
+  {
+    if (mBlock++ == mCrashAt)
+      abort();
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      double s = mState[c];
+
+      for (int i = 0; i < nFrames; i++)
+      {
+        for (int w = 0; w < mWork; w++)
+          s += mCoeff * (inputs[c][i] - s);
+
+        outputs[c][i] = (sample) s;
+      }
+
+      mState[c] = s;
+    }
+  }
+
+private:
+  int mWork;
+  int mCrashAt;
+  int mNChans = 0;
+  int mBlock = 0;
+  double mCoeff = 0.5;
+  std::vector<double> mState;
+};
+
+static double CPUSeconds(int who)
+{
+  rusage usage;
+  getrusage(who, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+static double NowSeconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void PrintResults(const char* name, std::vector<double>& times, double cpuPerBlock, double childCpuPerBlock)
+{
+  std::sort(times.begin(), times.end());
+  const size_t n = times.size();
+  auto percentile = [&](double p) { return n ? times[std::min(n - 1, (size_t) (p * n))] : 0.; };
+
+  printf("%-12s p50 %7.2f  p99 %7.2f  p99.9 %7.2f  max %8.2f us per block, CPU per block: host %6.2f us, child %6.2f us\n", name,
+         percentile(0.5), percentile(0.99), percentile(0.999), n ? times.back() : 0., cpuPerBlock, childCpuPerBlock);
+}
+
+/** Processes the blocks, returns the time each ProcessBlock() took in us */
+template <typename F>
+static std::vector<double> Run(const Options& o, F process)
+{
+  std::vector<std::vector<sample>> in(o.nChans, std::vector<sample>(o.blockSize)), out(o.nChans, std::vector<sample>(o.blockSize));
+  std::vector<sample*> inputs, outputs;
+
+  for (int c = 0; c < o.nChans; c++)
+  {
+    inputs.push_back(in[c].data());
+    outputs.push_back(out[c].data());
+  }
+
+  std::vector<double> times;
+  times.reserve(o.nBlocks);
+  const double blockDuration = o.blockSize / o.sampleRate;
+  const double start = NowSeconds();
+  int64_t frame = 0;
+
+  for (int b = 0; b < o.nBlocks; b++)
+  {
+    if (o.paced)
+    {
+      const double deadline = start + b * blockDuration;
+      std::this_thread::sleep_for(std::chrono::duration<double>(std::max(0., deadline - NowSeconds())));
+    }
+
+    for (int c = 0; c < o.nChans; c++)
+    {
+      for (int i = 0; i < o.blockSize; i++)
+        in[c][i] = (sample) std::sin(0.01 * (frame + i));
+    }
+
+    frame += o.blockSize;
+    const double t0 = NowSeconds();
+    process(b, inputs.data(), outputs.data());
+    times.push_back(1e6 * (NowSeconds() - t0));
+  }
+
+  return times;
+}
+
+int main(int argc, char* argv[])
+{
+  Options o;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], SANDBOX_ARG))
+    {
+      // started as the child: the work and crash settings are in the environment
+      FilterProcessor processor(atoi(getenv("SANDBOXBENCH_WORK")), atoi(getenv("SANDBOXBENCH_CRASH")));
+      IPlugSandboxChild child;
+      return child.Run(argc, argv, processor);
+    }
+    else if (!strcmp(argv[i], "-p"))
+      o.paced = true;
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      o.nBlocks = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      o.blockSize = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      o.sampleRate = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      o.nChans = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      o.work = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+      o.crashAt = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-cpu") && i + 1 < argc)
+      o.cpu = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-x") && i + 1 < argc)
+      o.childPath = argv[++i];
+    else
+    {
+      printf("usage: %s [-p] [-n blocks] [-b block size] [-r sample rate] [-c channels] [-w filter passes] [-k crash at block] [-cpu child cpu] [-x child]\n", argv[0]);
+      printf("  -p  issue blocks at the pace of an audio device\n");
+      return 1;
+    }
+  }
+
+  char work[16], crash[16];
+  snprintf(work, sizeof(work), "%d", o.work);
+  snprintf(crash, sizeof(crash), "%d", o.crashAt);
+  setenv("SANDBOXBENCH_WORK", work, 1);
+  setenv("SANDBOXBENCH_CRASH", crash, 1);
+
+  printf("%d blocks of %d frames at %.0f Hz, %d channels, %s, %s precision\n", o.nBlocks, o.blockSize, o.sampleRate, o.nChans,
+         o.paced ? "paced" : "back to back", sizeof(sample) == sizeof(double) ? "double" : "float");
+
+  // in process
+  {
+    FilterProcessor processor(o.work, -1);
+    processor.OnReset(o.sampleRate, o.blockSize, o.nChans, o.nChans);
+    const double cpu0 = CPUSeconds(RUSAGE_SELF);
+    std::vector<double> times = Run(o, [&](int block, sample** inputs, sample** outputs) {
+      processor.ProcessBlock(inputs, outputs, o.blockSize);
+    });
+    PrintResults("in process", times, 1e6 * (CPUSeconds(RUSAGE_SELF) - cpu0) / o.nBlocks, 0.);
+  }
+
+  // sandboxed
+  {
+    IPlugSandboxHost host;
+    char self[4096];
+    const ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    self[len > 0 ? len : 0] = 0;
+
+    if (!host.Start(o.childPath ? o.childPath : self, o.nChans, o.nChans, o.blockSize, o.sampleRate, o.cpu))
+    {
+      printf("could not start the sandbox child\n");
+      return 1;
+    }
+
+    host.AddParamChange(0, 0.5);
+    int nSilent = 0;
+    int restartedAt = -1;
+    const double cpu0 = CPUSeconds(RUSAGE_SELF);
+
+    std::vector<double> times = Run(o, [&](int block, sample** inputs, sample** outputs) {
+      if (!host.ProcessBlock(inputs, outputs, o.blockSize))
+        nSilent++;
+
+      if (!host.IsRunning() && restartedAt < 0) // in a plug-in, this would be noticed in OnIdle()
+      {
+        restartedAt = block;
+        setenv("SANDBOXBENCH_CRASH", "-1", 1);
+        host.Restart();
+      }
+    });
+
+    const double hostCpu = CPUSeconds(RUSAGE_SELF) - cpu0;
+    host.Stop();
+    const double childCpu = CPUSeconds(RUSAGE_CHILDREN);
+    PrintResults("sandboxed", times, 1e6 * hostCpu / o.nBlocks, 1e6 * childCpu / o.nBlocks);
+
+    if (nSilent || restartedAt >= 0)
+      printf("%d silent blocks, child restarted at block %d\n", nSilent, restartedAt);
+  }
+
+  return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief The main() of a sandbox child process that runs a plug-in built with the headless IPlugBench API
+ *
+ * Build it like the bench tool, with this file instead of IPlugBench_main.cpp, e.g. from Examples/IPlugEffect:
+ *
+ *   make -f projects/IPlugEffect-bench.mk BENCH_MAIN=../../IPlug/Extras/Sandbox/IPlugSandbox_child.cpp TARGET=./build-bench/IPlugEffect-sandbox
+ *
+ * and pass the executable to IPlugSandboxHost::Start() in the plug-in the host loads. Parameter changes and MIDI from the host are
+ * applied at their sample offsets. MIDI output is not forwarded yet.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugBench.h"
+#include "IPlugSandbox.h"
+
+#include "config.h"
+
+class BenchSandboxProcessor : public ISandboxProcessor
+{
+public:
+  BenchSandboxProcessor(IPlugBench& plug)
+  : mPlug(plug)
+  {
+  }
+
+  void OnReset(double sampleRate, int maxBlockSize, int nInputs, int nOutputs) override
+  {
+    mPlug.BenchReset(sampleRate, maxBlockSize);
+    mMaxBlockSize = maxBlockSize;
+    mNInputs = nInputs;
+    mNOutputs = nOutputs;
+    mScratch.assign((size_t) 2 * maxBlockSize, 0.);
+    mInputs.resize(mPlug.MaxNChannels(ERoute::kInput));
+    mOutputs.resize(mPlug.MaxNChannels(ERoute::kOutput));
+  }
+
+  void OnMsg(const IMsgRecord& record) override
+  {
+    if (record.mType == kMsgParamValue && record.mIdx >= 0 && record.mIdx < mPlug.NParams())
+      mPlug.BenchSetParameterValue(record.mIdx, record.mValue, record.mTag);
+    else if (record.mType == kMsgMidiMsg)
+      mPlug.BenchProcessMidiMsg(IMidiMsg(record.mIdx, record.mTag & 0xFF, (record.mTag >> 8) & 0xFF, (record.mTag >> 16) & 0xFF));
+  }
+
+  void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override
+  {
+    // the plug-in's channels that the host has no buffers for read silence, and write into scratch space
+    for (size_t c = 0; c < mInputs.size(); c++)
+      mInputs[c] = (int) c < mNInputs ? inputs[c] : mScratch.data();
+
+    for (size_t c = 0; c < mOutputs.size(); c++)
+      mOutputs[c] = (int) c < mNOutputs ? outputs[c] : mScratch.data() + mMaxBlockSize;
+
+    mPlug.BenchProcess(mInputs.data(), mOutputs.data(), nFrames);
+  }
+
+private:
+  IPlugBench& mPlug;
+  int mMaxBlockSize = 0;
+  int mNInputs = 0;
+  int mNOutputs = 0;
+  std::vector<sample> mScratch;
+  std::vector<sample*> mInputs;
+  std::vector<sample*> mOutputs;
+};
+
+int main(int argc, char** argv)
+{
+  if (!IPlugSandboxChild::IsSandboxCommandLine(argc, argv))
+  {
+    fprintf(stderr, "%s is started by IPlugSandboxHost\n", argv[0]);
+    return 1;
+  }
+
+  IPlugBench* pPlug = MakePlug();
+  BenchSandboxProcessor processor(*pPlug);
+  IPlugSandboxChild child;
+  const int result = child.Run(argc, argv, processor);
+  delete pPlug;
+  return result;
+}
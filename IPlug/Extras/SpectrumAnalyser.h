@@ -0,0 +1,318 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc SpectrumAnalyser
+ */
+
+#include <atomic>
+#include <thread>
+#include <cmath>
+
+#include "fft.h"
+#include "heapbuf.h"
+
+#include "IPlugConstants.h"
+#include "IPlugUtilities.h"
+#include "IPlugQueue.h"
+#include "IPlugSemaphore.h"
+#include "IPlugEditorDelegate.h"
+
+/** A realtime spectrum analysis pipeline for spectrum displays such as IVSpectrumAnalyserControl.
+ * The audio thread only copies samples into a lock-free ring per channel, and wakes a worker thread each time a hop's worth has arrived.
+ * The worker does the windowing (Hann), the FFT (WDL_real_fft), averaging of the power spectrum over time and log frequency binning.
+ * A block that would overwrite samples the worker has not finished with is skipped and counted, see GetNSkippedBlocks().
+ * Finished frames are queued for the main thread, where TransmitData()
+ * sends the most recent one to a control via IEditorDelegate::SendControlMsgFromDelegate(), so at most one frame is delivered per call.
+ * The message is a Data struct: int nChans, int nBins, float minFreq, float maxFreq, then nBins float dB values per channel (MAXBINS apart)
+ * NOTE: WDL/fft.c must be compiled in your project
+ * @tparam MAXNC The maximum number of channels
+ * @tparam MAXBINS The maximum number of log frequency bins that are delivered */
+template <int MAXNC = 2, int MAXBINS = 256>
+class SpectrumAnalyser
+{
+public:
+  static constexpr int kUpdateMessage = 0;
+  static constexpr int kMaxFFTSize = 32768;
+
+  /* Data packet */
+  struct Data
+  {
+    int nChans = MAXNC;
+    int nBins = MAXBINS;
+    float minFreq = 20.f;
+    float maxFreq = 20000.f;
+    float vals[MAXNC][MAXBINS] = {};
+  };
+
+  /** @param controlTag The tag of the control that will receive the data
+   * @param nChans The number of channels to analyse, up to MAXNC
+   * @param fftSize The FFT size, a power of 2 between 16 and 32768
+   * @param overlap The number of frames per fftSize samples, 4 means 75% overlap
+   * @param nBins The number of log frequency bins to deliver, up to MAXBINS
+   * @param maxBlockSize The largest block that will be passed to ProcessBlock(), which the ring is sized for */
+  SpectrumAnalyser(int controlTag, int nChans = MAXNC, int fftSize = 2048, int overlap = 4, int nBins = MAXBINS, int maxBlockSize = 8192)
+  : mControlTag(controlTag)
+  , mNChans(std::min(nChans, MAXNC))
+  , mFFTSize(Clip(fftSize, 16, kMaxFFTSize))
+  , mHopSize(std::max(mFFTSize / std::max(overlap, 1), 1))
+  , mNBins(Clip(nBins, 1, MAXBINS))
+  {
+    WDL_fft_init();
+
+    // room for a frame the worker is still reading, the hops it has yet to get to and a whole block
+    int ringSize = 1;
+    while(ringSize < std::max(mFFTSize * 4, 2 * (mFFTSize + std::max(maxBlockSize, 1)))) ringSize <<= 1;
+    mRingMask = ringSize - 1;
+    mRing.Resize(MAXNC * ringSize);
+    memset(mRing.Get(), 0, mRing.GetSize() * sizeof(float));
+
+    mWindow.Resize(mFFTSize);
+    float windowSum = 0.f;
+    for (auto i = 0; i < mFFTSize; i++)
+    {
+      mWindow.Get()[i] = 0.5f - 0.5f * std::cos(2.f * PI * i / (float) mFFTSize);
+      windowSum += mWindow.Get()[i];
+    }
+
+    // WDL_real_fft() output is twice the size of the usual one sided spectrum, so this makes a full scale sine read 0dB
+    mMagnitudeScale = 1.f / windowSum;
+
+    mFFTBuffer.Resize(mFFTSize);
+    mPower.Resize(MAXNC * (mFFTSize / 2 + 1));
+    memset(mPower.Get(), 0, mPower.GetSize() * sizeof(float));
+
+    SetSampleRate(DEFAULT_SAMPLE_RATE);
+
+    mWorker = std::thread(&SpectrumAnalyser::WorkerLoop, this);
+  }
+
+  ~SpectrumAnalyser()
+  {
+    mQuit = true;
+    mWakeWorker.Signal();
+    mWorker.join();
+  }
+
+  SpectrumAnalyser(const SpectrumAnalyser&) = delete;
+  SpectrumAnalyser& operator=(const SpectrumAnalyser&) = delete;
+
+  /** Call this from OnReset(), it sets the frequency range of the log bins
+   * @param sampleRate The sample rate
+   * @param minFreq The frequency of the lowest bin */
+  void SetSampleRate(double sampleRate, float minFreq = 20.f)
+  {
+    mSampleRate.store(sampleRate);
+    mMinFreq.store(minFreq);
+    mBinMapDirty = true;
+  }
+
+  /** @param averaging The amount of averaging between frames, from 0 (none) to just below 1 (very slow) */
+  void SetAveraging(float averaging)
+  {
+    mAveraging.store(Clip(averaging, 0.f, 0.999f));
+  }
+
+  /** Call this on the audio thread. It only copies samples, all the analysis happens on the worker thread.
+   * If the worker has fallen so far behind that the block would overwrite samples it still needs, the block is skipped */
+  void ProcessBlock(sample** inputs, int nFrames)
+  {
+    const uint32_t writePos = mWritePos.load(std::memory_order_relaxed);
+    const int ringSize = mRingMask + 1;
+
+    if(writePos + nFrames - mReadPos.load(std::memory_order_acquire) > (uint32_t) ringSize)
+    {
+      mNSkippedBlocks.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    for (auto c = 0; c < mNChans; c++)
+    {
+      float* pRing = mRing.Get() + (c * ringSize);
+
+      for (auto s = 0; s < nFrames; s++)
+        pRing[(writePos + s) & mRingMask] = (float) inputs[c][s];
+    }
+
+    mWritePos.store(writePos + nFrames, std::memory_order_release);
+
+    // wake the worker once for each frame that is now complete
+    for (mSamplesToNextFrame -= nFrames; mSamplesToNextFrame <= 0; mSamplesToNextFrame += mHopSize)
+      mWakeWorker.Signal();
+  }
+
+  /** @return The number of blocks skipped by ProcessBlock() because the worker had fallen behind */
+  int GetNSkippedBlocks() const { return mNSkippedBlocks.load(std::memory_order_relaxed); }
+
+  /** This must be called on the main thread - typically in MyPlugin::OnIdle(). Only the most recent frame is sent */
+  void TransmitData(IEditorDelegate& dlg)
+  {
+    bool hasData = false;
+
+    while(mQueue.ElementsAvailable())
+    {
+      mQueue.Pop(mTransmitData);
+      hasData = true;
+    }
+
+    if(hasData)
+      dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &mTransmitData);
+  }
+
+private:
+  void WorkerLoop()
+  {
+    uint32_t readPos = 0;
+
+    while(true)
+    {
+      mWakeWorker.Wait();
+
+      if(mQuit)
+        return;
+
+      const uint32_t writePos = mWritePos.load(std::memory_order_acquire);
+      bool processed = false;
+
+      while(writePos - readPos >= (uint32_t) mFFTSize && !mQuit)
+      {
+        ProcessFrame(readPos);
+        readPos += mHopSize;
+        mReadPos.store(readPos, std::memory_order_release); // the audio thread may now overwrite the samples before readPos
+        processed = true;
+      }
+
+      if(processed)
+        mQueue.Push(mData);
+    }
+  }
+
+  void ProcessFrame(uint32_t startPos)
+  {
+    if(mBinMapDirty.exchange(false))
+      BuildBinMap();
+
+    const int ringSize = mRingMask + 1;
+    const int nPowerBins = mFFTSize / 2 + 1;
+    const float averaging = mAveraging.load();
+    const float scale = mMagnitudeScale * mMagnitudeScale;
+    WDL_FFT_REAL* pFFT = mFFTBuffer.Get();
+
+    for (auto c = 0; c < mNChans; c++)
+    {
+      const float* pRing = mRing.Get() + (c * ringSize);
+
+      for (auto i = 0; i < mFFTSize; i++)
+        pFFT[i] = pRing[(startPos + i) & mRingMask] * mWindow.Get()[i];
+
+      WDL_real_fft(pFFT, mFFTSize, 0);
+
+      const WDL_FFT_COMPLEX* pBins = (WDL_FFT_COMPLEX*) pFFT;
+      float* pPower = mPower.Get() + (c * nPowerBins);
+
+      for (auto b = 0; b < nPowerBins; b++)
+      {
+        float power;
+
+        if(b == 0)
+          power = pBins[0].re * pBins[0].re;
+        else if(b == nPowerBins - 1)
+          power = pBins[0].im * pBins[0].im; // nyquist is packed into the imaginary part of the first bin
+        else
+        {
+          const WDL_FFT_COMPLEX& bin = pBins[mPermute[b]];
+          power = bin.re * bin.re + bin.im * bin.im;
+        }
+
+        pPower[b] = averaging * pPower[b] + (1.f - averaging) * power * scale;
+      }
+
+      for (auto b = 0; b < mNBins; b++)
+      {
+        const int lo = mBinMap[b];
+        const int hi = mBinMap[b + 1];
+        float binPower = 0.f;
+
+        // take the loudest FFT bin, so that peaks don't disappear between log bins
+        for (auto i = lo; i < hi; i++)
+          binPower = std::max(binPower, pPower[i]);
+
+        mData.vals[c][b] = 10.f * std::log10(binPower + 1e-20f);
+      }
+    }
+  }
+
+  void BuildBinMap()
+  {
+    const float sampleRate = (float) mSampleRate.load();
+    const float nyquist = sampleRate / 2.f;
+    const float minFreq = Clip(mMinFreq.load(), 1.f, nyquist / 2.f);
+    const int nPowerBins = mFFTSize / 2 + 1;
+    const float binWidth = sampleRate / (float) mFFTSize;
+
+    for (auto b = 0; b <= mNBins; b++)
+    {
+      const float freq = minFreq * std::pow(nyquist / minFreq, (float) b / (float) mNBins);
+      mBinMap[b] = Clip((int) std::round(freq / binWidth), 0, nPowerBins - 1);
+    }
+
+    // each log bin covers at least one FFT bin
+    for (auto b = 0; b < mNBins; b++)
+    {
+      if(mBinMap[b + 1] <= mBinMap[b])
+        mBinMap[b + 1] = std::min(mBinMap[b] + 1, nPowerBins);
+    }
+
+    for (auto b = 1; b < nPowerBins - 1; b++)
+      mPermute[b] = WDL_fft_permute(mFFTSize / 2, b);
+
+    mData.nChans = mNChans;
+    mData.nBins = mNBins;
+    mData.minFreq = minFreq;
+    mData.maxFreq = nyquist;
+  }
+
+  const int mControlTag;
+  const int mNChans;
+  const int mFFTSize;
+  const int mHopSize;
+  const int mNBins;
+
+  // audio thread -> worker
+  WDL_TypedBuf<float> mRing;
+  int mRingMask = 0;
+  std::atomic<uint32_t> mWritePos {0};
+  std::atomic<uint32_t> mReadPos {0}; // the oldest sample the worker still needs
+  std::atomic<int> mNSkippedBlocks {0};
+  int mSamplesToNextFrame = mFFTSize; // audio thread only
+  IPlugSemaphore mWakeWorker;
+
+  // worker
+  WDL_TypedBuf<float> mWindow;
+  WDL_TypedBuf<WDL_FFT_REAL> mFFTBuffer;
+  WDL_TypedBuf<float> mPower;
+  float mMagnitudeScale = 1.f;
+  int mBinMap[MAXBINS + 1] = {};
+  int mPermute[kMaxFFTSize / 2 + 1] = {};
+  Data mData;
+  std::atomic<double> mSampleRate {DEFAULT_SAMPLE_RATE};
+  std::atomic<float> mMinFreq {20.f};
+  std::atomic<float> mAveraging {0.7f};
+  std::atomic<bool> mBinMapDirty {true};
+  std::atomic<bool> mQuit {false};
+  std::thread mWorker;
+
+  // worker -> main thread
+  IPlugQueue<Data> mQueue {4};
+  Data mTransmitData;
+};
@@ -409,12 +409,12 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
       if(samplesRemaining < blockSize)
         blockSize = samplesRemaining;
 
-      while (!mMidiQueue.Empty())
-      {
-        IMidiMsg msg = mMidiQueue.Peek();
+      // the messages come out in chronological order
+      const IMidiEventBuffer::Span msgs = mMidiQueue.PopUntil(startIndex + blockSize);
 
-        // we assume the messages are in chronological order. If we find one later than the current block we are done.
-        if (msg.mOffset > startIndex + blockSize) break;
+      for (int i = 0; i < msgs.GetSize(); i++)
+      {
+        IMidiMsg msg = msgs.Get(i);
 
         if(IsRPNMessage(msg))
         {
@@ -427,7 +427,6 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
           msg.mOffset -= startIndex;
           mVoiceAllocator.AddEvent(MidiMessageToEvent(msg));
         }
-        mMidiQueue.Remove();
       }
 
       mVoiceAllocator.ProcessEvents(blockSize, mSampleTime);
@@ -474,7 +473,7 @@ void MidiSynth::SetSampleRateAndBlockSize(double sampleRate, int blockSize)
   Reset();
 
   mSampleRate = sampleRate;
-  mMidiQueue.Resize(blockSize);
+  mMidiQueue.SetCapacity(std::max(blockSize, MIDI_EVENT_BUFFER_SIZE));
   mVoiceAllocator.SetSampleRate(sampleRate);
 
   for(int v = 0; v < NVoices(); v++)
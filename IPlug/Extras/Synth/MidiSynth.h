@@ -18,6 +18,8 @@
 #include <array>
 #include <vector>
 #include <stdint.h>
+#include <cstdlib>
+#include <cstring>
 
 #include "ptrlist.h"
 
@@ -169,7 +171,7 @@ private:
 
   VoiceAllocator mVoiceAllocator;
   uint16_t mUnisonVoices{1};
-  IMidiQueue mMidiQueue;
+  IMidiEventBuffer mMidiQueue;
   float mVelocityLUT[128];
   float mAfterTouchLUT[128];
   ChannelState mChannelStates[16]{};
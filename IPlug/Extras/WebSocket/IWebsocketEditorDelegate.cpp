@@ -15,7 +15,7 @@ IWebsocketEditorDelegate::~IWebsocketEditorDelegate()
 
 void IWebsocketEditorDelegate::OnWebsocketReady(int connIdx)
 {
-  //TODO: need to send serialize state and send it to the client
+  // a new client is sent all parameter and control values in its first frame, see IWebsocketSender
 }
 
 bool IWebsocketEditorDelegate::OnWebsocketText(int connIdx, const char* pStr, size_t dataSize)
@@ -60,42 +60,24 @@ bool IWebsocketEditorDelegate::OnWebsocketData(int connIdx, void* pData, size_t
 
 void IWebsocketEditorDelegate::SendMidiMsgFromUI(const IMidiMsg& msg)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SMMFD");
-  data.Put(&msg.mStatus);
-  data.Put(&msg.mData1);
-  data.Put(&msg.mData2);
-
   // Server side UI edit, send to clients
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  GetPendingMsgs().AddMidiMsg(msg);
   
   IGEditorDelegate::SendMidiMsgFromUI(msg);
 }
 
 void IWebsocketEditorDelegate::SendSysexMsgFromUI(const ISysEx& msg)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SSMFD");
-  data.Put(&msg.mSize);
-  data.PutBytes(&msg.mData, msg.mSize);
-  
   // Server side UI edit, send to clients
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  GetPendingMsgs().AddSysexMsg(msg);
   
   IGEditorDelegate::SendSysexMsgFromUI(msg);
 }
 
 void IWebsocketEditorDelegate::SendArbitraryMsgFromUI(int messageTag, int controlTag, int dataSize, const void* pData)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SSMFD");
-  data.Put(&messageTag);
-  data.Put(&controlTag);
-  data.Put(&dataSize);
-  data.PutBytes(pData, dataSize);
-  
   // Server side UI edit, send to clients
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  GetPendingMsgs().AddArbitraryMsg(messageTag, dataSize, pData);
   
   IGEditorDelegate::SendArbitraryMsgFromUI(messageTag, controlTag, dataSize, pData);
 }
@@ -108,13 +90,8 @@ void IWebsocketEditorDelegate::SendArbitraryMsgFromUI(int messageTag, int contro
 
 void IWebsocketEditorDelegate::SendParameterValueFromUI(int paramIdx, double normalizedValue)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SPVFD");
-  data.Put(&paramIdx);
-  data.Put(&normalizedValue);
-  
   // Server side UI edit, send to clients
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueParamValue(paramIdx, normalizedValue);
 
   IGEditorDelegate::SendParameterValueFromUI(paramIdx, normalizedValue);
 }
@@ -126,64 +103,35 @@ void IWebsocketEditorDelegate::SendParameterValueFromUI(int paramIdx, double nor
 
 void IWebsocketEditorDelegate::SendControlValueFromDelegate(int controlTag, double normalizedValue)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SCVFD");
-  data.Put(&controlTag);
-  data.Put(&normalizedValue);
-  
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueControlValue(controlTag, normalizedValue);
   
   IGEditorDelegate::SendControlValueFromDelegate(controlTag, normalizedValue);
 }
 
 void IWebsocketEditorDelegate::SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize, const void* pData)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SCMFD");
-  data.Put(&controlTag);
-  data.Put(&messageTag);
-  data.Put(&dataSize);
-  data.PutBytes(pData, dataSize);
-  
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  GetPendingMsgs().AddControlMsg(controlTag, messageTag, dataSize, pData);
   
   IGEditorDelegate::SendControlMsgFromDelegate(controlTag, messageTag, dataSize, pData);
 }
 
 void IWebsocketEditorDelegate::SendArbitraryMsgFromDelegate(int messageTag, int dataSize, const void* pData)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SAMFD");
-  data.Put(&messageTag);
-  data.Put(&dataSize);
-  data.PutBytes(pData, dataSize);
-  
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  GetPendingMsgs().AddArbitraryMsg(messageTag, dataSize, pData);
   
   IGEditorDelegate::SendArbitraryMsgFromDelegate(messageTag, dataSize, pData);
 }
 
 void IWebsocketEditorDelegate::SendMidiMsgFromDelegate(const IMidiMsg& msg)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SMMFD");
-  data.Put(&msg.mStatus);
-  data.Put(&msg.mData1);
-  data.Put(&msg.mData2);
-
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  GetPendingMsgs().AddMidiMsg(msg);
   
   IGEditorDelegate::SendMidiMsgFromDelegate(msg);
 }
 
 void IWebsocketEditorDelegate::SendSysexMsgFromDelegate(const ISysEx& msg)
 {
-  IByteChunk data; // FIXME: don't copy
-  data.PutStr("SSMFD");
-  data.Put(&msg.mSize);
-  data.PutBytes(msg.mData, msg.mSize);
-  
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  GetPendingMsgs().AddSysexMsg(msg);
   
   IGEditorDelegate::SendSysexMsgFromDelegate(msg);
 }
@@ -214,4 +162,13 @@ void IWebsocketEditorDelegate::ProcessWebsocketQueue()
     IGEditorDelegate::SendMidiMsgFromDelegate(msg); // Call the superclass, since we don't want to send another MIDI message to the websocket
     DeferMidiMsg(msg); // can't just call SendMidiMsgFromUI here which would cause a feedback loop
   }
+
+  // the first time, queue every parameter, so that clients are sent the full state when they connect
+  if(NQueuedParamValues() < NParams())
+  {
+    for (int i = 0; i < NParams(); i++)
+      QueueParamValue(i, GetParam(i)->GetNormalized());
+  }
+
+  SendFrames();
 }
@@ -38,7 +38,7 @@ public:
   void SendSysexMsgFromDelegate(const ISysEx& msg) override;
 //  void SendParameterValueFromDelegate(int paramIdx, double value, bool normalized) override;
   
-  // Call this repeatedly in order to handle incoming data
+  /** Call this on the main thread once per timer tick. It handles incoming data, and sends everything queued for the clients since the last call as one frame per client */
   void ProcessWebsocketQueue();
   
 private:
@@ -0,0 +1,615 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Binary framing of the messages IWebsocketEditorDelegate sends to its clients, and the writer thread that sends them
+ *
+ * Everything produced in one tick (one IWebsocketSender::SendFrames() call) is sent to each client as a single binary websocket frame.
+ * A frame starts with the 4 byte magic "IPWF", followed by messages, each a uint8 EWebsocketMsgType and its data. All numbers are little endian.
+ *
+ * - kWebsocketParamValues, kWebsocketControlValues: int32 count, then count entries, each the difference from the previous entry's key
+ *   (a zigzag varint, the first is relative to 0) and a double value. Keys are parameter indexes or control tags
+ * - kWebsocketControlMsg: int32 control tag, int32 message tag, int32 data size, data
+ * - kWebsocketArbitraryMsg: int32 message tag, int32 data size, data
+ * - kWebsocketMidiMsg: uint8 status, uint8 data1, uint8 data2
+ * - kWebsocketSysexMsg: int32 data size, data
+ *
+ * Parameter and control values are coalesced: only the latest value of each is kept, and only values that differ from what the client
+ * was last sent are included. A client that is still receiving its previous frame is skipped, and gets the latest values in a later tick.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <limits>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "heapbuf.h"
+#include "ptrlist.h"
+#include "mutex.h"
+
+#include "IPlugMidi.h"
+
+/** The capacity of each of the two frame buffers of a client, in bytes. Messages that don't fit are dropped and counted */
+#ifndef WEBSOCKET_SEND_BUFFER_SIZE
+#define WEBSOCKET_SEND_BUFFER_SIZE 65536
+#endif
+
+enum EWebsocketMsgType : uint8_t
+{
+  kWebsocketParamValues = 1,
+  kWebsocketControlValues,
+  kWebsocketControlMsg,
+  kWebsocketArbitraryMsg,
+  kWebsocketMidiMsg,
+  kWebsocketSysexMsg
+};
+
+/** The latest value of each of a set of keys, e.g. parameter indexes. Each key has a slot, in the order keys were first set */
+class IWebsocketValues
+{
+public:
+  /** Sets the value of a key, adding a slot for it if it is new */
+  void Set(int key, double value)
+  {
+    auto it = mSlots.find(key);
+
+    if (it == mSlots.end())
+    {
+      mSlots[key] = mKeys.GetSize();
+      mKeys.Add(key);
+      mValues.Add(value);
+    }
+    else
+      mValues.Get()[it->second] = value;
+  }
+
+  int NSlots() const { return mKeys.GetSize(); }
+  int GetKey(int slot) const { return mKeys.Get()[slot]; }
+  double GetValue(int slot) const { return mValues.Get()[slot]; }
+
+private:
+  std::unordered_map<int, int> mSlots;
+  WDL_TypedBuf<int> mKeys;
+  WDL_TypedBuf<double> mValues;
+};
+
+/** Appends messages to a buffer of fixed capacity */
+class IWebsocketFrameWriter
+{
+public:
+  static constexpr int kHeaderSize = 4;
+
+  void SetCapacity(int capacity)
+  {
+    mBuf.Resize(capacity);
+    mSize = 0;
+  }
+
+  void Clear() { mSize = 0; }
+  bool Empty() const { return mSize == 0; }
+  const uint8_t* GetData() const { return mBuf.Get(); }
+  int GetSize() const { return mSize; }
+
+  bool AddControlMsg(int controlTag, int messageTag, int dataSize, const void* pData)
+  {
+    if (!Begin(kWebsocketControlMsg, 3 * sizeof(int) + dataSize))
+      return false;
+
+    PutInt(controlTag);
+    PutInt(messageTag);
+    PutInt(dataSize);
+    PutBytes(pData, dataSize);
+    return true;
+  }
+
+  bool AddArbitraryMsg(int messageTag, int dataSize, const void* pData)
+  {
+    if (!Begin(kWebsocketArbitraryMsg, 2 * sizeof(int) + dataSize))
+      return false;
+
+    PutInt(messageTag);
+    PutInt(dataSize);
+    PutBytes(pData, dataSize);
+    return true;
+  }
+
+  bool AddMidiMsg(const IMidiMsg& msg)
+  {
+    if (!Begin(kWebsocketMidiMsg, 3))
+      return false;
+
+    const uint8_t bytes[3] = { msg.mStatus, msg.mData1, msg.mData2 };
+    PutBytes(bytes, 3);
+    return true;
+  }
+
+  bool AddSysexMsg(const ISysEx& msg)
+  {
+    if (!Begin(kWebsocketSysexMsg, sizeof(int) + msg.mSize))
+      return false;
+
+    PutInt(msg.mSize);
+    PutBytes(msg.mData, msg.mSize);
+    return true;
+  }
+
+  /** Appends the messages of another writer
+   * @return \c false if they don't all fit, in which case none are appended */
+  bool AddMsgs(const IWebsocketFrameWriter& other)
+  {
+    if (other.mSize <= kHeaderSize)
+      return true;
+
+    const int size = other.mSize - kHeaderSize;
+
+    if (!Reserve(size))
+      return false;
+
+    PutBytes(other.GetData() + kHeaderSize, size);
+    return true;
+  }
+
+  /** Appends the values that differ from the ones last sent, and updates those
+   * @param sent The values last sent, per slot. Grown to the number of slots, with new slots set to NaN so that they are sent
+   * @return The number of values appended. If they don't all fit, the rest are sent by a later call */
+  int AddValueChanges(EWebsocketMsgType type, const IWebsocketValues& values, WDL_TypedBuf<double>& sent)
+  {
+    const int nSlots = values.NSlots();
+
+    if (sent.GetSize() < nSlots)
+    {
+      const int prevSize = sent.GetSize();
+      sent.Resize(nSlots);
+
+      for (int i = prevSize; i < nSlots; i++)
+        sent.Get()[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+
+    double* pSent = sent.Get();
+    int countPos = -1;
+    int count = 0;
+    int prevKey = 0;
+
+    for (int slot = 0; slot < nSlots; slot++)
+    {
+      const double value = values.GetValue(slot);
+
+      // compare the bits, so that NaN never matches
+      if (!memcmp(&value, pSent + slot, sizeof(double)))
+        continue;
+
+      if (countPos < 0)
+      {
+        if (!Begin(type, sizeof(int) + kMaxEntrySize))
+          break;
+
+        countPos = mSize;
+        PutInt(0);
+      }
+      else if (!Reserve(kMaxEntrySize))
+        break;
+
+      const int key = values.GetKey(slot);
+      PutVarInt(ZigZag(key - prevKey));
+      PutBytes(&value, sizeof(double));
+      pSent[slot] = value;
+      prevKey = key;
+      count++;
+    }
+
+    if (countPos >= 0)
+      memcpy(mBuf.Get() + countPos, &count, sizeof(int));
+
+    return count;
+  }
+
+private:
+  static constexpr int kMaxEntrySize = 5 + sizeof(double);
+
+  static uint32_t ZigZag(int v) { return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31); }
+
+  bool Reserve(int size)
+  {
+    if (mSize == 0)
+      size += kHeaderSize;
+
+    if (mSize + size > mBuf.GetSize())
+      return false;
+
+    if (mSize == 0)
+      PutBytes("IPWF", kHeaderSize);
+
+    return true;
+  }
+
+  bool Begin(EWebsocketMsgType type, int size)
+  {
+    if (!Reserve(1 + size))
+      return false;
+
+    const uint8_t typeByte = type;
+    PutBytes(&typeByte, 1);
+    return true;
+  }
+
+  void PutBytes(const void* pData, int size)
+  {
+    memcpy(mBuf.Get() + mSize, pData, size);
+    mSize += size;
+  }
+
+  void PutInt(int v) { PutBytes(&v, sizeof(int)); }
+
+  void PutVarInt(uint32_t v)
+  {
+    uint8_t* pDst = mBuf.Get() + mSize;
+
+    while (v >= 0x80)
+    {
+      *pDst++ = (uint8_t) (v | 0x80);
+      v >>= 7;
+    }
+
+    *pDst++ = (uint8_t) v;
+    mSize = (int) (pDst - mBuf.Get());
+  }
+
+  WDL_TypedBuf<uint8_t> mBuf;
+  int mSize = 0;
+};
+
+/** Iterates over the messages of a frame. Parameter and control value lists are returned one value at a time */
+class IWebsocketFrameReader
+{
+public:
+  struct Msg
+  {
+    EWebsocketMsgType mType;
+    int mKey; // parameter index, control tag or message tag
+    int mMessageTag; // for kWebsocketControlMsg
+    double mValue;
+    IMidiMsg mMidiMsg;
+    int mDataSize;
+    const uint8_t* mData;
+  };
+
+  IWebsocketFrameReader(const void* pData, int size)
+  : mData((const uint8_t*) pData)
+  , mSize(size)
+  {
+    mValid = size >= IWebsocketFrameWriter::kHeaderSize && !memcmp(pData, "IPWF", IWebsocketFrameWriter::kHeaderSize);
+    mPos = mValid ? IWebsocketFrameWriter::kHeaderSize : size;
+  }
+
+  /** @return \c false if the data does not start with the frame magic */
+  bool IsValid() const { return mValid; }
+
+  /** @return \c false at the end of the frame, or if it is malformed */
+  bool Next(Msg& msg)
+  {
+    if (mNValuesLeft > 0)
+    {
+      mNValuesLeft--;
+      msg.mType = mValuesType;
+      return GetValue(msg);
+    }
+
+    uint8_t type;
+
+    if (!Get(&type, 1))
+      return false;
+
+    msg.mType = (EWebsocketMsgType) type;
+    msg.mDataSize = 0;
+    msg.mData = nullptr;
+
+    switch (type)
+    {
+      case kWebsocketParamValues:
+      case kWebsocketControlValues:
+        if (!Get(&mNValuesLeft, sizeof(int)) || mNValuesLeft <= 0)
+          return false;
+        mValuesType = msg.mType;
+        mPrevKey = 0;
+        mNValuesLeft--;
+        return GetValue(msg);
+      case kWebsocketControlMsg:
+        return Get(&msg.mKey, sizeof(int)) && Get(&msg.mMessageTag, sizeof(int)) && GetData(msg);
+      case kWebsocketArbitraryMsg:
+        return Get(&msg.mKey, sizeof(int)) && GetData(msg);
+      case kWebsocketMidiMsg:
+        return Get(&msg.mMidiMsg.mStatus, 1) && Get(&msg.mMidiMsg.mData1, 1) && Get(&msg.mMidiMsg.mData2, 1);
+      case kWebsocketSysexMsg:
+        return GetData(msg);
+      default:
+        return false;
+    }
+  }
+
+private:
+  bool Get(void* pDst, int size)
+  {
+    if (mPos + size > mSize)
+      return false;
+
+    memcpy(pDst, mData + mPos, size);
+    mPos += size;
+    return true;
+  }
+
+  bool GetData(Msg& msg)
+  {
+    if (!Get(&msg.mDataSize, sizeof(int)) || msg.mDataSize < 0 || mPos + msg.mDataSize > mSize)
+      return false;
+
+    msg.mData = mData + mPos;
+    mPos += msg.mDataSize;
+    return true;
+  }
+
+  bool GetValue(Msg& msg)
+  {
+    uint32_t zigzag = 0;
+
+    for (int shift = 0; ; shift += 7)
+    {
+      uint8_t byte;
+
+      if (shift > 28 || !Get(&byte, 1))
+        return false;
+
+      zigzag |= (uint32_t) (byte & 0x7F) << shift;
+
+      if (!(byte & 0x80))
+        break;
+    }
+
+    mPrevKey += (int) (zigzag >> 1) ^ -(int) (zigzag & 1);
+    msg.mKey = mPrevKey;
+    return Get(&msg.mValue, sizeof(double));
+  }
+
+  const uint8_t* mData;
+  int mSize;
+  int mPos;
+  bool mValid;
+  int mNValuesLeft = 0;
+  int mPrevKey = 0;
+  EWebsocketMsgType mValuesType = kWebsocketParamValues;
+};
+
+/** The send state of one client: two preallocated frame buffers, one filled on the main thread while the writer thread sends the other,
+ * and the values the client was last sent */
+struct IWebsocketConnection
+{
+  IWebsocketConnection(const void* pTransport)
+  : mTransport(pTransport)
+  {
+    mFrames[0].SetCapacity(WEBSOCKET_SEND_BUFFER_SIZE);
+    mFrames[1].SetCapacity(WEBSOCKET_SEND_BUFFER_SIZE);
+  }
+
+  IWebsocketFrameWriter& GetBack() { return mFrames[mBack]; }
+  const IWebsocketFrameWriter& GetFront() const { return mFrames[mBack ^ 1]; }
+
+  const void* mTransport;
+  IWebsocketFrameWriter mFrames[2];
+  int mBack = 0;
+  std::atomic<bool> mSending {false}; // the front buffer belongs to the writer thread while this is set
+  WDL_Mutex mWriteMutex; // held by the writer thread while it sends
+  WDL_TypedBuf<double> mSentParamValues;
+  WDL_TypedBuf<double> mSentControlValues;
+  int mNDropped = 0;
+};
+
+/** Batches messages to websocket clients and sends them on a writer thread, so that the main thread never waits for the network.
+ * Subclasses provide the transport with WriteFrame(), and call AddConnection() and RemoveConnection() as clients come and go.
+ * Queue*(), GetPendingMsgs() and SendFrames() must be called on the main thread */
+class IWebsocketSender
+{
+public:
+  IWebsocketSender()
+  {
+    mPendingMsgs.SetCapacity(WEBSOCKET_SEND_BUFFER_SIZE);
+  }
+
+  virtual ~IWebsocketSender()
+  {
+    StopSending();
+
+    WDL_MutexLock lock(&mConnectionsMutex);
+    mSendConnections.Empty(true);
+  }
+
+  IWebsocketSender(const IWebsocketSender&) = delete;
+  IWebsocketSender& operator=(const IWebsocketSender&) = delete;
+
+  /** Sends a frame to a client. Called on the writer thread
+   * @return \c true on success */
+  virtual bool WriteFrame(const void* pTransport, const uint8_t* pData, int size) = 0;
+
+  void StartSending()
+  {
+    if (mWriterThread.joinable())
+      return;
+
+    mRunning = true;
+    mWriterThread = std::thread(&IWebsocketSender::WriterThreadFunc, this);
+  }
+
+  /** Stops the writer thread. Subclasses must call this in their destructor, since it calls WriteFrame() */
+  void StopSending()
+  {
+    if (!mWriterThread.joinable())
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock(mWakeMutex);
+      mRunning = false;
+    }
+
+    mWakeCV.notify_one();
+    mWriterThread.join();
+  }
+
+  /** Called on a server thread once a client has completed the websocket handshake. It is sent all queued values in its first frame */
+  void AddConnection(const void* pTransport)
+  {
+    WDL_MutexLock lock(&mConnectionsMutex);
+    mSendConnections.Add(new IWebsocketConnection(pTransport));
+  }
+
+  /** Called on a server thread when a client disconnects. Waits for a frame being sent to it */
+  void RemoveConnection(const void* pTransport)
+  {
+    WDL_MutexLock lock(&mConnectionsMutex);
+
+    for (int i = 0; i < mSendConnections.GetSize(); i++)
+    {
+      IWebsocketConnection* pConn = mSendConnections.Get(i);
+
+      if (pConn->mTransport == pTransport)
+      {
+        mSendConnections.Delete(i);
+        pConn->mWriteMutex.Enter();
+        pConn->mWriteMutex.Leave();
+        delete pConn;
+        return;
+      }
+    }
+  }
+
+  void QueueParamValue(int paramIdx, double normalizedValue) { mParamValues.Set(paramIdx, normalizedValue); }
+  void QueueControlValue(int controlTag, double normalizedValue) { mControlValues.Set(controlTag, normalizedValue); }
+  int NQueuedParamValues() const { return mParamValues.NSlots(); }
+
+  /** @return The messages that will be sent to all clients by the next SendFrames(). If a message does not fit, it is dropped */
+  IWebsocketFrameWriter& GetPendingMsgs() { return mPendingMsgs; }
+
+  /** Hands the messages queued since the last call to the writer thread, as one frame per client. Call once per timer tick */
+  void SendFrames()
+  {
+    bool wake = false;
+
+    {
+      WDL_MutexLock lock(&mConnectionsMutex);
+
+      for (int i = 0; i < mSendConnections.GetSize(); i++)
+      {
+        IWebsocketConnection& conn = *mSendConnections.Get(i);
+        IWebsocketFrameWriter& back = conn.GetBack();
+
+        if (!back.AddMsgs(mPendingMsgs))
+          conn.mNDropped++;
+
+        // a client that is still receiving its last frame keeps its messages, and gets the values that have changed by the time it is done
+        if (conn.mSending.load(std::memory_order_acquire))
+          continue;
+
+        back.AddValueChanges(kWebsocketParamValues, mParamValues, conn.mSentParamValues);
+        back.AddValueChanges(kWebsocketControlValues, mControlValues, conn.mSentControlValues);
+
+        if (!back.Empty())
+        {
+          conn.mBack ^= 1;
+          conn.GetBack().Clear();
+          conn.mSending.store(true, std::memory_order_release);
+          wake = true;
+        }
+      }
+    }
+
+    mPendingMsgs.Clear();
+
+    if (wake)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mWake = true;
+      }
+
+      mWakeCV.notify_one();
+    }
+  }
+
+  /** @return The number of times messages were dropped because a client's buffer was full, over all current clients */
+  int GetNDropped()
+  {
+    WDL_MutexLock lock(&mConnectionsMutex);
+    int nDropped = 0;
+
+    for (int i = 0; i < mSendConnections.GetSize(); i++)
+      nDropped += mSendConnections.Get(i)->mNDropped;
+
+    return nDropped;
+  }
+
+private:
+  void WriterThreadFunc()
+  {
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWakeCV.wait_for(lock, std::chrono::milliseconds(100), [this]() { return mWake || !mRunning; });
+
+        if (!mRunning)
+          return;
+
+        mWake = false;
+      }
+
+      for (int i = 0; ; i++)
+      {
+        IWebsocketConnection* pConn = nullptr;
+
+        {
+          WDL_MutexLock lock(&mConnectionsMutex);
+
+          if (i >= mSendConnections.GetSize())
+            break;
+
+          pConn = mSendConnections.Get(i);
+
+          if (!pConn->mSending.load(std::memory_order_acquire))
+            continue;
+
+          // RemoveConnection() can't delete it until this is released, and it can't be added to while mSending is set
+          pConn->mWriteMutex.Enter();
+        }
+
+        const IWebsocketFrameWriter& front = pConn->GetFront();
+        WriteFrame(pConn->mTransport, front.GetData(), front.GetSize());
+        pConn->mSending.store(false, std::memory_order_release);
+        pConn->mWriteMutex.Leave();
+      }
+    }
+  }
+
+  WDL_PtrList<IWebsocketConnection> mSendConnections;
+  WDL_Mutex mConnectionsMutex;
+  IWebsocketFrameWriter mPendingMsgs;
+  IWebsocketValues mParamValues;
+  IWebsocketValues mControlValues;
+
+  std::thread mWriterThread;
+  std::mutex mWakeMutex;
+  std::condition_variable mWakeCV;
+  bool mWake = false;
+  bool mRunning = false;
+};
@@ -0,0 +1,423 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line load test for the websocket framing of IWebsocketEditorDelegate
+ *
+ * A number of local websocket clients connect to an IWebsocketServer, and the main thread sends meter values at a timer rate, the way
+ * IWebsocketEditorDelegate does: QueueControlValue() for each meter, then SendFrames() once per tick. Each client decodes the frames
+ * it receives. Messages per second received over all clients and the CPU used by the process are printed. With -l, each message is
+ * sent as its own frame with SendDataToConnection() instead, which is what IWebsocketEditorDelegate used to do.
+ *
+ * Build on Linux or macOS with the civetweb library built with WITH_CPP=1 WITH_WEBSOCKET=1 (see Dependencies/Extras/civetweb):
+ *
+ *   g++ -O2 -std=c++14 -DOS_LINUX -IIPlug -IIPlug/Extras/WebSocket -IWDL -I<civetweb>/include IPlug/Extras/WebSocket/IWebsocketLoadTest.cpp \
+ *     IPlug/Extras/WebSocket/IWebsocketServer.cpp <civetweb>/libcivetweb.a -lpthread -ldl -o wsloadtest
+ *
+ * Add -DNO_CIVETWEB, and leave out the server and civetweb, to send over local socket pairs instead of the server. That measures the
+ * framing and the writer thread without the HTTP server.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#ifdef NO_CIVETWEB
+#include "IWebsocketFraming.h"
+#include "IPlugStructs.h"
+#else
+#include "IWebsocketServer.h"
+#include "IPlugStructs.h"
+#endif
+
+#define LOADTEST_PORT "8001"
+
+static double WallTime()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double CPUTime()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+static bool WriteAll(int fd, const void* pData, size_t size)
+{
+  const char* p = (const char*) pData;
+
+  while (size)
+  {
+    const ssize_t n = write(fd, p, size);
+
+    if (n <= 0)
+      return false;
+
+    p += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+static bool ReadAll(int fd, void* pData, size_t size)
+{
+  char* p = (char*) pData;
+
+  while (size)
+  {
+    const ssize_t n = read(fd, p, size);
+
+    if (n <= 0)
+      return false;
+
+    p += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+/** A websocket client that counts the messages in the binary frames it receives */
+struct Client
+{
+  int mFD = -1;
+  std::atomic<int64_t> mNMsgs {0};
+  std::atomic<int64_t> mNFrames {0};
+  std::atomic<int64_t> mNBytes {0};
+  std::thread mThread;
+
+  void Run(bool framed)
+  {
+    std::vector<uint8_t> payload;
+
+    while (true)
+    {
+      uint8_t header[2];
+
+      if (!ReadAll(mFD, header, 2))
+        return;
+
+      uint64_t size = header[1] & 0x7F;
+
+      if (size == 126)
+      {
+        uint8_t ext[2];
+        if (!ReadAll(mFD, ext, 2))
+          return;
+        size = (ext[0] << 8) | ext[1];
+      }
+      else if (size == 127)
+      {
+        uint8_t ext[8];
+        if (!ReadAll(mFD, ext, 8))
+          return;
+        size = 0;
+        for (int i = 0; i < 8; i++)
+          size = (size << 8) | ext[i];
+      }
+
+      payload.resize(size);
+
+      if (size && !ReadAll(mFD, payload.data(), size))
+        return;
+
+      if ((header[0] & 0x0F) != 2) // only count binary frames
+        continue;
+
+      int nMsgs = 1;
+
+      if (framed)
+      {
+        IWebsocketFrameReader reader(payload.data(), (int) size);
+        IWebsocketFrameReader::Msg msg;
+        nMsgs = 0;
+
+        while (reader.Next(msg))
+          nMsgs++;
+      }
+
+      mNMsgs += nMsgs;
+      mNFrames++;
+      mNBytes += size;
+    }
+  }
+};
+
+#ifdef NO_CIVETWEB
+/** Sends websocket frames over socket pairs */
+class LoopbackSender : public IWebsocketSender
+{
+public:
+  ~LoopbackSender() { StopSending(); }
+
+  bool WriteFrame(const void* pTransport, const uint8_t* pData, int size) override
+  {
+    return WriteWebsocketFrame((int) (intptr_t) pTransport, pData, size);
+  }
+
+  static bool WriteWebsocketFrame(int fd, const uint8_t* pData, int size)
+  {
+    uint8_t header[10] = { 0x82 }; // final binary frame, not masked
+    int headerSize = 2;
+
+    if (size < 126)
+      header[1] = (uint8_t) size;
+    else if (size < 65536)
+    {
+      header[1] = 126;
+      header[2] = (uint8_t) (size >> 8);
+      header[3] = (uint8_t) size;
+      headerSize = 4;
+    }
+    else
+    {
+      header[1] = 127;
+      for (int i = 0; i < 8; i++)
+        header[2 + i] = (uint8_t) ((uint64_t) size >> (56 - 8 * i));
+      headerSize = 10;
+    }
+
+    return WriteAll(fd, header, headerSize) && WriteAll(fd, pData, size);
+  }
+};
+#else
+static int ConnectClient()
+{
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(atoi(LOADTEST_PORT));
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+  if (connect(fd, (sockaddr*) &addr, sizeof(addr)))
+  {
+    close(fd);
+    return -1;
+  }
+
+  const int noDelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+  const char* request = "GET /ws HTTP/1.1\r\nHost: 127.0.0.1:" LOADTEST_PORT "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+  WriteAll(fd, request, strlen(request));
+
+  // skip the response headers
+  std::string response;
+  char c;
+
+  while (response.size() < 4 || response.compare(response.size() - 4, 4, "\r\n\r\n"))
+  {
+    if (read(fd, &c, 1) != 1)
+    {
+      close(fd);
+      return -1;
+    }
+
+    response += c;
+  }
+
+  return response.find(" 101 ") != std::string::npos ? fd : (close(fd), -1);
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+  int nClients = 8;
+  int nMeters = 128;
+  double rate = 60.;
+  double duration = 5.;
+  bool legacy = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-l"))
+      legacy = true;
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      nClients = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+      nMeters = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      rate = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      duration = atof(argv[++i]);
+    else
+    {
+      printf("usage: %s [-l] [-c clients] [-m meters] [-r timer rate Hz] [-t seconds]\n", argv[0]);
+      printf("  -l  send each message as its own frame, as IWebsocketEditorDelegate used to\n");
+      return 1;
+    }
+  }
+
+  std::vector<Client> clients(nClients);
+
+#ifdef NO_CIVETWEB
+  LoopbackSender sender;
+  WDL_Mutex legacyMutex;
+  std::vector<int> serverFDs;
+
+  for (Client& client : clients)
+  {
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+      return 1;
+
+    client.mFD = fds[0];
+    serverFDs.push_back(fds[1]);
+    sender.AddConnection((const void*) (intptr_t) fds[1]);
+  }
+
+  sender.StartSending();
+
+  // the old path: a chunk per message, written to each client under the connection list's lock
+  auto sendLegacy = [&](const IByteChunk& data) {
+    for (int fd : serverFDs)
+    {
+      WDL_MutexLock lock(&legacyMutex);
+      LoopbackSender::WriteWebsocketFrame(fd, data.GetData(), data.Size());
+    }
+  };
+#else
+  IWebsocketServer sender;
+
+  if (!sender.CreateServer(".", LOADTEST_PORT))
+    return 1;
+
+  for (Client& client : clients)
+  {
+    client.mFD = ConnectClient();
+
+    if (client.mFD < 0)
+    {
+      printf("could not connect to the server\n");
+      return 1;
+    }
+  }
+
+  while (sender.NClients() < nClients)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  auto sendLegacy = [&](const IByteChunk& data) {
+    sender.SendDataToConnection(-1, (void*) data.GetData(), data.Size());
+  };
+#endif
+
+  for (Client& client : clients)
+    client.mThread = std::thread(&Client::Run, &client, !legacy);
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> meter(0., 1.);
+  const int nTicks = (int) (duration * rate);
+  double tickTime = 0.;
+  double maxTickTime = 0.;
+
+  const double startCPU = CPUTime();
+  const double start = WallTime();
+
+  for (int tick = 0; tick < nTicks; tick++)
+  {
+    const double deadline = start + tick / rate;
+    std::this_thread::sleep_for(std::chrono::duration<double>(std::max(0., deadline - WallTime())));
+
+    const double tickStart = WallTime();
+
+    for (int m = 0; m < nMeters; m++)
+    {
+      const double value = meter(rng);
+
+      if (legacy)
+      {
+        IByteChunk data;
+        data.PutStr("SCVFD");
+        data.Put(&m);
+        data.Put(&value);
+        sendLegacy(data);
+      }
+      else
+        sender.QueueControlValue(m, value);
+    }
+
+    if (!legacy)
+      sender.SendFrames();
+
+    const double elapsed = WallTime() - tickStart;
+    tickTime += elapsed;
+    maxTickTime = std::max(maxTickTime, elapsed);
+  }
+
+  // let the clients catch up
+  const int64_t expected = (int64_t) nTicks * nMeters * nClients;
+  int64_t nMsgs = 0;
+
+  for (int wait = 0; wait < 200; wait++)
+  {
+    nMsgs = 0;
+
+    for (Client& client : clients)
+      nMsgs += client.mNMsgs;
+
+    if (nMsgs >= expected)
+      break;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  const double wall = WallTime() - start;
+  const double cpu = CPUTime() - startCPU;
+  int64_t nFrames = 0, nBytes = 0;
+
+  for (Client& client : clients)
+  {
+    nFrames += client.mNFrames;
+    nBytes += client.mNBytes;
+  }
+
+  printf("%s, %d clients, %d meters at %.0f Hz for %.1f s\n", legacy ? "one frame per message" : "batched frames", nClients, nMeters, rate, duration);
+  printf("  received %lld of %lld messages (%lld coalesced or dropped), %.0f messages/s, %.0f frames/s, %.0f kB/s\n",
+         (long long) nMsgs, (long long) expected, (long long) (expected - nMsgs), nMsgs / wall, nFrames / wall, nBytes / wall / 1024.);
+  printf("  CPU %.1f%% of one core, main thread %.1f us per tick (max %.1f us)\n", 100. * cpu / wall, 1e6 * tickTime / nTicks, 1e6 * maxTickTime);
+
+#ifdef NO_CIVETWEB
+  sender.StopSending();
+
+  for (int fd : serverFDs)
+    shutdown(fd, SHUT_RDWR);
+#else
+  sender.DestroyServer();
+
+  for (Client& client : clients)
+    shutdown(client.mFD, SHUT_RDWR);
+#endif
+
+  for (Client& client : clients)
+  {
+    client.mThread.join();
+    close(client.mFD);
+  }
+
+  return 0;
+}
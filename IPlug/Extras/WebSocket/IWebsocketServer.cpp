@@ -47,12 +47,15 @@ bool IWebsocketServer::CreateServer(const char* DOCUMENT_ROOT, const char* PORT)
   }
   
   sInstances++;
+  StartSending();
   
   return true;
 }
 
 void IWebsocketServer::DestroyServer()
 {
+  StopSending();
+
   if(sInstances)
     sInstances--;
   
@@ -103,6 +106,11 @@ bool IWebsocketServer::OnWebsocketData(int idx, void* pData, size_t dataSize)
   return true; // return true to keep the connection open
 }
 
+bool IWebsocketServer::WriteFrame(const void* pTransport, const uint8_t* pData, int size)
+{
+  return mg_websocket_write(const_cast<mg_connection*>((const mg_connection*) pTransport), MG_WEBSOCKET_OPCODE_BINARY, (const char*) pData, size) > 0;
+}
+
 bool IWebsocketServer::DoSendToConnection(int idx, int opcode, const char* pData, size_t sizeInBytes, int exclude)
 {
   int nclients = NClients();
@@ -153,6 +161,9 @@ void IWebsocketServer::handleReadyState(CivetServer* pServer, struct mg_connecti
 {
   WDL_MutexLock lock(&mMutex);
   
+  // the framing writer can only send once the websocket handshake is done
+  AddConnection(pConn);
+  
   DBGMSG("WS ready\n");
   
   OnWebsocketReady(NClients()-1); // should defer to main thread
@@ -181,6 +192,7 @@ void IWebsocketServer::handleClose(CivetServer* pServer, const struct mg_connect
   WDL_MutexLock lock(&mMutex);
 
   mConnections.DeletePtr(pConn);
+  RemoveConnection(pConn);
   
   DBGMSG("WS closed NClients %i\n", NClients());
 }
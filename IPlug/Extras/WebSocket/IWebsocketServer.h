@@ -13,6 +13,7 @@
 
 #include "ptrlist.h"
 #include "IPlugLogger.h"
+#include "IWebsocketFraming.h"
 
 #ifdef OS_WIN
 #include <windows.h>
@@ -20,7 +21,9 @@
 #include <unistd.h>
 #endif
 
-class IWebsocketServer : public CivetWebSocketHandler
+/** A websocket server, shared by all instances. Messages queued with IWebsocketSender are sent to clients as one frame per tick on a writer thread,
+ * SendTextToConnection() and SendDataToConnection() send immediately */
+class IWebsocketServer : public CivetWebSocketHandler, public IWebsocketSender
 {
 public:
   IWebsocketServer();
@@ -42,7 +45,10 @@ public:
   virtual bool OnWebsocketText(int idx, const char* str, size_t dataSize);
   
   virtual bool OnWebsocketData(int idx, void* pData, size_t dataSize);
-  
+
+  // IWebsocketSender
+  bool WriteFrame(const void* pTransport, const uint8_t* pData, int size) override;
+
 private:
   bool DoSendToConnection(int idx, int opcode, const char* pData, size_t sizeInBytes, int exclude);
   
@@ -41,6 +41,7 @@ IPlugAPIBase::IPlugAPIBase(IPlugConfig c, EAPI plugAPI)
   Trace(TRACELOC, "%s:%s", c.pluginName, CurrentTime());
   
   mParamDisplayStr.Set("", MAX_PARAM_DISPLAY_LEN);
+  mParamChangeFromProcessor.Resize(c.nParams);
 }
 
 IPlugAPIBase::~IPlugAPIBase()
@@ -127,9 +128,10 @@ void IPlugAPIBase::DirtyParametersFromUI()
 
 void IPlugAPIBase::SendParameterValueFromAPI(int paramIdx, double value, bool normalized)
 {
-  //TODO: Can we assume that no host is stupid enough to try and set parameters on multiple threads at the same time?
-  // If that is the case then we need a MPSPC queue not SPSC
-  mParamChangeFromProcessor.Push(IParamChange { paramIdx, value, normalized } );
+  const IParam* pParam = GetParam(paramIdx);
+
+  if (pParam) // stored normalised, safe to call from several threads at once
+    mParamChangeFromProcessor.Push(paramIdx, normalized ? value : pParam->ToNormalized(value));
 }
 
 void IPlugAPIBase::OnTimer(Timer& t)
@@ -138,12 +140,9 @@ void IPlugAPIBase::OnTimer(Timer& t)
   {
     // in distributed VST 3, parameter changes are managed by the host
   #if !defined VST3C_API && !defined VST3P_API
-    while(mParamChangeFromProcessor.ElementsAvailable())
-    {
-      IParamChange p;
-      mParamChangeFromProcessor.Pop(p);
-      SendParameterValueFromDelegate(p.paramIdx, p.value, p.normalized); // TODO:  if the parameter hasn't changed maybe we shouldn't do anything?
-    }
+    mParamChangeFromProcessor.Drain([this](const IParamChange& p) {
+      SendParameterValueFromDelegate(p.paramIdx, p.value, p.normalized);
+    });
     
     while (mMidiMsgsFromProcessor.ElementsAvailable())
     {
@@ -179,6 +178,10 @@ void IPlugAPIBase::OnTimer(Timer& t)
   }
   
   OnIdle();
+  
+#if defined VST3P_API
+  TransmitMsgBatchFromProcessor();
+#endif
 }
 
 void IPlugAPIBase::SendMidiMsgFromUI(const IMidiMsg& msg)
@@ -23,6 +23,7 @@
 #include "IPlugUtilities.h"
 #include "IPlugParameter.h"
 #include "IPlugQueue.h"
+#include "IPlugParamChangeSet.h"
 #include "IPlugTimer.h"
 
 /**
@@ -129,10 +130,12 @@ public:
   virtual void GetTrackName(WDL_String& str) {};
   
   virtual void DirtyParametersFromUI() override;
+  void InformHostOfParamChangeFromPlug(int paramIdx) override { InformHostOfParamChange(paramIdx, GetParam(paramIdx)->GetNormalized()); }
 #pragma mark - Methods called by the API class - you do not call these methods in your plug-in class
 
   /** This is called from the plug-in API class in order to update UI controls linked to plug-in parameters, prior to calling OnParamChange()
-   * NOTE: It may be called on the high priority audio thread. Its purpose is to place parameter changes in a queue to defer to main thread for the UI
+   * NOTE: It may be called on the high priority audio thread. Its purpose is to store parameter changes to defer to main thread for the UI.
+   * Only the latest value of each parameter is delivered to the UI, on the next timer tick
    * @param paramIdx The index of the parameter that changed
    * @param value The new value
    * @param normalized /true if value is normalised */
@@ -176,6 +179,8 @@ private:
   //DISTRIBUTED ONLY (Currently only VST3)
   virtual void TransmitMidiMsgFromProcessor(const IMidiMsg& msg) {};
   virtual void TransmitSysExDataFromProcessor(const SysExData& data) {};
+  /** Called at the end of each timer tick, to send the messages the processor has batched up to the controller */
+  virtual void TransmitMsgBatchFromProcessor() {};
 
   void OnTimer(Timer& t);
 
@@ -183,7 +188,7 @@ protected:
   WDL_String mParamDisplayStr;
   Timer* mTimer = nullptr;
   
-  IPlugQueue<IParamChange> mParamChangeFromProcessor {PARAM_TRANSFER_SIZE};
+  IParamChangeSet mParamChangeFromProcessor; // the latest value of each parameter changed by the host, sized to NParams() on construction
   IPlugQueue<IMidiMsg> mMidiMsgsFromEditor {MIDI_TRANSFER_SIZE}; // a queue of midi messages generated in the editor by clicking keyboard UI etc
   IPlugQueue<IMidiMsg> mMidiMsgsFromProcessor {MIDI_TRANSFER_SIZE}; // a queue of MIDI messages received (potentially on the high priority thread), by the processor to send to the editor
   IPlugQueue<SysExData> mSysExDataFromEditor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the processor
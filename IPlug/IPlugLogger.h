@@ -16,6 +16,11 @@
  *
  * To trace some arbitrary data:                 Trace(TRACELOC, "%s:%d", myStr, myInt);
  * To simply create a trace entry in the log:    TRACE;
+ * To trace up to 4 numeric values:              TRACE_VALUES("voices", nVoices, cpuLoad);
+ * To trace the duration of a scope:             TRACE_SCOPE("render");
+ *
+ * TRACE, TRACE_VALUES and TRACE_SCOPE write binary records to a per thread lock-free ring (see IPlugTraceRing.h), so they are safe to use on the audio thread.
+ * Define TRACER_TEXT_LOG to send TRACE to the text log file used by Trace() instead.
  * No need to wrap tracer calls in #ifdef TRACER_BUILD because Trace is a no-op unless TRACER_BUILD is defined.
  */
 
@@ -44,7 +49,18 @@
 #endif
 
 #if defined TRACER_BUILD
-  #define TRACE Trace(TRACELOC, "");
+  #include "IPlugTraceRing.h"
+
+  #ifdef TRACER_TEXT_LOG
+    #define TRACE Trace(TRACELOC, "");
+  #else
+    #define TRACE TraceEvent(TRACELOC, nullptr);
+  #endif
+
+  #define TRACE_VALUES(label, ...) TraceEvent(TRACELOC, label, __VA_ARGS__);
+  #define TRACE_SCOPE_NAME_(line) traceScope##line
+  #define TRACE_SCOPE_NAME(line) TRACE_SCOPE_NAME_(line)
+  #define TRACE_SCOPE(label) TraceScope TRACE_SCOPE_NAME(__LINE__)(TRACELOC, label);
 
   #if defined OS_WIN
     #define SYS_THREAD_ID (intptr_t) GetCurrentThreadId()
@@ -54,6 +70,8 @@
 
   #else
     #define TRACE
+    #define TRACE_VALUES(label, ...)
+    #define TRACE_SCOPE(label)
   #endif
 
   #define TRACELOC __FUNCTION__,__LINE__
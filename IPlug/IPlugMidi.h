@@ -19,9 +19,13 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 
+#include "heapbuf.h"
+
 #include "IPlugLogger.h"
+#include "IPlugRTGuard.h"
 
 /** Encapsulates a MIDI message and provides helper functions
  * @ingroup IPlugStructs */
@@ -551,6 +555,7 @@ protected:
   bool Expand()
   {
     if (!mGrow) return false;
+    RT_GUARD_FLAG("IMidiQueue full, growing with realloc");
     int size = (mSize / mGrow + 1) * mGrow;
 
     void* buf = realloc(mBuf, size * sizeof(IMidiMsg));
@@ -583,3 +588,311 @@ protected:
   int mSize, mGrow;
   int mFront, mBack;
 };
+
+#ifndef MIDI_EVENT_BUFFER_SIZE
+  #define MIDI_EVENT_BUFFER_SIZE 4096
+#endif
+
+/** A fixed capacity buffer of timestamped MIDI messages, that never allocates on the audio thread.
+ *
+ * Messages are stored with their offset plus a base that Flush() advances, so the remaining messages don't have to be rewritten
+ * each block. Add() appends a message that is in order, and moves one that is only slightly out of order (e.g. from interleaved
+ * streams such as the channels of an MPE controller) into place. Anything further out of order is appended, and the buffer is
+ * sorted in bulk, stably by offset, when it is next read. That sort uses a second preallocated buffer, and is a counting sort, O(n)
+ * for the whole block instead of a memmove per message, unless the offsets span more than a few blocks.
+ *
+ * When the buffer is full, the newest message is dropped and counted, see GetNDropped(). Size it with SetCapacity() for the densest
+ * stream expected within a block.
+ * @code
+ * void MyPlug::ProcessBlock(double** inputs, double** outputs, int nFrames)
+ * {
+ *   for (int start = 0; start < nFrames; start += kSubBlockSize)
+ *   {
+ *     IMidiEventBuffer::Span events = mMidiEvents.PopUntil(start + kSubBlockSize);
+ *
+ *     for (int i = 0; i < events.GetSize(); i++)
+ *     {
+ *       const IMidiMsg msg = events.Get(i); // msg.mOffset is relative to the start of the block
+ *       // To-do: Handle the MIDI message
+ *     }
+ *
+ *     // To-do: Process audio
+ *   }
+ *
+ *   mMidiEvents.Flush(nFrames);
+ * }
+ * @endcode
+ * @ingroup IPlugUtilities */
+class IMidiEventBuffer
+{
+public:
+  /** The messages returned by PopUntil(), valid until the next call to Add() or SetCapacity() */
+  class Span
+  {
+  public:
+    Span(const IMidiMsg* pMsgs = nullptr, int size = 0, int base = 0)
+    : mMsgs(pMsgs), mSize(size), mBase(base)
+    {}
+
+    int GetSize() const { return mSize; }
+
+    /** @return A copy of a message, with its offset relative to the start of the current block */
+    IMidiMsg Get(int idx) const
+    {
+      IMidiMsg msg = mMsgs[idx];
+      msg.mOffset -= mBase;
+      return msg;
+    }
+
+  private:
+    const IMidiMsg* mMsgs;
+    int mSize;
+    int mBase;
+  };
+
+  IMidiEventBuffer(int capacity = MIDI_EVENT_BUFFER_SIZE)
+  {
+    SetCapacity(capacity);
+  }
+
+  /** Allocates space for capacity messages and clears the buffer. Not realtime safe */
+  void SetCapacity(int capacity)
+  {
+    mBufs[0].Resize(capacity);
+    mBufs[1].Resize(capacity);
+    mCounts.Resize(kCountingSortRange);
+    mData = mBufs[0].Get();
+    mSpare = mBufs[1].Get();
+    Clear();
+    mNDropped = 0;
+  }
+
+  int GetCapacity() const { return mBufs[0].GetSize(); }
+
+  /** Adds a message, which may be out of order
+   * @param msg The message, with mOffset relative to the start of the current block
+   * @return \c false if the buffer is full and the message was dropped */
+  bool Add(const IMidiMsg& msg)
+  {
+    if (mBack == GetCapacity() && !Compact())
+    {
+      mNDropped++;
+      return false;
+    }
+
+    IMidiMsg stored = msg;
+    stored.mOffset += mBase;
+    int pos = mBack;
+
+    // short displacements, e.g. from interleaved streams, are fixed straight away, anything else waits for Sort()
+    if (mSorted)
+    {
+      while (pos > mFront && mBack - pos < kMaxInsertDistance && stored.mOffset < mData[pos - 1].mOffset)
+        pos--;
+
+      if (pos > mFront && stored.mOffset < mData[pos - 1].mOffset)
+      {
+        mSorted = false;
+        pos = mBack;
+      }
+      else if (pos < mBack)
+        memmove(&mData[pos + 1], &mData[pos], (mBack - pos) * sizeof(IMidiMsg));
+    }
+
+    mData[pos] = stored;
+    mBack++;
+    return true;
+  }
+
+  /** Adds several messages, see Add()
+   * @return The number of messages added */
+  int Add(const IMidiMsg* pMsgs, int nMsgs)
+  {
+    int nAdded = 0;
+
+    for (int i = 0; i < nMsgs; i++)
+      nAdded += Add(pMsgs[i]);
+
+    return nAdded;
+  }
+
+  /** Removes the messages with an offset before endOffset, sorted by offset. Messages added with an offset before that of messages
+   * already popped (e.g. in the previous block) are returned by the next call
+   * @param endOffset The end of the range, relative to the start of the current block
+   * @return The messages, stored in the buffer */
+  Span PopUntil(int endOffset)
+  {
+    Sort();
+
+    const int end = mBase + endOffset;
+    const IMidiMsg* pLast = std::lower_bound(mData + mFront, mData + mBack, end, [](const IMidiMsg& msg, int offset) { return msg.mOffset < offset; });
+    const int first = mFront;
+    mFront = (int) (pLast - mData);
+    return Span(mData + first, mFront - first, mBase);
+  }
+
+  /** @return \c true if there are no messages waiting */
+  bool Empty() const { return mFront == mBack; }
+
+  /** @return The number of messages waiting */
+  int ToDo() const { return mBack - mFront; }
+
+  /** Ends a block, so that offsets passed to and returned by the other methods are relative to the next one. O(1)
+   * @param nFrames The size of the block */
+  void Flush(int nFrames)
+  {
+    if (mFront == mBack)
+    {
+      Clear();
+      return;
+    }
+
+    mBase += nFrames;
+
+    // keep the stored offsets well away from overflowing, this is the only time they are rewritten
+    if (mBase > (1 << 30))
+    {
+      for (int i = mFront; i < mBack; i++)
+        mData[i].mOffset -= mBase;
+
+      mBase = 0;
+    }
+  }
+
+  /** Removes all messages */
+  void Clear()
+  {
+    mFront = mBack = 0;
+    mBase = 0;
+    mSorted = true;
+  }
+
+  /** @return The number of messages dropped because the buffer was full, since SetCapacity() or ResetNDropped() */
+  int GetNDropped() const { return mNDropped; }
+  void ResetNDropped() { mNDropped = 0; }
+
+private:
+  /** Moves the waiting messages to the front of the buffer, @return \c true if that made space */
+  bool Compact()
+  {
+    if (mFront == 0)
+      return false;
+
+    const int n = mBack - mFront;
+    memmove(mData, mData + mFront, n * sizeof(IMidiMsg));
+    mFront = 0;
+    mBack = n;
+    return true;
+  }
+
+  /** Stable sort of the waiting messages into mSpare, which then becomes mData. Offsets usually span less than a few blocks,
+   * so a counting sort does it in O(n). Otherwise short runs are insertion sorted in place, then merged alternating between the buffers */
+  void Sort()
+  {
+    if (mSorted)
+      return;
+
+    mSorted = true;
+    int minOffset = mData[mFront].mOffset;
+    int maxOffset = minOffset;
+
+    for (int i = mFront + 1; i < mBack; i++)
+    {
+      minOffset = std::min(minOffset, mData[i].mOffset);
+      maxOffset = std::max(maxOffset, mData[i].mOffset);
+    }
+
+    if (maxOffset - minOffset < kCountingSortRange)
+    {
+      int* pCounts = mCounts.Get();
+      const int range = maxOffset - minOffset + 1;
+      memset(pCounts, 0, range * sizeof(int));
+
+      for (int i = mFront; i < mBack; i++)
+        pCounts[mData[i].mOffset - minOffset]++;
+
+      for (int o = 0, pos = mFront; o < range; o++)
+      {
+        const int count = pCounts[o];
+        pCounts[o] = pos;
+        pos += count;
+      }
+
+      for (int i = mFront; i < mBack; i++)
+        mSpare[pCounts[mData[i].mOffset - minOffset]++] = mData[i];
+
+      std::swap(mData, mSpare);
+      return;
+    }
+
+    for (int start = mFront; start < mBack; start += kMaxInsertDistance)
+    {
+      const int end = std::min(start + kMaxInsertDistance, mBack);
+
+      for (int i = start + 1; i < end; i++)
+      {
+        const IMidiMsg msg = mData[i];
+        int j = i;
+
+        while (j > start && msg.mOffset < mData[j - 1].mOffset)
+        {
+          mData[j] = mData[j - 1];
+          j--;
+        }
+
+        mData[j] = msg;
+      }
+    }
+
+    IMidiMsg* pSrc = mData;
+    IMidiMsg* pDst = mSpare;
+    int nRuns = 0;
+
+    do
+    {
+      nRuns = 0;
+      int start = mFront;
+
+      while (start < mBack)
+      {
+        int mid = start + 1;
+        while (mid < mBack && pSrc[mid - 1].mOffset <= pSrc[mid].mOffset) mid++;
+
+        int end = mid;
+        if (end < mBack) end++;
+        while (end < mBack && pSrc[end - 1].mOffset <= pSrc[end].mOffset) end++;
+
+        // stable merge of the runs [start, mid) and [mid, end)
+        int a = start, b = mid, out = start;
+
+        while (a < mid && b < end)
+          pDst[out++] = (pSrc[b].mOffset < pSrc[a].mOffset) ? pSrc[b++] : pSrc[a++];
+
+        while (a < mid) pDst[out++] = pSrc[a++];
+        while (b < end) pDst[out++] = pSrc[b++];
+
+        nRuns++;
+        start = end;
+      }
+
+      std::swap(pSrc, pDst);
+    }
+    while (nRuns > 1);
+
+    mData = pSrc;
+    mSpare = pDst;
+  }
+
+  static constexpr int kMaxInsertDistance = 32;
+  static constexpr int kCountingSortRange = 8192;
+
+  WDL_TypedBuf<IMidiMsg> mBufs[2];
+  WDL_TypedBuf<int> mCounts;
+  IMidiMsg* mData = nullptr;
+  IMidiMsg* mSpare = nullptr;
+  int mFront = 0;
+  int mBack = 0;
+  int mBase = 0;
+  int mNDropped = 0;
+  bool mSorted = true;
+};
@@ -0,0 +1,401 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Fixed layout binary messages between a processor and its controller/UI, and the containers that carry them
+ *
+ * Every message is an IMsgRecord: a 32 byte header, followed by the message's data, padded to a multiple of 8 bytes. The layout is the same
+ * whatever the transport, so records can be written into an IMsgBatch and sent as one binary blob (a WAM postMessage, a VST3 IMessage),
+ * or into an IMsgRing in memory shared between threads or processes. All numbers are in the native byte order, little endian on all
+ * supported platforms.
+ *
+ * | type              | mIdx          | mTag                               | mValue | mFlags      | data      |
+ * |-------------------|---------------|------------------------------------|--------|-------------|-----------|
+ * | kMsgParamValue    | parameter     |                                    | value  | kNormalized |           |
+ * | kMsgControlValue  | control tag   |                                    | value  |             |           |
+ * | kMsgControlMsg    | control tag   | message tag                        |        |             | message   |
+ * | kMsgArbitraryMsg  | control tag   | message tag                        |        |             | message   |
+ * | kMsgMidiMsg       | sample offset | status, data1 << 8, data2 << 16    |        |             |           |
+ * | kMsgSysEx         | sample offset |                                    |        |             | sysex     |
+ */
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "heapbuf.h"
+
+#include "IPlugMidi.h"
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "IMsgRing positions must be lock-free to be shared between processes");
+
+enum EMsgRecordType : uint16_t
+{
+  kMsgParamValue = 1,
+  kMsgControlValue,
+  kMsgControlMsg,
+  kMsgArbitraryMsg,
+  kMsgMidiMsg,
+  kMsgSysEx
+};
+
+/** The header of a message, see IPlugMsgRing.h for the meaning of the fields of each type */
+struct IMsgRecord
+{
+  static constexpr uint16_t kNormalized = 1;
+
+  uint32_t mSize; // the size of the record including the header and padding, a multiple of 8
+  uint16_t mType; // EMsgRecordType
+  uint16_t mFlags;
+  int32_t mIdx;
+  int32_t mTag;
+  int32_t mDataSize;
+  int32_t mReserved;
+  double mValue;
+
+  const uint8_t* GetData() const { return reinterpret_cast<const uint8_t*>(this + 1); }
+
+  /** @return The size of a record with dataSize bytes of data */
+  static uint32_t SizeFor(int dataSize) { return (uint32_t) ((sizeof(IMsgRecord) + dataSize + 7) & ~7); }
+
+  /** @return \c true if a record of size bytes can be read */
+  bool IsValid(uint32_t size) const
+  {
+    return mSize >= sizeof(IMsgRecord) && mSize <= size && !(mSize & 7) && mDataSize >= 0 && SizeFor(mDataSize) <= mSize;
+  }
+
+  /** Passes the message to the matching IEditorDelegate::Send...FromDelegate() method of a delegate */
+  template <class D>
+  void SendToDelegate(D& delegate) const
+  {
+    switch (mType)
+    {
+      case kMsgParamValue: delegate.SendParameterValueFromDelegate(mIdx, mValue, mFlags & kNormalized); break;
+      case kMsgControlValue: delegate.SendControlValueFromDelegate(mIdx, mValue); break;
+      case kMsgControlMsg: delegate.SendControlMsgFromDelegate(mIdx, mTag, mDataSize, GetData()); break;
+      case kMsgArbitraryMsg: delegate.SendArbitraryMsgFromDelegate(mTag, mDataSize, GetData()); break;
+      case kMsgMidiMsg: delegate.SendMidiMsgFromDelegate(IMidiMsg(mIdx, mTag & 0xFF, (mTag >> 8) & 0xFF, (mTag >> 16) & 0xFF)); break;
+      case kMsgSysEx: delegate.SendSysexMsgFromDelegate(ISysEx(mIdx, GetData(), mDataSize)); break;
+      default: break;
+    }
+  }
+};
+
+static_assert(sizeof(IMsgRecord) == 32, "IMsgRecord is a fixed layout");
+
+/** Writes records into the space returned by T::Reserve(uint32_t size), which returns nullptr if there is none */
+template <class T>
+class IMsgRecordWriter
+{
+public:
+  bool AddParamValue(int paramIdx, double value, bool normalized)
+  {
+    return Add(kMsgParamValue, normalized ? IMsgRecord::kNormalized : 0, paramIdx, 0, value);
+  }
+
+  bool AddControlValue(int controlTag, double normalizedValue)
+  {
+    return Add(kMsgControlValue, 0, controlTag, 0, normalizedValue);
+  }
+
+  bool AddControlMsg(int controlTag, int messageTag, int dataSize, const void* pData)
+  {
+    return Add(kMsgControlMsg, 0, controlTag, messageTag, 0., dataSize, pData);
+  }
+
+  bool AddArbitraryMsg(int messageTag, int controlTag, int dataSize, const void* pData)
+  {
+    return Add(kMsgArbitraryMsg, 0, controlTag, messageTag, 0., dataSize, pData);
+  }
+
+  bool AddMidiMsg(const IMidiMsg& msg)
+  {
+    return Add(kMsgMidiMsg, 0, msg.mOffset, msg.mStatus | (msg.mData1 << 8) | (msg.mData2 << 16), 0.);
+  }
+
+  bool AddSysEx(int offset, int dataSize, const void* pData)
+  {
+    return Add(kMsgSysEx, 0, offset, 0, 0., dataSize, pData);
+  }
+
+  bool Add(EMsgRecordType type, uint16_t flags, int idx, int tag, double value, int dataSize = 0, const void* pData = nullptr)
+  {
+    if (dataSize < 0)
+      return false;
+
+    const uint32_t size = IMsgRecord::SizeFor(dataSize);
+    uint8_t* pDst = static_cast<T*>(this)->Reserve(size);
+
+    if (!pDst)
+      return false;
+
+    IMsgRecord* pRecord = reinterpret_cast<IMsgRecord*>(pDst);
+    pRecord->mSize = size;
+    pRecord->mType = type;
+    pRecord->mFlags = flags;
+    pRecord->mIdx = idx;
+    pRecord->mTag = tag;
+    pRecord->mDataSize = dataSize;
+    pRecord->mReserved = 0;
+    pRecord->mValue = value;
+
+    if (dataSize)
+      memcpy(pDst + sizeof(IMsgRecord), pData, dataSize);
+
+    memset(pDst + sizeof(IMsgRecord) + dataSize, 0, size - sizeof(IMsgRecord) - dataSize);
+    return true;
+  }
+};
+
+/** A growable, contiguous batch of records, sent as one block of bytes. Not thread safe */
+class IMsgBatch : public IMsgRecordWriter<IMsgBatch>
+{
+public:
+  uint8_t* Reserve(uint32_t size)
+  {
+    const int pos = mBuf.GetSize();
+
+    if (!mBuf.Resize(pos + size, false))
+      return nullptr;
+
+    return mBuf.Get() + pos;
+  }
+
+  void Clear() { mBuf.Resize(0, false); }
+  bool Empty() const { return mBuf.GetSize() == 0; }
+  const uint8_t* GetData() const { return mBuf.Get(); }
+  int GetSize() const { return mBuf.GetSize(); }
+
+  /** Calls func(const IMsgRecord&) for each record in a block of bytes, stopping at the first malformed one
+   * @return The number of records read */
+  template <typename F>
+  static int Read(const void* pData, int size, F func)
+  {
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+
+    if (reinterpret_cast<uintptr_t>(pBytes) & 7) // a transport may hand over a copy that is not 8 byte aligned
+    {
+      WDL_TypedBuf<uint64_t> aligned;
+      aligned.Resize((size + 7) / 8);
+      memcpy(aligned.Get(), pBytes, size);
+      return Read(aligned.Get(), size, func);
+    }
+
+    int pos = 0;
+    int nRecords = 0;
+
+    while (size - pos >= (int) sizeof(IMsgRecord))
+    {
+      const IMsgRecord* pRecord = reinterpret_cast<const IMsgRecord*>(pBytes + pos);
+
+      if (!pRecord->IsValid(size - pos))
+        break;
+
+      func(*pRecord);
+      pos += pRecord->mSize;
+      nRecords++;
+    }
+
+    return nRecords;
+  }
+
+private:
+  WDL_TypedBuf<uint8_t> mBuf;
+};
+
+/** A lock-free single producer, single consumer ring of records, in memory it owns or in memory shared with another process.
+ * The producer's records become visible to the consumer all at once when it calls Flush(), e.g. once per processing block.
+ * The consumer reads everything flushed so far with Read(), which also frees the space in one step.
+ * A record that doesn't fit, or is larger than half the capacity, is dropped and counted, the producer never waits. Both processes must be built for the same architecture */
+class IMsgRing : public IMsgRecordWriter<IMsgRing>
+{
+public:
+  static constexpr uint32_t kMagic = 0x474D5049; // "IPMG"
+  static constexpr uint32_t kVersion = 1;
+
+  /** The start of the memory of a ring, followed by the records */
+  struct Header
+  {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mCapacity;
+    uint32_t mReserved;
+    alignas(64) std::atomic<uint32_t> mWritePos; // written by the producer, in bytes since the start, wrapping at 2^32
+    alignas(64) std::atomic<uint32_t> mReadPos; // written by the consumer
+    alignas(64) std::atomic<uint32_t> mNDropped; // records the producer couldn't fit
+  };
+
+  IMsgRing() = default;
+  IMsgRing(const IMsgRing&) = delete;
+  IMsgRing& operator=(const IMsgRing&) = delete;
+
+  /** @return The memory needed for a ring of capacity bytes */
+  static size_t GetMemorySize(uint32_t capacity) { return sizeof(Header) + capacity; }
+
+  /** Allocates a ring for use between threads of this process
+   * @param capacity The size of the ring in bytes, rounded up to a power of two */
+  bool Create(uint32_t capacity)
+  {
+    uint32_t size = 256;
+
+    while (size < capacity)
+      size <<= 1;
+
+    mOwnedMem.Resize((int) GetMemorySize(size) + 64);
+    const uintptr_t aligned = (reinterpret_cast<uintptr_t>(mOwnedMem.Get()) + 63) & ~(uintptr_t) 63;
+    return Init(reinterpret_cast<void*>(aligned), GetMemorySize(size));
+  }
+
+  /** Lays out a new, empty ring in a block of memory, e.g. shared memory that the other process will Attach() to. The capacity is the
+   * largest power of two that fits
+   * @param pMemory Must be aligned to 64 bytes, which memory from mmap() or MapViewOfFile() is */
+  bool Init(void* pMemory, size_t size)
+  {
+    if (!pMemory || size < GetMemorySize(256))
+      return false;
+
+    uint32_t capacity = 256;
+
+    while (capacity < (1u << 30) && GetMemorySize(capacity << 1) <= size)
+      capacity <<= 1;
+
+    Header* pHeader = new (pMemory) Header;
+    pHeader->mCapacity = capacity;
+    pHeader->mReserved = 0;
+    pHeader->mWritePos.store(0, std::memory_order_relaxed);
+    pHeader->mReadPos.store(0, std::memory_order_relaxed);
+    pHeader->mNDropped.store(0, std::memory_order_relaxed);
+    pHeader->mVersion = kVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    pHeader->mMagic = kMagic;
+    return Attach(pMemory, size);
+  }
+
+  /** Uses a ring that was laid out with Init(), possibly by another process
+   * @return \c false if the memory doesn't hold a ring of this version */
+  bool Attach(void* pMemory, size_t size)
+  {
+    Header* pHeader = static_cast<Header*>(pMemory);
+
+    if (!pHeader || size < sizeof(Header) || pHeader->mMagic != kMagic || pHeader->mVersion != kVersion
+        || (pHeader->mCapacity & (pHeader->mCapacity - 1)) || GetMemorySize(pHeader->mCapacity) > size)
+      return false;
+
+    mHeader = pHeader;
+    mData = static_cast<uint8_t*>(pMemory) + sizeof(Header);
+    mCapacity = pHeader->mCapacity;
+    mWritePos = pHeader->mWritePos.load(std::memory_order_acquire);
+    return true;
+  }
+
+  bool IsValid() const { return mHeader != nullptr; }
+  uint32_t GetCapacity() const { return mCapacity; }
+  int GetNDropped() const { return mHeader ? (int) mHeader->mNDropped.load(std::memory_order_relaxed) : 0; }
+
+  /** Producer: reserves space for the next record. Called by the Add...() methods
+   * @return nullptr if the ring is full */
+  uint8_t* Reserve(uint32_t size)
+  {
+    if (!mHeader)
+      return nullptr;
+
+    const uint32_t readPos = mHeader->mReadPos.load(std::memory_order_acquire);
+    const uint32_t offset = mWritePos & (mCapacity - 1);
+    const uint32_t contiguous = mCapacity - offset;
+    const uint32_t skip = size > contiguous ? contiguous : 0; // records don't wrap, the rest of the ring is skipped instead
+
+    if (size > mCapacity / 2 || mWritePos - readPos + skip + size > mCapacity)
+    {
+      mHeader->mNDropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    if (skip)
+    {
+      reinterpret_cast<IMsgRecord*>(mData + offset)->mSize = 0; // there are always at least 8 bytes left, since sizes are multiples of 8
+      mWritePos += skip;
+    }
+
+    uint8_t* pDst = mData + (mWritePos & (mCapacity - 1));
+    mWritePos += size;
+    return pDst;
+  }
+
+  /** Producer: makes the records added since the last call visible to the consumer */
+  void Flush()
+  {
+    if (mHeader)
+      mHeader->mWritePos.store(mWritePos, std::memory_order_release);
+  }
+
+  /** Consumer: calls func(const IMsgRecord&) for each flushed record, then frees their space. If the producer wrote a malformed
+   * record, e.g. a process that crashed while writing, the rest of the flushed data is discarded
+   * @return The number of records read */
+  template <typename F>
+  int Read(F func, int maxRecords = INT_MAX)
+  {
+    if (!mHeader)
+      return 0;
+
+    uint32_t pos = mHeader->mReadPos.load(std::memory_order_relaxed);
+    const uint32_t end = mHeader->mWritePos.load(std::memory_order_acquire);
+    int nRecords = 0;
+
+    while (pos != end && nRecords < maxRecords)
+    {
+      const uint32_t offset = pos & (mCapacity - 1);
+      const uint32_t available = end - pos;
+      const IMsgRecord* pRecord = reinterpret_cast<const IMsgRecord*>(mData + offset);
+
+      if (available > mCapacity)
+      {
+        pos = end;
+        break;
+      }
+
+      if (pRecord->mSize == 0)
+      {
+        pos += mCapacity - offset;
+        continue;
+      }
+
+      if (!pRecord->IsValid(available < mCapacity - offset ? available : mCapacity - offset))
+      {
+        pos = end;
+        break;
+      }
+
+      func(*pRecord);
+      pos += pRecord->mSize;
+      nRecords++;
+    }
+
+    mHeader->mReadPos.store(pos, std::memory_order_release);
+    return nRecords;
+  }
+
+  /** Consumer: @return \c true if there are flushed records to read */
+  bool ElementsAvailable() const
+  {
+    return mHeader && mHeader->mReadPos.load(std::memory_order_relaxed) != mHeader->mWritePos.load(std::memory_order_acquire);
+  }
+
+private:
+  Header* mHeader = nullptr;
+  uint8_t* mData = nullptr;
+  uint32_t mCapacity = 0;
+  uint32_t mWritePos = 0; // the producer's position, ahead of mHeader->mWritePos by what hasn't been flushed
+  WDL_TypedBuf<uint8_t> mOwnedMem;
+};
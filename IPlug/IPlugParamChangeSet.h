@@ -0,0 +1,144 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IParamChangeSet
+ */
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "IPlugStructs.h"
+
+/** Transfers parameter changes from the host/audio threads to the main thread, keeping only the latest value of each parameter.
+ * Push() stores the normalized value in a per-parameter atomic and sets the parameter's bit in a dirty bitset, plus a bit in a summary bitset with
+ * one bit per 64 parameters. Drain() visits only the summary words and dirty words that have bits set, so its cost is proportional to
+ * the number of changed parameters. Unlike a queue of changes it can't fill up, and it never delivers stale intermediate values.
+ * Push() is wait-free and may be called from several threads at once. Drain() must only be called from one thread at a time. */
+class IParamChangeSet
+{
+public:
+  IParamChangeSet(int nParams = 0)
+  {
+    Resize(nParams);
+  }
+
+  IParamChangeSet(const IParamChangeSet&) = delete;
+  IParamChangeSet& operator=(const IParamChangeSet&) = delete;
+
+  /** Sets the number of parameters and clears all changes. Must not be called while other threads use the set */
+  void Resize(int nParams)
+  {
+    mNParams = nParams;
+    mNWords = (nParams + 63) / 64;
+    mNSummaryWords = (mNWords + 63) / 64;
+    mValues.reset(new std::atomic<double>[nParams]);
+    mDirty.reset(new std::atomic<uint64_t>[mNWords]);
+    mSummary.reset(new std::atomic<uint64_t>[mNSummaryWords]);
+    Clear();
+  }
+
+  /** @return The number of parameters */
+  int GetSize() const { return mNParams; }
+
+  /** Stores the latest value of a parameter. Realtime safe. Out of range indexes are ignored
+   * @param normalizedValue The normalised value. Values are only stored normalised, so that each change is a single atomic store */
+  void Push(int paramIdx, double normalizedValue)
+  {
+    if (paramIdx < 0 || paramIdx >= mNParams)
+      return;
+
+    mValues[paramIdx].store(normalizedValue, std::memory_order_relaxed);
+
+    // the dirty bit first, so that Drain() never clears a summary bit while its word still has to be visited
+    const int word = paramIdx >> 6;
+    mDirty[word].fetch_or(uint64_t(1) << (paramIdx & 63), std::memory_order_release);
+    mSummary[word >> 6].fetch_or(uint64_t(1) << (word & 63), std::memory_order_release);
+  }
+
+  /** Calls func(const IParamChange&) once for each parameter changed since the last call, in index order, with its latest normalised value
+   * @return The number of changes delivered */
+  template <typename F>
+  int Drain(F func)
+  {
+    int nChanges = 0;
+
+    for (int s = 0; s < mNSummaryWords; s++)
+    {
+      if (!mSummary[s].load(std::memory_order_relaxed))
+        continue;
+
+      uint64_t words = mSummary[s].exchange(0, std::memory_order_acquire);
+
+      while (words)
+      {
+        const int word = (s << 6) + CountTrailingZeros(words);
+        words &= words - 1;
+        uint64_t bits = mDirty[word].exchange(0, std::memory_order_acquire);
+
+        while (bits)
+        {
+          const int paramIdx = (word << 6) + CountTrailingZeros(bits);
+          bits &= bits - 1;
+          func(IParamChange { paramIdx, mValues[paramIdx].load(std::memory_order_relaxed), true });
+          nChanges++;
+        }
+      }
+    }
+
+    return nChanges;
+  }
+
+  /** Forgets all changes */
+  void Clear()
+  {
+    for (int i = 0; i < mNParams; i++)
+      mValues[i].store(0., std::memory_order_relaxed);
+
+    for (int i = 0; i < mNWords; i++)
+      mDirty[i].store(0, std::memory_order_relaxed);
+
+    for (int i = 0; i < mNSummaryWords; i++)
+      mSummary[i].store(0, std::memory_order_release);
+  }
+
+private:
+  static int CountTrailingZeros(uint64_t v)
+  {
+#if defined _MSC_VER && defined _WIN64
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (int) idx;
+#elif defined _MSC_VER
+    unsigned long idx;
+    if (_BitScanForward(&idx, (unsigned long) v))
+      return (int) idx;
+    _BitScanForward(&idx, (unsigned long) (v >> 32));
+    return (int) idx + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+  }
+
+  int mNParams = 0;
+  int mNWords = 0;
+  int mNSummaryWords = 0;
+  std::unique_ptr<std::atomic<double>[]> mValues;
+  std::unique_ptr<std::atomic<uint64_t>[]> mDirty;
+  std::unique_ptr<std::atomic<uint64_t>[]> mSummary;
+};
@@ -0,0 +1,323 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IParamSmoother
+ */
+
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "heapbuf.h"
+
+#include "IPlugConstants.h"
+
+/** The maximum number of sample accurate automation points per parameter, per block. Further points in the same block replace the last one */
+#ifndef PARAM_SMOOTHING_MAX_POINTS
+#define PARAM_SMOOTHING_MAX_POINTS 16
+#endif
+
+/** A parameter is considered settled once it is within this fraction of its range from the target */
+#define PARAM_SMOOTHING_SETTLE_THRESHOLD 0.000001
+
+/** Renders smoothed values for the parameters that opt into smoothing, once per block.
+ * Each smoothed parameter gets a row of sample values in one contiguous buffer, so DSP code can read a plain sample array per parameter.
+ * Rows are padded to a multiple of 8 samples, so that every row has the same alignment.
+ * Parameters that have reached their target are skipped; their row is filled with a constant once, when they settle.
+ * Targets can be set from any thread via SetTarget(). Sample accurate points (sampleOffset > -1) must be set on the audio thread, before ProcessBlock()
+ * Blocks longer than the maximum block size passed to Reset() are rendered in chunks, see ProcessBlock() */
+class IParamSmoother
+{
+public:
+  enum ECurve
+  {
+    kCurveLinear = 0, // reaches the target in exactly the smoothing time
+    kCurveExponential // one-pole low pass, the smoothing time is the time constant
+  };
+
+  /** Opt a parameter into smoothing. Call this on the main thread before processing starts
+   * @param paramIdx The parameter index
+   * @param timeMs The smoothing time in milliseconds
+   * @param curve The smoothing curve
+   * @param value The current value of the parameter
+   * @param range The range of the parameter, used to decide when it has settled */
+  void SetSmoothing(int paramIdx, double timeMs, ECurve curve, double value, double range)
+  {
+    if(paramIdx >= (int) mParamToSlot.size())
+      mParamToSlot.resize(paramIdx + 1, -1);
+
+    Slot* pSlot = nullptr;
+
+    if(mParamToSlot[paramIdx] > -1)
+      pSlot = mSlots[mParamToSlot[paramIdx]].get();
+    else
+    {
+      mParamToSlot[paramIdx] = (int) mSlots.size();
+      mSlots.emplace_back(new Slot);
+      pSlot = mSlots.back().get();
+    }
+
+    pSlot->mTimeMs = timeMs;
+    pSlot->mCurve = curve;
+    pSlot->mThreshold = std::fabs(range) * PARAM_SMOOTHING_SETTLE_THRESHOLD;
+    pSlot->mTarget.store(value);
+    pSlot->mActiveTarget = pSlot->mCurrent = value;
+    pSlot->mSettled = true;
+    pSlot->mRowFilled = false;
+
+    Reset(mSampleRate, mMaxBlockSize);
+  }
+
+  /** Call this on a sample rate or block size change, e.g. from OnReset(). Allocates the buffer and jumps all smoothed parameters to their targets
+   * @param sampleRate The sample rate
+   * @param maxBlockSize The largest number of frames that will be passed to ProcessBlock() */
+  void Reset(double sampleRate, int maxBlockSize)
+  {
+    mSampleRate = sampleRate;
+    mMaxBlockSize = std::max(maxBlockSize, 1);
+    mRowStride = (mMaxBlockSize + 7) & ~7;
+    mBuffer.Resize((int) mSlots.size() * mRowStride);
+
+    for (int i = 0; i < (int) mSlots.size(); i++)
+    {
+      Slot& slot = *mSlots[i];
+      const double timeSamples = std::max(slot.mTimeMs * 0.001 * sampleRate, 1.);
+      slot.mCoeff = 1. - std::exp(-1. / timeSamples);
+      slot.mRampSamples = (int) timeSamples;
+      slot.mLastTargetSeq = slot.mTargetSeq.load(std::memory_order_acquire);
+      slot.mActiveTarget = slot.mCurrent = slot.mTarget.load();
+      slot.mRampRemaining = 0;
+      slot.mNPoints = 0;
+      slot.mSettled = true;
+      slot.mRowFilled = false;
+      slot.mRow = mBuffer.Get() + (i * mRowStride);
+    }
+  }
+
+  /** Set a new target value, e.g. from OnParamChange()
+   * @param paramIdx The parameter index, parameters that are not smoothed are ignored
+   * @param value The new non-normalised value
+   * @param sampleOffset If this is > -1 the change happens at this sample in the next block. Only valid on the audio thread */
+  void SetTarget(int paramIdx, double value, int sampleOffset = -1)
+  {
+    Slot* pSlot = GetSlot(paramIdx);
+
+    if(!pSlot)
+      return;
+
+    if(sampleOffset > -1)
+    {
+      const int pointIdx = std::min(pSlot->mNPoints, PARAM_SMOOTHING_MAX_POINTS - 1);
+      pSlot->mPoints[pointIdx] = { sampleOffset, value };
+      pSlot->mNPoints = pointIdx + 1;
+    }
+    else
+    {
+      pSlot->mTarget.store(value);
+      pSlot->mTargetSeq.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  /** Render the smoothed values of all smoothed parameters for this block. Call on the audio thread at the start of ProcessBlock()
+   * If nFrames is larger than the block size passed to Reset(), only that many frames are rendered and sample accurate points after them
+   * are kept for the next call. Process the block in chunks of the returned size, calling this at the start of each chunk
+   * @param nFrames The number of frames left in this block
+   * @return The number of frames rendered, which the values returned by GetValues() are valid for */
+  int ProcessBlock(int nFrames)
+  {
+    const int n = std::min(nFrames, mMaxBlockSize);
+    const bool lastChunk = n == nFrames;
+
+    for (auto& pSlot : mSlots)
+    {
+      Slot& slot = *pSlot;
+
+      if(slot.mNPoints == 0)
+      {
+        // any SetTarget() since the last ramp wins, even if it sets the value from before some sample accurate points
+        const uint32_t seq = slot.mTargetSeq.load(std::memory_order_acquire);
+
+        if(seq != slot.mLastTargetSeq)
+        {
+          slot.mLastTargetSeq = seq;
+          slot.BeginRamp(slot.mTarget.load());
+        }
+
+        if(slot.mSettled)
+        {
+          if(!slot.mRowFilled)
+          {
+            slot.Fill(0, mMaxBlockSize);
+            slot.mRowFilled = true;
+          }
+
+          continue;
+        }
+
+        slot.Render(0, n);
+      }
+      else
+      {
+        int pos = 0;
+        int p = 0;
+
+        for (; p < slot.mNPoints && (lastChunk || slot.mPoints[p].mOffset < n); p++)
+        {
+          const int offset = std::min(std::max(slot.mPoints[p].mOffset, pos), n);
+          slot.Render(pos, offset);
+          slot.BeginRamp(slot.mPoints[p].mValue);
+          pos = offset;
+        }
+
+        slot.Render(pos, n);
+
+        // points after this chunk move to the start of the next one
+        int nKept = 0;
+
+        for (; p < slot.mNPoints; p++)
+          slot.mPoints[nKept++] = { slot.mPoints[p].mOffset - n, slot.mPoints[p].mValue };
+
+        slot.mNPoints = nKept;
+      }
+    }
+
+    return n;
+  }
+
+  /** @return A pointer to the smoothed values for the current block, or nullptr if the parameter is not smoothed */
+  const sample* GetValues(int paramIdx) const
+  {
+    const Slot* pSlot = GetSlot(paramIdx);
+    return pSlot ? pSlot->mRow : nullptr;
+  }
+
+  /** @return The smoothed value at the end of the current block */
+  double GetValue(int paramIdx) const
+  {
+    const Slot* pSlot = GetSlot(paramIdx);
+    return pSlot ? pSlot->mCurrent : 0.;
+  }
+
+  /** @return \c true if the parameter has reached its target, meaning its values for the current block are constant */
+  bool IsSettled(int paramIdx) const
+  {
+    const Slot* pSlot = GetSlot(paramIdx);
+    return pSlot ? pSlot->mSettled : true;
+  }
+
+  bool IsSmoothed(int paramIdx) const { return GetSlot(paramIdx) != nullptr; }
+
+private:
+  struct Point
+  {
+    int mOffset;
+    double mValue;
+  };
+
+  struct Slot
+  {
+    void BeginRamp(double target)
+    {
+      mActiveTarget = target;
+      mSettled = false;
+      mRowFilled = false;
+      mRampRemaining = mRampSamples;
+      mRampStep = (target - mCurrent) / std::max(mRampSamples, 1);
+    }
+
+    void Fill(int startIdx, int endIdx)
+    {
+      for (auto s = startIdx; s < endIdx; s++)
+        mRow[s] = (sample) mCurrent;
+    }
+
+    void Render(int startIdx, int endIdx)
+    {
+      if(mSettled)
+      {
+        Fill(startIdx, endIdx);
+        return;
+      }
+
+      int s = startIdx;
+
+      if(mCurve == kCurveLinear)
+      {
+        for (; s < endIdx && mRampRemaining > 0; s++, mRampRemaining--)
+        {
+          mCurrent += mRampStep;
+          mRow[s] = (sample) mCurrent;
+        }
+
+        if(mRampRemaining == 0)
+          Settle();
+      }
+      else
+      {
+        for (; s < endIdx; s++)
+        {
+          mCurrent += mCoeff * (mActiveTarget - mCurrent);
+          mRow[s] = (sample) mCurrent;
+        }
+
+        if(std::fabs(mActiveTarget - mCurrent) <= mThreshold)
+          Settle();
+      }
+
+      Fill(s, endIdx);
+    }
+
+    void Settle()
+    {
+      mCurrent = mActiveTarget;
+      mSettled = true;
+    }
+
+    std::atomic<double> mTarget {0.}; // written by SetTarget() on any thread, only read on the audio thread
+    std::atomic<uint32_t> mTargetSeq {0}; // bumped after every write to mTarget
+    uint32_t mLastTargetSeq = 0; // the mTargetSeq last ramped to, so that sample accurate points are not undone by an unchanged mTarget
+    double mActiveTarget = 0.;
+    double mCurrent = 0.;
+    double mTimeMs = 0.;
+    double mThreshold = 0.;
+    double mCoeff = 1.;
+    double mRampStep = 0.;
+    int mRampSamples = 1;
+    int mRampRemaining = 0;
+    ECurve mCurve = kCurveExponential;
+    bool mSettled = true;
+    bool mRowFilled = false;
+    sample* mRow = nullptr;
+    Point mPoints[PARAM_SMOOTHING_MAX_POINTS];
+    int mNPoints = 0;
+  };
+
+  Slot* GetSlot(int paramIdx) const
+  {
+    if(paramIdx < 0 || paramIdx >= (int) mParamToSlot.size() || mParamToSlot[paramIdx] < 0)
+      return nullptr;
+
+    return mSlots[mParamToSlot[paramIdx]].get();
+  }
+
+  std::vector<int> mParamToSlot;
+  std::vector<std::unique_ptr<Slot>> mSlots;
+  WDL_TypedBuf<sample> mBuffer;
+  double mSampleRate = DEFAULT_SAMPLE_RATE;
+  int mMaxBlockSize = DEFAULT_BLOCK_SIZE;
+  int mRowStride = DEFAULT_BLOCK_SIZE;
+};
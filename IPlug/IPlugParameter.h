@@ -138,6 +138,11 @@ public:
   void SetToDefault() { mValue.store(mDefault); }
   void SetDefault(double value) { mDefault = value; SetToDefault(); }
 
+  /** Sets the ID that identifies this parameter in tagged state chunks (see IPluginBase::SetStateFormat()), so that parameters can be
+   * reordered, inserted or removed in later versions of a plug-in without breaking saved state. By default the parameter index is used
+   * @param id A non-negative ID, unique within the plug-in */
+  void SetStableID(int id) { mStableID = id; }
+
   void SetDisplayText(double value, const char* str);
 
   // Accessors / converters.
@@ -181,6 +186,8 @@ public:
   int GetDisplayPrecision() const {return mDisplayPrecision;}
   
   int GetFlags() const { return mFlags; }
+  /** @return The ID set with SetStableID(), or -1 if the parameter index is used */
+  int GetStableID() const { return mStableID; }
   bool GetCanAutomate() const { return !(mFlags & kFlagCannotAutomate); }
   bool GetStepped() const { return mFlags & kFlagStepped; }
   bool GetNegateDisplay() const { return mFlags & kFlagNegateDisplay; }
@@ -205,6 +212,7 @@ private:
   double mDefault = 0.0;
   int mDisplayPrecision = 0;
   int mFlags = 0;
+  int mStableID = -1;
 
   char mName[MAX_PARAM_NAME_LEN];
   char mLabel[MAX_PARAM_LABEL_LEN];
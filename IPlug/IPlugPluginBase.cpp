@@ -13,6 +13,8 @@
  * @brief IPluginBase implementation
  */
 
+#include <unordered_map>
+
 #include "IPlugPluginBase.h"
 #include "wdlendian.h"
 #include "wdl_base64.h"
@@ -79,6 +81,7 @@ const char* IPluginBase::GetAPIStr() const
     case kAPIAPP: return "Standalone";
     case kAPIWAM: return "WAM";
     case kAPIWEB: return "WEB";
+    case kAPIBENCH: return "Bench";
     default: return "";
   }
 }
@@ -105,9 +108,19 @@ void IPluginBase::GetBuildInfoStr(WDL_String& str) const
 void IPluginBase::OnParamChange(int paramIdx, EParamSource source, int sampleOffset)
 {
   Trace(TRACELOC, "idx:%i src:%s\n", paramIdx, ParamSourceStrs[source]);
+  
+  // only host automation arrives on the audio thread with a sample offset, other sources take effect at the start of the next block
+  mParamSmoother.SetTarget(paramIdx, GetParam(paramIdx)->Value(), source == kHost ? sampleOffset : -1);
+  
   OnParamChange(paramIdx);
 }
 
+void IPluginBase::SetParamSmoothing(int paramIdx, double timeMs, IParamSmoother::ECurve curve)
+{
+  IParam* pParam = GetParam(paramIdx);
+  mParamSmoother.SetSmoothing(paramIdx, timeMs, curve, pParam->Value(), pParam->GetRange());
+}
+
 void IPluginBase::OnParamReset(EParamSource source)
 {
   for (int i = 0; i < NParams(); ++i)
@@ -124,36 +137,196 @@ bool IPluginBase::SerializeParams(IByteChunk& chunk)
   TRACE;
   bool savedOK = true;
   int i, n = mParams.GetSize();
-  for (i = 0; i < n && savedOK; ++i)
+
+  if (mStateFormat == kStateFormatLegacy)
+  {
+    chunk.Reserve(n * (int) sizeof(double));
+
+    for (i = 0; i < n && savedOK; ++i)
+    {
+      IParam* pParam = mParams.Get(i);
+      Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
+      double v = pParam->Value();
+      savedOK &= (chunk.Put(&v) > 0);
+    }
+
+    return savedOK;
+  }
+
+  // parameters are stored in runs of consecutive IDs, so that a full state costs little more than the legacy format
+  IByteChunk payload;
+  const int sectionPos = IStateFormat::BeginSection(payload, IStateFormat::kParamsSection);
+  const int runsPos = payload.Size();
+  payload.Resize(runsPos + (int) sizeof(int) + n * (int) (2 * sizeof(int) + sizeof(double))); // enough for a run per parameter
+
+  uint8_t* pStart = payload.GetData() + runsPos + sizeof(int);
+  uint8_t* pWrite = pStart;
+  uint8_t* pRunCount = nullptr;
+  int nRuns = 0, runCount = 0, nextID = -1;
+
+  for (i = 0; i < n; ++i)
   {
     IParam* pParam = mParams.Get(i);
-    Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
-    double v = pParam->Value();
-    savedOK &= (chunk.Put(&v) > 0);
+    const double v = pParam->Value();
+
+    if ((mStateFormat & kStateFormatDelta) && v == pParam->GetDefault())
+      continue;
+
+    const int id = GetParamStableID(i);
+
+    if (!pRunCount || id != nextID)
+    {
+      if (pRunCount)
+        memcpy(pRunCount, &runCount, sizeof(int));
+
+      memcpy(pWrite, &id, sizeof(int));
+      pRunCount = pWrite + sizeof(int);
+      pWrite += 2 * sizeof(int);
+      runCount = 0;
+      nRuns++;
+    }
+
+    memcpy(pWrite, &v, sizeof(double));
+    pWrite += sizeof(double);
+    runCount++;
+    nextID = id + 1;
   }
-  return savedOK;
+
+  if (pRunCount)
+    memcpy(pRunCount, &runCount, sizeof(int));
+
+  memcpy(payload.GetData() + runsPos, &nRuns, sizeof(int));
+  payload.Resize(runsPos + (int) sizeof(int) + (int) (pWrite - pStart));
+  IStateFormat::EndSection(payload, sectionPos);
+
+  return IStateFormat::Write(chunk, payload, mStateFormat);
 }
 
 int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
 {
   TRACE;
+  IParamSnapshot snapshot;
+  const int pos = PrepareParamSnapshot(chunk, startPos, snapshot);
+
+  // a legacy chunk that is too short (e.g. from a version with fewer parameters) is still applied as far as it goes
+  if (pos >= 0 || !IStateFormat::HasHeader(chunk, startPos))
+    ApplyParamSnapshot(snapshot);
+
+  return pos;
+}
+
+int IPluginBase::PrepareParamSnapshot(const IByteChunk& chunk, int startPos, IParamSnapshot& snapshot) const
+{
   int i, n = mParams.GetSize(), pos = startPos;
-  ENTER_PARAMS_MUTEX;
-  for (i = 0; i < n && pos >= 0; ++i)
+  double* pValues = snapshot.mValues.Resize(n);
+
+  if (!IStateFormat::HasHeader(chunk, startPos))
   {
-    IParam* pParam = mParams.Get(i);
-    double v = 0.0;
-    pos = chunk.Get(&v, pos);
-    pParam->Set(v);
-    Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
+    for (i = 0; i < n && pos >= 0; ++i)
+    {
+      pValues[i] = mParams.Get(i)->GetDefault();
+      pos = chunk.Get(&pValues[i], pos);
+    }
+
+    return pos;
   }
 
-  OnParamReset(kPresetRecall);
+  IByteChunk payload;
+  int flags = 0;
+  pos = IStateFormat::Read(chunk, startPos, payload, flags);
+
+  if (pos < 0)
+  {
+    DBGMSG("Failed to read a tagged state chunk, it may be from a newer version or compressed without STATE_COMPRESSION\n");
+    return -1;
+  }
+
+  for (i = 0; i < n; ++i)
+    pValues[i] = mParams.Get(i)->GetDefault();
+
+  int length = 0;
+  int paramPos = IStateFormat::FindSection(payload, IStateFormat::kParamsSection, length);
+  const int sectionEnd = paramPos + length;
+  int nRuns = 0;
+  paramPos = payload.Get(&nRuns, paramPos);
+
+  if (paramPos < 0)
+    return -1;
+
+  // IDs are the parameter indices unless a plug-in has set its own, in which case they are looked up
+  std::unordered_map<int, int> idxForID;
+
+  for (i = 0; i < n; ++i)
+  {
+    if (mParams.Get(i)->GetStableID() > -1)
+    {
+      for (int p = 0; p < n; ++p)
+      {
+        const int id = GetParamStableID(p);
+
+        // two parameters with one ID would silently share a value, so the chunk is rejected rather than loaded wrongly
+        if (!idxForID.emplace(id, p).second)
+        {
+          DBGMSG("Parameters %i and %i have the same stable ID %i, see IParam::SetStableID()\n", idxForID[id], p, id);
+          assert(false && "duplicate stable parameter ID");
+          return -1;
+        }
+      }
+
+      break;
+    }
+  }
+
+  for (int r = 0; r < nRuns; ++r)
+  {
+    int firstID = 0, runCount = 0;
+    paramPos = payload.Get(&firstID, paramPos);
+    paramPos = payload.Get(&runCount, paramPos);
+
+    if (paramPos < 0 || runCount < 0 || runCount > (sectionEnd - paramPos) / (int) sizeof(double))
+      return -1;
+
+    const uint8_t* pRead = payload.GetData() + paramPos;
+    paramPos += runCount * (int) sizeof(double);
+
+    for (int k = 0; k < runCount; ++k, pRead += sizeof(double))
+    {
+      const int id = firstID + k;
+      int idx = -1;
+
+      if (idxForID.empty())
+        idx = id < n ? id : -1;
+      else
+      {
+        auto it = idxForID.find(id);
+
+        if (it != idxForID.end())
+          idx = it->second;
+      }
+
+      // IDs that are no longer used, e.g. parameters removed in a later version, are skipped
+      if (idx > -1)
+        memcpy(&pValues[idx], pRead, sizeof(double));
+    }
+  }
 
-  LEAVE_PARAMS_MUTEX;
   return pos;
 }
 
+void IPluginBase::ApplyParamSnapshot(const IParamSnapshot& snapshot)
+{
+  TRACE;
+  const int n = std::min(mParams.GetSize(), snapshot.mValues.GetSize());
+  const double* pValues = snapshot.mValues.Get();
+
+  ENTER_PARAMS_MUTEX;
+  for (int i = 0; i < n; ++i)
+    mParams.Get(i)->Set(pValues[i]);
+
+  OnParamReset(kPresetRecall);
+  LEAVE_PARAMS_MUTEX;
+}
+
 void IPluginBase::InitParamRange(int startIdx, int endIdx, int countStart, const char* nameFmtStr, double defaultVal, double minVal, double maxVal, double step, const char *label, int flags, const char *group, IParam::Shape *shape, IParam::EParamUnit unit, IParam::DisplayFunc displayFunc)
 {
   WDL_String nameStr;
@@ -822,15 +995,19 @@ bool IPluginBase::SaveBankAsFXB(const char* file)
         bnk.Put(&numParams);
         bnk.PutBytes(prgName, 28);
         
-        int pos = 0;
+        // presets are stored in the format set with SetStateFormat(), which may be tagged rather than one double per parameter
+        IParamSnapshot snapshot;
+        
+        if (PrepareParamSnapshot(pPreset->mChunk, 0, snapshot) < 0 && IStateFormat::HasHeader(pPreset->mChunk, 0))
+        {
+          for (int i = 0; i < NParams(); i++)
+            snapshot.mValues.Get()[i] = GetParam(i)->GetDefault();
+        }
         
         for (int i = 0; i< NParams(); i++)
         {
-          double v = 0.0;
-          pos = pPreset->mChunk.Get(&v, pos);
-          
           WDL_EndianFloat v32;
-          v32.f = (float) GetParam(i)->ToNormalized(v);
+          v32.f = (float) GetParam(i)->ToNormalized(snapshot.mValues.Get()[i]);
           uint32_t swapped = WDL_bswap32(v32.int32);
           bnk.Put(&swapped);
         }
@@ -19,7 +19,9 @@
 
 #include "IPlugDelegate_select.h"
 #include "IPlugParameter.h"
+#include "IPlugParamSmoother.h"
 #include "IPlugStructs.h"
+#include "IPlugStateFormat.h"
 #include "IPlugLogger.h"
 
 /** Base class that contains plug-in info and state manipulation methods */
@@ -122,20 +124,78 @@ public:
    * @param source Specifies the source of the parameter changes */
   void OnParamReset(EParamSource source);
   
+  /** Implemented by IPlugAPIBase, tells the host the current value of a parameter that the plug-in changed without a UI gesture,
+   * e.g. when IPresetBank recalls a preset on the audio thread. Call from the main thread
+   * @param paramIdx The index of the parameter that changed */
+  virtual void InformHostOfParamChangeFromPlug(int paramIdx) {};
+  
+#pragma mark - Parameter Smoothing
+  /** Opt a parameter into per-block smoothing. Call this in your constructor, after the parameter has been initialized.
+   * Changes to the parameter from any source, including sample accurate host automation, will then be smoothed
+   * @param paramIdx The parameter index
+   * @param timeMs The smoothing time in milliseconds
+   * @param curve IParamSmoother::kCurveExponential (one-pole) or IParamSmoother::kCurveLinear */
+  void SetParamSmoothing(int paramIdx, double timeMs, IParamSmoother::ECurve curve = IParamSmoother::kCurveExponential);
+  
+  /** Call this from OnReset(), to allocate the smoothing buffer and jump smoothed parameters to their current values
+   * @param sampleRate The sample rate
+   * @param maxBlockSize The largest number of frames that will be processed in one block */
+  void ResetParamSmoothing(double sampleRate, int maxBlockSize) { mParamSmoother.Reset(sampleRate, maxBlockSize); }
+  
+  /** Call this at the start of ProcessBlock() to render the smoothed values of all smoothed parameters for this block.
+   * If the host passes more frames than the maxBlockSize given to ResetParamSmoothing(), process the block in chunks of the returned size
+   * @param nFrames The number of frames left in the block
+   * @return The number of frames rendered */
+  int RenderSmoothedParams(int nFrames) { return mParamSmoother.ProcessBlock(nFrames); }
+  
+  /** @param paramIdx The parameter index
+   * @return nFrames smoothed, non-normalised values for this block, or nullptr if the parameter is not smoothed */
+  const sample* GetSmoothedParamValues(int paramIdx) const { return mParamSmoother.GetValues(paramIdx); }
+  
+  /** @param paramIdx The parameter index
+   * @return \c true if the smoothed values for this block are constant, so that per-sample work can be skipped */
+  bool IsParamSettled(int paramIdx) const { return mParamSmoother.IsSettled(paramIdx); }
+  
 #pragma mark - State Serialization
   /** @return \c true if the plug-in has been set up to do state chunks, via config.h */
   bool DoesStateChunks() const { return mStateChunks; }
   
-  /** Serializes the current double precision floating point, non-normalised values (IParam::mValue) of all parameters, into a binary byte chunk.
+  /** Sets the format SerializeParams() writes. UnserializeParams() reads all formats, but builds of a plug-in that predate the tagged format
+   * can't load chunks written in it. See IPlugStateFormat.h
+   * @param flags A combination of EStateFormat flags, kStateFormatLegacy by default */
+  void SetStateFormat(int flags) { mStateFormat = flags; }
+
+  /** @return The EStateFormat flags set with SetStateFormat() */
+  int GetStateFormat() const { return mStateFormat; }
+
+  /** Serializes the current double precision floating point, non-normalised values (IParam::mValue) of all parameters, into a binary byte chunk,
+   * in the format set with SetStateFormat()
    * @param chunk The output chunk to serialize to. Will append data if the chunk has already been started.
    * @return \c true if the serialization was successful */
   bool SerializeParams(IByteChunk& chunk);
   
   /** Unserializes double precision floating point, non-normalised values from a byte chunk into mParams.
+   * The chunk is parsed with PrepareParamSnapshot() before the values are applied with ApplyParamSnapshot()
    * @param chunk The incoming chunk where parameter values are stored to unserialize
    * @param startPos The start position in the chunk where parameter values are stored
    * @return The new chunk position (endPos) */
   int UnserializeParams(const IByteChunk& chunk, int startPos);
+
+  /** Reads parameter values written by SerializeParams() in any format, without modifying the plug-in or taking the params mutex.
+   * Parameters that are not in a tagged chunk, e.g. those added in a later version or omitted by kStateFormatDelta, get their default value
+   * @param chunk The incoming chunk where parameter values are stored
+   * @param startPos The start position in the chunk where parameter values are stored
+   * @param snapshot Filled with a value for every parameter
+   * @return The new chunk position (endPos), or -1 if the chunk could not be read or two parameters have the same stable ID */
+  int PrepareParamSnapshot(const IByteChunk& chunk, int startPos, IParamSnapshot& snapshot) const;
+
+  /** Sets all parameters from a snapshot made with PrepareParamSnapshot() and calls OnParamReset(kPresetRecall).
+   * If PARAMS_MUTEX is defined it is held while the values are set, which is a copy per parameter */
+  void ApplyParamSnapshot(const IParamSnapshot& snapshot);
+
+  /** @param paramIdx The parameter index
+   * @return The ID that identifies the parameter in tagged state chunks, see IParam::SetStableID() */
+  int GetParamStableID(int paramIdx) const { const int id = mParams.Get(paramIdx)->GetStableID(); return id > -1 ? id : paramIdx; }
   
   /** Override this method to serialize custom state data, if your plugin does state chunks.
    * @param chunk The output bytechunk where data can be serialized
@@ -337,6 +397,8 @@ protected:
   int mCurrentPresetIdx = 0;
   /** \c true if the plug-in does opaque state chunks. If false the host will provide a default interface */
   bool mStateChunks = false;
+  /** EStateFormat flags for SerializeParams() */
+  int mStateFormat = kStateFormatLegacy;
   /** The name of this plug-in */
   WDL_String mPluginName;
   /** Product name: if the plug-in is part of collection of plug-ins it might be one product */
@@ -374,6 +436,9 @@ protected:
   WDL_PtrList<IPreset> mPresets;
 #endif
 
+  /** Renders smoothed values for parameters that have opted in via SetParamSmoothing() */
+  IParamSmoother mParamSmoother;
+  
 #ifdef PARAMS_MUTEX
   /** Lock when accessing mParams (including via GetParam) from the audio thread */
   WDL_Mutex mParams_mutex;
@@ -0,0 +1,666 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief A bank of presets in a single memory mapped file, for plug-ins with libraries too big for IPluginBase::mPresets
+ *
+ * A bank file is written with IPresetBankWriter, one state chunk (as made by IPluginBase::SerializeState()) per preset.
+ * It starts with a header holding a magic, version, the number of presets and the offset of the index. The preset chunks follow
+ * back to back, then the index, one entry per preset with the offset and size of its chunk and the offset of its name,
+ * then the NUL terminated names.
+ *
+ * IPresetBank maps the file read-only, so only the presets that are actually used are paged in, and builds a hash index of the
+ * names, so that Find() does not depend on the number of presets. A worker thread prepares IParamSnapshots of the presets adjacent to
+ * the last one recalled, so that stepping through the bank with program changes finds them ready.
+ *
+ * Recall from the audio thread, e.g. on a MIDI program change, is realtime safe:
+ * @code
+ * void MyPlug::ProcessMidiMsg(const IMidiMsg& msg)
+ * {
+ *   if(msg.StatusMsg() == IMidiMsg::kProgramChange)
+ *     mBank.RequestRecall(msg.Program());
+ * }
+ *
+ * void MyPlug::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
+ * {
+ *   mBank.ProcessRecall(); // calls OnParamChange(paramIdx, kPresetRecall) if a requested preset is ready
+ *   ...
+ * }
+ *
+ * void MyPlug::OnIdle()
+ * {
+ *   mBank.OnIdle(); // updates the UI and the host after a recall on the audio thread
+ * }
+ * @endcode
+ * RequestRecall() only stores the index. The worker reads the preset's parameter values with IPluginBase::PrepareParamSnapshot(), and hands
+ * them over through a small pool of pre-allocated snapshots, which ProcessRecall() swaps out without locking or allocating.
+ * Only parameter values are recalled this way, so a plug-in that writes custom data before its parameters in SerializeState()
+ * should recall its presets with Restore() instead, which calls UnserializeState() on the main thread.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#include "IPlugPluginBase.h"
+#include "IPlugSemaphore.h"
+
+#ifdef OS_WIN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+/** The number of presets on each side of the last recalled preset that the worker prepares */
+#ifndef PRESET_BANK_PREFETCH
+#define PRESET_BANK_PREFETCH 2
+#endif
+
+#define PRESET_BANK_VERSION 1
+
+/** The layout of a bank file, shared by IPresetBankWriter and IPresetBank */
+struct IPresetBankFormat
+{
+  struct Header
+  {
+    char mMagic[4];
+    uint32_t mVersion;
+    uint32_t mNPresets;
+    uint32_t mReserved;
+    uint64_t mIndexOffset;
+  };
+
+  struct Entry
+  {
+    uint64_t mDataOffset;
+    uint32_t mDataSize;
+    uint32_t mNameOffset; // from the end of the index
+  };
+
+  static const char* GetMagic() { return "IPBK"; }
+
+  /** FNV-1a, for the name index */
+  static uint64_t HashName(const char* name)
+  {
+    uint64_t hash = 14695981039346656037ull;
+
+    while(*name)
+      hash = (hash ^ (uint8_t) *name++) * 1099511628211ull;
+
+    return hash;
+  }
+};
+
+/** Writes a bank file one preset at a time, so that a large library never has to be held in memory */
+class IPresetBankWriter
+{
+public:
+  IPresetBankWriter() {}
+  ~IPresetBankWriter() { Close(); }
+
+  IPresetBankWriter(const IPresetBankWriter&) = delete;
+  IPresetBankWriter& operator=(const IPresetBankWriter&) = delete;
+
+  /** @param path The UTF-8 path of the bank file, which is overwritten
+   * @return \c true if the file could be created */
+  bool Open(const char* path)
+  {
+    Close();
+    mFile = fopenUTF8(path, "wb");
+
+    if(!mFile)
+      return false;
+
+    IPresetBankFormat::Header header = {};
+    mOK = fwrite(&header, sizeof(header), 1, mFile) == 1;
+    mPos = sizeof(header);
+    return mOK;
+  }
+
+  /** Appends a preset
+   * @param name The preset name, which should be unique within the bank
+   * @param chunk The preset's state, as made by IPluginBase::SerializeState() */
+  bool Add(const char* name, const IByteChunk& chunk)
+  {
+    if(!mFile || !mOK)
+      return false;
+
+    IPresetBankFormat::Entry entry;
+    entry.mDataOffset = mPos;
+    entry.mDataSize = (uint32_t) chunk.Size();
+    entry.mNameOffset = (uint32_t) mNames.GetSize();
+    mEntries.Add(entry);
+
+    const int nameLen = (int) strlen(name) + 1;
+    memcpy(mNames.Resize(mNames.GetSize() + nameLen) + entry.mNameOffset, name, nameLen);
+
+    mOK = !chunk.Size() || fwrite(chunk.GetData(), chunk.Size(), 1, mFile) == 1;
+    mPos += chunk.Size();
+    return mOK;
+  }
+
+  /** Writes the index and closes the file
+   * @return \c true if every preset and the index were written */
+  bool Close()
+  {
+    if(!mFile)
+      return false;
+
+    IPresetBankFormat::Header header;
+    memcpy(header.mMagic, IPresetBankFormat::GetMagic(), sizeof(header.mMagic));
+    header.mVersion = PRESET_BANK_VERSION;
+    header.mNPresets = (uint32_t) mEntries.GetSize();
+    header.mReserved = 0;
+    header.mIndexOffset = mPos;
+
+    if(mOK && mEntries.GetSize())
+      mOK = fwrite(mEntries.Get(), sizeof(IPresetBankFormat::Entry), mEntries.GetSize(), mFile) == (size_t) mEntries.GetSize();
+
+    if(mOK && mNames.GetSize())
+      mOK = fwrite(mNames.Get(), 1, mNames.GetSize(), mFile) == (size_t) mNames.GetSize();
+
+    if(mOK)
+      mOK = fseek(mFile, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, mFile) == 1;
+
+    mOK = (fclose(mFile) == 0) && mOK;
+    mFile = nullptr;
+    mEntries.Resize(0);
+    mNames.Resize(0);
+    return mOK;
+  }
+
+private:
+  static FILE* fopenUTF8(const char* path, const char* mode)
+  {
+#ifdef OS_WIN
+    wchar_t wPath[MAX_PATH], wMode[8];
+    if(!MultiByteToWideChar(CP_UTF8, 0, path, -1, wPath, MAX_PATH) || !MultiByteToWideChar(CP_UTF8, 0, mode, -1, wMode, 8))
+      return nullptr;
+    return _wfopen(wPath, wMode);
+#else
+    return fopen(path, mode);
+#endif
+  }
+
+  FILE* mFile = nullptr;
+  bool mOK = false;
+  uint64_t mPos = 0;
+  WDL_TypedBuf<IPresetBankFormat::Entry> mEntries;
+  WDL_TypedBuf<char> mNames;
+};
+
+/** A read-only bank of presets in a memory mapped file, see the file description above */
+class IPresetBank
+{
+public:
+  /** @param plug The plug-in that the presets are recalled into. It must outlive the bank */
+  IPresetBank(IPluginBase& plug)
+  : mPlug(plug)
+  {
+  }
+
+  ~IPresetBank() { Close(); }
+
+  IPresetBank(const IPresetBank&) = delete;
+  IPresetBank& operator=(const IPresetBank&) = delete;
+
+  /** Maps a bank file, indexes the preset names and starts the worker thread. Call from the main thread, with no audio thread calls in progress
+   * @param path The UTF-8 path of a file written with IPresetBankWriter
+   * @return \c true if the file is a valid bank */
+  bool Open(const char* path)
+  {
+    Close();
+
+    if(!Map(path) || !ReadIndex())
+    {
+      DBGMSG("IPresetBank: %s is not a valid preset bank\n", path);
+      Close();
+      return false;
+    }
+
+    // pre-allocate the hand-over snapshots and the changed flags, so that neither thread allocates when recalling
+    for (auto& slot : mSlots)
+    {
+      slot.mSnapshot.mValues.Resize(mPlug.NParams());
+      slot.mInUse.store(false);
+    }
+
+    mNChangedParams = mPlug.NParams();
+    mChangedParams.reset(new std::atomic<bool>[mNChangedParams]);
+
+    for (auto i = 0; i < mNChangedParams; i++)
+      mChangedParams[i].store(false);
+
+    mRunning = true;
+    mThread = std::thread(&IPresetBank::ThreadFunc, this);
+    return true;
+  }
+
+  /** Stops the worker and unmaps the file. Call from the main thread, with no audio thread calls in progress */
+  void Close()
+  {
+    if(mThread.joinable())
+    {
+      mRunning = false;
+      mWakeWorker.Signal();
+      mThread.join();
+    }
+
+    mNameIndex.clear();
+    mEntries = nullptr;
+    mNames = nullptr;
+    mNPresets = 0;
+    mCurrentIdx = -1;
+    mRequestedIdx.store(-1);
+    mPrefetchIdx.store(-1);
+    mPendingSlot.store(-1);
+    mRecallApplied.store(false);
+
+    for (auto& cached : mCache)
+      cached.mPresetIdx = -1;
+
+    Unmap();
+  }
+
+  /** @return The number of presets in the bank */
+  int NPresets() const { return mNPresets; }
+
+  /** @return The index of the last preset recalled, or -1 */
+  int GetCurrentIdx() const { return mCurrentIdx; }
+
+  /** @return The name of a preset, which points into the mapped file and is valid until Close() */
+  const char* GetName(int idx) const
+  {
+    return (idx >= 0 && idx < mNPresets) ? mNames + GetEntry(idx).mNameOffset : "";
+  }
+
+  /** Looks a preset up by name, in constant time on average
+   * @return The index of the preset, or -1 if there is none with the name */
+  int Find(const char* name) const
+  {
+    auto range = mNameIndex.equal_range(IPresetBankFormat::HashName(name));
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if(!strcmp(GetName(it->second), name))
+        return it->second;
+    }
+
+    return -1;
+  }
+
+  /** Copies a preset's state chunk out of the mapped file
+   * @return \c true if idx is valid */
+  bool GetChunk(int idx, IByteChunk& chunk) const
+  {
+    if(idx < 0 || idx >= mNPresets)
+      return false;
+
+    const IPresetBankFormat::Entry entry = GetEntry(idx);
+    chunk.Clear();
+    chunk.Reserve((int) entry.mDataSize);
+    chunk.PutBytes(mData + entry.mDataOffset, (int) entry.mDataSize);
+    return true;
+  }
+
+  /** Restores a preset with IPluginBase::UnserializeState() and calls OnRestoreState(). Call from the main thread
+   * @return \c true on success */
+  bool Restore(int idx)
+  {
+    IByteChunk chunk;
+
+    if(!GetChunk(idx, chunk) || mPlug.UnserializeState(chunk, 0) < 0)
+      return false;
+
+    mCurrentIdx = idx;
+    mPrefetchIdx.store(idx);
+    mWakeWorker.Signal();
+    mPlug.OnRestoreState();
+    return true;
+  }
+
+  /** Restores a preset by name, see Restore(int) */
+  bool Restore(const char* name)
+  {
+    return Restore(Find(name));
+  }
+
+  /** Asks the worker to prepare a preset for ProcessRecall(). Realtime safe. If several requests are made before the worker
+   * gets to them, only the last one is recalled */
+  void RequestRecall(int idx)
+  {
+    if(idx >= 0 && idx < mNPresets)
+    {
+      mRequestedIdx.store(idx, std::memory_order_release);
+      mWakeWorker.Signal();
+    }
+  }
+
+  /** Sets the parameters from the last preset prepared after a RequestRecall(), if any, and calls OnParamChange(paramIdx, kPresetRecall)
+   * for each of them. Call from the audio thread at the start of ProcessBlock(). Realtime safe: the values are set with IParam::Set(),
+   * which is atomic, and the params mutex is not taken. The parameters whose values changed are flagged for OnIdle(), which tells the UI and the host
+   * @return \c true if a preset was recalled */
+  bool ProcessRecall()
+  {
+    const int slotIdx = mPendingSlot.exchange(-1, std::memory_order_acq_rel);
+
+    if(slotIdx < 0)
+      return false;
+
+    Slot& slot = mSlots[slotIdx];
+    const int n = std::min(mPlug.NParams(), slot.mSnapshot.mValues.GetSize());
+    const double* pValues = slot.mSnapshot.mValues.Get();
+
+    for (auto i = 0; i < n; i++)
+    {
+      IParam* pParam = mPlug.GetParam(i);
+
+      if(pParam->Value() != pValues[i])
+      {
+        pParam->Set(pValues[i]);
+        mChangedParams[i].store(true, std::memory_order_relaxed);
+      }
+    }
+
+    for (auto i = 0; i < n; i++)
+      mPlug.OnParamChange(i, kPresetRecall);
+
+    mAppliedIdx.store(slot.mPresetIdx, std::memory_order_relaxed);
+    mRecallApplied.store(true, std::memory_order_release);
+    slot.mInUse.store(false, std::memory_order_release);
+    return true;
+  }
+
+  /** Updates the current index after a recall on the audio thread, and sends each parameter that the recall changed to the UI, which calls
+   * OnParamChangeUI(), and to the host. Call from the main thread, e.g. in OnIdle()
+   * @return \c true if a preset had been recalled since the last call */
+  bool OnIdle()
+  {
+    if(!mRecallApplied.exchange(false, std::memory_order_acquire))
+      return false;
+
+    mCurrentIdx = mAppliedIdx.load(std::memory_order_relaxed);
+
+    for (auto i = 0; i < mNChangedParams; i++)
+    {
+      if(mChangedParams[i].exchange(false, std::memory_order_relaxed))
+      {
+        mPlug.SendParameterValueFromDelegate(i, mPlug.GetParam(i)->GetNormalized(), true);
+        mPlug.InformHostOfParamChangeFromPlug(i);
+      }
+    }
+
+    return true;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<bool> mInUse {false}; // owned by the worker while filled, then by the audio thread until it has been applied
+    int mPresetIdx = -1;
+    IParamSnapshot mSnapshot;
+  };
+
+  struct CachedSnapshot
+  {
+    int mPresetIdx = -1;
+    uint64_t mLastUsed = 0;
+    IParamSnapshot mSnapshot;
+  };
+
+  static constexpr int kNumSlots = 3; // one pending, one being applied and one being filled
+  static constexpr int kCacheSize = 2 * PRESET_BANK_PREFETCH + 2;
+
+  IPresetBankFormat::Entry GetEntry(int idx) const
+  {
+    IPresetBankFormat::Entry entry;
+    memcpy(&entry, mEntries + idx * sizeof(IPresetBankFormat::Entry), sizeof(entry));
+    return entry;
+  }
+
+  bool ReadIndex()
+  {
+    IPresetBankFormat::Header header;
+
+    if(mSize < sizeof(header))
+      return false;
+
+    memcpy(&header, mData, sizeof(header));
+
+    if(memcmp(header.mMagic, IPresetBankFormat::GetMagic(), sizeof(header.mMagic)) || header.mVersion > PRESET_BANK_VERSION)
+      return false;
+
+    const uint64_t indexSize = (uint64_t) header.mNPresets * sizeof(IPresetBankFormat::Entry);
+
+    if(header.mIndexOffset > mSize || indexSize > mSize - header.mIndexOffset)
+      return false;
+
+    mNPresets = (int) header.mNPresets;
+    mEntries = mData + header.mIndexOffset;
+    mNames = (const char*) mEntries + indexSize;
+    const uint64_t namesSize = mSize - header.mIndexOffset - indexSize;
+
+    mNameIndex.reserve(mNPresets);
+
+    for (auto i = 0; i < mNPresets; i++)
+    {
+      const IPresetBankFormat::Entry entry = GetEntry(i);
+
+      if(entry.mDataOffset > header.mIndexOffset || entry.mDataSize > header.mIndexOffset - entry.mDataOffset
+         || entry.mNameOffset >= namesSize || !memchr(mNames + entry.mNameOffset, 0, namesSize - entry.mNameOffset))
+        return false;
+
+      mNameIndex.emplace(IPresetBankFormat::HashName(mNames + entry.mNameOffset), i);
+    }
+
+    return true;
+  }
+
+  bool Map(const char* path)
+  {
+#ifdef OS_WIN
+    wchar_t wPath[MAX_PATH];
+    if(!MultiByteToWideChar(CP_UTF8, 0, path, -1, wPath, MAX_PATH))
+      return false;
+
+    mFile = CreateFileW(wPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+
+    if(mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &size) || !size.QuadPart)
+      return false;
+
+    mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if(!mMapping)
+      return false;
+
+    mData = (const uint8_t*) MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+    mSize = (uint64_t) size.QuadPart;
+    return mData != nullptr;
+#else
+    mFile = open(path, O_RDONLY);
+    struct stat info;
+
+    if(mFile < 0 || fstat(mFile, &info) || !info.st_size)
+      return false;
+
+    void* pData = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, mFile, 0);
+
+    if(pData == MAP_FAILED)
+      return false;
+
+    mData = (const uint8_t*) pData;
+    mSize = (uint64_t) info.st_size;
+    return true;
+#endif
+  }
+
+  void Unmap()
+  {
+#ifdef OS_WIN
+    if(mData)
+      UnmapViewOfFile(mData);
+
+    if(mMapping)
+      CloseHandle(mMapping);
+
+    if(mFile != INVALID_HANDLE_VALUE)
+      CloseHandle(mFile);
+
+    mMapping = nullptr;
+    mFile = INVALID_HANDLE_VALUE;
+#else
+    if(mData)
+      munmap((void*) mData, (size_t) mSize);
+
+    if(mFile >= 0)
+      close(mFile);
+
+    mFile = -1;
+#endif
+    mData = nullptr;
+    mSize = 0;
+  }
+
+  /** Worker thread only. @return The cached snapshot of a preset, preparing it if needed, or nullptr if it could not be read */
+  const IParamSnapshot* GetSnapshot(int idx)
+  {
+    CachedSnapshot* pOldest = &mCache[0];
+
+    for (auto& cached : mCache)
+    {
+      if(cached.mPresetIdx == idx)
+      {
+        cached.mLastUsed = ++mCacheClock;
+        return &cached.mSnapshot;
+      }
+
+      if(cached.mLastUsed < pOldest->mLastUsed)
+        pOldest = &cached;
+    }
+
+    pOldest->mPresetIdx = -1;
+
+    if(!GetChunk(idx, mChunk) || mPlug.PrepareParamSnapshot(mChunk, 0, pOldest->mSnapshot) < 0)
+      return nullptr;
+
+    pOldest->mPresetIdx = idx;
+    pOldest->mLastUsed = ++mCacheClock;
+    return &pOldest->mSnapshot;
+  }
+
+  /** Worker thread only. Copies a preset's values into a free slot and makes it the pending one */
+  void Publish(int idx)
+  {
+    const IParamSnapshot* pSnapshot = GetSnapshot(idx);
+    int slotIdx = 0;
+
+    while(slotIdx < kNumSlots && mSlots[slotIdx].mInUse.load(std::memory_order_acquire))
+      slotIdx++;
+
+    if(!pSnapshot || slotIdx == kNumSlots)
+      return;
+
+    Slot& slot = mSlots[slotIdx];
+    slot.mInUse.store(true, std::memory_order_relaxed);
+    slot.mPresetIdx = idx;
+    const int n = std::min(slot.mSnapshot.mValues.GetSize(), pSnapshot->mValues.GetSize());
+    memcpy(slot.mSnapshot.mValues.Get(), pSnapshot->mValues.Get(), n * sizeof(double));
+
+    // a preset that was published but not picked up by the audio thread yet is superseded
+    const int replaced = mPendingSlot.exchange(slotIdx, std::memory_order_acq_rel);
+
+    if(replaced > -1)
+      mSlots[replaced].mInUse.store(false, std::memory_order_release);
+  }
+
+  /** Worker thread only. Prepares the presets around idx, nearest first, stopping early if a recall is requested */
+  void Prefetch(int idx)
+  {
+    for (auto d = 1; d <= PRESET_BANK_PREFETCH && mRequestedIdx.load(std::memory_order_relaxed) < 0; d++)
+    {
+      if(idx + d < mNPresets)
+        GetSnapshot(idx + d);
+
+      if(idx - d >= 0)
+        GetSnapshot(idx - d);
+    }
+  }
+
+  void ThreadFunc()
+  {
+    while(mRunning)
+    {
+      const int requested = mRequestedIdx.exchange(-1, std::memory_order_acquire);
+
+      if(requested > -1)
+      {
+        Publish(requested);
+        Prefetch(requested);
+        continue;
+      }
+
+      const int prefetch = mPrefetchIdx.exchange(-1);
+
+      if(prefetch > -1)
+      {
+        GetSnapshot(prefetch);
+        Prefetch(prefetch);
+        continue;
+      }
+
+      mWakeWorker.Wait();
+    }
+  }
+
+  IPluginBase& mPlug;
+
+#ifdef OS_WIN
+  HANDLE mFile = INVALID_HANDLE_VALUE;
+  HANDLE mMapping = nullptr;
+#else
+  int mFile = -1;
+#endif
+  const uint8_t* mData = nullptr;
+  uint64_t mSize = 0;
+  const uint8_t* mEntries = nullptr;
+  const char* mNames = nullptr;
+  int mNPresets = 0;
+  std::unordered_multimap<uint64_t, int> mNameIndex; // name hash to preset index, names are compared on lookup
+  int mCurrentIdx = -1;
+
+  std::thread mThread;
+  IPlugSemaphore mWakeWorker;
+  std::atomic<bool> mRunning {false};
+  std::atomic<int> mRequestedIdx {-1}; // written by the audio thread
+  std::atomic<int> mPrefetchIdx {-1}; // written by the main thread
+  std::atomic<int> mPendingSlot {-1};
+  std::atomic<int> mAppliedIdx {-1};
+  std::atomic<bool> mRecallApplied {false};
+  std::unique_ptr<std::atomic<bool>[]> mChangedParams; // set by the audio thread, cleared by OnIdle()
+  int mNChangedParams = 0;
+  Slot mSlots[kNumSlots];
+
+  // worker thread only
+  CachedSnapshot mCache[kCacheSize];
+  uint64_t mCacheClock = 0;
+  IByteChunk mChunk;
+};
@@ -0,0 +1,187 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IProcessTimer
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "IPlugQueue.h"
+
+/** The amount of audio (in seconds) summarised in each IProcessTimingStats packet */
+#ifndef PROCESS_TIMING_REPORT_INTERVAL
+#define PROCESS_TIMING_REPORT_INTERVAL 0.1
+#endif
+
+#define PROCESS_TIMING_TRANSFER_SIZE 64
+
+/** A summary of the processing load over one report interval. Load is the time spent processing a block relative to the block's
+ * real-time budget (nFrames / sample rate), so 1.0 means the block took as long to process as it lasts */
+struct IProcessTimingStats
+{
+  float mAverageLoad = 0.f; // over the report interval
+  float mP99Load = 0.f; // over the report interval, to the precision of the histogram
+  float mMaxLoad = 0.f; // over the report interval
+  float mPeakLoad = 0.f; // since the timer was last reset
+  int mNOverruns = 0; // blocks that exceeded their budget since the timer was last reset
+  int mNBlocks = 0; // blocks measured since the timer was last reset
+};
+
+/** Measures how long the audio thread spends processing each block. Used by IPlugProcessor, see IPlugProcessor::EnableProcessTiming().
+ * When disabled the cost is a relaxed atomic load per block. When enabled, each block's load is added to a histogram
+ * and a summary is pushed to a queue for the main thread every PROCESS_TIMING_REPORT_INTERVAL seconds of audio. */
+class IProcessTimer
+{
+public:
+  static constexpr int kNHistogramBins = 100;
+  static constexpr float kHistogramMaxLoad = 2.f; // the last bin also counts all blocks above this load
+
+  void SetEnabled(bool enable) { mEnabled.store(enable, std::memory_order_relaxed); }
+
+  bool GetEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+  /** Called on the main thread. The totals will be cleared at the start of the next measured block */
+  void Reset() { mResetRequested.store(true, std::memory_order_relaxed); }
+
+  /** Called on the audio thread before processing */
+  inline void BeginBlock()
+  {
+    if(mEnabled.load(std::memory_order_relaxed))
+    {
+      mStartTime = std::chrono::steady_clock::now();
+      mTiming = true;
+    }
+  }
+
+  /** Called on the audio thread after processing */
+  inline void EndBlock(int nFrames, double sampleRate)
+  {
+    if(!mTiming)
+      return;
+
+    mTiming = false;
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStartTime).count();
+
+    if(nFrames > 0 && sampleRate > 0.)
+      AddBlock(elapsed, nFrames / sampleRate);
+  }
+
+  /** Called on the main thread, e.g. in OnIdle()
+   * @param stats Set to the most recent summary, if there is one
+   * @return \c true if a new summary was available */
+  bool GetStats(IProcessTimingStats& stats)
+  {
+    bool hasStats = false;
+
+    while(mQueue.ElementsAvailable())
+    {
+      mQueue.Pop(stats);
+      hasStats = true;
+    }
+
+    return hasStats;
+  }
+
+  /** Can be called on any thread. The counts are cumulative since the timer was last reset.
+   * @param counts An array of kNHistogramBins counts, bin i counts blocks with a load between i and i + 1 * (kHistogramMaxLoad / kNHistogramBins) */
+  void GetHistogram(uint32_t* counts) const
+  {
+    for (auto i = 0; i < kNHistogramBins; i++)
+      counts[i] = mHistogram[i].load(std::memory_order_relaxed);
+  }
+
+private:
+  void AddBlock(double elapsed, double budget)
+  {
+    if(mResetRequested.exchange(false, std::memory_order_relaxed))
+    {
+      for (auto& bin : mHistogram)
+        bin.store(0, std::memory_order_relaxed);
+
+      mTotals = IProcessTimingStats();
+      ClearInterval();
+    }
+
+    const float load = (float) (elapsed / budget);
+    const int bin = std::min((int) (load * (kNHistogramBins / kHistogramMaxLoad)), kNHistogramBins - 1);
+
+    mHistogram[bin].fetch_add(1, std::memory_order_relaxed);
+    mIntervalHistogram[bin]++;
+
+    mIntervalLoadSum += load;
+    mIntervalMaxLoad = std::max(mIntervalMaxLoad, load);
+    mIntervalNBlocks++;
+    mIntervalTime += budget;
+
+    mTotals.mNBlocks++;
+    mTotals.mPeakLoad = std::max(mTotals.mPeakLoad, load);
+
+    if(load > 1.f)
+      mTotals.mNOverruns++;
+
+    if(mIntervalTime >= PROCESS_TIMING_REPORT_INTERVAL)
+    {
+      IProcessTimingStats stats = mTotals;
+      stats.mAverageLoad = mIntervalLoadSum / (float) mIntervalNBlocks;
+      stats.mMaxLoad = mIntervalMaxLoad;
+
+      const int p99Count = mIntervalNBlocks - (mIntervalNBlocks / 100);
+      int count = 0;
+
+      for (auto i = 0; i < kNHistogramBins; i++)
+      {
+        count += mIntervalHistogram[i];
+
+        if(count >= p99Count)
+        {
+          stats.mP99Load = std::min((i + 1) * (kHistogramMaxLoad / kNHistogramBins), mIntervalMaxLoad);
+          break;
+        }
+      }
+
+      mQueue.Push(stats);
+      ClearInterval();
+    }
+  }
+
+  void ClearInterval()
+  {
+    for (auto& count : mIntervalHistogram)
+      count = 0;
+
+    mIntervalLoadSum = 0.f;
+    mIntervalMaxLoad = 0.f;
+    mIntervalNBlocks = 0;
+    mIntervalTime = 0.;
+  }
+
+  std::atomic<bool> mEnabled {false};
+  std::atomic<bool> mResetRequested {false};
+  std::atomic<uint32_t> mHistogram[kNHistogramBins] = {};
+
+  // only touched by the audio thread
+  std::chrono::steady_clock::time_point mStartTime;
+  bool mTiming = false;
+  IProcessTimingStats mTotals;
+  int mIntervalHistogram[kNHistogramBins] = {};
+  float mIntervalLoadSum = 0.f;
+  float mIntervalMaxLoad = 0.f;
+  int mIntervalNBlocks = 0;
+  double mIntervalTime = 0.;
+
+  IPlugQueue<IProcessTimingStats> mQueue {PROCESS_TIMING_TRANSFER_SIZE};
+};
@@ -36,6 +36,14 @@ IPlugProcessor<T>::IPlugProcessor(IPlugConfig c, EAPI plugAPI)
   , mDoesMIDIOut(c.plugDoesMidiOut)
   , mDoesMPE(c.plugDoesMPE)
 {
+#ifdef RT_GUARD
+  IRTGuard::Get(); // construct the guard here, on the main thread, rather than from a hook on the audio thread
+#endif
+
+#ifdef TRACER_BUILD
+  TraceRingWriter::Get(); // opens the trace file and starts its drain thread here rather than at the first TRACE on the audio thread
+#endif
+
   int totalNInBuses, totalNOutBuses;
   int totalNInChans, totalNOutChans;
 
@@ -77,6 +85,10 @@ IPlugProcessor<T>::~IPlugProcessor()
 
   if (mLatencyDelay)
     DELETE_NULL(mLatencyDelay);
+
+#ifdef RT_GUARD
+  IRTGuard::Get().PrintReport(stderr, true);
+#endif
 }
 
 template<typename T>
@@ -410,10 +422,15 @@ void IPlugProcessor<T>::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAM
 template<typename T>
 void IPlugProcessor<T>::PassThroughBuffers(PLUG_SAMPLE_DST type, int nFrames)
 {
+  IRTGuardScope rtGuard;
+  mProcessTimer.BeginBlock();
+
   if (mLatency && mLatencyDelay)
     mLatencyDelay->ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
   else
     IPlugProcessor<T>::ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+
+  mProcessTimer.EndBlock(nFrames, mSampleRate);
 }
 
 template<typename T>
@@ -438,12 +455,17 @@ void IPlugProcessor<T>::PassThroughBuffers(PLUG_SAMPLE_SRC type, int nFrames)
 template<typename T>
 void IPlugProcessor<T>::ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames)
 {
+  IRTGuardScope rtGuard;
+  mProcessTimer.BeginBlock();
   ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+  mProcessTimer.EndBlock(nFrames, mSampleRate);
 }
 
 template<typename T>
 void IPlugProcessor<T>::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames)
 {
+  IRTGuardScope rtGuard;
+  mProcessTimer.BeginBlock();
   ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
   int i, n = MaxNChannels(ERoute::kOutput);
   IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
@@ -457,11 +479,15 @@ void IPlugProcessor<T>::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames)
       CastCopy(pOutChannel->mIncomingData, *(pOutChannel->mData), nFrames);
     }
   }
+
+  mProcessTimer.EndBlock(nFrames, mSampleRate);
 }
 
 template<typename T>
 void IPlugProcessor<T>::ProcessBuffersAccumulating(int nFrames)
 {
+  IRTGuardScope rtGuard;
+  mProcessTimer.BeginBlock();
   ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
   int i, n = MaxNChannels(ERoute::kOutput);
   IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
@@ -479,6 +505,8 @@ void IPlugProcessor<T>::ProcessBuffersAccumulating(int nFrames)
       }
     }
   }
+
+  mProcessTimer.EndBlock(nFrames, mSampleRate);
 }
 
 template<typename T>
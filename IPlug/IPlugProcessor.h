@@ -20,6 +20,8 @@
 #include "IPlugStructs.h"
 #include "IPlugUtilities.h"
 #include "NChanDelay.h"
+#include "IPlugProcessTimer.h"
+#include "IPlugRTGuard.h"
 
 /**
  * @file
@@ -104,6 +106,23 @@ public:
   /** @return \c true if the plugin is currently rendering off-line */
   bool GetRenderingOffline() const { return mRenderingOffline; };
 
+#pragma mark -
+  /** Measure the time the audio thread spends in each block, relative to the block's real-time budget. Off by default
+   * @param enable \c true to start measuring */
+  void EnableProcessTiming(bool enable) { mProcessTimer.SetEnabled(enable); }
+
+  /** Call this on the main thread, e.g. in OnIdle(), to get the latest summary of the processing load.
+   * Typically the result is sent to an IVDSPLoadControl via SendControlMsgFromDelegate()
+   * @param stats Set to the most recent summary, if there is one
+   * @return \c true if a new summary was available */
+  bool GetProcessTimingStats(IProcessTimingStats& stats) { return mProcessTimer.GetStats(stats); }
+
+  /** Clear the peak load, overrun count and histogram */
+  void ResetProcessTiming() { mProcessTimer.Reset(); }
+
+  /** @return The process timer, for access to the load histogram */
+  const IProcessTimer& GetProcessTimer() const { return mProcessTimer; }
+
 #pragma mark -
   /** @return The number of samples elapsed since start of project timeline. */
   int GetSamplePos() const { return mTimeInfo.mSamplePos; }
@@ -285,6 +304,8 @@ private:
   bool mBypassed = false;
   /** \c true if the plug-in is rendering off-line*/
   bool mRenderingOffline = false;
+  /** Measures the duration of each processed block */
+  IProcessTimer mProcessTimer;
   /** A list of IOConfig structures populated by ParseChannelIOStr in the IPlugProcessor constructor */
   WDL_PtrList<IOConfig> mIOConfigs;
   /* Manages pointers to the actual data for each channel */
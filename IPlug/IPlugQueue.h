@@ -18,6 +18,8 @@
 #include <atomic>
 #include <cstddef>
 
+#include "heapbuf.h"
+
 /** A lock-free SPSC queue used to transfer data between threads
  * based on MLQueue.h by Randy Jones
  * based on https://kjellkod.wordpress.com/2012/11/28/c-debt-paid-in-full-wait-free-lock-free-queue/ */
@@ -67,7 +69,7 @@ public:
   const T& Peek()
   {
     const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
-    return mData[currentReadIndex];
+    return mData.Get()[currentReadIndex];
   }
 
   bool WasEmpty() const
@@ -77,7 +79,7 @@ public:
 
   bool WasFull() const
   {
-    const auto nextWriteIndex = increment(mWriteIndex.load());
+    const auto nextWriteIndex = Increment(mWriteIndex.load());
     return (nextWriteIndex == mReadIndex.load());
   }
 
@@ -0,0 +1,330 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Debug guard that detects memory allocation and locking on the audio thread, enabled by defining RT_GUARD
+ *
+ * IPlugProcessor marks the calling thread as realtime while ProcessBuffers() runs (see IRTGuardScope). With RT_GUARD defined,
+ * IPlug_include_in_plug_src.h replaces operator new/delete and, on Linux with glibc, also intercepts malloc/calloc/realloc/free
+ * and pthread_mutex_lock (which WDL_Mutex::Enter and std::mutex use). Each offending call made on a realtime thread is recorded
+ * with its call stack, and code that is known to be unsafe can flag itself with RT_GUARD_FLAG("reason") which records the TRACELOC.
+ *
+ * The report is printed to stderr when a plug-in is destroyed and by the bench target (see IPlug/BENCH), or can be requested at any time
+ * with IRTGuard::Get().PrintReport(). The hooks slow down every allocation a little, so only use RT_GUARD for debug and CI builds.
+ *
+ * When a plug-in is built as a shared library on Linux, link it with -Wl,-Bsymbolic-functions, so that the plug-in's own calls to malloc
+ * and operator new bind to the hooks rather than to the host's.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+
+#include "IPlugPlatform.h"
+
+#if defined RT_GUARD && (defined OS_MAC || defined OS_LINUX || defined OS_IOS)
+  #include <execinfo.h>
+  #define RT_GUARD_HAS_BACKTRACE
+#elif defined RT_GUARD && defined OS_WIN
+  #include <windows.h>
+#endif
+
+/** The maximum number of distinct violations (by type, location and call stack) that are stored */
+#ifndef RT_GUARD_MAX_VIOLATIONS
+#define RT_GUARD_MAX_VIOLATIONS 64
+#endif
+
+/** The number of call stack frames stored with each violation */
+#ifndef RT_GUARD_MAX_FRAMES
+#define RT_GUARD_MAX_FRAMES 24
+#endif
+
+#if defined __GNUC__ && !defined OS_WIN
+  // initial-exec TLS is accessed without calling into the runtime, which could otherwise allocate from inside the malloc hooks
+  #define RT_GUARD_TLS static thread_local __attribute__((tls_model("initial-exec")))
+#else
+  #define RT_GUARD_TLS static thread_local
+#endif
+
+#ifdef RT_GUARD
+
+/** Records calls that are not realtime safe, made on threads marked as realtime with IRTGuardScope */
+class IRTGuard
+{
+public:
+  enum EViolation
+  {
+    kAllocation = 0,
+    kDeallocation,
+    kLock,
+    kFlagged,
+    kNumViolationTypes
+  };
+
+  /** The guard is constructed on first use, which may be inside a hook on a realtime thread. IPlugProcessor calls this on construction
+   * so that it normally happens earlier, on the main thread */
+  static IRTGuard& Get()
+  {
+    static IRTGuard sGuard;
+    return sGuard;
+  }
+
+  /** @return \c true if the calling thread is inside an IRTGuardScope, and not already inside a hook */
+  static inline bool IsRealtimeThread()
+  {
+    return Depth() > 0 && !InHook();
+  }
+
+  static inline void EnterRealtime() { Depth()++; }
+  static inline void ExitRealtime() { Depth()--; }
+
+  /** Called by the hooks and RT_GUARD_FLAG on a realtime thread
+   * @param type The kind of violation
+   * @param size The number of bytes for allocations, otherwise 0
+   * @param funcName The function that flagged itself, or nullptr for the hooks
+   * @param line The line that flagged itself
+   * @param label A description of the violation, must be a string literal */
+  void Record(EViolation type, size_t size, const char* funcName = nullptr, int line = 0, const char* label = nullptr)
+  {
+    InHook() = true; // anything below that allocates or locks (e.g. the first call to backtrace) passes straight through
+
+    mCounts[type].fetch_add(1, std::memory_order_relaxed);
+
+    void* stack[RT_GUARD_MAX_FRAMES];
+    const int nFrames = CaptureStack(stack);
+    const uint64_t hash = Hash(type, funcName, line, stack, nFrames);
+    const int nViolations = std::min<int>(mNViolations.load(std::memory_order_acquire), RT_GUARD_MAX_VIOLATIONS);
+
+    for (auto i = 0; i < nViolations; i++)
+    {
+      Violation& v = mViolations[i];
+
+      if(v.mReady.load(std::memory_order_acquire) && v.mHash == hash)
+      {
+        v.mCount.fetch_add(1, std::memory_order_relaxed);
+        v.mMaxSize = std::max(v.mMaxSize, size);
+        InHook() = false;
+        return;
+      }
+    }
+
+    const int idx = mNViolations.fetch_add(1, std::memory_order_acq_rel);
+
+    if(idx < RT_GUARD_MAX_VIOLATIONS)
+    {
+      Violation& v = mViolations[idx];
+      v.mType = type;
+      v.mHash = hash;
+      v.mFuncName = funcName;
+      v.mLine = line;
+      v.mLabel = label;
+      v.mMaxSize = size;
+      v.mNFrames = nFrames;
+      memcpy(v.mStack, stack, nFrames * sizeof(void*));
+      v.mCount.store(1, std::memory_order_relaxed);
+      v.mReady.store(true, std::memory_order_release);
+    }
+
+    InHook() = false;
+  }
+
+  /** @return The number of violations of a type since the last Clear() */
+  uint64_t GetCount(EViolation type) const { return mCounts[type].load(std::memory_order_relaxed); }
+
+  /** @return The number of violations of any type since the last Clear() */
+  uint64_t GetTotalCount() const
+  {
+    uint64_t total = 0;
+
+    for (auto i = 0; i < kNumViolationTypes; i++)
+      total += GetCount((EViolation) i);
+
+    return total;
+  }
+
+  /** Prints each distinct violation with its count and call stack. Not realtime safe
+   * @param onlyNew If \c true only the distinct violations recorded since the last such report are printed, and nothing if there are none.
+   * This is what ~IPlugProcessor uses, so that each violation is printed once however many plug-in instances there are */
+  void PrintReport(FILE* fp = stderr, bool onlyNew = false)
+  {
+    const int nViolations = std::min<int>(mNViolations.load(std::memory_order_acquire), RT_GUARD_MAX_VIOLATIONS);
+    const int firstIdx = onlyNew ? std::min(mNReported, nViolations) : 0;
+
+    if(onlyNew)
+      mNReported = nViolations;
+
+    if(!GetTotalCount() || (onlyNew && firstIdx == nViolations))
+      return;
+
+    fprintf(fp, "RT_GUARD: %llu allocations, %llu deallocations, %llu locks, %llu flagged calls on the audio thread\n",
+            (unsigned long long) GetCount(kAllocation), (unsigned long long) GetCount(kDeallocation),
+            (unsigned long long) GetCount(kLock), (unsigned long long) GetCount(kFlagged));
+
+    for (auto i = firstIdx; i < nViolations; i++)
+    {
+      const Violation& v = mViolations[i];
+
+      if(!v.mReady.load(std::memory_order_acquire))
+        continue;
+
+      fprintf(fp, "\n#%i %s x%u", i, GetTypeStr(v.mType), v.mCount.load(std::memory_order_relaxed));
+
+      if(v.mMaxSize)
+        fprintf(fp, ", up to %llu bytes", (unsigned long long) v.mMaxSize);
+
+      if(v.mFuncName)
+        fprintf(fp, ", %s:%i %s", v.mFuncName, v.mLine, v.mLabel ? v.mLabel : "");
+
+      fprintf(fp, "\n");
+      fflush(fp);
+
+#ifdef RT_GUARD_HAS_BACKTRACE
+      backtrace_symbols_fd(const_cast<void* const*>(v.mStack), v.mNFrames, fileno(fp));
+#else
+      for (auto f = 0; f < v.mNFrames; f++)
+        fprintf(fp, "  %p\n", v.mStack[f]);
+#endif
+    }
+
+    if(mNViolations.load(std::memory_order_relaxed) > RT_GUARD_MAX_VIOLATIONS)
+      fprintf(fp, "\nRT_GUARD: only the first %i distinct violations were stored\n", RT_GUARD_MAX_VIOLATIONS);
+
+    fflush(fp);
+  }
+
+  /** Forget all violations. Must not be called while a realtime thread is running */
+  void Clear()
+  {
+    for (auto& count : mCounts)
+      count.store(0, std::memory_order_relaxed);
+
+    for (auto& v : mViolations)
+      v.mReady.store(false, std::memory_order_relaxed);
+
+    mNViolations.store(0, std::memory_order_release);
+    mNReported = 0;
+  }
+
+  static const char* GetTypeStr(EViolation type)
+  {
+    switch (type)
+    {
+      case kAllocation: return "allocation";
+      case kDeallocation: return "deallocation";
+      case kLock: return "lock";
+      case kFlagged: return "flagged";
+      default: return "";
+    }
+  }
+
+private:
+  struct Violation
+  {
+    std::atomic<bool> mReady {false};
+    std::atomic<uint32_t> mCount {0};
+    EViolation mType = kAllocation;
+    uint64_t mHash = 0;
+    const char* mFuncName = nullptr;
+    int mLine = 0;
+    const char* mLabel = nullptr;
+    size_t mMaxSize = 0;
+    int mNFrames = 0;
+    void* mStack[RT_GUARD_MAX_FRAMES];
+  };
+
+  IRTGuard()
+  {
+    // the first call to backtrace() loads the unwinder, which allocates, so get that out of the way now. If this is the first use of the
+    // guard, from inside a hook, those allocations must pass straight through rather than call Get() while sGuard is being constructed
+    const bool wasInHook = InHook();
+    InHook() = true;
+    void* stack[RT_GUARD_MAX_FRAMES];
+    CaptureStack(stack);
+    InHook() = wasInHook;
+  }
+
+  IRTGuard(const IRTGuard&) = delete;
+  IRTGuard& operator=(const IRTGuard&) = delete;
+
+  static int& Depth()
+  {
+    RT_GUARD_TLS int tDepth = 0;
+    return tDepth;
+  }
+
+  static bool& InHook()
+  {
+    RT_GUARD_TLS bool tInHook = false;
+    return tInHook;
+  }
+
+  static int CaptureStack(void** stack)
+  {
+#if defined RT_GUARD_HAS_BACKTRACE
+    return backtrace(stack, RT_GUARD_MAX_FRAMES);
+#elif defined OS_WIN
+    return (int) CaptureStackBackTrace(0, RT_GUARD_MAX_FRAMES, stack, nullptr);
+#else
+    return 0;
+#endif
+  }
+
+  static uint64_t Hash(EViolation type, const char* funcName, int line, void* const* stack, int nFrames)
+  {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    auto Add = [&hash](uint64_t v) { hash = (hash ^ v) * 1099511628211ull; };
+
+    Add((uint64_t) type);
+    Add((uint64_t) (uintptr_t) funcName);
+    Add((uint64_t) line);
+
+    for (auto i = 0; i < nFrames; i++)
+      Add((uint64_t) (uintptr_t) stack[i]);
+
+    return hash;
+  }
+
+  std::atomic<uint64_t> mCounts[kNumViolationTypes] = {};
+  std::atomic<int> mNViolations {0};
+  Violation mViolations[RT_GUARD_MAX_VIOLATIONS];
+  int mNReported = 0; // distinct violations already printed by PrintReport(fp, true), main thread only
+};
+
+/** Marks the calling thread as realtime for the lifetime of the object. Scopes can be nested */
+class IRTGuardScope
+{
+public:
+  IRTGuardScope() { IRTGuard::EnterRealtime(); }
+  ~IRTGuardScope() { IRTGuard::ExitRealtime(); }
+
+  IRTGuardScope(const IRTGuardScope&) = delete;
+  IRTGuardScope& operator=(const IRTGuardScope&) = delete;
+};
+
+/** Records a violation with the TRACELOC of the caller if it is on a realtime thread. Use in code that is known not to be realtime safe */
+#define RT_GUARD_FLAG(label) if(IRTGuard::IsRealtimeThread()) IRTGuard::Get().Record(IRTGuard::kFlagged, 0, __FUNCTION__, __LINE__, label);
+
+#else
+
+class IRTGuardScope
+{
+public:
+  IRTGuardScope() {}
+};
+
+#define RT_GUARD_FLAG(label)
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief The allocation and lock hooks used by IRTGuard. Included by IPlug_include_in_plug_src.h when RT_GUARD is defined,
+ * so that they are defined exactly once per plug-in binary. Don't include it anywhere else.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if defined OS_LINUX && defined __GLIBC__
+  #include <dlfcn.h>
+  #include <pthread.h>
+#endif
+
+#include "IPlugRTGuard.h"
+
+#if defined OS_LINUX && defined __GLIBC__
+// on glibc the C allocator and pthread_mutex_lock can be interposed too, which catches WDL containers, realloc, aligned buffers and WDL_Mutex::Enter
+extern "C"
+{
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+  void __libc_free(void* ptr);
+
+  void* malloc(size_t size)
+  {
+    if(IRTGuard::IsRealtimeThread())
+      IRTGuard::Get().Record(IRTGuard::kAllocation, size);
+
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t n, size_t size)
+  {
+    if(IRTGuard::IsRealtimeThread())
+      IRTGuard::Get().Record(IRTGuard::kAllocation, n * size);
+
+    return __libc_calloc(n, size);
+  }
+
+  void* realloc(void* ptr, size_t size)
+  {
+    if(IRTGuard::IsRealtimeThread())
+      IRTGuard::Get().Record(IRTGuard::kAllocation, size);
+
+    return __libc_realloc(ptr, size);
+  }
+
+  int posix_memalign(void** pPtr, size_t alignment, size_t size)
+  {
+    if(IRTGuard::IsRealtimeThread())
+      IRTGuard::Get().Record(IRTGuard::kAllocation, size);
+
+    // __libc_memalign() rounds a bad alignment up rather than failing
+    if(!alignment || alignment % sizeof(void*) || (alignment & (alignment - 1)))
+      return EINVAL;
+
+    void* ptr = __libc_memalign(alignment, size);
+
+    if(!ptr)
+      return ENOMEM;
+
+    *pPtr = ptr;
+    return 0;
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size)
+  {
+    if(IRTGuard::IsRealtimeThread())
+      IRTGuard::Get().Record(IRTGuard::kAllocation, size);
+
+    return __libc_memalign(alignment, size);
+  }
+
+  void free(void* ptr)
+  {
+    if(ptr && IRTGuard::IsRealtimeThread())
+      IRTGuard::Get().Record(IRTGuard::kDeallocation, 0);
+
+    __libc_free(ptr);
+  }
+
+  int pthread_mutex_lock(pthread_mutex_t* pMutex)
+  {
+    if(IRTGuard::IsRealtimeThread())
+      IRTGuard::Get().Record(IRTGuard::kLock, 0);
+
+    typedef int (*LockFunc)(pthread_mutex_t*);
+    static LockFunc sNextLock = (LockFunc) dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    return sNextLock(pMutex);
+  }
+}
+
+#define RT_GUARD_HOOKS_MALLOC
+#endif
+
+void* operator new(std::size_t size)
+{
+#ifndef RT_GUARD_HOOKS_MALLOC
+  if(IRTGuard::IsRealtimeThread())
+    IRTGuard::Get().Record(IRTGuard::kAllocation, size);
+#endif
+
+  if(void* ptr = std::malloc(size ? size : 1))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+#ifndef RT_GUARD_HOOKS_MALLOC
+  if(IRTGuard::IsRealtimeThread())
+    IRTGuard::Get().Record(IRTGuard::kAllocation, size);
+#endif
+
+  return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept
+{
+#ifndef RT_GUARD_HOOKS_MALLOC
+  if(ptr && IRTGuard::IsRealtimeThread())
+    IRTGuard::Get().Record(IRTGuard::kDeallocation, 0);
+#endif
+
+  std::free(ptr);
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { operator delete(ptr); }
@@ -0,0 +1,93 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugSemaphore
+ */
+
+#include <cerrno>
+#include <climits>
+
+#include "IPlugPlatform.h"
+
+#ifdef OS_WIN
+  #include <windows.h>
+#elif defined OS_MAC || defined OS_IOS
+  #include <dispatch/dispatch.h>
+#else
+  #include <semaphore.h>
+#endif
+
+/** A counting semaphore that can be signalled from the audio thread, to wake a worker thread such as those of IPresetBank and SpectrumAnalyser.
+ * Posting does not take a lock: it is an atomic increment, plus a system call only if the worker is waiting */
+class IPlugSemaphore
+{
+public:
+  IPlugSemaphore()
+  {
+#if defined OS_WIN
+    mSemaphore = CreateSemaphore(nullptr, 0, LONG_MAX, nullptr);
+#elif defined OS_MAC || defined OS_IOS
+    mSemaphore = dispatch_semaphore_create(0);
+#else
+    sem_init(&mSemaphore, 0, 0);
+#endif
+  }
+
+  ~IPlugSemaphore()
+  {
+#if defined OS_WIN
+    CloseHandle(mSemaphore);
+#elif defined OS_MAC || defined OS_IOS
+  #if !__has_feature(objc_arc)
+    dispatch_release(mSemaphore);
+  #endif
+#else
+    sem_destroy(&mSemaphore);
+#endif
+  }
+
+  IPlugSemaphore(const IPlugSemaphore&) = delete;
+  IPlugSemaphore& operator=(const IPlugSemaphore&) = delete;
+
+  void Signal()
+  {
+#if defined OS_WIN
+    ReleaseSemaphore(mSemaphore, 1, nullptr);
+#elif defined OS_MAC || defined OS_IOS
+    dispatch_semaphore_signal(mSemaphore);
+#else
+    sem_post(&mSemaphore);
+#endif
+  }
+
+  void Wait()
+  {
+#if defined OS_WIN
+    WaitForSingleObject(mSemaphore, INFINITE);
+#elif defined OS_MAC || defined OS_IOS
+    dispatch_semaphore_wait(mSemaphore, DISPATCH_TIME_FOREVER);
+#else
+    while(sem_wait(&mSemaphore) && errno == EINTR) {}
+#endif
+  }
+
+private:
+#if defined OS_WIN
+  HANDLE mSemaphore;
+#elif defined OS_MAC || defined OS_IOS
+  dispatch_semaphore_t mSemaphore;
+#else
+  sem_t mSemaphore;
+#endif
+};
@@ -0,0 +1,174 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ISharedMemory
+ */
+
+#include <cstddef>
+#include <cstring>
+
+#include "wdlstring.h"
+
+#include "IPlugPlatform.h"
+
+#ifdef OS_WIN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+/** A named block of memory shared between processes, POSIX shared memory or a Windows file mapping. One process Create()s it,
+ * the others Open() it by name. The memory is page aligned and zeroed when created. Names start with a '/' and, for macOS,
+ * are at most 30 characters long */
+class ISharedMemory
+{
+public:
+  ISharedMemory() = default;
+  ISharedMemory(const ISharedMemory&) = delete;
+  ISharedMemory& operator=(const ISharedMemory&) = delete;
+
+  ~ISharedMemory() { Close(); }
+
+  /** Creates a new block, replacing any left over from a process that crashed. It is removed when the creator closes it */
+  bool Create(const char* name, size_t size)
+  {
+    return Map(name, size, true);
+  }
+
+  /** Maps a block another process created */
+  bool Open(const char* name, size_t size)
+  {
+    return Map(name, size, false);
+  }
+
+  void Close()
+  {
+    if (!mMemory)
+      return;
+
+#ifdef OS_WIN
+    UnmapViewOfFile(mMemory);
+    CloseHandle(mHandle);
+    mHandle = nullptr;
+#else
+    munmap(mMemory, mSize);
+    close(mFD);
+    mFD = -1;
+
+    if (mCreated)
+      shm_unlink(mName.Get());
+#endif
+
+    mMemory = nullptr;
+    mSize = 0;
+    mCreated = false;
+  }
+
+  void* Get() const { return mMemory; }
+  size_t GetSize() const { return mSize; }
+  const char* GetName() const { return mName.Get(); }
+
+private:
+  bool Map(const char* name, size_t size, bool create)
+  {
+    Close();
+
+    if (!name || name[0] != '/' || !size)
+      return false;
+
+    mName.Set(name);
+
+#ifdef OS_WIN
+    WDL_String mappingName("Local\\");
+    mappingName.Append(name + 1);
+    const DWORD sizeHi = (DWORD) ((unsigned long long) size >> 32), sizeLo = (DWORD) (size & 0xFFFFFFFF);
+
+    if (create)
+      mHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, sizeHi, sizeLo, mappingName.Get());
+    else
+      mHandle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName.Get());
+
+    if (!mHandle)
+      return false;
+
+    mMemory = MapViewOfFile(mHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+
+    if (!mMemory)
+    {
+      CloseHandle(mHandle);
+      mHandle = nullptr;
+      return false;
+    }
+#else
+    if (create)
+    {
+      shm_unlink(name);
+      mFD = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+      if (mFD >= 0 && ftruncate(mFD, (off_t) size))
+      {
+        close(mFD);
+        shm_unlink(name);
+        mFD = -1;
+      }
+    }
+    else
+    {
+      mFD = shm_open(name, O_RDWR, 0600);
+      struct stat st;
+
+      if (mFD >= 0 && (fstat(mFD, &st) || (size_t) st.st_size < size))
+      {
+        close(mFD);
+        mFD = -1;
+      }
+    }
+
+    if (mFD < 0)
+      return false;
+
+    void* pMemory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFD, 0);
+
+    if (pMemory == MAP_FAILED)
+    {
+      close(mFD);
+      mFD = -1;
+
+      if (create)
+        shm_unlink(name);
+
+      return false;
+    }
+
+    mMemory = pMemory;
+#endif
+
+    mSize = size;
+    mCreated = create;
+    return true;
+  }
+
+  void* mMemory = nullptr;
+  size_t mSize = 0;
+  bool mCreated = false;
+  WDL_String mName;
+#ifdef OS_WIN
+  HANDLE mHandle = nullptr;
+#else
+  int mFD = -1;
+#endif
+};
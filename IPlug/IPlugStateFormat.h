@@ -0,0 +1,207 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief A tagged, versioned binary state format, used by IPluginBase::SerializeParams() when a plug-in opts in with IPluginBase::SetStateFormat()
+ *
+ * A tagged chunk starts with an 8 byte magic, then a uint16 version, uint16 EStateFormat flags, int32 stored payload size and
+ * int32 uncompressed payload size, followed by the payload. The last two bytes of the magic make it a NaN when read as a double,
+ * so a tagged chunk can never be mistaken for the legacy format, which starts with the value of the first parameter.
+ *
+ * The payload is a list of sections, each a uint32 tag, an int32 length and the section's data. Readers skip sections they don't know,
+ * so sections can be added in later versions. The parameter section holds an int32 number of runs, each an int32 first stable ID,
+ * an int32 count and count doubles, the values of the parameters with consecutive IDs starting at the first ID.
+ *
+ * Compression uses the bundled zlib (WDL/zlib) and is only available when STATE_COMPRESSION is defined and the zlib sources are
+ * compiled into the plug-in. Without it the kStateFormatCompressed flag is ignored when writing, and compressed chunks fail to load.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "IPlugStructs.h"
+
+#ifdef STATE_COMPRESSION
+#include "zlib/zlib.h"
+#endif
+
+/** Flags for IPluginBase::SetStateFormat() */
+enum EStateFormat
+{
+  kStateFormatLegacy = 0, // one double per parameter, in index order
+  kStateFormatTagged = 1 << 0, // the versioned format described above, with parameters keyed by IParam::GetStableID()
+  kStateFormatCompressed = 1 << 1, // tagged, with the payload deflated. Needs STATE_COMPRESSION
+  kStateFormatDelta = 1 << 2 // tagged, only storing parameters that differ from their default value
+};
+
+#define STATE_FORMAT_VERSION 1
+#define STATE_FORMAT_TAG(a, b, c, d) ((uint32_t) (a) << 24 | (uint32_t) (b) << 16 | (uint32_t) (c) << 8 | (uint32_t) (d))
+
+/** The values of all parameters, prepared from a state chunk without touching the plug-in, see IPluginBase::PrepareParamSnapshot() */
+struct IParamSnapshot
+{
+  WDL_TypedBuf<double> mValues;
+};
+
+/** Reads and writes the container of the tagged state format */
+class IStateFormat
+{
+public:
+  static constexpr uint32_t kParamsSection = STATE_FORMAT_TAG('P','R','M','S');
+
+  /** @return \c true if a tagged state chunk starts at pos */
+  static bool HasHeader(const IByteChunk& chunk, int pos)
+  {
+    uint8_t magic[kMagicSize];
+    return chunk.GetBytes(magic, kMagicSize, pos) > 0 && !memcmp(magic, GetMagic(), kMagicSize);
+  }
+
+  /** Appends the header and the payload to chunk, compressing the payload if requested and available
+   * @param flags EStateFormat flags. kStateFormatCompressed is cleared if the payload is not compressed
+   * @return \c true on success */
+  static bool Write(IByteChunk& chunk, const IByteChunk& payload, int flags)
+  {
+    const int rawSize = payload.Size();
+    const uint8_t* pStored = payload.GetData();
+    int storedSize = rawSize;
+
+#ifdef STATE_COMPRESSION
+    WDL_TypedBuf<uint8_t> compressed;
+
+    if(flags & kStateFormatCompressed)
+    {
+      uLongf compressedSize = compressBound((uLong) rawSize);
+      compressed.Resize((int) compressedSize);
+
+      // don't keep the result if it doesn't make the chunk smaller, e.g. for a few, mostly random values
+      if(compress2(compressed.Get(), &compressedSize, payload.GetData(), (uLong) rawSize, Z_BEST_SPEED) == Z_OK && (int) compressedSize < rawSize)
+      {
+        pStored = compressed.Get();
+        storedSize = (int) compressedSize;
+      }
+      else
+        flags &= ~kStateFormatCompressed;
+    }
+#else
+    flags &= ~kStateFormatCompressed;
+#endif
+
+    const uint16_t version = STATE_FORMAT_VERSION;
+    const uint16_t storedFlags = (uint16_t) (flags | kStateFormatTagged);
+
+    chunk.Reserve(kMagicSize + 2 * (int) sizeof(uint16_t) + 2 * (int) sizeof(int) + storedSize);
+    chunk.PutBytes(GetMagic(), kMagicSize);
+    chunk.Put(&version);
+    chunk.Put(&storedFlags);
+    chunk.Put(&storedSize);
+    chunk.Put(&rawSize);
+    return chunk.PutBytes(pStored, storedSize) > 0;
+  }
+
+  /** Reads the header at startPos and extracts the uncompressed payload
+   * @param flags Set to the EStateFormat flags the chunk was written with
+   * @return The position after the tagged chunk, or -1 if it is not a tagged chunk, is from a newer format version or can't be decompressed */
+  static int Read(const IByteChunk& chunk, int startPos, IByteChunk& payload, int& flags)
+  {
+    if(!HasHeader(chunk, startPos))
+      return -1;
+
+    uint16_t version = 0, storedFlags = 0;
+    int storedSize = 0, rawSize = 0;
+    int pos = startPos + kMagicSize;
+    pos = chunk.Get(&version, pos);
+    pos = chunk.Get(&storedFlags, pos);
+    pos = chunk.Get(&storedSize, pos);
+    pos = chunk.Get(&rawSize, pos);
+
+    if(pos < 0 || version > STATE_FORMAT_VERSION || storedSize < 0 || rawSize < 0 || pos + storedSize > chunk.Size())
+      return -1;
+
+    flags = storedFlags;
+    payload.Clear();
+    payload.Resize(rawSize);
+
+    if(storedFlags & kStateFormatCompressed)
+    {
+#ifdef STATE_COMPRESSION
+      uLongf size = (uLongf) rawSize;
+
+      if(uncompress(payload.GetData(), &size, chunk.GetData() + pos, (uLong) storedSize) != Z_OK || (int) size != rawSize)
+        return -1;
+#else
+      return -1;
+#endif
+    }
+    else if(storedSize != rawSize)
+      return -1;
+    else
+      memcpy(payload.GetData(), chunk.GetData() + pos, rawSize);
+
+    return pos + storedSize;
+  }
+
+  /** Starts a section in a payload
+   * @return The position of the section's length, to pass to EndSection() */
+  static int BeginSection(IByteChunk& payload, uint32_t tag)
+  {
+    const int length = 0;
+    payload.Put(&tag);
+    const int lengthPos = payload.Size();
+    payload.Put(&length);
+    return lengthPos;
+  }
+
+  /** Fills in the length of a section started with BeginSection(), after its data has been appended */
+  static void EndSection(IByteChunk& payload, int lengthPos)
+  {
+    const int length = payload.Size() - lengthPos - (int) sizeof(int);
+    uint8_t* pData = payload.GetData();
+
+    if (pData && length >= 0)
+      memcpy(pData + lengthPos, &length, sizeof(int));
+  }
+
+  /** Finds a section in a payload
+   * @param length Set to the length of the section's data
+   * @return The position of the section's data, or -1 if the section is not present */
+  static int FindSection(const IByteChunk& payload, uint32_t tag, int& length)
+  {
+    int pos = 0;
+
+    while(pos >= 0 && pos < payload.Size())
+    {
+      uint32_t sectionTag = 0;
+      pos = payload.Get(&sectionTag, pos);
+      pos = payload.Get(&length, pos);
+
+      if(pos < 0 || length < 0 || pos + length > payload.Size())
+        return -1;
+
+      if(sectionTag == tag)
+        return pos;
+
+      pos += length;
+    }
+
+    return -1;
+  }
+
+private:
+  static constexpr int kMagicSize = 8;
+
+  static const uint8_t* GetMagic()
+  {
+    static const uint8_t sMagic[kMagicSize] = { 'I', 'P', 'S', 'T', 'A', 'T', 0xF8, 0xFF };
+    return sMagic;
+  }
+};
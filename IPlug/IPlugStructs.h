@@ -194,10 +194,24 @@ public:
     return n;
   }
   
+  /** Makes sure that the next size bytes can be added to the chunk without reallocating
+   * @param size The number of bytes that are about to be added */
+  inline void Reserve(int size)
+  {
+    const int n = mBytes.GetSize();
+    mBytes.Resize(n + size, false);
+    mBytes.Resize(n, false);
+  }
+
   inline uint8_t* GetData()
   {
     return mBytes.Get();
   }
+
+  inline const uint8_t* GetData() const
+  {
+    return mBytes.Get();
+  }
   
   inline bool IsEqual(IByteChunk& otherChunk) const
   {
@@ -28,7 +28,7 @@ struct Timer;
 
 typedef std::function<void(Timer& t)> ITimerFunction;
 
-#if defined OS_WEB
+#if defined OS_WEB || defined BENCH_API
 struct Timer
 {
   static Timer* Create(ITimerFunction func, uint32_t intervalMs)
@@ -0,0 +1,494 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Realtime safe binary tracing backend, used by TRACE, TRACE_VALUES and TRACE_SCOPE when TRACER_BUILD is defined
+ *
+ * Each thread writes fixed size records into its own lock-free ring. A background thread drains the rings to TRACE_RING_FILE in the
+ * user's home directory (C:\ on windows, /tmp if HOME is not set). Use Scripts/trace_to_json.py to convert the file to Chrome trace
+ * event JSON (chrome://tracing).
+ *
+ * The function name and label are copied into each record, truncated to TRACE_RING_MAX_STRING characters, so the trace can be drained
+ * after the code that made it has been unloaded. Rings are allocated by the drain thread, which keeps TRACE_RING_SPARE_RINGS unused ones
+ * ready, and the first trace call on a thread claims one of those, so tracing doesn't allocate on the calling thread. A ring is returned
+ * to the pool when its thread exits. If a ring is full, or no ring is free, records are dropped and the count is written to the file.
+ *
+ * The writer opens the file and starts the drain thread when it is constructed, which IPlugProcessor does on the main thread. Code that
+ * traces from a realtime thread without an IPlugProcessor should call TraceRingWriter::Get() on another thread first.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#ifdef OS_WIN
+  #include <windows.h>
+#else
+  #include <pthread.h>
+#endif
+
+/** The maximum number of numeric values stored with a record */
+#ifndef TRACE_RING_MAX_ARGS
+#define TRACE_RING_MAX_ARGS 4
+#endif
+
+/** The number of records in each thread's ring, must be a power of 2 */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 8192
+#endif
+
+/** The maximum number of threads that can trace at the same time. Further threads are ignored until a tracing thread exits */
+#ifndef TRACE_RING_MAX_THREADS
+#define TRACE_RING_MAX_THREADS 64
+#endif
+
+/** The number of unused rings the drain thread keeps allocated, for threads that start tracing */
+#ifndef TRACE_RING_SPARE_RINGS
+#define TRACE_RING_SPARE_RINGS 2
+#endif
+
+/** The size of the function name and label copied into each record, including the terminating zero */
+#ifndef TRACE_RING_MAX_STRING
+#define TRACE_RING_MAX_STRING 48
+#endif
+
+#ifndef TRACE_RING_DRAIN_INTERVAL_MS
+#define TRACE_RING_DRAIN_INTERVAL_MS 10
+#endif
+
+#ifndef TRACE_RING_FILE
+#define TRACE_RING_FILE "IPlugTrace.bin"
+#endif
+
+#define TRACE_RING_FILE_VERSION 1
+
+#if defined __GNUC__ && !defined OS_WIN
+  // initial-exec TLS is accessed without calling into the runtime, which could allocate or lock on the first trace call from a thread
+  #define TRACE_RING_TLS static thread_local __attribute__((tls_model("initial-exec")))
+#else
+  #define TRACE_RING_TLS static thread_local
+#endif
+
+/** A single trace record, as written by the tracing thread */
+struct TraceRecord
+{
+  enum EPhase : char
+  {
+    kInstant = 'i',
+    kBegin = 'B',
+    kEnd = 'E'
+  };
+
+  uint64_t mTime; // nanoseconds since the trace started
+  char mFuncName[TRACE_RING_MAX_STRING];
+  char mLabel[TRACE_RING_MAX_STRING];
+  double mArgs[TRACE_RING_MAX_ARGS];
+  int32_t mLine;
+  uint8_t mNArgs;
+  EPhase mPhase;
+};
+
+/** A single producer, single consumer ring of TraceRecords, owned by one tracing thread at a time */
+class TraceRing
+{
+public:
+  enum EState
+  {
+    kFree = 0, // ready to be claimed by a thread
+    kClaimed, // owned by a thread that is tracing
+    kReleased // its thread has exited, waiting to be drained and freed by the drain thread
+  };
+
+  TraceRing()
+  {
+    static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of 2");
+  }
+
+  /** Called on the tracing thread. Returns a record to fill in, or nullptr if the ring is full */
+  TraceRecord* BeginWrite()
+  {
+    const uint32_t writeIdx = mWriteIdx.load(std::memory_order_relaxed);
+
+    if(writeIdx - mReadIdx.load(std::memory_order_acquire) >= TRACE_RING_SIZE)
+    {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    return &mRecords[writeIdx & (TRACE_RING_SIZE - 1)];
+  }
+
+  void EndWrite()
+  {
+    mWriteIdx.store(mWriteIdx.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /** Called on the drain thread */
+  template <class F>
+  void Drain(F func)
+  {
+    const uint32_t writeIdx = mWriteIdx.load(std::memory_order_acquire);
+    uint32_t readIdx = mReadIdx.load(std::memory_order_relaxed);
+
+    for (; readIdx != writeIdx; readIdx++)
+      func(mRecords[readIdx & (TRACE_RING_SIZE - 1)]);
+
+    mReadIdx.store(readIdx, std::memory_order_release);
+  }
+
+  uint32_t TakeDropped() { return mDropped.exchange(0, std::memory_order_relaxed); }
+
+  /** Called on the drain thread, once a released ring has been drained */
+  void Reset()
+  {
+    mWriteIdx.store(0, std::memory_order_relaxed);
+    mReadIdx.store(0, std::memory_order_relaxed);
+    mDropped.store(0, std::memory_order_relaxed);
+  }
+
+  std::atomic<int> mState {kFree};
+  std::atomic<uint32_t> mThreadIdx {0}; // set by the thread that claims the ring, each thread gets a new index
+
+private:
+  TraceRecord mRecords[TRACE_RING_SIZE];
+  std::atomic<uint32_t> mWriteIdx {0};
+  std::atomic<uint32_t> mReadIdx {0};
+  std::atomic<uint32_t> mDropped {0};
+};
+
+/** Owns the per thread rings and the thread that drains them to disk.
+ *
+ * File format (native byte order): the magic "IPTR", uint32 version, uint32 TRACE_RING_MAX_ARGS, followed by chunks starting with a uint8 type:
+ * - kChunkString: uint32 id, uint32 length, the characters. Id 0 is the empty string and is never written
+ * - kChunkEvent: uint64 time (ns), uint32 thread, uint32 function name id, uint32 label id, int32 line, uint8 phase, uint8 nArgs, nArgs doubles
+ * - kChunkDropped: uint32 thread, uint32 number of records that were dropped. The thread is kNoThread for records of threads that got no ring */
+class TraceRingWriter
+{
+public:
+  enum EChunk : uint8_t
+  {
+    kChunkString = 1,
+    kChunkEvent,
+    kChunkDropped
+  };
+
+  static constexpr uint32_t kNoThread = 0xFFFFFFFF;
+
+  static TraceRingWriter& Get()
+  {
+    static TraceRingWriter sWriter;
+    return sWriter;
+  }
+
+  ~TraceRingWriter()
+  {
+    mRunning = false;
+
+    if(mDrainThread.joinable())
+      mDrainThread.join();
+
+    Drain();
+
+    // rings are not deleted, as threads that are still running may hold them
+#ifdef OS_WIN
+    FlsFree(mThreadExitKey);
+#else
+    pthread_key_delete(mThreadExitKey);
+#endif
+
+    if(mFP)
+      fclose(mFP);
+  }
+
+  /** @return The calling thread's ring, claiming a free one on first use, or nullptr if none is free */
+  TraceRing* GetThreadRing()
+  {
+    TRACE_RING_TLS TraceRing* tpRing = nullptr;
+
+    if(!tpRing && mRunning)
+    {
+      const uint32_t nRings = mNRings.load(std::memory_order_acquire);
+
+      for (uint32_t r = 0; r < nRings && !tpRing; r++)
+      {
+        TraceRing* pRing = mRings[r].load(std::memory_order_relaxed);
+        int state = TraceRing::kFree;
+
+        if(pRing->mState.load(std::memory_order_relaxed) == TraceRing::kFree
+           && pRing->mState.compare_exchange_strong(state, TraceRing::kClaimed, std::memory_order_acq_rel))
+        {
+          pRing->mThreadIdx.store(mNextThreadIdx.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+          tpRing = pRing;
+          // the ring is released when the thread exits
+#ifdef OS_WIN
+          FlsSetValue(mThreadExitKey, pRing);
+#else
+          pthread_setspecific(mThreadExitKey, pRing);
+#endif
+        }
+      }
+    }
+
+    return tpRing;
+  }
+
+  void Record(TraceRecord::EPhase phase, const char* funcName, int line, const char* label, int nArgs, const double* args)
+  {
+    TraceRing* pRing = GetThreadRing();
+
+    if(!pRing)
+    {
+      mDroppedWithoutRing.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    TraceRecord* pRecord = pRing->BeginWrite();
+
+    if(!pRecord)
+      return;
+
+    pRecord->mTime = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStartTime).count();
+    CopyString(pRecord->mFuncName, funcName);
+    CopyString(pRecord->mLabel, label);
+    pRecord->mLine = line;
+    pRecord->mPhase = phase;
+    pRecord->mNArgs = (uint8_t) nArgs;
+
+    for (auto i = 0; i < nArgs; i++)
+      pRecord->mArgs[i] = args[i];
+
+    pRing->EndWrite();
+  }
+
+private:
+  TraceRingWriter()
+  : mStartTime(std::chrono::steady_clock::now())
+  {
+    for (auto& ring : mRings)
+      ring.store(nullptr);
+
+#ifdef OS_WIN
+    mThreadExitKey = FlsAlloc(ReleaseRing);
+#else
+    pthread_key_create(&mThreadExitKey, ReleaseRing);
+#endif
+
+    char path[1024];
+#ifdef OS_WIN
+    snprintf(path, sizeof(path), "%s/%s", "C:\\", TRACE_RING_FILE);
+#else
+    const char* home = getenv("HOME");
+    snprintf(path, sizeof(path), "%s/%s", home ? home : "/tmp", TRACE_RING_FILE);
+#endif
+    mFP = fopen(path, "wb");
+
+    if(!mFP)
+    {
+      mRunning = false;
+      return;
+    }
+
+    const uint32_t header[] = { TRACE_RING_FILE_VERSION, TRACE_RING_MAX_ARGS };
+    fwrite("IPTR", 1, 4, mFP);
+    fwrite(header, sizeof(header), 1, mFP);
+
+    AllocateSpareRings();
+
+    mDrainThread = std::thread([this]() {
+      while(mRunning)
+      {
+        Drain();
+        AllocateSpareRings();
+        std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_RING_DRAIN_INTERVAL_MS));
+      }
+    });
+  }
+
+  TraceRingWriter(const TraceRingWriter&) = delete;
+  TraceRingWriter& operator=(const TraceRingWriter&) = delete;
+
+#ifdef OS_WIN
+  static void WINAPI ReleaseRing(void* pRing)
+#else
+  static void ReleaseRing(void* pRing)
+#endif
+  {
+    if(pRing)
+      static_cast<TraceRing*>(pRing)->mState.store(TraceRing::kReleased, std::memory_order_release);
+  }
+
+  static void CopyString(char* pDest, const char* str)
+  {
+    int i = 0;
+
+    if(str)
+    {
+      for (; i < TRACE_RING_MAX_STRING - 1 && str[i]; i++)
+        pDest[i] = str[i];
+    }
+
+    pDest[i] = 0;
+  }
+
+  /** Makes sure TRACE_RING_SPARE_RINGS rings are free, unless TRACE_RING_MAX_THREADS rings are allocated already */
+  void AllocateSpareRings()
+  {
+    uint32_t nRings = mNRings.load(std::memory_order_relaxed);
+    int nFree = 0;
+
+    for (uint32_t r = 0; r < nRings; r++)
+    {
+      if(mRings[r].load(std::memory_order_relaxed)->mState.load(std::memory_order_relaxed) == TraceRing::kFree)
+        nFree++;
+    }
+
+    for (; nFree < TRACE_RING_SPARE_RINGS && nRings < TRACE_RING_MAX_THREADS; nFree++, nRings++)
+    {
+      mRings[nRings].store(new TraceRing, std::memory_order_relaxed);
+      mNRings.store(nRings + 1, std::memory_order_release);
+    }
+  }
+
+  uint32_t GetStringID(const char* str)
+  {
+    if(!*str)
+      return 0;
+
+    auto it = mStringIDs.find(str);
+
+    if(it != mStringIDs.end())
+      return it->second;
+
+    const uint32_t id = (uint32_t) mStringIDs.size() + 1;
+    const uint32_t len = (uint32_t) strlen(str);
+    const uint8_t type = kChunkString;
+    fwrite(&type, 1, 1, mFP);
+    fwrite(&id, sizeof(id), 1, mFP);
+    fwrite(&len, sizeof(len), 1, mFP);
+    fwrite(str, 1, len, mFP);
+    mStringIDs[str] = id;
+    return id;
+  }
+
+  void WriteDropped(uint32_t threadIdx, uint32_t dropped)
+  {
+    const uint8_t type = kChunkDropped;
+    fwrite(&type, 1, 1, mFP);
+    fwrite(&threadIdx, sizeof(uint32_t), 1, mFP);
+    fwrite(&dropped, sizeof(uint32_t), 1, mFP);
+  }
+
+  void Drain()
+  {
+    if(!mFP)
+      return;
+
+    const uint32_t nRings = mNRings.load(std::memory_order_acquire);
+
+    for (uint32_t r = 0; r < nRings; r++)
+    {
+      TraceRing* pRing = mRings[r].load(std::memory_order_relaxed);
+      // checked before draining, so that all the records of a thread that has exited are drained before its ring is freed
+      const bool released = pRing->mState.load(std::memory_order_acquire) == TraceRing::kReleased;
+      const uint32_t threadIdx = pRing->mThreadIdx.load(std::memory_order_relaxed);
+
+      pRing->Drain([&](const TraceRecord& record) {
+        const uint32_t funcID = GetStringID(record.mFuncName);
+        const uint32_t labelID = GetStringID(record.mLabel);
+        const uint8_t type = kChunkEvent;
+        const uint8_t phase = (uint8_t) record.mPhase;
+        fwrite(&type, 1, 1, mFP);
+        fwrite(&record.mTime, sizeof(uint64_t), 1, mFP);
+        fwrite(&threadIdx, sizeof(uint32_t), 1, mFP);
+        fwrite(&funcID, sizeof(uint32_t), 1, mFP);
+        fwrite(&labelID, sizeof(uint32_t), 1, mFP);
+        fwrite(&record.mLine, sizeof(int32_t), 1, mFP);
+        fwrite(&phase, 1, 1, mFP);
+        fwrite(&record.mNArgs, 1, 1, mFP);
+        fwrite(record.mArgs, sizeof(double), record.mNArgs, mFP);
+      });
+
+      const uint32_t dropped = pRing->TakeDropped();
+
+      if(dropped)
+        WriteDropped(threadIdx, dropped);
+
+      if(released)
+      {
+        pRing->Reset();
+        pRing->mState.store(TraceRing::kFree, std::memory_order_release);
+      }
+    }
+
+    const uint32_t droppedWithoutRing = mDroppedWithoutRing.exchange(0, std::memory_order_relaxed);
+
+    if(droppedWithoutRing)
+      WriteDropped(kNoThread, droppedWithoutRing);
+
+    fflush(mFP);
+  }
+
+  const std::chrono::steady_clock::time_point mStartTime;
+  std::atomic<TraceRing*> mRings[TRACE_RING_MAX_THREADS];
+  std::atomic<uint32_t> mNRings {0}; // allocated by the drain thread, never deleted
+  std::atomic<uint32_t> mNextThreadIdx {0};
+  std::atomic<uint32_t> mDroppedWithoutRing {0};
+  std::atomic<bool> mRunning {true};
+  std::thread mDrainThread;
+  std::unordered_map<std::string, uint32_t> mStringIDs; // only touched by the drain thread, or after it has been joined
+  FILE* mFP = nullptr;
+#ifdef OS_WIN
+  DWORD mThreadExitKey;
+#else
+  pthread_key_t mThreadExitKey;
+#endif
+};
+
+/** Record a trace event with up to TRACE_RING_MAX_ARGS numeric values. Typically called via the TRACE or TRACE_VALUES macros */
+template <typename... Args>
+static inline void TraceEvent(const char* funcName, int line, const char* label, Args... args)
+{
+  static_assert(sizeof...(Args) <= TRACE_RING_MAX_ARGS, "Too many values for a trace record, increase TRACE_RING_MAX_ARGS");
+  const double vals[] = { 0., (double) args... };
+  TraceRingWriter::Get().Record(TraceRecord::kInstant, funcName, line, label, (int) sizeof...(Args), vals + 1);
+}
+
+/** Records a begin event when constructed and an end event when destroyed, which show up as a duration in the trace viewer. Typically used via TRACE_SCOPE */
+class TraceScope
+{
+public:
+  TraceScope(const char* funcName, int line, const char* label)
+  : mFuncName(funcName)
+  , mLine(line)
+  , mLabel(label)
+  {
+    TraceRingWriter::Get().Record(TraceRecord::kBegin, mFuncName, mLine, mLabel, 0, nullptr);
+  }
+
+  ~TraceScope()
+  {
+    TraceRingWriter::Get().Record(TraceRecord::kEnd, mFuncName, mLine, mLabel, 0, nullptr);
+  }
+
+private:
+  const char* mFuncName;
+  int mLine;
+  const char* mLabel;
+};
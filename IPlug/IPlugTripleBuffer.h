@@ -0,0 +1,63 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ITripleBuffer
+ */
+
+#include <atomic>
+
+/** A lock-free single producer, single consumer transfer of the latest value of T, e.g. a frame of meter or scope data from the audio
+ * thread to the UI. The producer fills GetWriteBuffer() in place and calls Publish(). The consumer calls Consume() and reads
+ * GetReadBuffer(). Values published in between are overwritten, never queued, so the consumer only ever sees the latest one and the
+ * producer never waits or fails. Neither side copies T */
+template <typename T>
+class ITripleBuffer final
+{
+public:
+  ITripleBuffer() = default;
+  ITripleBuffer(const ITripleBuffer&) = delete;
+  ITripleBuffer& operator=(const ITripleBuffer&) = delete;
+
+  /** Producer: the buffer to fill. Its contents are whatever was in it the last time it was the read or write buffer */
+  T& GetWriteBuffer() { return mBuffers[mWriteIdx]; }
+
+  /** Producer: makes the write buffer the latest value, and takes the spare buffer as the next write buffer */
+  void Publish()
+  {
+    mWriteIdx = mSpare.exchange(mWriteIdx | kNewFlag, std::memory_order_acq_rel) & kIdxMask;
+  }
+
+  /** Consumer: takes the latest value, if one was published since the last call
+   * @return \c true if GetReadBuffer() holds a new value */
+  bool Consume()
+  {
+    if (!(mSpare.load(std::memory_order_relaxed) & kNewFlag))
+      return false;
+
+    mReadIdx = mSpare.exchange(mReadIdx, std::memory_order_acq_rel) & kIdxMask;
+    return true;
+  }
+
+  /** Consumer: the latest value taken with Consume() */
+  const T& GetReadBuffer() const { return mBuffers[mReadIdx]; }
+
+private:
+  static constexpr int kIdxMask = 3;
+  static constexpr int kNewFlag = 4;
+
+  T mBuffers[3];
+  int mWriteIdx = 0;
+  int mReadIdx = 1;
+  std::atomic<int> mSpare {2}; // the index of the buffer that is neither being written nor read, plus kNewFlag if it holds a new value
+};
@@ -58,6 +58,10 @@
 #elif defined WEB_API
   #include "IPlugWeb.h"
   typedef IPlugWeb IPlug;
+#elif defined BENCH_API
+  #include "IPlugBench.h"
+  typedef IPlugBench IPlug;
+  #define API_EXT "bench"
 #elif defined VST3_API
   #define IPLUG_VST3
   #include "IPlugVST3.h"
@@ -87,6 +91,7 @@
   #define EXPORT __attribute__ ((visibility("default")))
 #elif defined OS_LINUX
   //TODO:
+  #define BUNDLE_ID ""
 #elif defined OS_WEB
   #define BUNDLE_ID ""
 #else
@@ -398,6 +398,13 @@ extern "C"
     
     return 0;
   }
+#pragma mark - BENCH
+#elif defined BENCH_API
+  IPlug* MakePlug()
+  {
+    IPlugInstanceInfo instanceInfo;
+    return new PLUG_CLASS_NAME(instanceInfo);
+  }
 #else
   #error "No API defined!"
 #endif
@@ -438,6 +445,10 @@ DWORD GetTickCount()
     PLUG_LATENCY, PLUG_DOES_MIDI_IN, PLUG_DOES_MIDI_OUT, PLUG_DOES_MPE, PLUG_DOES_STATE_CHUNKS, PLUG_TYPE, \
     PLUG_HAS_UI, PLUG_WIDTH, PLUG_HEIGHT, BUNDLE_ID))
 
+#ifdef RT_GUARD
+#include "IPlugRTGuardHooks.h"
+#endif
+
 #if !defined NO_IGRAPHICS && !defined VST3P_API
 #include "IGraphics_include_in_plug_src.h"
 #endif
@@ -17,6 +17,7 @@
 
 #include "IPlugVST3_Parameter.h"
 #include "IPlugVST3_view.h"
+#include "IPlugMsgRing.h"
 
 using namespace Steinberg;
 using namespace Steinberg::Vst;
@@ -378,70 +379,20 @@ tresult PLUGIN_API IPlugVST3Controller::notify(IMessage* message)
   if (!message)
     return kInvalidArgument;
   
-  if (!strcmp (message->getMessageID(), "SCVFD"))
+  if (!strcmp (message->getMessageID(), "SBMFD")) // a batch of IMsgRecords from the processor
   {
-    Steinberg::int64 controlTag = kNoTag;
-    double normalizedValue = 0.;
-    
-    if(message->getAttributes()->getInt("CT", controlTag) == kResultFalse)
-      return kResultFalse;
-    
-    if(message->getAttributes()->getFloat("NV", normalizedValue) == kResultFalse)
-      return kResultFalse;
-    
-    SendControlValueFromDelegate((int) controlTag, normalizedValue);
-
-  }
-  else if (!strcmp (message->getMessageID(), "SCMFD"))
-  {
-    const void* data;
-    Steinberg::int64 controlTag = kNoTag;
-    Steinberg::int64 messageTag = kNoTag;
-
-    if(message->getAttributes()->getInt("CT", controlTag) == kResultFalse)
-      return kResultFalse;
-    
-    if(message->getAttributes()->getInt("MT", messageTag) == kResultFalse)
-      return kResultFalse;
-
+    const void* data = nullptr;
     Steinberg::uint32 size;
     
     if (message->getAttributes()->getBinary("D", data, size) == kResultOk)
     {
-      SendControlMsgFromDelegate((int) controlTag, (int) messageTag, size, data);
+      IMsgBatch::Read(data, (int) size, [this](const IMsgRecord& record) {
+        record.SendToDelegate(*this);
+      });
+      
       return kResultOk;
     }
   }
-  else if (!strcmp (message->getMessageID(), "SMMFD"))
-  {
-    const void* data = nullptr;
-    uint32 size;
-    
-    if (message->getAttributes()->getBinary("D", data, size) == kResultOk)
-    {
-      if (size == sizeof(IMidiMsg))
-      {
-        IMidiMsg msg;
-        memcpy(&msg, data, size);
-        SendMidiMsgFromDelegate(msg);
-      }
-    }
-  }
-  else if (!strcmp (message->getMessageID(), "SSMFD"))
-  {
-    const void* data = nullptr;
-    uint32 size;
-    int64 offset;
-    
-    if (message->getAttributes()->getBinary("D", data, size) == kResultOk)
-    {
-      if (message->getAttributes()->getInt("O", offset) == kResultOk)
-      {
-        ISysEx msg {static_cast<int>(offset), static_cast<const uint8_t*>(data), static_cast<int>(size)};
-        SendSysexMsgFromDelegate(msg);
-      }
-    }
-  }
   
   return ComponentBase::notify(message);
 }
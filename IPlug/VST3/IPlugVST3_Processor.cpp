@@ -598,51 +598,17 @@ void IPlugVST3Processor::PrepareProcessContext()
 
 void IPlugVST3Processor::SendControlValueFromDelegate(int controlTag, double normalizedValue)
 {
-  OPtr<IMessage> message = allocateMessage();
-  
-  if (!message)
-    return;
-  
-  message->setMessageID("SCVFD");
-  message->getAttributes()->setInt("CT", controlTag);
-  message->getAttributes()->setFloat("NV", normalizedValue);
-  
-  sendMessage(message);
+  mMsgsToController.AddControlValue(controlTag, normalizedValue);
 }
 
 void IPlugVST3Processor::SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize, const void* pData)
 {
-  OPtr<IMessage> message = allocateMessage();
-  
-  if (!message)
-    return;
-  
-  message->setMessageID("SCMFD");
-  message->getAttributes()->setInt("CT", controlTag);
-  message->getAttributes()->setInt("MT", messageTag);
-  message->getAttributes()->setBinary("D", pData, dataSize);
-  
-  sendMessage(message);
+  mMsgsToController.AddControlMsg(controlTag, messageTag, dataSize, pData);
 }
 
 void IPlugVST3Processor::SendArbitraryMsgFromDelegate(int messageTag, int dataSize, const void* pData)
 {
-  OPtr<IMessage> message = allocateMessage();
-  
-  if (!message)
-    return;
-  
-  if(dataSize == 0) // allow sending messages with no data
-  {
-    dataSize = 1;
-    uint8_t dummy = 0;
-    pData = &dummy;
-  }
-  
-  message->setMessageID("SAMFD");
-  message->getAttributes()->setInt("MT", messageTag);
-  message->getAttributes()->setBinary("D", pData, dataSize);
-  sendMessage(message);
+  mMsgsToController.AddArbitraryMsg(messageTag, kNoTag, dataSize, pData);
 }
 
 bool IPlugVST3Processor::SendMidiMsg(const IMidiMsg& msg)
@@ -698,26 +664,27 @@ tresult PLUGIN_API IPlugVST3Processor::notify(IMessage* message)
 
 void IPlugVST3Processor::TransmitMidiMsgFromProcessor(const IMidiMsg& msg)
 {
-  OPtr<IMessage> message = allocateMessage();
-  
-  if (!message)
-    return;
-  
-  message->setMessageID("SMMFD");
-  message->getAttributes()->setBinary("D", (void*) &msg, sizeof(IMidiMsg));
-  sendMessage(message);
+  mMsgsToController.AddMidiMsg(msg);
 }
 
 void IPlugVST3Processor::TransmitSysExDataFromProcessor(const SysExData& data)
 {
+  mMsgsToController.AddSysEx(data.mOffset, data.mSize, data.mData);
+}
+
+void IPlugVST3Processor::TransmitMsgBatchFromProcessor()
+{
+  if (mMsgsToController.Empty())
+    return;
+  
   OPtr<IMessage> message = allocateMessage();
   
-  if (!message)
-    return;
+  if (message)
+  {
+    message->setMessageID("SBMFD");
+    message->getAttributes()->setBinary("D", mMsgsToController.GetData(), mMsgsToController.GetSize());
+    sendMessage(message);
+  }
   
-  message->setMessageID("SSMFD");
-  message->getAttributes()->setBinary("D", (void*) data.mData, data.mSize);
-  message->getAttributes()->setInt("O", data.mOffset);
-  sendMessage(message);
+  mMsgsToController.Clear();
 }
-
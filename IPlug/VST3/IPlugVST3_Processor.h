@@ -19,6 +19,7 @@
 
 #include "IPlugAPIBase.h"
 #include "IPlugProcessor.h"
+#include "IPlugMsgRing.h"
 
 /**
  * @file
@@ -67,6 +68,7 @@ public:
 private:
   void TransmitMidiMsgFromProcessor(const IMidiMsg& msg) override;
   void TransmitSysExDataFromProcessor(const SysExData& data) override;
+  void TransmitMsgBatchFromProcessor() override;
 
   bool mSidechainActive = false;
 
@@ -79,6 +81,7 @@ private:
   ProcessContext mProcessContext;
   ParameterChanges mOutputParamChanges;
   IMidiQueue mMidiOutputQueue;
+  IMsgBatch mMsgsToController; // messages to the controller, as IMsgRecords, sent in one IMessage per timer tick
 };
 
 IPlugVST3Processor* MakeProcessor();
@@ -66,12 +66,9 @@ void IPlugWAM::onProcess(WAM::AudioBus* pAudio, void* pData)
   //emulate IPlugAPIBase::OnTimer - should be called on the main thread - how to do that in audio worklet processor?
   if(mBlockCounter == 0)
   {
-    while(mParamChangeFromProcessor.ElementsAvailable())
-    {
-      IParamChange p;
-      mParamChangeFromProcessor.Pop(p);
+    mParamChangeFromProcessor.Drain([this](const IParamChange& p) {
       SendParameterValueFromDelegate(p.paramIdx, p.value, p.normalized);
-    }
+    });
     
     while (mMidiMsgsFromProcessor.ElementsAvailable())
     {
@@ -86,6 +83,17 @@ void IPlugWAM::onProcess(WAM::AudioBus* pAudio, void* pData)
   }
   
   mBlockCounter--;
+  
+  FlushMsgsToController();
+}
+
+void IPlugWAM::FlushMsgsToController()
+{
+  if (mMsgsToController.Empty())
+    return;
+  
+  postMessage("SBMFD", "", mMsgsToController.GetData(), (uint32_t) mMsgsToController.GetSize());
+  mMsgsToController.Clear();
 }
 
 void IPlugWAM::onMessage(char* verb, char* res, double data)
@@ -142,12 +150,8 @@ void IPlugWAM::onMidi(byte status, byte data1, byte data2)
   ProcessMidiMsg(msg); // onMidi is not called on HPT. We could queue things up, but just process the message straightaway for now
   //mMidiMsgsFromProcessor.Push(msg);
   
-  WDL_String dataStr;
-  dataStr.SetFormatted(16, "%i:%i:%i", msg.mStatus, msg.mData1, msg.mData2);
-  
-  // TODO: in the future this will be done via shared array buffer
   // if onMidi ever gets called on HPT, should defer via queue
-  postMessage("SMMFD", dataStr.Get(), "");
+  mMsgsToController.AddMidiMsg(msg);
 }
 
 void IPlugWAM::onParam(uint32_t idparam, double value)
@@ -161,52 +165,26 @@ void IPlugWAM::onSysex(byte* pData, uint32_t size)
   ISysEx sysex = {0 /* no offset */, pData, (int) size };
   ProcessSysEx(sysex);
   
-  WDL_String dataStr;
-  dataStr.SetFormatted(16, "%i", size);
-  
-  // TODO: in the future this will be done via shared array buffer
   // if onSysex ever gets called on HPT, should defer via queue
-  postMessage("SSMFD", dataStr.Get(), "");
+  mMsgsToController.AddSysEx(sysex.mOffset, sysex.mSize, sysex.mData);
 }
 
 void IPlugWAM::SendControlValueFromDelegate(int controlTag, double normalizedValue)
 {
-  WDL_String propStr;
-  WDL_String dataStr;
-
-  propStr.SetFormatted(16, "%i", controlTag);
-  dataStr.SetFormatted(16, "%f", normalizedValue);
-
-  // TODO: in the future this will be done via shared array buffer
-  postMessage("SCVFD", propStr.Get(), dataStr.Get());
+  mMsgsToController.AddControlValue(controlTag, normalizedValue);
 }
 
 void IPlugWAM::SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize, const void* pData)
 {
-  WDL_String propStr;
-  propStr.SetFormatted(16, "%i:%i", controlTag, messageTag);
-  
-  // TODO: in the future this will be done via shared array buffer
-  postMessage("SCMFD", propStr.Get(), pData, (uint32_t) dataSize);
+  mMsgsToController.AddControlMsg(controlTag, messageTag, dataSize, pData);
 }
 
 void IPlugWAM::SendParameterValueFromDelegate(int paramIdx, double value, bool normalized)
 {
-  WDL_String propStr;
-  WDL_String dataStr;
-  propStr.SetFormatted(16, "%i", paramIdx);
-  dataStr.SetFormatted(16, "%f", value);
-
-  // TODO: in the future this will be done via shared array buffer
-  postMessage("SPVFD", propStr.Get(), dataStr.Get());
+  mMsgsToController.AddParamValue(paramIdx, value, normalized);
 }
 
 void IPlugWAM::SendArbitraryMsgFromDelegate(int messageTag, int dataSize, const void* pData)
 {
-  WDL_String propStr;
-  propStr.SetFormatted(16, "%i", messageTag);
-  
-  // TODO: in the future this will be done via shared array buffer
-  postMessage("SAMFD", propStr.Get(), pData, (uint32_t) dataSize);
+  mMsgsToController.AddArbitraryMsg(messageTag, kNoTag, dataSize, pData);
 }
-
@@ -13,6 +13,7 @@
 
 #include "IPlugAPIBase.h"
 #include "IPlugProcessor.h"
+#include "IPlugMsgRing.h"
 #include "processor.h"
 
 using namespace WAM;
@@ -55,7 +56,11 @@ public:
   void SendArbitraryMsgFromDelegate(int messageTag, int dataSize = 0, const void* pData = nullptr) override;
   
 private:
+  /** Posts the messages batched since the last call to the controller as one "SBMFD" message */
+  void FlushMsgsToController();
+
   int mBlockCounter = 0;
+  IMsgBatch mMsgsToController; // messages to the controller, as IMsgRecords, posted once per block
 };
 
 IPlugWAM* MakePlug();
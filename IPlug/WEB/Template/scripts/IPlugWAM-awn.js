@@ -26,7 +26,56 @@ class NAME_PLACEHOLDERController extends WAMController
       console.log("got WAM descriptor...");
     }
 
-    if(msg.verb == "SPVFD") {
+    //Send Batched Messages From Delegate - fixed layout records, see IPlugMsgRing.h
+    if(msg.verb == "SBMFD") {
+      var bytes = new Uint8Array(msg.data);
+      var dv = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+      var pos = 0;
+
+      function sendDataToModule(func, arg1, arg2, size) {
+        const buffer = Module._malloc(size);
+        Module.HEAPU8.set(bytes.subarray(pos + 32, pos + 32 + size), buffer);
+        if(arg2 === null)
+          func(arg1, size, buffer);
+        else
+          func(arg1, arg2, size, buffer);
+        Module._free(buffer);
+      }
+
+      while(pos + 32 <= dv.byteLength) {
+        var size = dv.getUint32(pos, true);
+
+        if(size < 32 || pos + size > dv.byteLength)
+          break;
+
+        var type = dv.getUint16(pos + 4, true);
+        var idx = dv.getInt32(pos + 8, true);
+        var tag = dv.getInt32(pos + 12, true);
+        var dataSize = dv.getInt32(pos + 16, true);
+        var value = dv.getFloat64(pos + 24, true);
+
+        if(type == 1) // parameter value
+          Module.SPVFD(idx, value);
+        else if(type == 2) // control value
+          Module.SCVFD(idx, value);
+        else if(type == 3) // control message
+          sendDataToModule(Module.SCMFD, idx, tag, dataSize);
+        else if(type == 4) // arbitrary message
+          sendDataToModule(Module.SAMFD, tag, null, dataSize);
+        else if(type == 5) // MIDI message
+          Module.SMMFD(tag & 0xff, (tag >> 8) & 0xff, (tag >> 16) & 0xff);
+        else if(type == 6) // sysex message
+        {
+          const buffer = Module._malloc(dataSize);
+          Module.HEAPU8.set(bytes.subarray(pos + 32, pos + 32 + dataSize), buffer);
+          Module.SSMFD(dataSize, buffer);
+          Module._free(buffer);
+        }
+
+        pos += size;
+      }
+    }
+    else if(msg.verb == "SPVFD") {
       Module.SPVFD(parseInt(msg.prop), parseFloat(msg.data));
     }
     //Send Control Message From Delegate
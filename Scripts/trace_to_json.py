@@ -0,0 +1,88 @@
+#!/usr/bin/python
+
+# python script to convert a binary trace written by a TRACER_BUILD (see IPlug/IPlugTraceRing.h) to Chrome trace event JSON
+# open the result in chrome://tracing or https://ui.perfetto.dev
+
+import json, struct, sys
+
+CHUNK_STRING = 1
+CHUNK_EVENT = 2
+CHUNK_DROPPED = 3
+
+def read(f, fmt):
+  size = struct.calcsize(fmt)
+  data = f.read(size)
+
+  if len(data) < size:
+    raise EOFError()
+
+  return struct.unpack(fmt, data)
+
+def decode(inPath):
+  events = []
+  strings = { 0 : "" }
+
+  with open(inPath, "rb") as f:
+    if f.read(4) != b"IPTR":
+      raise ValueError(inPath + " is not an IPlug trace file")
+
+    version, maxArgs = read(f, "=II")
+
+    if version != 1:
+      raise ValueError("unsupported trace file version " + str(version))
+
+    try:
+      while True:
+        chunk, = read(f, "=B")
+
+        if chunk == CHUNK_STRING:
+          id, length = read(f, "=II")
+          strings[id] = f.read(length).decode("utf-8", "replace")
+        elif chunk == CHUNK_EVENT:
+          time, tid, funcID, labelID, line, phase, nArgs = read(f, "=QIIIiBB")
+          args = read(f, "=" + "d" * nArgs) if nArgs else ()
+          funcName = strings.get(funcID, "?")
+          label = strings.get(labelID, "")
+
+          event = {
+            "name" : label if label else funcName,
+            "cat" : funcName,
+            "ph" : chr(phase),
+            "ts" : time / 1000.0,
+            "pid" : 0,
+            "tid" : tid,
+            "args" : { "line" : line }
+          }
+
+          for i, value in enumerate(args):
+            event["args"]["v" + str(i)] = value
+
+          if event["ph"] == "i":
+            event["s"] = "t"
+
+          events.append(event)
+        elif chunk == CHUNK_DROPPED:
+          tid, count = read(f, "=II")
+          time = events[-1]["ts"] if events else 0
+          events.append({ "name" : "dropped " + str(count) + " records", "ph" : "i", "s" : "t", "ts" : time, "pid" : 0, "tid" : tid })
+        else:
+          raise ValueError("corrupt trace file, unknown chunk type " + str(chunk))
+    except EOFError:
+      pass # the last chunk may be incomplete if the plug-in crashed
+
+  return events
+
+def main():
+  if len(sys.argv) != 3:
+    print("Usage: trace_to_json.py IPlugTrace.bin trace.json")
+    sys.exit(1)
+
+  events = decode(sys.argv[1])
+
+  with open(sys.argv[2], "w") as f:
+    json.dump({ "traceEvents" : events, "displayTimeUnit" : "ns" }, f)
+
+  print("wrote " + str(len(events)) + " events to " + sys.argv[2])
+
+if __name__ == '__main__':
+  main()
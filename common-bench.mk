@@ -0,0 +1,77 @@
+# Makefile fragment for the headless IPlugBench target, see IPlug/BENCH/IPlugBench.h
+# Include this from a project makefile that adds the plug-in sources to SRC and sets TARGET, e.g. projects/IPlugEffect-bench.mk
+# Build with "make -f projects/IPlugEffect-bench.mk" from the project folder, add PRECISION=float to build with single precision processing
+# Add RT_GUARD=1 to detect allocations and locks on the audio thread (see IPlug/IPlugRTGuard.h), which --fail-on-violation needs.
+# The hooks slow down every allocation, so the timings are only representative without it
+
+ROOT ?= ../..
+PROJECT_ROOT = .
+DEPS_PATH = $(ROOT)/Dependencies
+WDL_PATH = $(ROOT)/WDL
+IPLUG_PATH = $(ROOT)/IPlug
+SWELL_PATH = $(WDL_PATH)/swell
+IGRAPHICS_PATH = $(ROOT)/IGraphics
+CONTROLS_PATH = $(IGRAPHICS_PATH)/Controls
+PLATFORMS_PATH = $(IGRAPHICS_PATH)/Platforms
+DRAWING_PATH = $(IGRAPHICS_PATH)/Drawing
+IPLUG_EXTRAS_PATH = $(IPLUG_PATH)/Extras
+IPLUG_SYNTH_PATH = $(IPLUG_EXTRAS_PATH)/Synth
+IPLUG_FAUST_PATH = $(IPLUG_EXTRAS_PATH)/Faust
+IPLUG_BENCH_PATH = $(IPLUG_PATH)/BENCH
+NANOSVG_PATH = $(DEPS_PATH)/IGraphics/NanoSVG/src
+
+CXX ?= c++
+PRECISION ?= double
+RT_GUARD ?= 0
+
+# no IPlugTimer.cpp, the bench has no main loop
+IPLUG_SRC = $(IPLUG_PATH)/IPlugAPIBase.cpp \
+	$(IPLUG_PATH)/IPlugParameter.cpp \
+	$(IPLUG_PATH)/IPlugPluginBase.cpp
+
+# the driver: the bench tool by default, or IPlug/Extras/Sandbox/IPlugSandbox_child.cpp for a sandbox child process
+BENCH_MAIN ?= $(IPLUG_BENCH_PATH)/IPlugBench_main.cpp
+
+BENCH_SRC = $(IPLUG_BENCH_PATH)/IPlugBench.cpp \
+	$(BENCH_MAIN)
+
+# IGraphics headers are on the include path so that plug-in sources that include them unconditionally still compile, nothing is drawn
+INCLUDE_PATHS = -I$(PROJECT_ROOT) \
+-I$(WDL_PATH) \
+-I$(IPLUG_PATH) \
+-I$(IPLUG_EXTRAS_PATH) \
+-I$(IPLUG_SYNTH_PATH) \
+-I$(IPLUG_FAUST_PATH) \
+-I$(IPLUG_BENCH_PATH) \
+-I$(IGRAPHICS_PATH) \
+-I$(CONTROLS_PATH) \
+-I$(DRAWING_PATH) \
+-I$(PLATFORMS_PATH) \
+-I$(NANOSVG_PATH) \
+-I$(SWELL_PATH)
+
+SRC = $(IPLUG_SRC) $(BENCH_SRC)
+
+CFLAGS = $(INCLUDE_PATHS) \
+-std=c++14 \
+-O2 \
+-DNDEBUG \
+-DBENCH_API \
+-DNO_IGRAPHICS \
+-DIPLUG_DSP=1 \
+-DIPLUG_EDITOR=0 \
+-DWDL_NO_DEFINE_MINMAX \
+-DNOMINMAX \
+-Wno-multichar
+
+ifeq ($(PRECISION),float)
+CFLAGS += -DSAMPLE_TYPE_FLOAT
+else
+CFLAGS += -DSAMPLE_TYPE_DOUBLE
+endif
+
+ifeq ($(RT_GUARD),1)
+CFLAGS += -DRT_GUARD
+endif
+
+LDFLAGS = -lpthread -ldl -rdynamic